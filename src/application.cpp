@@ -1,208 +1,781 @@
-#include "application.h"
-
-namespace FilterMakers {
-
-    Manipulator* MakeFastGaussianBlurFilter(const FilterDescriptor& fd) {
-        if (fd.GetFilterName() != "-blur") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeBlurFilter");
-        }
-        if (fd.GetParams().size() > 1) {
-            throw std::invalid_argument("invalid arguments number passed to MakeBlurFilter");
-        }
-        char *dummy;
-        double sigma = 1.0;
-        if (fd.GetParams().size() == 1) {
-            sigma = std::strtod(fd.GetParams()[0].begin(), &dummy);
-        }
-        return new FastGaussianBlurFilter(sigma);
-    }
-
-    Manipulator* MakeCropFilter(const FilterDescriptor& fd) {
-        if (fd.GetFilterName() != "-crop") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeCropFilter");
-        }
-        if (fd.GetParams().size() != 2) {
-            throw std::invalid_argument("invalid arguments number passed to MakeCropFilter");
-        }
-        char* dummy;
-        size_t width = std::strtol(fd.GetParams()[0].begin(), &dummy, 10);
-        size_t height = std::strtol(fd.GetParams()[1].begin(), &dummy, 10);
-        return new CropFilter(width, height);
-    }
-
-    Manipulator* MakeSharpeningFilter(const FilterDescriptor& fd) {
-        if (fd.GetFilterName() != "-sharp") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeSharpeningFilter");
-        }
-        return new SharpeningFilter();
-    }
-
-    Manipulator* MakeEdgeDetectionFilter(const FilterDescriptor& fd) {
-        if (fd.GetFilterName() != "-edge") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeEdgeDetectionFilter");
-        }
-        if (fd.GetParams().size() > 1) {
-            throw std::invalid_argument("invalid arguments number passed to MakeEdgeDetectionFilter");
-        }
-        double threshold = 0;
-        if (fd.GetParams().empty()) {
-            threshold = 0.33;
-        } else {
-            char* dummy;
-            threshold = std::strtod(fd.GetParams()[0].begin(), &dummy);
-        }
-        return new EdgeDetectionFilter(threshold);
-    }
-
-    Manipulator* MakeNegativeFilter(const FilterDescriptor &fd) {
-        if (fd.GetFilterName() != "-neg") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeNegativeFilter");
-        }
-        if (!fd.GetParams().empty()) {
-            throw std::invalid_argument("invalid arguments number passed to MakeNegativeFilter");
-        }
-        return new NegativeFilter();
-    }
-
-    Manipulator *MakeToGreyscaleBasicFilter(const FilterDescriptor &fd) {
-        if (fd.GetFilterName() != "-gsbasic") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeToGreyscaleBasicFilter");
-        }
-        if (fd.GetParams().empty()) {
-            throw std::invalid_argument("invalid arguments number passed to MakeToGreyscaleBasicFilter");
-        }
-        return new ToGreyscaleBasicFilter();
-    }
-
-    Manipulator *MakeToGreyscaleFilter(const FilterDescriptor &fd) {
-        if (fd.GetFilterName() != "-gs") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeToGreyscaleFilter");
-        }
-        if (!fd.GetParams().empty()) {
-            throw std::invalid_argument("invalid arguments number passed to MakeToGreyscaleFilter");
-        }
-        return new ToGreyscaleFilter();
-    }
-
-    Manipulator* MakeCurvesFilter(const FilterDescriptor &fd) {
-        if (fd.GetFilterName() != "-curves") {
-            throw std::invalid_argument("invalid filter descriptor passed to MakeCurvesFilter");
-        }
-        if ((fd.GetParams().size() % 2) != 0) {
-            throw std::invalid_argument("invalid arguments number passed to MakeCurvesFilter");
-        }
-        size_t size = fd.GetParams().size();
-        const std::vector<std::string_view>& params = fd.GetParams();
-        std::vector<PixelParameters::Scalar> xs(0);
-        std::vector<PixelParameters::Scalar> ys(0);
-        std::map<PixelParameters::Scalar, PixelParameters::Scalar> values;
-        for (size_t i = 0; i < size / 2; ++i) {
-            char* dummy;
-            double x_i = std::strtod(params[2 * i].begin(), &dummy);
-            double y_i = std::strtod(params[2 * i + 1].begin(), &dummy);
-            auto ptr_i = values.find(x_i);
-            if (ptr_i != values.end()) {
-                throw std::invalid_argument("Identical x-coordinates found at MakeCurvesFilter");
-            }
-            values.insert({x_i, y_i});
-        }
-        auto ptr_0 = values.find(0);
-        if (ptr_0 == values.end()) {
-            values.insert({0, 0});
-        }
-
-        auto ptr_1 = values.find(1);
-        if (ptr_1 == values.end()) {
-            values.insert({1, 1});
-        }
-
-        for (auto& [x_i, y_i] : values) {
-            xs.push_back(x_i);
-            ys.push_back(y_i);
-        }
-        return new CurvesFilter(xs, ys);
-    }
-
-}
-
-void Application::Configure() {
-    GetFilterPipelineMaker().AddFilterCreator("-blur", FilterMakers::MakeFastGaussianBlurFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-crop", FilterMakers::MakeCropFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-sharp", FilterMakers::MakeSharpeningFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-edge", FilterMakers::MakeEdgeDetectionFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-neg", FilterMakers::MakeNegativeFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-gsbasic", FilterMakers::MakeToGreyscaleBasicFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-gs", FilterMakers::MakeToGreyscaleFilter);
-    GetFilterPipelineMaker().AddFilterCreator("-curves", FilterMakers::MakeCurvesFilter);
-    helpers_.insert({"-blur", FastGaussianBlurFilter::GetHelp});
-    helpers_.insert({"-crop", CropFilter::GetHelp});
-    helpers_.insert({"-sharp", SharpeningFilter::GetHelp});
-    helpers_.insert({"-edge", EdgeDetectionFilter::GetHelp});
-    helpers_.insert({"-neg", NegativeFilter::GetHelp});
-    helpers_.insert({"-gsbasic", ToGreyscaleBasicFilter::GetHelp});
-    helpers_.insert({"-gs", ToGreyscaleFilter::GetHelp});
-    helpers_.insert({"-curves", CurvesFilter::GetHelp});
-    helpers_.insert({"-h", GetHelp});
-}
-
-FilterPipelineMaker &Application::GetFilterPipelineMaker() {
-    return filter_pipeline_maker_;
-}
-
-void Application::Run(int argc, char **argv) {
-    try {
-        CommandLineParser clm;
-        // Testing(); // TODO: перенести тестирование в отдельную компоненту
-        bool is_parsed = clm.Parse(argc, argv);
-        std::cout << "Reading input..." << std::endl;
-        if (!is_parsed) {
-            if (clm.IsUsedForHelp()) {
-                std::cout << GetHelper(clm.GetDesiredFunction())() << std::endl;
-            } else {
-                std::cout << WRONG_INPUT << std::endl;
-            }
-            return;
-        }
-        std::cout << "Parsed successfully" << std::endl;
-        Bitmap input_bitmap;
-        std::cout << "Loading file..." << std::endl;
-        bool is_loaded = input_bitmap.load(clm.GetInput().begin());
-        if (!is_loaded) {
-            std::cout << "file could not be loaded or has wrong type" << std::endl;
-            return;
-        }
-        std::cout << "Loaded successfully" << std::endl;
-        FilterPipelineMaker& maker = GetFilterPipelineMaker();
-        std::cout << "Creating pipeline..." << std::endl;
-        FilterPipeline pipeline = maker.BuildPipeline(clm.GetDescriptions());
-        std::cout << "Created successfully" << std::endl;
-        std::cout << "Applying filters..." << std::endl;
-        Bitmap output_bitmap = pipeline.Apply(input_bitmap);
-        std::cout << "Applied successfully" << std::endl;
-        std::cout << "Saving file..." << std::endl;
-        bool is_saved = output_bitmap.save(clm.GetOutput().begin());
-        if (!is_saved) {
-            std::cout << "file could not be saved" << std::endl;
-            return;
-        }
-        std::cout << "Result saved to " << clm.GetOutput() << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << "Fatal failure! Caught exception: ";
-        std::cerr << e.what();
-    }
-}
-
-std::string Application::GetHelp() {
-    return HELP;
-}
-Application::FilterHelpers Application::GetHelpers() const {
-    return helpers_;
-}
-
-Application::FilterHelper Application::GetHelper(std::string_view query) const {
-    auto helper_ptr = helpers_.find(query);
-    if (helper_ptr != GetHelpers().end()) {
-        return *helper_ptr->second;
-    }
-    return []() -> std::string { return WRONG_INPUT; };
-}
+#include "application.h"
+
+namespace {
+// A size parameter (a radius, a width): a non-negative integer, std::invalid_argument naming the maker otherwise.
+size_t ParseSize(std::string_view param, const std::string& maker) {
+    char* end;
+    long value = std::strtol(param.data(), &end, 10);
+    if (param.empty() || end != param.data() + param.size() || value < 0) {
+        throw std::invalid_argument("invalid size " + std::string(param) + " passed to " + maker);
+    }
+    return static_cast<size_t>(value);
+}
+
+// A size in MiB (--cache-size, --max-memory) in bytes, std::invalid_argument naming the option unless it fits.
+size_t ParseMegabytes(std::string_view param, const std::string& option) {
+    size_t megabytes = ParseSize(param, option);
+    if (megabytes > (SIZE_MAX >> 20)) {
+        throw std::invalid_argument("invalid size " + std::string(param) + " passed to " + option);
+    }
+    return megabytes << 20;
+}
+}  // namespace
+
+namespace FilterMakers {
+
+    Manipulator* MakeFastGaussianBlurFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-blur") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeBlurFilter");
+        }
+        if (fd.GetParams().size() > 1 && fd.GetParams()[1] == "precise") {
+            return MakeGaussianBlurFilter(fd);
+        }
+        if (fd.GetParams().size() > 1 && fd.GetParams()[1] == "pyramid") {
+            return MakePyramidGaussianBlurFilter(fd);
+        }
+        if (fd.GetParams().size() > 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeBlurFilter");
+        }
+        char *dummy;
+        double sigma = 1.0;
+        if (fd.GetParams().size() == 1) {
+            sigma = std::strtod(fd.GetParams()[0].begin(), &dummy);
+        }
+        return new FastGaussianBlurFilter(sigma);
+    }
+
+    Manipulator* MakeGaussianBlurFilter(const FilterDescriptor& fd) {
+        const std::vector<std::string_view>& params = fd.GetParams();
+        if (fd.GetFilterName() != "-blur" || params.size() < 2 || params[1] != "precise") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeGaussianBlurFilter");
+        }
+        if (params.size() > 3) {
+            throw std::invalid_argument("invalid arguments number passed to MakeGaussianBlurFilter");
+        }
+        char* dummy;
+        double sigma = std::strtod(params[0].begin(), &dummy);
+        double epsilon = ManipulatorParameters::GAUSSIAN_EPSILON;
+        if (params.size() == 3) {
+            epsilon = std::strtod(params[2].begin(), &dummy);
+        }
+        return new GaussianBlurFilter(sigma, epsilon);
+    }
+
+    Manipulator* MakePyramidGaussianBlurFilter(const FilterDescriptor& fd) {
+        const std::vector<std::string_view>& params = fd.GetParams();
+        if (fd.GetFilterName() != "-blur" || params.size() != 2 || params[1] != "pyramid") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakePyramidGaussianBlurFilter");
+        }
+        char* dummy;
+        double sigma = std::strtod(params[0].begin(), &dummy);
+        return new PyramidGaussianBlurFilter(sigma);
+    }
+
+    Manipulator* MakeMedianFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-median") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeMedianFilter");
+        }
+        if (fd.GetParams().size() > 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeMedianFilter");
+        }
+        size_t radius = 1;
+        if (fd.GetParams().size() == 1) {
+            radius = ParseSize(fd.GetParams()[0], "MakeMedianFilter");
+        }
+        return new MedianFilter(radius);
+    }
+
+    Manipulator* MakeResizeFilter(const FilterDescriptor& fd) {
+        const std::vector<std::string_view>& params = fd.GetParams();
+        if (fd.GetFilterName() != "-resize") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeResizeFilter");
+        }
+        if (params.size() != 2 && params.size() != 3) {
+            throw std::invalid_argument("invalid arguments number passed to MakeResizeFilter");
+        }
+        size_t width = ParseSize(params[0], "MakeResizeFilter");
+        size_t height = ParseSize(params[1], "MakeResizeFilter");
+        ResampleParameters::Kernel kernel = ResampleParameters::Kernel::Bicubic;
+        if (params.size() == 3) {
+            if (params[2] == "box") {
+                kernel = ResampleParameters::Kernel::Box;
+            } else if (params[2] == "bilinear") {
+                kernel = ResampleParameters::Kernel::Bilinear;
+            } else if (params[2] == "lanczos") {
+                kernel = ResampleParameters::Kernel::Lanczos;
+            } else if (params[2] != "bicubic") {
+                throw std::invalid_argument("unknown kernel passed to MakeResizeFilter");
+            }
+        }
+        return new ResizeFilter(width, height, kernel);
+    }
+
+    Manipulator* MakeOrientationFilter(const FilterDescriptor& fd) {
+        using OrientationParameters::Operation;
+        std::string_view name = fd.GetFilterName();
+        const std::vector<std::string_view> params = fd.GetParams();
+        if (name == "-transpose" && params.empty()) {
+            return new OrientationFilter(Operation::Transpose);
+        }
+        if (name == "-flip" && params.size() <= 1) {
+            if (params.empty() || params[0] == "h") {
+                return new OrientationFilter(Operation::FlipHorizontal);
+            }
+            if (params[0] == "v") {
+                return new OrientationFilter(Operation::FlipVertical);
+            }
+        }
+        if (name == "-rotate" && params.size() == 1) {
+            const std::unordered_map<std::string_view, Operation> angles = {
+                {"90", Operation::Rotate90}, {"180", Operation::Rotate180}, {"270", Operation::Rotate270}};
+            auto angle = angles.find(params[0]);
+            if (angle != angles.end()) {
+                return new OrientationFilter(angle->second);
+            }
+        }
+        if (name != "-transpose" && name != "-flip" && name != "-rotate") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeOrientationFilter");
+        }
+        throw std::invalid_argument("invalid arguments passed to MakeOrientationFilter");
+    }
+
+    Manipulator* MakeStatisticsFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-stats") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeStatisticsFilter");
+        }
+        if (fd.GetParams().size() != 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeStatisticsFilter");
+        }
+        return new StatisticsFilter(std::string(fd.GetParams()[0]));
+    }
+
+    Manipulator* MakeAutoLevelsFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-autolevels") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeAutoLevelsFilter");
+        }
+        if (fd.GetParams().size() != 0 && fd.GetParams().size() != 2) {
+            throw std::invalid_argument("invalid arguments number passed to MakeAutoLevelsFilter");
+        }
+        if (fd.GetParams().empty()) {
+            return new AutoLevelsFilter(0.005, 0.995);
+        }
+        char* dummy;
+        double low = std::strtod(fd.GetParams()[0].begin(), &dummy);
+        double high = std::strtod(fd.GetParams()[1].begin(), &dummy);
+        return new AutoLevelsFilter(low, high);
+    }
+
+    Manipulator* MakeMorphologyFilter(const FilterDescriptor& fd) {
+        const std::unordered_map<std::string_view, MorphologyParameters::Operation> operations = {
+            {"-erode", MorphologyParameters::Operation::Erode},
+            {"-dilate", MorphologyParameters::Operation::Dilate},
+            {"-open", MorphologyParameters::Operation::Open},
+            {"-close", MorphologyParameters::Operation::Close}};
+        auto operation = operations.find(fd.GetFilterName());
+        if (operation == operations.end()) {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeMorphologyFilter");
+        }
+        if (fd.GetParams().empty() || fd.GetParams().size() > 2) {
+            throw std::invalid_argument("invalid arguments number passed to MakeMorphologyFilter");
+        }
+        size_t width = ParseSize(fd.GetParams()[0], "MakeMorphologyFilter");
+        size_t height = fd.GetParams().size() == 2 ? ParseSize(fd.GetParams()[1], "MakeMorphologyFilter") : width;
+        return new MorphologyFilter(operation->second, width, height);
+    }
+
+    Manipulator* MakeBoxBlurFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-boxblur") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeBoxBlurFilter");
+        }
+        if (fd.GetParams().size() != 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeBoxBlurFilter");
+        }
+        return new BoxBlurFilter(ParseSize(fd.GetParams()[0], "MakeBoxBlurFilter"));
+    }
+
+    Manipulator* MakeBilateralFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-bilateral") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeBilateralFilter");
+        }
+        if (fd.GetParams().size() != 2) {
+            throw std::invalid_argument("invalid arguments number passed to MakeBilateralFilter");
+        }
+        char* dummy;
+        double sigma_spatial = std::strtod(fd.GetParams()[0].begin(), &dummy);
+        double sigma_range = std::strtod(fd.GetParams()[1].begin(), &dummy);
+        return new BilateralFilter(sigma_spatial, sigma_range);
+    }
+
+    Manipulator* MakeCropFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-crop") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeCropFilter");
+        }
+        if (fd.GetParams().size() != 2) {
+            throw std::invalid_argument("invalid arguments number passed to MakeCropFilter");
+        }
+        char* dummy;
+        size_t width = std::strtol(fd.GetParams()[0].begin(), &dummy, 10);
+        size_t height = std::strtol(fd.GetParams()[1].begin(), &dummy, 10);
+        return new CropFilter(width, height);
+    }
+
+    Manipulator* MakeSharpeningFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-sharp") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeSharpeningFilter");
+        }
+        return new SharpeningFilter();
+    }
+
+    Manipulator* MakeEdgeDetectionFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-edge") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeEdgeDetectionFilter");
+        }
+        if (!fd.GetParams().empty() && fd.GetParams()[0] == "adaptive") {
+            if (fd.GetParams().size() < 2 || fd.GetParams().size() > 3) {
+                throw std::invalid_argument("invalid arguments number passed to MakeEdgeDetectionFilter");
+            }
+            char* dummy;
+            size_t radius = ParseSize(fd.GetParams()[1], "MakeEdgeDetectionFilter");
+            double offset = fd.GetParams().size() == 3 ? std::strtod(fd.GetParams()[2].begin(), &dummy) : 0.05;
+            return new AdaptiveEdgeDetectionFilter(radius, offset);
+        }
+        if (!fd.GetParams().empty() && fd.GetParams()[0] == "auto") {
+            if (fd.GetParams().size() > 2) {
+                throw std::invalid_argument("invalid arguments number passed to MakeEdgeDetectionFilter");
+            }
+            char* dummy;
+            double fraction = fd.GetParams().size() == 2 ? std::strtod(fd.GetParams()[1].begin(), &dummy) : 0.1;
+            return new AutoEdgeDetectionFilter(fraction);
+        }
+        if (fd.GetParams().size() > 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeEdgeDetectionFilter");
+        }
+        double threshold = 0;
+        if (fd.GetParams().empty()) {
+            threshold = 0.33;
+        } else {
+            char* dummy;
+            threshold = std::strtod(fd.GetParams()[0].begin(), &dummy);
+        }
+        return new EdgeDetectionFilter(threshold);
+    }
+
+    Manipulator* MakeNegativeFilter(const FilterDescriptor &fd) {
+        if (fd.GetFilterName() != "-neg") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeNegativeFilter");
+        }
+        if (!fd.GetParams().empty()) {
+            throw std::invalid_argument("invalid arguments number passed to MakeNegativeFilter");
+        }
+        return new NegativeFilter();
+    }
+
+    Manipulator *MakeToGreyscaleBasicFilter(const FilterDescriptor &fd) {
+        if (fd.GetFilterName() != "-gsbasic") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeToGreyscaleBasicFilter");
+        }
+        if (!fd.GetParams().empty()) {
+            throw std::invalid_argument("invalid arguments number passed to MakeToGreyscaleBasicFilter");
+        }
+        return new ToGreyscaleBasicFilter();
+    }
+
+    Manipulator *MakeToGreyscaleFilter(const FilterDescriptor &fd) {
+        if (fd.GetFilterName() != "-gs") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeToGreyscaleFilter");
+        }
+        if (!fd.GetParams().empty()) {
+            throw std::invalid_argument("invalid arguments number passed to MakeToGreyscaleFilter");
+        }
+        return new ToGreyscaleFilter();
+    }
+
+    Manipulator* MakeCurvesFilter(const FilterDescriptor &fd) {
+        if (fd.GetFilterName() != "-curves") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeCurvesFilter");
+        }
+        if ((fd.GetParams().size() % 2) != 0) {
+            throw std::invalid_argument("invalid arguments number passed to MakeCurvesFilter");
+        }
+        size_t size = fd.GetParams().size();
+        const std::vector<std::string_view>& params = fd.GetParams();
+        std::vector<PixelParameters::Scalar> xs(0);
+        std::vector<PixelParameters::Scalar> ys(0);
+        std::map<PixelParameters::Scalar, PixelParameters::Scalar> values;
+        for (size_t i = 0; i < size / 2; ++i) {
+            char* dummy;
+            double x_i = std::strtod(params[2 * i].begin(), &dummy);
+            double y_i = std::strtod(params[2 * i + 1].begin(), &dummy);
+            auto ptr_i = values.find(x_i);
+            if (ptr_i != values.end()) {
+                throw std::invalid_argument("Identical x-coordinates found at MakeCurvesFilter");
+            }
+            values.insert({x_i, y_i});
+        }
+        auto ptr_0 = values.find(0);
+        if (ptr_0 == values.end()) {
+            values.insert({0, 0});
+        }
+
+        auto ptr_1 = values.find(1);
+        if (ptr_1 == values.end()) {
+            values.insert({1, 1});
+        }
+
+        for (auto& [x_i, y_i] : values) {
+            xs.push_back(x_i);
+            ys.push_back(y_i);
+        }
+        return new CurvesFilter(xs, ys);
+    }
+
+    Manipulator* MakeConvolutionFilter(const FilterDescriptor& fd) {
+        if (fd.GetFilterName() != "-conv") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeConvolutionFilter");
+        }
+        const std::vector<std::string_view>& params = fd.GetParams();
+        std::vector<std::vector<ManipulatorParameters::ManipulatorBaseType>> kernel;
+        if (params.size() == 1) {
+            std::ifstream file{std::string(params[0])};
+            if (!file) {
+                throw std::invalid_argument("the kernel file could not be opened");
+            }
+            std::string line;
+            while (std::getline(file, line)) {
+                std::istringstream stream(line);
+                std::vector<ManipulatorParameters::ManipulatorBaseType> row;
+                ManipulatorParameters::ManipulatorBaseType weight = 0;
+                while (stream >> weight) {
+                    row.push_back(weight);
+                }
+                if (!stream.eof()) {
+                    throw std::invalid_argument("invalid kernel line " + line + " passed to MakeConvolutionFilter");
+                }
+                if (!row.empty()) {
+                    kernel.push_back(std::move(row));
+                }
+            }
+        } else {
+            if (params.size() < 2) {
+                throw std::invalid_argument("invalid arguments number passed to MakeConvolutionFilter");
+            }
+            size_t width = ParseSize(params[0], "MakeConvolutionFilter");
+            size_t height = ParseSize(params[1], "MakeConvolutionFilter");
+            // Both sides bounded by the number of parameters, so their product cannot overflow.
+            if (width == 0 || height == 0 || width > params.size() || height > params.size() ||
+                params.size() != 2 + width * height) {
+                throw std::invalid_argument("invalid arguments number passed to MakeConvolutionFilter");
+            }
+            kernel.resize(height);
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    std::string_view param = params[2 + y * width + x];
+                    char* end;
+                    kernel[y].push_back(std::strtod(param.data(), &end));
+                    if (param.empty() || end != param.data() + param.size()) {
+                        throw std::invalid_argument("invalid weight " + std::string(param) +
+                                                    " passed to MakeConvolutionFilter");
+                    }
+                }
+            }
+        }
+        if (kernel.empty()) {
+            throw std::invalid_argument("empty kernel passed to MakeConvolutionFilter");
+        }
+        for (const std::vector<ManipulatorParameters::ManipulatorBaseType>& row : kernel) {
+            if (row.size() != kernel[0].size()) {
+                throw std::invalid_argument("kernel rows of different lengths passed to MakeConvolutionFilter");
+            }
+        }
+        return new ConvolutionFilter(Matrix<ManipulatorParameters::ManipulatorBaseType>(kernel));
+    }
+
+    Manipulator* MakeRegionFilter(const FilterDescriptor& fd, Manipulator* filter) {
+        if (fd.GetFilterName() != "-roi") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeRegionFilter");
+        }
+        if (fd.GetParams().empty() || fd.GetParams().size() % 4 != 0) {
+            throw std::invalid_argument("invalid arguments number passed to MakeRegionFilter");
+        }
+        const std::vector<std::string_view>& params = fd.GetParams();
+        std::vector<RegionFilter::Region> regions;
+        for (size_t i = 0; i < params.size(); i += 4) {
+            regions.push_back({ParseSize(params[i], "MakeRegionFilter"), ParseSize(params[i + 1], "MakeRegionFilter"),
+                               ParseSize(params[i + 2], "MakeRegionFilter"),
+                               ParseSize(params[i + 3], "MakeRegionFilter")});
+        }
+        return new RegionFilter(filter, std::move(regions));
+    }
+
+    Manipulator* MakeMaskRegionFilter(const FilterDescriptor& fd, Manipulator* filter) {
+        if (fd.GetFilterName() != "-roi-mask") {
+            throw std::invalid_argument("invalid filter descriptor passed to MakeMaskRegionFilter");
+        }
+        if (fd.GetParams().size() != 1) {
+            throw std::invalid_argument("invalid arguments number passed to MakeMaskRegionFilter");
+        }
+        Bitmap picture;
+        if (!picture.load(std::string(fd.GetParams()[0]).c_str())) {
+            throw std::invalid_argument("the region mask could not be loaded");
+        }
+        BitMask mask;
+        if (picture.GetMask() != nullptr) {
+            const BitMask& bits = *picture.GetMask();
+            const auto& palette = picture.GetMaskPalette();
+            mask = BitMask(bits.GetWidth(), bits.GetHeight());
+            for (size_t y = 0; y < mask.GetHeight(); ++y) {
+                for (size_t x = 0; x < mask.GetWidth(); ++x) {
+                    mask.SetElement(x, y, palette[bits.GetElement(x, y)].GetValue() >= 0.5);
+                }
+            }
+        } else {
+            const Matrix<Pixel>& data = *picture.GetData();
+            mask = BitMask(data.GetWidth(), data.GetHeight());
+            for (size_t y = 0; y < mask.GetHeight(); ++y) {
+                for (size_t x = 0; x < mask.GetWidth(); ++x) {
+                    mask.SetElement(x, y, data.GetElement(x, y).GetValue() >= 0.5);
+                }
+            }
+        }
+        return new RegionFilter(filter, std::move(mask));
+    }
+
+    void RegisterFilterCreators(FilterPipelineMaker& maker) {
+        maker.AddFilterCreator("-blur", MakeFastGaussianBlurFilter);
+        maker.AddFilterCreator("-crop", MakeCropFilter);
+        maker.AddFilterCreator("-sharp", MakeSharpeningFilter);
+        maker.AddFilterCreator("-edge", MakeEdgeDetectionFilter);
+        maker.AddFilterCreator("-neg", MakeNegativeFilter);
+        maker.AddFilterCreator("-gsbasic", MakeToGreyscaleBasicFilter);
+        maker.AddFilterCreator("-gs", MakeToGreyscaleFilter);
+        maker.AddFilterCreator("-curves", MakeCurvesFilter);
+        maker.AddFilterCreator("-conv", MakeConvolutionFilter);
+        maker.AddFilterCreator("-median", MakeMedianFilter);
+        maker.AddFilterCreator("-resize", MakeResizeFilter);
+        maker.AddFilterCreator("-bilateral", MakeBilateralFilter);
+        maker.AddFilterCreator("-boxblur", MakeBoxBlurFilter);
+        for (const char* name : {"-erode", "-dilate", "-open", "-close"}) {
+            maker.AddFilterCreator(name, MakeMorphologyFilter);
+        }
+        for (const char* name : {"-rotate", "-flip", "-transpose"}) {
+            maker.AddFilterCreator(name, MakeOrientationFilter);
+        }
+        maker.AddFilterCreator("-stats", MakeStatisticsFilter);
+        maker.AddFilterCreator("-autolevels", MakeAutoLevelsFilter);
+        maker.AddWrapperCreator("-roi", MakeRegionFilter);
+        maker.AddWrapperCreator("-roi-mask", MakeMaskRegionFilter);
+    }
+
+}
+
+void Application::Configure() {
+    FilterMakers::RegisterFilterCreators(GetFilterPipelineMaker());
+    helpers_.insert({"-blur", FastGaussianBlurFilter::GetHelp});
+    helpers_.insert({"-crop", CropFilter::GetHelp});
+    helpers_.insert({"-sharp", SharpeningFilter::GetHelp});
+    helpers_.insert({"-edge", EdgeDetectionFilter::GetHelp});
+    helpers_.insert({"-neg", NegativeFilter::GetHelp});
+    helpers_.insert({"-gsbasic", ToGreyscaleBasicFilter::GetHelp});
+    helpers_.insert({"-gs", ToGreyscaleFilter::GetHelp});
+    helpers_.insert({"-curves", CurvesFilter::GetHelp});
+    helpers_.insert({"-conv", ConvolutionFilter::GetHelp});
+    helpers_.insert({"-median", MedianFilter::GetHelp});
+    helpers_.insert({"-resize", ResizeFilter::GetHelp});
+    helpers_.insert({"-bilateral", BilateralFilter::GetHelp});
+    helpers_.insert({"-boxblur", BoxBlurFilter::GetHelp});
+    for (const char* name : {"-erode", "-dilate", "-open", "-close"}) {
+        helpers_.insert({name, MorphologyFilter::GetHelp});
+    }
+    for (const char* name : {"-rotate", "-flip", "-transpose"}) {
+        helpers_.insert({name, OrientationFilter::GetHelp});
+    }
+    helpers_.insert({"-stats", StatisticsFilter::GetHelp});
+    helpers_.insert({"-autolevels", AutoLevelsFilter::GetHelp});
+    helpers_.insert({"-roi", RegionFilter::GetHelp});
+    helpers_.insert({"-roi-mask", RegionFilter::GetHelp});
+    helpers_.insert({"-h", GetHelp});
+}
+
+FilterPipelineMaker &Application::GetFilterPipelineMaker() {
+    return filter_pipeline_maker_;
+}
+
+void Application::Run(int argc, char **argv) {
+    try {
+        CommandLineParser clm;
+        // Testing(); // TODO: перенести тестирование в отдельную компоненту
+        bool is_parsed = clm.Parse(argc, argv);
+        std::cout << "Reading input..." << std::endl;
+        if (!is_parsed) {
+            if (clm.IsUsedForHelp()) {
+                std::cout << GetHelper(clm.GetDesiredFunction())() << std::endl;
+            } else {
+                std::cout << WRONG_INPUT << std::endl;
+            }
+            return;
+        }
+        std::cout << "Parsed successfully" << std::endl;
+        if (std::filesystem::is_directory(std::string(clm.GetInput()))) {
+            RunBatch(clm);
+            return;
+        }
+        if (clm.HasOption("--max-memory") && RunWithinMemory(clm)) {
+            return;
+        }
+        Bitmap input_bitmap;
+        std::cout << "Loading file..." << std::endl;
+        auto [min_width, min_height] = GetMinLoadSize(clm);
+        bool is_loaded = input_bitmap.load(clm.GetInput().begin(), min_width, min_height);
+        if (!is_loaded) {
+            std::cout << "file could not be loaded or has wrong type" << std::endl;
+            return;
+        }
+        std::cout << "Loaded successfully" << std::endl;
+        if (clm.HasOption("--output-bpp")) {
+            char* dummy;
+            input_bitmap.SetOutputBitsPerPixel(std::strtol(clm.GetOption("--output-bpp").begin(), &dummy, 10));
+        }
+        if (clm.GetBranches().size() > 1) {
+            RunGraph(clm, input_bitmap);
+            return;
+        }
+        FilterPipelineMaker& maker = GetFilterPipelineMaker();
+        std::cout << "Creating pipeline..." << std::endl;
+        FilterPipeline pipeline = maker.BuildPipeline(clm.GetDescriptions());
+        std::cout << "Created successfully" << std::endl;
+        ReportPipeline(pipeline);
+        std::cout << "Applying filters..." << std::endl;
+        Bitmap output_bitmap =
+            clm.HasOption("--cache-dir") ? ApplyCached(clm, pipeline, input_bitmap) : pipeline.Apply(input_bitmap);
+        std::cout << "Applied successfully" << std::endl;
+        std::cout << "Saving file..." << std::endl;
+        bool is_saved = output_bitmap.save(clm.GetOutput().begin());
+        if (!is_saved) {
+            std::cout << "file could not be saved" << std::endl;
+            return;
+        }
+        std::cout << "Result saved to " << clm.GetOutput() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal failure! Caught exception: ";
+        std::cerr << e.what();
+    }
+}
+
+std::pair<size_t, size_t> Application::GetMinLoadSize(const CommandLineParser& clm) {
+    // A leading -resize lets the loader box-average the pixels before storing them. Cached prefixes and other
+    // branches need the picture as it is.
+    std::vector<FilterDescriptor> descriptions = clm.GetDescriptions();
+    if (clm.GetBranches().size() > 1 || clm.HasOption("--cache-dir") || descriptions.empty() ||
+        descriptions[0].GetFilterName() != "-resize") {
+        return {0, 0};
+    }
+    std::unique_ptr<Manipulator> resize(FilterMakers::MakeResizeFilter(descriptions[0]));
+    return static_cast<const ResizeFilter&>(*resize).GetMinLoadSize();
+}
+
+void Application::ReportPipeline(FilterPipeline& pipeline) {
+    for (const Manipulator* filter : pipeline.GetPipeline()) {
+        if (const auto* pyramid = dynamic_cast<const PyramidGaussianBlurFilter*>(filter)) {
+            std::cout << "Pyramid blur works at level " << pyramid->GetLevel()
+                      << ", differs from the precise one by at most " << pyramid->GetErrorBound() << std::endl;
+        }
+    }
+}
+
+size_t Application::GetMaxMemory(const CommandLineParser& clm) {
+    if (!clm.HasOption("--max-memory")) {
+        return SIZE_MAX;
+    }
+    return ParseMegabytes(clm.GetOption("--max-memory"), "--max-memory");
+}
+
+bool Application::RunWithinMemory(const CommandLineParser& clm) {
+    Bitmap::BMPHeader bmp_header;
+    Bitmap::DIBHeader dib_header;
+    if (!Bitmap::ReadHeaders(clm.GetInput().begin(), bmp_header, dib_header)) {
+        // Bitmap::load reports the file.
+        return false;
+    }
+    size_t budget = GetMaxMemory(clm);
+    std::cout << "Planning memory..." << std::endl;
+    if (clm.GetBranches().size() > 1) {
+        // The branches may all run at once, each on its own copy of the input.
+        size_t peak = 0;
+        for (const CommandLineParser::Branch& branch : clm.GetBranches()) {
+            FilterPipeline pipeline = GetFilterPipelineMaker().BuildPipeline(branch.descriptions);
+            BitmapParameters::StorageFormat precision;
+            peak += MemoryBudget::EstimatePeak(dib_header, pipeline.GetPipeline(), 0, 0, precision);
+        }
+        if (peak > budget) {
+            throw std::runtime_error("the branches need about " + std::to_string(peak >> 20) +
+                                     " MiB in memory, more than the " + std::to_string(budget >> 20) + " MiB allowed");
+        }
+        std::cout << "Planned in memory" << std::endl;
+        return false;
+    }
+    // Strips are written as 24-bit rows in place; cached prefixes and regions need the whole picture.
+    bool can_stream = !clm.HasOption("--cache-dir");
+    if (clm.HasOption("--output-bpp")) {
+        char* dummy;
+        can_stream = can_stream && std::strtol(clm.GetOption("--output-bpp").begin(), &dummy, 10) ==
+                                       BitmapParameters::COLOUR_BITS_PER_PIXEL;
+    }
+    for (const FilterDescriptor& description : clm.GetDescriptions()) {
+        can_stream =
+            can_stream && description.GetFilterName() != "-roi" && description.GetFilterName() != "-roi-mask";
+    }
+    auto [min_width, min_height] = GetMinLoadSize(clm);
+    FilterPipeline pipeline = GetFilterPipelineMaker().BuildPipeline(clm.GetDescriptions());
+    ReportPipeline(pipeline);
+    MemoryBudget::Plan plan =
+        MemoryBudget::MakePlan(dib_header, pipeline.GetPipeline(), budget, can_stream, min_width, min_height);
+    std::string strategy = "in memory";
+    if (plan.strategy == MemoryBudgetParameters::Strategy::Strips) {
+        strategy = "in strips of " + std::to_string(plan.strip_rows) + " rows";
+    } else if (plan.strategy == MemoryBudgetParameters::Strategy::Spill) {
+        strategy = "filter by filter in strips of " + std::to_string(plan.strip_rows) + " rows spilled to disk";
+        if (plan.spill_precision != plan.precision) {
+            strategy += " rounded to 8-bit between the filters";
+        }
+    }
+    bool is_double = plan.precision == BitmapParameters::StorageFormat::Colours ||
+                     plan.precision == BitmapParameters::StorageFormat::Greyscale;
+    std::cout << "Planned " << strategy << " at " << (is_double ? "double" : "8-bit") << " precision, about "
+              << (plan.peak >> 20) << " MiB" << std::endl;
+    if (plan.strategy == MemoryBudgetParameters::Strategy::InMemory) {
+        return false;
+    }
+    std::cout << "Streaming filters..." << std::endl;
+    std::string output(clm.GetOutput());
+    if (!MemoryBudget::Stream(plan, std::string(clm.GetInput()), output, pipeline.GetPipeline())) {
+        std::cout << "file could not be streamed" << std::endl;
+    } else {
+        std::cout << "Result saved to " << clm.GetOutput() << std::endl;
+    }
+    return true;
+}
+
+void Application::RunGraph(const CommandLineParser& clm, const Bitmap& input) {
+    std::cout << "Creating filter graph..." << std::endl;
+    FilterGraph graph = GetFilterPipelineMaker().BuildGraph(clm.GetBranches());
+    std::cout << "Created successfully" << std::endl;
+    std::cout << "Applying filters and saving files..." << std::endl;
+    std::vector<std::string_view> failed_outputs = graph.Apply(input);
+    for (const CommandLineParser::Branch& branch : clm.GetBranches()) {
+        if (std::find(failed_outputs.begin(), failed_outputs.end(), branch.output_file_name) != failed_outputs.end()) {
+            std::cout << "file " << branch.output_file_name << " could not be saved" << std::endl;
+        } else {
+            std::cout << "Result saved to " << branch.output_file_name << std::endl;
+        }
+    }
+}
+
+void Application::RunBatch(const CommandLineParser& clm) {
+    if (clm.GetBranches().size() > 1) {
+        throw std::invalid_argument("--output cannot be used with a directory of inputs");
+    }
+    std::filesystem::path output_directory(std::string(clm.GetOutput()));
+    std::filesystem::create_directories(output_directory);
+    std::vector<Batch::Job> jobs = Batch::ListDirectory(std::string(clm.GetInput()), output_directory);
+    char* dummy;
+    size_t budget = BatchParameters::DEFAULT_MEMORY_BUDGET;
+    if (clm.HasOption("--batch-memory")) {
+        budget = std::strtoull(clm.GetOption("--batch-memory").begin(), &dummy, 10) << 20;
+    }
+    size_t max_depth = BatchParameters::DEFAULT_QUEUE_DEPTH;
+    if (clm.HasOption("--queue-depth")) {
+        max_depth = std::strtoull(clm.GetOption("--queue-depth").begin(), &dummy, 10);
+    }
+    // Half of --max-memory for the queues, the other half for the picture being filtered.
+    size_t max_memory = GetMaxMemory(clm);
+    budget = std::min(budget, max_memory / 2);
+    size_t queue_depth = Batch::GetQueueDepth(jobs, budget, max_depth);
+    uint16_t output_bits_per_pixel = BitmapParameters::COLOUR_BITS_PER_PIXEL;
+    if (clm.HasOption("--output-bpp")) {
+        output_bits_per_pixel = std::strtol(clm.GetOption("--output-bpp").begin(), &dummy, 10);
+    }
+    std::cout << "Creating pipeline..." << std::endl;
+    FilterPipeline pipeline = GetFilterPipelineMaker().BuildPipeline(clm.GetDescriptions());
+    std::cout << "Created successfully" << std::endl;
+    std::cout << "Processing " << jobs.size() << " files, up to " << queue_depth << " pictures per queue..."
+              << std::endl;
+    auto [min_width, min_height] = GetMinLoadSize(clm);
+    std::vector<std::string> failed_outputs = Batch::Run(
+        jobs, queue_depth,
+        [&](const std::string& path, Bitmap& bitmap) {
+            Bitmap::BMPHeader bmp_header;
+            Bitmap::DIBHeader dib_header;
+            BitmapParameters::StorageFormat precision;
+            if (max_memory != SIZE_MAX && Bitmap::ReadHeaders(path.c_str(), bmp_header, dib_header) &&
+                MemoryBudget::EstimatePeak(dib_header, pipeline.GetPipeline(), min_width, min_height, precision) >
+                    max_memory / 2) {
+                return false;
+            }
+            if (!bitmap.load(path.c_str(), min_width, min_height)) {
+                return false;
+            }
+            bitmap.SetOutputBitsPerPixel(output_bits_per_pixel);
+            return true;
+        },
+        [&](Bitmap& bitmap) {
+            bitmap = clm.HasOption("--cache-dir") ? ApplyCached(clm, pipeline, bitmap) : pipeline.Apply(bitmap);
+        },
+        [](const std::string& path, Bitmap& bitmap) { return bitmap.save(path.c_str()); });
+    for (const std::string& output : failed_outputs) {
+        std::cout << "file " << output << " could not be processed" << std::endl;
+    }
+    std::cout << jobs.size() - failed_outputs.size() << " of " << jobs.size() << " results saved to "
+              << clm.GetOutput() << std::endl;
+}
+
+Bitmap Application::ApplyCached(const CommandLineParser& clm, const FilterPipeline& pipeline, const Bitmap& input) {
+    size_t budget = CacheParameters::DEFAULT_BUDGET;
+    if (clm.HasOption("--cache-size")) {
+        budget = ParseMegabytes(clm.GetOption("--cache-size"), "--cache-size");
+    }
+    ResultCache cache(std::string(clm.GetOption("--cache-dir")), budget);
+    std::vector<FilterDescriptor> descriptions = clm.GetDescriptions();
+    // Results are stored after every filter, wrappers (-roi) belong to the filter they wrap.
+    std::vector<size_t> stage_ends = GetFilterPipelineMaker().GetStageEnds(descriptions);
+
+    Bitmap output = input;
+    uint64_t input_hash = ResultCache::HashBitmap(output);
+    // Restored filters are not run and -stats would not write its report: only the filters before the first one are.
+    size_t restorable = descriptions.size();
+    for (size_t i = 0; i < descriptions.size(); ++i) {
+        if (descriptions[i].GetFilterName() == "-stats") {
+            restorable = i;
+            break;
+        }
+    }
+    size_t restored = cache.Restore(
+        input_hash, std::vector<FilterDescriptor>(descriptions.begin(), descriptions.begin() + restorable), output);
+    size_t first_stage = 0;
+    if (restored > 0) {
+        first_stage = std::find(stage_ends.begin(), stage_ends.end(), restored) - stage_ends.begin() + 1;
+    }
+    if (first_stage > 0) {
+        std::cout << "Restored " << first_stage << " of " << pipeline.GetSize() << " filters from cache" << std::endl;
+    }
+    for (size_t stage = first_stage; stage < pipeline.GetSize(); ++stage) {
+        pipeline.ApplyStage(stage, output);
+        cache.Store(cache.MakeKey(input_hash, descriptions, stage_ends[stage]), output);
+    }
+    cache.Evict();
+    return output;
+}
+
+std::string Application::GetHelp() {
+    return HELP;
+}
+Application::FilterHelpers Application::GetHelpers() const {
+    return helpers_;
+}
+
+Application::FilterHelper Application::GetHelper(std::string_view query) const {
+    auto helper_ptr = helpers_.find(query);
+    if (helper_ptr != GetHelpers().end()) {
+        return *helper_ptr->second;
+    }
+    return []() -> std::string { return WRONG_INPUT; };
+}
@@ -1,53 +1,112 @@
-#ifndef PROJECT_APPLICATION_H
-#define PROJECT_APPLICATION_H
-
-#include "command_line_parser.h"
-#include "filter_pipeline.h"
-#include "filter_pipeline_maker.h"
-#include "image_manipulators.h"
-
-#include <stdexcept>
-#include <string>
-#include <string_view>
-#include <unordered_map>
-
-namespace FilterMakers {
-Manipulator* MakeFastGaussianBlurFilter(const FilterDescriptor& fd);
-Manipulator* MakeCropFilter(const FilterDescriptor& fd);
-Manipulator* MakeSharpeningFilter(const FilterDescriptor& fd);
-Manipulator* MakeEdgeDetectionFilter(const FilterDescriptor& fd);
-Manipulator* MakeNegativeFilter(const FilterDescriptor& fd);
-Manipulator* MakeToGreyscaleBasicFilter(const FilterDescriptor& fd);
-Manipulator* MakeToGreyscaleFilter(const FilterDescriptor& fd);
-Manipulator* MakeCurvesFilter(const FilterDescriptor& fd);
-}
-
-namespace {
-static const std::string HELP =
-    "Usage:\n"
-    "[input_file_path] [output_file_path] [-filter] {parameters}\n\n"
-    "input_file_path: Path to the file to be processed,\n"
-    "output_file_path: Path to the processed result.\n"
-    "To get the filters' options, type \"image_processor [-filter_name] \"";
-
-static const std::string WRONG_INPUT = "wrong input type, enter \"filter_processor -h\" to get help";
-}
-
-class Application {
-public:
-    typedef std::string (*FilterHelper)();
-    using FilterHelpers = std::unordered_map<std::string_view, FilterHelper>;
-    Application() : filter_pipeline_maker_(){};
-    void Configure();
-    void Run(int argc, char* argv[]);
-    static std::string GetHelp();
-    FilterHelpers GetHelpers() const;
-    FilterHelper GetHelper(std::string_view query) const;
-
-protected:
-    FilterPipelineMaker& GetFilterPipelineMaker();
-    FilterPipelineMaker filter_pipeline_maker_;
-    FilterHelpers helpers_;
-};
-
-#endif  // PROJECT_APPLICATION_H
+#ifndef PROJECT_APPLICATION_H
+#define PROJECT_APPLICATION_H
+
+#include "batch.h"
+#include "command_line_parser.h"
+#include "filter_pipeline.h"
+#include "filter_pipeline_maker.h"
+#include "image_manipulators.h"
+#include "memory_budget.h"
+#include "result_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace FilterMakers {
+Manipulator* MakeFastGaussianBlurFilter(const FilterDescriptor& fd);
+// -blur sigma precise [epsilon]
+Manipulator* MakeGaussianBlurFilter(const FilterDescriptor& fd);
+// -blur sigma pyramid
+Manipulator* MakePyramidGaussianBlurFilter(const FilterDescriptor& fd);
+Manipulator* MakeCropFilter(const FilterDescriptor& fd);
+Manipulator* MakeSharpeningFilter(const FilterDescriptor& fd);
+// -edge [threshold], -edge adaptive radius [offset] or -edge auto [fraction]
+Manipulator* MakeEdgeDetectionFilter(const FilterDescriptor& fd);
+Manipulator* MakeNegativeFilter(const FilterDescriptor& fd);
+Manipulator* MakeToGreyscaleBasicFilter(const FilterDescriptor& fd);
+Manipulator* MakeToGreyscaleFilter(const FilterDescriptor& fd);
+Manipulator* MakeCurvesFilter(const FilterDescriptor& fd);
+Manipulator* MakeConvolutionFilter(const FilterDescriptor& fd);
+Manipulator* MakeMedianFilter(const FilterDescriptor& fd);
+// -resize width height [box|bilinear|bicubic|lanczos]
+Manipulator* MakeResizeFilter(const FilterDescriptor& fd);
+Manipulator* MakeBilateralFilter(const FilterDescriptor& fd);
+Manipulator* MakeBoxBlurFilter(const FilterDescriptor& fd);
+// -erode, -dilate, -open or -close width [height]
+Manipulator* MakeMorphologyFilter(const FilterDescriptor& fd);
+// -rotate 90|180|270, -flip [h|v] or -transpose
+Manipulator* MakeOrientationFilter(const FilterDescriptor& fd);
+// -stats path
+Manipulator* MakeStatisticsFilter(const FilterDescriptor& fd);
+// -autolevels [low high]
+Manipulator* MakeAutoLevelsFilter(const FilterDescriptor& fd);
+Manipulator* MakeRegionFilter(const FilterDescriptor& fd, Manipulator* filter);
+Manipulator* MakeMaskRegionFilter(const FilterDescriptor& fd, Manipulator* filter);
+
+void RegisterFilterCreators(FilterPipelineMaker& maker);
+}
+
+namespace {
+static const std::string HELP =
+    "Usage:\n"
+    "[input_file_path] [output_file_path] [-filter] {parameters}\n\n"
+    "input_file_path: Path to the file to be processed,\n"
+    "output_file_path: Path to the processed result.\n"
+    "If input_file_path is a directory, every .bmp file in it is processed and saved under the same name\n"
+    "to the directory output_file_path, reading, filtering and writing running concurrently.\n"
+    "To get the filters' options, type \"image_processor [-filter_name] \"\n\n"
+    "Options:\n"
+    "--output path: starts another filter chain applied to the same input and saved to path,\n"
+    "    chains sharing their first filters compute them only once,\n"
+    "--cache-dir path: reuse results of previously computed filter chain prefixes stored in path,\n"
+    "--cache-size megabytes: size budget of the cache directory (1024 by default),\n"
+    "--output-bpp bits: 24 (default), 8 or 1: 8 saves greyscale images with a grey palette,\n"
+    "    1 saves two-colour images (e.g. after -edge) one bit per pixel,\n"
+    "--queue-depth pictures: most pictures waiting between two stages of a batch (4 by default),\n"
+    "--batch-memory megabytes: the waiting pictures of a batch are limited to this budget (1024 by default),\n"
+    "--max-memory megabytes: the whole run is planned within this budget before the input is loaded: in memory,\n"
+    "    in strips streamed from the file or filter by filter spilled to disk, failing if none of them fits.\n\n"
+    "Any filter can be limited to a part of the picture by preceding it with -roi x y width height ...\n"
+    "or -roi-mask path, e.g. \"-roi 0 0 100 50 -blur 8\".";
+
+static const std::string WRONG_INPUT = "wrong input type, enter \"filter_processor -h\" to get help";
+}
+
+class Application {
+public:
+    typedef std::string (*FilterHelper)();
+    using FilterHelpers = std::unordered_map<std::string_view, FilterHelper>;
+    Application() : filter_pipeline_maker_(){};
+    void Configure();
+    void Run(int argc, char* argv[]);
+    static std::string GetHelp();
+    FilterHelpers GetHelpers() const;
+    FilterHelper GetHelper(std::string_view query) const;
+
+protected:
+    FilterPipelineMaker& GetFilterPipelineMaker();
+    void RunGraph(const CommandLineParser& clm, const Bitmap& input);
+    // Every picture of the input directory through the filters into the output directory, see Batch::Run.
+    void RunBatch(const CommandLineParser& clm);
+    // Prints what the filters chose for themselves, e.g. the level of a pyramid blur.
+    static void ReportPipeline(FilterPipeline& pipeline);
+    // --max-memory in bytes, SIZE_MAX without it.
+    static size_t GetMaxMemory(const CommandLineParser& clm);
+    // Plans the input within --max-memory from its headers, see MemoryBudget::MakePlan. Streams it and returns
+    // true if it does not fit in memory, returns false to load it as usual. Throws if no strategy fits.
+    bool RunWithinMemory(const CommandLineParser& clm);
+    // The size Bitmap::load may reduce the input to, {0, 0} to load it as it is.
+    static std::pair<size_t, size_t> GetMinLoadSize(const CommandLineParser& clm);
+    Bitmap ApplyCached(const CommandLineParser& clm, const FilterPipeline& pipeline, const Bitmap& input);
+    FilterPipelineMaker filter_pipeline_maker_;
+    FilterHelpers helpers_;
+};
+
+#endif  // PROJECT_APPLICATION_H
@@ -0,0 +1,110 @@
+#include "batch.h"
+
+#include "spsc_queue.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <future>
+#include <optional>
+
+namespace {
+// A picture on its way between two stages, std::nullopt ends the stream.
+struct Item {
+    size_t job;
+    Bitmap bitmap;
+};
+using Queue = SpscQueue<std::optional<Item>>;
+
+// Runs a stage's work on one job, an exception counts as a failure.
+template <typename Function>
+bool Attempt(Function function) {
+    try {
+        return function();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+}  // namespace
+
+namespace Batch {
+std::vector<Job> ListDirectory(const std::filesystem::path& input_directory,
+                               const std::filesystem::path& output_directory) {
+    std::vector<Job> jobs;
+    for (const auto& file : std::filesystem::directory_iterator(input_directory)) {
+        if (file.is_regular_file() && file.path().extension() == BatchParameters::FILE_EXTENSION) {
+            jobs.push_back({file.path().string(), (output_directory / file.path().filename()).string()});
+        }
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.input < b.input; });
+    return jobs;
+}
+
+size_t GetQueueDepth(const std::vector<Job>& jobs, size_t budget, size_t max_depth) {
+    size_t largest = 0;
+    for (const Job& job : jobs) {
+        Bitmap::BMPHeader bmp_header;
+        Bitmap::DIBHeader dib_header;
+        if (Bitmap::ReadHeaders(job.input.c_str(), bmp_header, dib_header)) {
+            largest = std::max(largest, static_cast<size_t>(dib_header.width) *
+                                            static_cast<size_t>(std::abs(dib_header.height)) * sizeof(Pixel));
+        }
+    }
+    size_t pictures = largest == 0 ? SIZE_MAX : budget / largest;
+    size_t depth = pictures > BatchParameters::PICTURES_IN_STAGES
+                       ? (pictures - BatchParameters::PICTURES_IN_STAGES) / 2
+                       : 0;
+    return std::clamp<size_t>(depth, 1, std::max<size_t>(1, max_depth));
+}
+
+std::vector<std::string> Run(const std::vector<Job>& jobs, size_t queue_depth, const Loader& load,
+                             const Processor& process, const Saver& save) {
+    Queue loaded(queue_depth);
+    Queue processed(queue_depth);
+    // Every stage lists its own failures, they are merged once the stages are done.
+    std::vector<size_t> load_failures;
+    std::vector<size_t> process_failures;
+    std::vector<size_t> save_failures;
+    std::future<void> reader = std::async(std::launch::async, [&] {
+        for (size_t job = 0; job < jobs.size(); ++job) {
+            Bitmap bitmap;
+            if (Attempt([&] { return load(jobs[job].input, bitmap); })) {
+                loaded.Push(Item{job, std::move(bitmap)});
+            } else {
+                load_failures.push_back(job);
+            }
+        }
+        loaded.Push(std::nullopt);
+    });
+    std::future<void> writer = std::async(std::launch::async, [&] {
+        while (std::optional<Item> item = processed.Pop()) {
+            if (!Attempt([&] { return save(jobs[item->job].output, item->bitmap); })) {
+                save_failures.push_back(item->job);
+            }
+        }
+    });
+    while (std::optional<Item> item = loaded.Pop()) {
+        if (Attempt([&] {
+                process(item->bitmap);
+                return true;
+            })) {
+            processed.Push(std::move(item));
+        } else {
+            process_failures.push_back(item->job);
+        }
+    }
+    processed.Push(std::nullopt);
+    reader.get();
+    writer.get();
+
+    std::vector<size_t> failures = load_failures;
+    failures.insert(failures.end(), process_failures.begin(), process_failures.end());
+    failures.insert(failures.end(), save_failures.begin(), save_failures.end());
+    std::sort(failures.begin(), failures.end());
+    std::vector<std::string> failed_outputs;
+    for (size_t job : failures) {
+        failed_outputs.push_back(jobs[job].output);
+    }
+    return failed_outputs;
+}
+}  // namespace Batch
@@ -0,0 +1,51 @@
+#ifndef IMAGE_PROCESSOR_BATCH_H
+#define IMAGE_PROCESSOR_BATCH_H
+
+#include "bitmap.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace BatchParameters {
+const size_t DEFAULT_MEMORY_BUDGET = static_cast<size_t>(1) << 30;  // 1 GiB
+const size_t DEFAULT_QUEUE_DEPTH = 4;
+// Pictures held by the stages themselves besides those waiting in the queues: one being read, one being
+// filtered and one being written.
+const size_t PICTURES_IN_STAGES = 3;
+const std::string_view FILE_EXTENSION = ".bmp";
+}  // namespace BatchParameters
+
+// Many pictures filtered alike, streamed through three stages on their own threads: the reader decodes the
+// files, the processor applies the filters and the writer encodes the results. The stages are connected by two
+// bounded SPSC queues, so reading and writing overlap the filtering and a batch takes about as long as its
+// slowest stage, not the sum of them.
+namespace Batch {
+struct Job {
+    std::string input;
+    std::string output;
+};
+
+// Every stage reports failures by returning false or throwing, the job is then dropped from the later stages.
+using Loader = std::function<bool(const std::string& path, Bitmap& bitmap)>;
+using Processor = std::function<void(Bitmap& bitmap)>;
+using Saver = std::function<bool(const std::string& path, Bitmap& bitmap)>;
+
+// The .bmp files of input_directory in the order of their names, saved under the same names to output_directory.
+std::vector<Job> ListDirectory(const std::filesystem::path& input_directory,
+                               const std::filesystem::path& output_directory);
+
+// Pictures every queue may hold so that both queues and the stages stay within budget bytes, every picture being
+// counted at sizeof(Pixel) per pixel (the widest storage) from the headers of the largest input. Never more than
+// max_depth and never less than 1: a budget smaller than that still runs, one picture per queue.
+size_t GetQueueDepth(const std::vector<Job>& jobs, size_t budget, size_t max_depth);
+
+// Runs every job through the stages, returns the outputs of the jobs that failed in any of them.
+std::vector<std::string> Run(const std::vector<Job>& jobs, size_t queue_depth, const Loader& load,
+                             const Processor& process, const Saver& save);
+}  // namespace Batch
+
+#endif  // IMAGE_PROCESSOR_BATCH_H
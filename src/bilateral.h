@@ -0,0 +1,288 @@
+#ifndef IMAGE_PROCESSOR_BILATERAL_H
+#define IMAGE_PROCESSOR_BILATERAL_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BilateralParameters {
+// Bytes of grid cells a thread may hold at once, pictures whose grid is larger go in strips.
+const size_t GRID_BUDGET = 32 << 20;
+// The grid is blurred with 1 4 6 4 1 along every axis: the variance of one cell, splatting and slicing add
+// a sixth each. Cells are made smaller than sigma by the square root of that sum.
+const double CELLS_PER_SIGMA = 1.1547005383792515;
+// A cell holding the splats of a pixel is reached by the slices of the pixels this many cells away.
+const size_t CELL_REACH = 4;
+// Grid rows every strip blurs on both sides of its own (the blur reaches two, the slices one more).
+const size_t STRIP_MARGIN = 3;
+// Rough costs in blurred grid cells (one cell blurred along the three axes counts 3): a pixel splatted into and
+// sliced from its eight cells, and a tap of the direct kernel with its exponential.
+const double PIXEL_COST = 16;
+const double DIRECT_TAP_COST = 2;
+// The direct kernel is cut this many spatial sigmas away.
+const double DIRECT_SIGMAS = 3;
+}  // namespace BilateralParameters
+
+// The bilateral filter on a grid over (x, y, guide value): every pixel is splatted into the eight cells around
+// it with its trilinear weights, the grid is blurred along the three axes and every pixel reads the blurred
+// grid back at its place, dividing the values by the weights. The grid has about width * height / sigma_s^2
+// cells per 1 / sigma_r range cells, so the time barely depends on the spatial sigma. Sigmas too small for
+// the grid to pay off are filtered directly instead.
+namespace Bilateral {
+// Grid geometry: cell sizes and the number of cells along every axis.
+struct Grid {
+    double spatial_cell;
+    double range_cell;
+    size_t width;
+    size_t range;
+
+    Grid(size_t picture_width, double sigma_spatial, double sigma_range)
+        : spatial_cell(std::max(1.0, sigma_spatial / BilateralParameters::CELLS_PER_SIGMA)),
+          range_cell(sigma_range / BilateralParameters::CELLS_PER_SIGMA),
+          width(static_cast<size_t>(static_cast<double>(picture_width) / spatial_cell) + 2),
+          range(static_cast<size_t>(1 / range_cell) + 2) {
+    }
+
+    // Pixels whose cell lies within this many pixels of a pixel's cell may change it.
+    size_t GetReach() const {
+        return static_cast<size_t>(ceil(BilateralParameters::CELL_REACH * spatial_cell));
+    }
+};
+
+template <typename ElementType>
+struct Cell {
+    ElementType value;
+    double weight;
+};
+
+inline size_t GetTotalRows(const Grid& grid, size_t height) {
+    return static_cast<size_t>(static_cast<double>(height - 1) / grid.spatial_cell) + 2;
+}
+
+// Grid rows of the strips one thread slices, each blurred with STRIP_MARGIN more rows on both sides. They are
+// not taller than the budget allows and not fewer than the threads.
+inline size_t GetStripRows(const Grid& grid, size_t total_rows, size_t cell_size, size_t budget) {
+    const size_t margin = BilateralParameters::STRIP_MARGIN;
+    size_t budget_rows = budget / (grid.width * grid.range * cell_size);
+    return std::max<size_t>(1, std::min(budget_rows > 2 * margin ? budget_rows - 2 * margin : 1,
+                                        (total_rows + Parallel::GetThreadCount() - 1) / Parallel::GetThreadCount()));
+}
+
+// Estimated costs of filtering a width x height picture, in blurred grid cells. Tiny sigmas make grids of cells
+// no larger than a pixel and range cells so many that strips of a single grid row hardly fit the budget: the
+// direct kernel, reaching only a few pixels then, is much cheaper.
+inline double GetGridCost(size_t width, size_t height, double sigma_spatial, double sigma_range, size_t cell_size,
+                          size_t budget) {
+    Grid grid(width, sigma_spatial, sigma_range);
+    size_t total_rows = GetTotalRows(grid, height);
+    size_t strip_rows = GetStripRows(grid, total_rows, cell_size, budget);
+    size_t strips = (total_rows + strip_rows - 1) / strip_rows;
+    double blurred_rows = static_cast<double>(strips * (strip_rows + 2 * BilateralParameters::STRIP_MARGIN));
+    return 3 * blurred_rows * static_cast<double>(grid.width * grid.range) +
+           BilateralParameters::PIXEL_COST * static_cast<double>(width * height);
+}
+
+inline double GetDirectCost(size_t width, size_t height, double sigma_spatial) {
+    double side = 2 * ceil(BilateralParameters::DIRECT_SIGMAS * sigma_spatial) + 1;
+    return BilateralParameters::DIRECT_TAP_COST * side * side * static_cast<double>(width * height);
+}
+
+inline bool IsDirectCheaper(size_t width, size_t height, double sigma_spatial, double sigma_range, size_t cell_size,
+                            size_t budget) {
+    return GetDirectCost(width, height, sigma_spatial) <
+           GetGridCost(width, height, sigma_spatial, sigma_range, cell_size, budget);
+}
+
+// The exact filter: every pixel sums the pixels within DIRECT_SIGMAS spatial sigmas weighted by both Gaussians.
+template <typename ElementType>
+void ApplyDirect(MatrixView<const ElementType> source, MatrixView<const double> guide,
+                 MatrixView<ElementType> destination, double sigma_spatial, double sigma_range) {
+    size_t reach = static_cast<size_t>(ceil(BilateralParameters::DIRECT_SIGMAS * sigma_spatial));
+    std::vector<double> spatial(reach + 1);
+    for (size_t d = 0; d <= reach; ++d) {
+        spatial[d] = exp(-static_cast<double>(d * d) / (2 * sigma_spatial * sigma_spatial));
+    }
+    double range_factor = -1 / (2 * sigma_range * sigma_range);
+    Parallel::ForBlocks(
+        source.height,
+        [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                size_t top = y - std::min(y, reach);
+                size_t bottom = std::min(source.height, y + reach + 1);
+                for (size_t x = 0; x < source.width; ++x) {
+                    size_t left = x - std::min(x, reach);
+                    size_t right = std::min(source.width, x + reach + 1);
+                    double centre = guide(x, y);
+                    Cell<ElementType> sum{};
+                    for (size_t window_y = top; window_y < bottom; ++window_y) {
+                        double weight_y = spatial[window_y > y ? window_y - y : y - window_y];
+                        for (size_t window_x = left; window_x < right; ++window_x) {
+                            double difference = guide(window_x, window_y) - centre;
+                            double weight = weight_y * spatial[window_x > x ? window_x - x : x - window_x] *
+                                            exp(difference * difference * range_factor);
+                            sum.value += source(window_x, window_y) * weight;
+                            sum.weight += weight;
+                        }
+                    }
+                    destination(x, y) = sum.value * (1 / sum.weight);
+                }
+            }
+        },
+        1);
+}
+
+// Blurs length cells stride apart with 1 4 6 4 1, the cells beyond the ends are empty.
+template <typename ElementType>
+void BlurLine(Cell<ElementType>* first, size_t length, size_t stride, std::vector<Cell<ElementType>>& line) {
+    const double weights[] = {6.0 / 16, 4.0 / 16, 1.0 / 16};
+    line.assign(length + 4, Cell<ElementType>{});
+    for (size_t i = 0; i < length; ++i) {
+        line[i + 2] = first[i * stride];
+    }
+    for (size_t i = 0; i < length; ++i) {
+        const Cell<ElementType>* centre = line.data() + i + 2;
+        Cell<ElementType>& cell = first[i * stride];
+        cell.value = centre[0].value * weights[0] + (centre[-1].value + centre[1].value) * weights[1] +
+                     (centre[-2].value + centre[2].value) * weights[2];
+        cell.weight = centre[0].weight * weights[0] + (centre[-1].weight + centre[1].weight) * weights[1] +
+                      (centre[-2].weight + centre[2].weight) * weights[2];
+    }
+}
+
+// Filters source into destination guided by the values of guide in [0, 1], all of the same size, on the grid.
+// Every thread holds about budget bytes of the grid at most, though never less than a strip of one grid row and
+// its margins.
+template <typename ElementType>
+void ApplyGrid(MatrixView<const ElementType> source, MatrixView<const double> guide,
+               MatrixView<ElementType> destination, double sigma_spatial, double sigma_range,
+               size_t budget = BilateralParameters::GRID_BUDGET) {
+    if (source.width == 0 || source.height == 0) {
+        return;
+    }
+    Grid grid(source.width, sigma_spatial, sigma_range);
+    size_t cells_per_row = grid.width * grid.range;
+    size_t total_rows = GetTotalRows(grid, source.height);
+    // Strips of grid rows sliced by one thread, each with the grid rows within the blur's reach on both sides
+    // (the pixels of the last row also read the row below it).
+    const size_t margin = BilateralParameters::STRIP_MARGIN;
+    size_t strip_rows = GetStripRows(grid, total_rows, sizeof(Cell<ElementType>), budget);
+    size_t strips = (total_rows + strip_rows - 1) / strip_rows;
+    Parallel::ForBlocks(
+        strips,
+        [&](size_t begin, size_t end) {
+            std::vector<Cell<ElementType>> cells;
+            std::vector<Cell<ElementType>> line;
+            for (size_t strip = begin; strip < end; ++strip) {
+                // Grid rows first_row ... last_row - 1, the pixels sliced are those whose upper cell row is sliced.
+                int64_t first_row = static_cast<int64_t>(strip * strip_rows) - static_cast<int64_t>(margin);
+                int64_t last_row = static_cast<int64_t>(std::min(total_rows, (strip + 1) * strip_rows) + margin);
+                size_t rows = static_cast<size_t>(last_row - first_row);
+                cells.assign(rows * cells_per_row, Cell<ElementType>{});
+                auto locate = [&](size_t x, size_t y, double& fx, double& fy, double& fr) {
+                    fx = static_cast<double>(x) / grid.spatial_cell;
+                    fy = static_cast<double>(y) / grid.spatial_cell - static_cast<double>(first_row);
+                    fr = std::clamp(guide(x, y), 0.0, 1.0) / grid.range_cell;
+                };
+                // The eight cells around (fx, fy, fr) inside the strip with their trilinear weights.
+                auto for_corners = [&](double fx, double fy, double fr, auto function) {
+                    double floor_y = floor(fy);
+                    size_t x0 = static_cast<size_t>(fx);
+                    size_t r0 = static_cast<size_t>(fr);
+                    double dx = fx - static_cast<double>(x0);
+                    double dy = fy - floor_y;
+                    double dr = fr - static_cast<double>(r0);
+                    for (int64_t i = 0; i < 2; ++i) {
+                        int64_t row = static_cast<int64_t>(floor_y) + i;
+                        if (row < 0 || row >= static_cast<int64_t>(rows)) {
+                            continue;
+                        }
+                        double wy = i == 0 ? 1 - dy : dy;
+                        for (size_t j = 0; j < 2; ++j) {
+                            double wx = j == 0 ? 1 - dx : dx;
+                            Cell<ElementType>* corner =
+                                cells.data() + (static_cast<size_t>(row) * grid.width + x0 + j) * grid.range + r0;
+                            function(corner[0], wy * wx * (1 - dr));
+                            function(corner[1], wy * wx * dr);
+                        }
+                    }
+                };
+                // Splatting: every pixel reaching a cell of the strip.
+                int64_t first_y = std::max<int64_t>(
+                    0, static_cast<int64_t>(floor(static_cast<double>(first_row - 1) * grid.spatial_cell)));
+                int64_t last_y = std::min<int64_t>(
+                    static_cast<int64_t>(source.height),
+                    static_cast<int64_t>(ceil(static_cast<double>(last_row) * grid.spatial_cell)) + 1);
+                for (int64_t y = first_y; y < last_y; ++y) {
+                    for (size_t x = 0; x < source.width; ++x) {
+                        double fx = 0;
+                        double fy = 0;
+                        double fr = 0;
+                        locate(x, static_cast<size_t>(y), fx, fy, fr);
+                        Cell<ElementType> splat{source(x, static_cast<size_t>(y)), 1};
+                        for_corners(fx, fy, fr, [&splat](Cell<ElementType>& cell, double weight) {
+                            cell.value += splat.value * weight;
+                            cell.weight += weight;
+                        });
+                    }
+                }
+                // Blurring along the range, the rows and the columns.
+                for (size_t i = 0; i < rows * grid.width; ++i) {
+                    BlurLine(cells.data() + i * grid.range, grid.range, 1, line);
+                }
+                for (size_t row = 0; row < rows; ++row) {
+                    for (size_t r = 0; r < grid.range; ++r) {
+                        BlurLine(cells.data() + row * cells_per_row + r, grid.width, grid.range, line);
+                    }
+                }
+                for (size_t i = 0; i < cells_per_row; ++i) {
+                    BlurLine(cells.data() + i, rows, cells_per_row, line);
+                }
+                // Slicing the pixels whose upper cell row belongs to the strip.
+                size_t top = static_cast<size_t>(static_cast<double>(strip * strip_rows) * grid.spatial_cell);
+                size_t bottom = std::min(source.height, static_cast<size_t>(static_cast<double>((strip + 1) * strip_rows) *
+                                                                          grid.spatial_cell) + 2);
+                for (size_t y = top > 0 ? top - 1 : 0; y < bottom; ++y) {
+                    size_t row = static_cast<size_t>(static_cast<double>(y) / grid.spatial_cell);
+                    if (row < strip * strip_rows || row >= (strip + 1) * strip_rows) {
+                        continue;
+                    }
+                    for (size_t x = 0; x < source.width; ++x) {
+                        double fx = 0;
+                        double fy = 0;
+                        double fr = 0;
+                        locate(x, y, fx, fy, fr);
+                        Cell<ElementType> sum{};
+                        for_corners(fx, fy, fr, [&sum](const Cell<ElementType>& cell, double weight) {
+                            sum.value += cell.value * weight;
+                            sum.weight += cell.weight * weight;
+                        });
+                        destination(x, y) = sum.value * (1 / sum.weight);
+                    }
+                }
+            }
+        },
+        1);
+}
+
+// Filters source into destination on the grid within budget or directly, whichever is estimated cheaper.
+template <typename ElementType>
+void Apply(MatrixView<const ElementType> source, MatrixView<const double> guide, MatrixView<ElementType> destination,
+           double sigma_spatial, double sigma_range, size_t budget = BilateralParameters::GRID_BUDGET) {
+    if (source.width == 0 || source.height == 0) {
+        return;
+    }
+    if (IsDirectCheaper(source.width, source.height, sigma_spatial, sigma_range, sizeof(Cell<ElementType>),
+                        budget)) {
+        ApplyDirect(source, guide, destination, sigma_spatial, sigma_range);
+    } else {
+        ApplyGrid(source, guide, destination, sigma_spatial, sigma_range, budget);
+    }
+}
+}  // namespace Bilateral
+
+#endif  // IMAGE_PROCESSOR_BILATERAL_H
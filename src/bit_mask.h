@@ -0,0 +1,74 @@
+#ifndef IMAGE_PROCESSOR_BIT_MASK_H
+#define IMAGE_PROCESSOR_BIT_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Two-colour image packed 64 pixels per word, pixel x of a row lives in bit x % 64 of word x / 64.
+// Every row starts with a fresh word, the unused bits of the last one are kept zero.
+class BitMask {
+public:
+    using Word = uint64_t;
+    static constexpr size_t WORD_BITS = 64;
+
+    BitMask() : width_(0), height_(0), words_per_row_(0){};
+
+    explicit BitMask(size_t width, size_t height)
+        : width_(width), height_(height), words_per_row_((width + WORD_BITS - 1) / WORD_BITS) {
+        if (width == 0 || height == 0) {
+            width_ = 0;
+            height_ = 0;
+            words_per_row_ = 0;
+            return;
+        }
+        words_.resize(words_per_row_ * height_);
+    }
+
+    std::pair<size_t, size_t> GetSize() const {
+        return {height_, width_};
+    }
+    size_t GetHeight() const {
+        return height_;
+    }
+    size_t GetWidth() const {
+        return width_;
+    }
+    size_t GetWordsPerRow() const {
+        return words_per_row_;
+    }
+
+    bool GetElement(size_t x, size_t y) const {
+        if (x >= width_ || y >= height_) {
+            throw std::out_of_range("mask coordinates are out of range");
+        }
+        return (GetRow(y)[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+    }
+    void SetElement(size_t x, size_t y, bool value) {
+        if (x >= width_ || y >= height_) {
+            throw std::out_of_range("mask coordinates are out of range");
+        }
+        Word bit = static_cast<Word>(1) << (x % WORD_BITS);
+        Word& word = GetRow(y)[x / WORD_BITS];
+        word = value ? (word | bit) : (word & ~bit);
+    }
+
+    Word* GetRow(size_t y) {
+        return words_.data() + y * words_per_row_;
+    }
+    const Word* GetRow(size_t y) const {
+        return words_.data() + y * words_per_row_;
+    }
+
+    bool operator==(const BitMask& other) const = default;
+
+private:
+    size_t width_;
+    size_t height_;
+    size_t words_per_row_;
+    std::vector<Word> words_;
+};
+
+#endif  // IMAGE_PROCESSOR_BIT_MASK_H
@@ -1,17 +1,79 @@
 #include "bitmap.h"
 
-bool Bitmap::load(const char* file_name) {
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+const uint32_t HEADERS_SIZE = sizeof(Bitmap::BMPHeader) + sizeof(Bitmap::DIBHeader);
+
+struct PaletteEntry {
+    uint8_t blue;
+    uint8_t green;
+    uint8_t red;
+    uint8_t reserved;
+} __attribute__((packed));
+
+size_t GetRowSize(size_t width, uint16_t bits_per_pixel) {
+    return (width * bits_per_pixel + 7) / 8;
+}
+
+size_t GetRowPadding(size_t width, uint16_t bits_per_pixel) {
+    return (4 - GetRowSize(width, bits_per_pixel) % 4) % 4;
+}
+
+// The size fields of the headers of a file with palette_size palette entries.
+void FillHeaders(size_t width, size_t height, bool top_down, uint16_t bits_per_pixel, size_t palette_size,
+                 Bitmap::BMPHeader& bmp_header, Bitmap::DIBHeader& dib_header) {
+    dib_header.header_size = sizeof(Bitmap::DIBHeader);
+    dib_header.width = width;
+    dib_header.height = top_down ? -static_cast<int64_t>(height) : static_cast<int64_t>(height);
+    dib_header.number_color_planes = 1;
+    dib_header.bits_per_pixel = bits_per_pixel;
+    dib_header.compression = 0;
+    dib_header.image_size = (GetRowSize(width, bits_per_pixel) + GetRowPadding(width, bits_per_pixel)) * height;
+    dib_header.number_colors = palette_size;
+    dib_header.number_important_colors = 0;
+    bmp_header.signature = 0x4d42;
+    bmp_header.offset = HEADERS_SIZE + palette_size * sizeof(PaletteEntry);
+    bmp_header.bmp_size = dib_header.image_size + bmp_header.offset;
+}
+
+Bitmap::PrimitivePixel ToPrimitivePixel(const Pixel& pixel) {
+    return {ColourParameters::ToByte(pixel.GetRed()), ColourParameters::ToByte(pixel.GetGreen()),
+            ColourParameters::ToByte(pixel.GetBlue())};
+}
+
+Pixel FromPaletteEntry(const PaletteEntry& entry) {
+    return Pixel(ColourParameters::FromByte(entry.red), ColourParameters::FromByte(entry.green),
+                 ColourParameters::FromByte(entry.blue), ColourParameters::ColourSchemes::RGB);
+}
+
+bool IsGreyRamp(const std::vector<PaletteEntry>& palette) {
+    if (palette.size() != BitmapParameters::PALETTE_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < palette.size(); ++i) {
+        if (palette[i].red != i || palette[i].green != i || palette[i].blue != i) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+bool Bitmap::load(const char* file_name, size_t min_width, size_t min_height) {
     std::string str(file_name);
     std::ifstream file;
     file.open(str, std::ios_base::in | std::ios_base::binary);
     if (!file.is_open()) {
         return false;
     }
-    bool status = load(file);
+    bool status = load(file, min_width, min_height);
     return status;
 }
 
-bool Bitmap::load(std::istream& istr) {
+bool Bitmap::load(std::istream& istr, size_t min_width, size_t min_height) {
     BMPHeader bmp_header;
     istr.read(reinterpret_cast<char *>(&bmp_header), sizeof(bmp_header));
     if (!CheckBMPHeader(bmp_header)) {
@@ -24,17 +86,130 @@ bool Bitmap::load(std::istream& istr) {
         return false;
     }
 
-    data_ = std::make_unique<Matrix<Pixel>>(
-        Matrix<Pixel>(static_cast<uint64_t>(dib_header.width), static_cast<uint64_t>(dib_header.height)));
-    size_t padding = (4 - (dib_header.width * dib_header.bits_per_pixel / 8) % 4) % 4;
-    for (size_t y = 0; y < dib_header.height; ++y) {
-        for (size_t x = 0; x < dib_header.width; ++x) {
-            PrimitivePixel temp{};
-            istr.read(reinterpret_cast<char *>(&temp), sizeof(temp));
-            data_->GetElement(x, dib_header.height - y - 1) =
-                Pixel(temp.red / 256.0, temp.green / 256.0, temp.blue / 256.0);
+    std::vector<PaletteEntry> palette;
+    if (dib_header.bits_per_pixel != BitmapParameters::COLOUR_BITS_PER_PIXEL) {
+        size_t max_palette_size = static_cast<size_t>(1) << dib_header.bits_per_pixel;
+        size_t palette_size = dib_header.number_colors != 0 ? dib_header.number_colors : max_palette_size;
+        if (palette_size > max_palette_size) {
+            return false;
         }
-        istr.ignore(padding);
+        palette.resize(palette_size);
+        istr.read(reinterpret_cast<char *>(palette.data()), static_cast<std::streamsize>(palette_size * sizeof(PaletteEntry)));
+    }
+    size_t read_size = HEADERS_SIZE + palette.size() * sizeof(PaletteEntry);
+    if (bmp_header.offset < read_size) {
+        return false;
+    }
+    istr.ignore(bmp_header.offset - read_size);
+
+    // Rows are stored bottom-up unless the height is negative. Every branch reads the file's row y straight
+    // into the picture's row picture_y(y).
+    size_t width = dib_header.width;
+    bool top_down = dib_header.height < 0;
+    size_t height = top_down ? -static_cast<int64_t>(dib_header.height) : dib_header.height;
+    auto picture_y = [top_down, height](size_t y) { return top_down ? y : height - y - 1; };
+    size_t padding = GetRowPadding(width, dib_header.bits_per_pixel);
+    // A header promising more rows than the file holds fails before anything of its size is allocated.
+    std::streampos pixels = istr.tellg();
+    if (pixels != std::streampos(-1) && istr.seekg(0, std::ios_base::end)) {
+        std::streamoff available = istr.tellg() - pixels;
+        istr.seekg(pixels);
+        if (static_cast<uint64_t>(available) <
+            static_cast<uint64_t>(GetRowSize(width, dib_header.bits_per_pixel) + padding) * (height - 1) +
+                GetRowSize(width, dib_header.bits_per_pixel)) {
+            return false;
+        }
+    }
+    size_t factor_x = min_width == 0 ? 1 : std::max<size_t>(1, width / min_width);
+    size_t factor_y = min_height == 0 ? 1 : std::max<size_t>(1, height / min_height);
+    if (palette.empty() && (factor_x > 1 || factor_y > 1)) {
+        // The blocks are counted from the top as Resample::BoxReduce does: a block is complete once its top row
+        // is read (its bottom one in top-down files).
+        const size_t channels = 3;
+        auto bytes = std::make_unique<Matrix<PrimitivePixel>>((width + factor_x - 1) / factor_x,
+                                                              (height + factor_y - 1) / factor_y);
+        std::vector<PrimitivePixel> row(width);
+        Resample::BoxAccumulator<uint8_t> accumulator(width, channels, factor_x);
+        for (size_t y = 0; y < height; ++y) {
+            istr.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(width * sizeof(PrimitivePixel)));
+            istr.ignore(padding);
+            accumulator.Add({reinterpret_cast<const uint8_t *>(row.data()), channels * width});
+            size_t block = picture_y(y) / factor_y;
+            size_t block_top = block * factor_y;
+            size_t block_bottom = std::min(height, block_top + factor_y);
+            if (picture_y(y) == (top_down ? block_bottom - 1 : block_top)) {
+                accumulator.Take({reinterpret_cast<uint8_t *>(bytes->Row(block).data()), channels * bytes->GetWidth()},
+                                 block_bottom - block_top);
+            }
+        }
+        if (!istr) {
+            return false;
+        }
+        dib_header.width = static_cast<int32_t>(bytes->GetWidth());
+        dib_header.height = static_cast<int32_t>(top_down ? -static_cast<int64_t>(bytes->GetHeight()) : bytes->GetHeight());
+        bytes_ = std::move(bytes);
+        data_ = nullptr;
+        greyscale_ = nullptr;
+        mask_ = nullptr;
+    } else if (palette.empty()) {
+        auto bytes = std::make_unique<Matrix<PrimitivePixel>>(width, height);
+        for (size_t y = 0; y < height; ++y) {
+            istr.read(reinterpret_cast<char *>(bytes->Row(picture_y(y)).data()),
+                      static_cast<std::streamsize>(width * sizeof(PrimitivePixel)));
+            istr.ignore(padding);
+        }
+        if (!istr) {
+            return false;
+        }
+        bytes_ = std::move(bytes);
+        data_ = nullptr;
+        greyscale_ = nullptr;
+        mask_ = nullptr;
+    } else if (dib_header.bits_per_pixel == BitmapParameters::MASK_BITS_PER_PIXEL) {
+        auto mask = std::make_unique<BitMask>(width, height);
+        std::vector<uint8_t> row(GetRowSize(width, dib_header.bits_per_pixel) + padding);
+        for (size_t y = 0; y < height; ++y) {
+            istr.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
+            BitMask::Word* words = mask->GetRow(picture_y(y));
+            for (size_t x = 0; x < width; ++x) {
+                words[x / BitMask::WORD_BITS] |= static_cast<BitMask::Word>((row[x / 8] >> (7 - x % 8)) & 1)
+                                                 << (x % BitMask::WORD_BITS);
+            }
+        }
+        if (!istr) {
+            return false;
+        }
+        palette.resize(BitmapParameters::MASK_PALETTE_SIZE, {0, 0, 0, 0});
+        SetMask(std::move(*mask), FromPaletteEntry(palette[0]), FromPaletteEntry(palette[1]));
+    } else {
+        // An 8-bit grey ramp is loaded straight into a single plane, other palettes are expanded to RGB.
+        bool is_grey = IsGreyRamp(palette);
+        auto bytes = is_grey ? nullptr : std::make_unique<Matrix<PrimitivePixel>>(width, height);
+        auto greyscale = is_grey ? std::make_unique<Matrix<ColourParameters::ColourType>>(width, height) : nullptr;
+        std::vector<uint8_t> row(width + padding);
+        for (size_t y = 0; y < height; ++y) {
+            istr.read(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
+            if (is_grey) {
+                std::span<ColourParameters::ColourType> grey_row = greyscale->Row(picture_y(y));
+                std::transform(row.begin(), row.begin() + static_cast<std::ptrdiff_t>(width), grey_row.begin(),
+                               ColourParameters::FromByte);
+                continue;
+            }
+            std::span<PrimitivePixel> bytes_row = bytes->Row(picture_y(y));
+            for (size_t x = 0; x < width; ++x) {
+                if (row[x] < palette.size()) {
+                    const PaletteEntry& entry = palette[row[x]];
+                    bytes_row[x] = {entry.red, entry.green, entry.blue};
+                }
+            }
+        }
+        if (!istr) {
+            return false;
+        }
+        bytes_ = std::move(bytes);
+        greyscale_ = std::move(greyscale);
+        data_ = nullptr;
+        mask_ = nullptr;
     }
 
     bmp_header_ = bmp_header;
@@ -48,8 +223,18 @@ bool Bitmap::CheckBMPHeader(const Bitmap::BMPHeader& header) {
 }
 
 bool Bitmap::CheckDIBHeader(const Bitmap::DIBHeader& header) {
-    return (header.bits_per_pixel == 24 && header.header_size == 40 && header.compression == 0 &&
-            header.number_color_planes == 1);
+    return ((header.bits_per_pixel == BitmapParameters::COLOUR_BITS_PER_PIXEL ||
+             header.bits_per_pixel == BitmapParameters::GREYSCALE_BITS_PER_PIXEL ||
+             header.bits_per_pixel == BitmapParameters::MASK_BITS_PER_PIXEL) &&
+            header.header_size == 40 && header.compression == 0 && header.number_color_planes == 1 &&
+            header.width > 0 && header.height != 0);
+}
+
+bool Bitmap::ReadHeaders(const char* file_name, BMPHeader& bmp_header, DIBHeader& dib_header) {
+    std::ifstream file(file_name, std::ios_base::in | std::ios_base::binary);
+    file.read(reinterpret_cast<char *>(&bmp_header), sizeof(bmp_header));
+    file.read(reinterpret_cast<char *>(&dib_header), sizeof(dib_header));
+    return file && CheckBMPHeader(bmp_header) && CheckDIBHeader(dib_header);
 }
 
 bool Bitmap::save(const char* file_name) {
@@ -63,40 +248,268 @@ bool Bitmap::save(const char* file_name) {
 }
 
 bool Bitmap::save(std::ofstream& istr) {
-    dib_header_.width = data_->GetWidth();
-    dib_header_.height = data_->GetHeight();
-    size_t padding = (4 - (dib_header_.width * dib_header_.bits_per_pixel / 8) % 4) % 4;
-    dib_header_.image_size = (dib_header_.width * dib_header_.bits_per_pixel / 8 + padding) * dib_header_.height;
-    bmp_header_.bmp_size = dib_header_.image_size + bmp_header_.offset;
-
-    unsigned char bmp_padding[3] = {0, 0, 0};
+    if (IsEmpty()) {
+        return false;
+    }
+    std::vector<PaletteEntry> palette;
+    if (output_bits_per_pixel_ == BitmapParameters::GREYSCALE_BITS_PER_PIXEL) {
+        for (size_t i = 0; i < BitmapParameters::PALETTE_SIZE; ++i) {
+            uint8_t value = static_cast<uint8_t>(i);
+            palette.push_back({value, value, value, 0});
+        }
+    } else if (output_bits_per_pixel_ == BitmapParameters::MASK_BITS_PER_PIXEL) {
+        for (const Pixel& colour : mask_palette_) {
+            PrimitivePixel temp = mask_ != nullptr ? ToPrimitivePixel(colour) : PrimitivePixel();
+            palette.push_back({temp.blue, temp.green, temp.red, 0});
+        }
+        if (mask_ == nullptr) {
+            palette.back() = {UINT8_MAX, UINT8_MAX, UINT8_MAX, 0};
+        }
+    }
+    auto [height, width] = GetSize();
+    // Pictures loaded top-down are saved top-down.
+    bool top_down = dib_header_.height < 0;
+    size_t row_size = GetRowSize(width, output_bits_per_pixel_);
+    size_t padding = GetRowPadding(width, output_bits_per_pixel_);
+    FillHeaders(width, height, top_down, output_bits_per_pixel_, palette.size(), bmp_header_, dib_header_);
 
     istr.write(reinterpret_cast<char *>(&bmp_header_), sizeof(bmp_header_));
     istr.write(reinterpret_cast<char *>(&dib_header_), sizeof(dib_header_));
-    for (size_t y = 0; y < dib_header_.height; ++y) {
-        for (size_t x = 0; x < dib_header_.width; ++x) {
-            const Pixel &temp = data_->GetElement(x, dib_header_.height - y - 1);
-            ColourParameters::ColourType lo = 0.0;
-            ColourParameters::ColourType hi = 1.0;
-            PrimitivePixel temp1 = {static_cast<uint8_t>(std::round(std::clamp(temp.GetRed(), lo, hi) * 255)),
-                                    static_cast<uint8_t>(std::round(std::clamp(temp.GetGreen(), lo, hi) * 255)),
-                                    static_cast<uint8_t>(std::round(std::clamp(temp.GetBlue(), lo, hi) * 255))};
-            istr.write(reinterpret_cast<char *>(&temp1), sizeof(temp1));
-        }
-        istr.write(reinterpret_cast<char *>(bmp_padding), padding);
+    istr.write(reinterpret_cast<char *>(palette.data()), static_cast<std::streamsize>(palette.size() * sizeof(PaletteEntry)));
+    // Other storages are converted on the fly, saving must not demote the image: it may be processed further.
+    std::vector<uint8_t> row(row_size + padding);
+    for (size_t y = 0; y < height; ++y) {
+        size_t source_y = top_down ? y : height - y - 1;
+        if (output_bits_per_pixel_ == BitmapParameters::COLOUR_BITS_PER_PIXEL && bytes_ != nullptr) {
+            // The stored bytes are the file's row as they are.
+            istr.write(reinterpret_cast<const char *>(bytes_->Row(source_y).data()),
+                       static_cast<std::streamsize>(row_size));
+            istr.write(reinterpret_cast<const char *>(row.data() + row_size), static_cast<std::streamsize>(padding));
+            continue;
+        }
+        std::fill(row.begin(), row.end(), 0);
+        for (size_t x = 0; x < width; ++x) {
+            if (output_bits_per_pixel_ == BitmapParameters::COLOUR_BITS_PER_PIXEL) {
+                PrimitivePixel temp = GetPrimitivePixel(x, source_y);
+                std::memcpy(row.data() + x * sizeof(PrimitivePixel), &temp, sizeof(PrimitivePixel));
+            } else if (output_bits_per_pixel_ == BitmapParameters::GREYSCALE_BITS_PER_PIXEL && greyscale_ != nullptr) {
+                row[x] = ColourParameters::ToByte(greyscale_->GetElement(x, source_y));
+            } else if (output_bits_per_pixel_ == BitmapParameters::MASK_BITS_PER_PIXEL && mask_ != nullptr) {
+                row[x / 8] |= mask_->GetElement(x, source_y) << (7 - x % 8);
+            } else {
+                PrimitivePixel temp = GetPrimitivePixel(x, source_y);
+                uint8_t grey = static_cast<uint8_t>((temp.red + temp.green + temp.blue + 1) / 3);
+                if (output_bits_per_pixel_ == BitmapParameters::GREYSCALE_BITS_PER_PIXEL) {
+                    row[x] = grey;
+                } else {
+                    row[x / 8] |= (grey > UINT8_MAX / 2) << (7 - x % 8);
+                }
+            }
+        }
+        istr.write(reinterpret_cast<char *>(row.data()), static_cast<std::streamsize>(row.size()));
     }
-    return true;
+    return static_cast<bool>(istr);
+}
+
+std::pair<size_t, size_t> Bitmap::GetSize() const {
+    if (bytes_ != nullptr) {
+        return bytes_->GetSize();
+    }
+    if (greyscale_ != nullptr) {
+        return greyscale_->GetSize();
+    }
+    if (mask_ != nullptr) {
+        return mask_->GetSize();
+    }
+    if (data_ != nullptr) {
+        return data_->GetSize();
+    }
+    return {0, 0};
+}
+
+bool Bitmap::IsEmpty() const {
+    return data_ == nullptr && bytes_ == nullptr && greyscale_ == nullptr && mask_ == nullptr;
+}
+
+Bitmap::PrimitivePixel Bitmap::GetPrimitivePixel(size_t x, size_t y) const {
+    if (bytes_ != nullptr) {
+        return bytes_->GetElement(x, y);
+    }
+    if (greyscale_ != nullptr) {
+        uint8_t value = ColourParameters::ToByte(greyscale_->GetElement(x, y));
+        return {value, value, value};
+    }
+    if (mask_ != nullptr) {
+        return ToPrimitivePixel(mask_palette_[mask_->GetElement(x, y)]);
+    }
+    return ToPrimitivePixel(data_->GetElement(x, y));
 }
 
 Matrix<Pixel> *Bitmap::GetData() {
-    return &(*data_);
+    Convert(BitmapParameters::StorageFormat::Colours);
+    return data_.get();
+}
+
+Matrix<Bitmap::PrimitivePixel> *Bitmap::GetBytes() {
+    Convert(BitmapParameters::StorageFormat::Bytes);
+    return bytes_.get();
+}
+
+Matrix<ColourParameters::ColourType> *Bitmap::GetGreyscale() {
+    Convert(BitmapParameters::StorageFormat::Greyscale);
+    return greyscale_.get();
+}
+
+void Bitmap::SetData(Matrix<Pixel>&& data) {
+    data_ = std::make_unique<Matrix<Pixel>>(std::move(data));
+    bytes_ = nullptr;
+    greyscale_ = nullptr;
+    mask_ = nullptr;
+}
+
+void Bitmap::SetGreyscale(Matrix<ColourParameters::ColourType>&& plane) {
+    greyscale_ = std::make_unique<Matrix<ColourParameters::ColourType>>(std::move(plane));
+    data_ = nullptr;
+    bytes_ = nullptr;
+    mask_ = nullptr;
+}
+
+void Bitmap::SetBytes(Matrix<PrimitivePixel>&& bytes) {
+    bytes_ = std::make_unique<Matrix<PrimitivePixel>>(std::move(bytes));
+    data_ = nullptr;
+    greyscale_ = nullptr;
+    mask_ = nullptr;
+}
+
+BitMask *Bitmap::GetMask() {
+    return mask_.get();
+}
+
+const std::array<Pixel, BitmapParameters::MASK_PALETTE_SIZE> &Bitmap::GetMaskPalette() const {
+    return mask_palette_;
+}
+
+void Bitmap::SetMask(BitMask&& mask, const Pixel& unset, const Pixel& set) {
+    mask_ = std::make_unique<BitMask>(std::move(mask));
+    mask_palette_ = {unset, set};
+    data_ = nullptr;
+    bytes_ = nullptr;
+    greyscale_ = nullptr;
+}
+
+BitmapParameters::StorageFormat Bitmap::GetStorageFormat() const {
+    if (bytes_ != nullptr) {
+        return BitmapParameters::StorageFormat::Bytes;
+    }
+    if (greyscale_ != nullptr) {
+        return BitmapParameters::StorageFormat::Greyscale;
+    }
+    if (mask_ != nullptr) {
+        return BitmapParameters::StorageFormat::Mask;
+    }
+    return BitmapParameters::StorageFormat::Colours;
+}
+
+bool Bitmap::IsGreyscale() const {
+    if (greyscale_ != nullptr) {
+        return true;
+    }
+    return mask_ != nullptr && mask_palette_[0] == mask_palette_[0].InGrayScalePixel() &&
+           mask_palette_[1] == mask_palette_[1].InGrayScalePixel();
+}
+
+void Bitmap::Convert(BitmapParameters::StorageFormat format) {
+    if (format == GetStorageFormat() || IsEmpty()) {
+        return;
+    }
+    if (format == BitmapParameters::StorageFormat::Mask) {
+        throw std::logic_error("images are turned into masks by filters only");
+    }
+    auto [height, width] = GetSize();
+    if (format == BitmapParameters::StorageFormat::Colours) {
+        auto data = std::make_unique<Matrix<Pixel>>(width, height);
+        data->ForEachRow([this](size_t y, std::span<Pixel> row) {
+            for (size_t x = 0; x < row.size(); ++x) {
+                if (greyscale_ != nullptr) {
+                    ColourParameters::ColourType value = greyscale_->Row(y)[x];
+                    row[x] = Pixel(value, value, value, ColourParameters::ColourSchemes::Greyscale);
+                } else if (mask_ != nullptr) {
+                    row[x] = mask_palette_[mask_->GetElement(x, y)];
+                } else {
+                    const PrimitivePixel &temp = bytes_->Row(y)[x];
+                    row[x] = Pixel(ColourParameters::FromByte(temp.red), ColourParameters::FromByte(temp.green),
+                                   ColourParameters::FromByte(temp.blue));
+                }
+            }
+        });
+        data_ = std::move(data);
+    } else if (format == BitmapParameters::StorageFormat::Bytes) {
+        auto bytes = std::make_unique<Matrix<PrimitivePixel>>(width, height);
+        bytes->ForEachRow([this](size_t y, std::span<PrimitivePixel> row) {
+            for (size_t x = 0; x < row.size(); ++x) {
+                row[x] = GetPrimitivePixel(x, y);
+            }
+        });
+        bytes_ = std::move(bytes);
+    } else {
+        auto greyscale = std::make_unique<Matrix<ColourParameters::ColourType>>(width, height);
+        greyscale->ForEachRow([this](size_t y, std::span<ColourParameters::ColourType> row) {
+            for (size_t x = 0; x < row.size(); ++x) {
+                if (bytes_ != nullptr) {
+                    const PrimitivePixel &temp = bytes_->Row(y)[x];
+                    row[x] = (ColourParameters::FromByte(temp.red) + ColourParameters::FromByte(temp.green) +
+                              ColourParameters::FromByte(temp.blue)) / 3;
+                } else if (mask_ != nullptr) {
+                    row[x] = mask_palette_[mask_->GetElement(x, y)].GetValue();
+                } else {
+                    row[x] = data_->Row(y)[x].GetValue();
+                }
+            }
+        });
+        greyscale_ = std::move(greyscale);
+    }
+    if (format != BitmapParameters::StorageFormat::Colours) {
+        data_ = nullptr;
+    }
+    if (format != BitmapParameters::StorageFormat::Bytes) {
+        bytes_ = nullptr;
+    }
+    if (format != BitmapParameters::StorageFormat::Greyscale) {
+        greyscale_ = nullptr;
+    }
+    mask_ = nullptr;
+}
+
+void Bitmap::SetOutputBitsPerPixel(uint16_t bits_per_pixel) {
+    if (bits_per_pixel != BitmapParameters::COLOUR_BITS_PER_PIXEL &&
+        bits_per_pixel != BitmapParameters::GREYSCALE_BITS_PER_PIXEL &&
+        bits_per_pixel != BitmapParameters::MASK_BITS_PER_PIXEL) {
+        throw std::invalid_argument("unsupported output bits per pixel");
+    }
+    output_bits_per_pixel_ = bits_per_pixel;
+}
+
+uint16_t Bitmap::GetOutputBitsPerPixel() const {
+    return output_bits_per_pixel_;
 }
 
 Bitmap::Bitmap(const Bitmap& other) {
-    data_ = std::make_unique<Matrix<Pixel>>(Matrix<Pixel>());
-    *data_ = *(other.data_);
+    if (other.data_ != nullptr) {
+        data_ = std::make_unique<Matrix<Pixel>>(*other.data_);
+    }
+    if (other.bytes_ != nullptr) {
+        bytes_ = std::make_unique<Matrix<PrimitivePixel>>(*other.bytes_);
+    }
+    if (other.greyscale_ != nullptr) {
+        greyscale_ = std::make_unique<Matrix<ColourParameters::ColourType>>(*other.greyscale_);
+    }
+    if (other.mask_ != nullptr) {
+        mask_ = std::make_unique<BitMask>(*other.mask_);
+    }
+    mask_palette_ = other.mask_palette_;
     dib_header_ = other.dib_header_;
     bmp_header_ = other.bmp_header_;
+    output_bits_per_pixel_ = other.output_bits_per_pixel_;
 }
 Bitmap::DIBHeader Bitmap::GetDIBHeader() const {
     return dib_header_;
@@ -116,3 +529,75 @@ bool Bitmap::DIBHeader::operator==(const Bitmap::DIBHeader& other) const {
             horizontal_resolution == other.horizontal_resolution && vertical_resolution == other.vertical_resolution &&
             number_colors == other.number_colors && number_important_colors == other.number_important_colors);
 }
+
+bool BitmapRowReader::Open(const char* file_name) {
+    Bitmap::BMPHeader bmp_header;
+    Bitmap::DIBHeader dib_header;
+    if (!Bitmap::ReadHeaders(file_name, bmp_header, dib_header) ||
+        dib_header.bits_per_pixel != BitmapParameters::COLOUR_BITS_PER_PIXEL) {
+        return false;
+    }
+    file_.open(file_name, std::ios_base::in | std::ios_base::binary);
+    dib_header_ = dib_header;
+    offset_ = bmp_header.offset;
+    width_ = dib_header.width;
+    top_down_ = dib_header.height < 0;
+    height_ = top_down_ ? -static_cast<int64_t>(dib_header.height) : dib_header.height;
+    return file_.is_open();
+}
+
+size_t BitmapRowReader::GetWidth() const {
+    return width_;
+}
+
+size_t BitmapRowReader::GetHeight() const {
+    return height_;
+}
+
+bool BitmapRowReader::IsTopDown() const {
+    return top_down_;
+}
+
+const Bitmap::DIBHeader& BitmapRowReader::GetHeader() const {
+    return dib_header_;
+}
+
+bool BitmapRowReader::Read(size_t top, Matrix<Bitmap::PrimitivePixel>& rows) {
+    size_t row_size = GetRowSize(width_, BitmapParameters::COLOUR_BITS_PER_PIXEL);
+    size_t stride = row_size + GetRowPadding(width_, BitmapParameters::COLOUR_BITS_PER_PIXEL);
+    for (size_t y = 0; y < rows.GetHeight(); ++y) {
+        size_t file_row = top_down_ ? top + y : height_ - top - y - 1;
+        file_.seekg(static_cast<std::streamoff>(offset_ + file_row * stride));
+        file_.read(reinterpret_cast<char *>(rows.Row(y).data()), static_cast<std::streamsize>(row_size));
+    }
+    return static_cast<bool>(file_);
+}
+
+bool BitmapRowWriter::Open(const char* file_name, const Bitmap::DIBHeader& header) {
+    file_.open(file_name, std::ios_base::out | std::ios_base::binary);
+    Bitmap::BMPHeader bmp_header{};
+    Bitmap::DIBHeader dib_header = header;
+    bool top_down = header.height < 0;
+    size_t width = header.width;
+    size_t height = top_down ? -static_cast<int64_t>(header.height) : header.height;
+    FillHeaders(width, height, top_down, BitmapParameters::COLOUR_BITS_PER_PIXEL, 0, bmp_header, dib_header);
+    file_.write(reinterpret_cast<char *>(&bmp_header), sizeof(bmp_header));
+    file_.write(reinterpret_cast<char *>(&dib_header), sizeof(dib_header));
+    width_ = width;
+    height_ = height;
+    top_down_ = top_down;
+    return static_cast<bool>(file_);
+}
+
+bool BitmapRowWriter::Write(size_t top, const Matrix<Bitmap::PrimitivePixel>& rows) {
+    size_t row_size = GetRowSize(width_, BitmapParameters::COLOUR_BITS_PER_PIXEL);
+    size_t padding = GetRowPadding(width_, BitmapParameters::COLOUR_BITS_PER_PIXEL);
+    const char zeros[4] = {};
+    for (size_t y = 0; y < rows.GetHeight(); ++y) {
+        size_t file_row = top_down_ ? top + y : height_ - top - y - 1;
+        file_.seekp(static_cast<std::streamoff>(HEADERS_SIZE + file_row * (row_size + padding)));
+        file_.write(reinterpret_cast<const char *>(rows.Row(y).data()), static_cast<std::streamsize>(row_size));
+        file_.write(zeros, static_cast<std::streamsize>(padding));
+    }
+    return static_cast<bool>(file_);
+}
@@ -1,20 +1,52 @@
 #ifndef IMAGE_PROCESSOR_BITMAP_H
 #define IMAGE_PROCESSOR_BITMAP_H
 
+#include "bit_mask.h"
 #include "matrix.h"
 #include "pixel.h"
+#include "resample.h"
 
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
 
+namespace BitmapParameters {
+// In-memory representations of the pixels, combined into bit sets by filters declaring what they accept.
+enum StorageFormat : uint8_t {
+    Bytes = 1,      // 8-bit RGB, exactly as stored on disk
+    Colours = 2,    // Pixel with double channels in [0, 1]
+    Greyscale = 4,  // a single double plane, for images whose channels are all equal
+    Mask = 8,       // one bit per pixel choosing between two colours, produced by filters only
+};
+using StorageFormats = uint8_t;
+
+const uint16_t COLOUR_BITS_PER_PIXEL = 24;
+const uint16_t GREYSCALE_BITS_PER_PIXEL = 8;  // with a 256-entry grey palette
+const uint16_t MASK_BITS_PER_PIXEL = 1;       // with a 2-entry palette
+const size_t PALETTE_SIZE = 256;
+const size_t MASK_PALETTE_SIZE = 2;
+}  // namespace BitmapParameters
+
+// The pixels stay in their 8-bit on-disk form until somebody asks for Colours (GetData) and are demoted back
+// only when somebody asks for Bytes again (GetBytes), so pipelines of byte-friendly filters never convert at all.
+// Greyscale images keep a single plane (GetGreyscale) instead of three equal channels,
+// two-colour images keep a bit-packed mask (GetMask) and the two colours.
 class Bitmap {
 public:
     Bitmap(const Bitmap& other);
     Bitmap(Bitmap&& other) = default;
-    Bitmap() : data_(nullptr), bmp_header_(), dib_header_(){};
+    Bitmap()
+        : data_(nullptr),
+          bytes_(nullptr),
+          greyscale_(nullptr),
+          mask_(nullptr),
+          mask_palette_(),
+          bmp_header_(),
+          dib_header_(),
+          output_bits_per_pixel_(BitmapParameters::COLOUR_BITS_PER_PIXEL){};
 
     struct BMPHeader {
         uint16_t signature;
@@ -59,13 +91,37 @@ public:
             red = 0;
         };
 
+        bool operator==(const PrimitivePixel& other) const = default;
+
     } __attribute__((packed));
 
-    bool load(std::istream& istr);
-    bool load(const char* file_name);
+    // 24-bit pictures at least min_width x min_height times larger are box-averaged by whole factors while
+    // being read (as Resample::GetBoxFactor(width, min_width / REDUCING_GAP) would have it), the full-size
+    // pixels are never stored. Other pictures are loaded as they are.
+    bool load(std::istream& istr, size_t min_width = 0, size_t min_height = 0);
+    bool load(const char* file_name, size_t min_width = 0, size_t min_height = 0);
     bool save(std::ofstream& istr);
     bool save(const char* file_name);
     Matrix<Pixel>* GetData();
+    Matrix<PrimitivePixel>* GetBytes();
+    Matrix<ColourParameters::ColourType>* GetGreyscale();
+    void SetData(Matrix<Pixel>&& data);
+    void SetGreyscale(Matrix<ColourParameters::ColourType>&& plane);
+    void SetBytes(Matrix<PrimitivePixel>&& bytes);
+    // nullptr unless the storage is Mask: no conversion leads to a mask.
+    BitMask* GetMask();
+    const std::array<Pixel, BitmapParameters::MASK_PALETTE_SIZE>& GetMaskPalette() const;
+    void SetMask(BitMask&& mask, const Pixel& unset, const Pixel& set);
+    BitmapParameters::StorageFormat GetStorageFormat() const;
+    // Greyscale storage or a mask of two shades of grey.
+    bool IsGreyscale() const;
+    // Switches the storage to format, converting the pixels if needed (colours become greyscale by averaging),
+    // throws std::logic_error when asked for a Mask.
+    void Convert(BitmapParameters::StorageFormat format);
+    // 24 (default), 8 or 1: 8 saves a greyscale image with a grey palette, 1 saves the mask with its two colours
+    // (other storages are split at mid-grey into black and white).
+    void SetOutputBitsPerPixel(uint16_t bits_per_pixel);
+    uint16_t GetOutputBitsPerPixel() const;
 
     Bitmap& operator=(const Bitmap& other) = delete;
     Bitmap& operator=(Bitmap&& other) = default;
@@ -73,14 +129,64 @@ public:
 
     static bool CheckBMPHeader(const BMPHeader& header);  // true, если header - хороший, false иначе
     static bool CheckDIBHeader(const DIBHeader& header);
+    // Reads the headers of a file without its pixels, false if the file cannot be read or is not supported.
+    static bool ReadHeaders(const char* file_name, BMPHeader& bmp_header, DIBHeader& dib_header);
 
     DIBHeader GetDIBHeader() const;  // true, если header - хороший, false иначе
     BMPHeader GetBMPHeader() const;
+    // {height, width} of the pixels in whatever storage they are, {0, 0} for an empty bitmap.
+    std::pair<size_t, size_t> GetSize() const;
 
 protected:
     std::unique_ptr<Matrix<Pixel>> data_;
+    std::unique_ptr<Matrix<PrimitivePixel>> bytes_;
+    std::unique_ptr<Matrix<ColourParameters::ColourType>> greyscale_;
+    std::unique_ptr<BitMask> mask_;
+    std::array<Pixel, BitmapParameters::MASK_PALETTE_SIZE> mask_palette_;
     BMPHeader bmp_header_;
     DIBHeader dib_header_;
+    uint16_t output_bits_per_pixel_;
+
+    PrimitivePixel GetPrimitivePixel(size_t x, size_t y) const;
+    bool IsEmpty() const;
+};
+
+// A 24-bit file read a band of rows at a time. The rows are numbered from the top of the picture whatever the
+// order of the file and are found by seeking, so only the rows asked for are ever held.
+class BitmapRowReader {
+public:
+    // false if the file cannot be read or is not a 24-bit BMP.
+    bool Open(const char* file_name);
+    size_t GetWidth() const;
+    size_t GetHeight() const;
+    bool IsTopDown() const;
+    const Bitmap::DIBHeader& GetHeader() const;
+    // Reads the rows [top, top + rows.GetHeight()) of the picture into rows.
+    bool Read(size_t top, Matrix<Bitmap::PrimitivePixel>& rows);
+
+protected:
+    std::ifstream file_;
+    Bitmap::DIBHeader dib_header_{};
+    size_t offset_ = 0;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    bool top_down_ = false;
+};
+
+// A 24-bit file written a band of rows at a time, the bands may come in any order.
+class BitmapRowWriter {
+public:
+    // Creates the file and writes the headers of a 24-bit picture, keeping the other fields (e.g. the resolution)
+    // of header as Bitmap::save keeps those of the loaded file.
+    bool Open(const char* file_name, const Bitmap::DIBHeader& header);
+    // Writes rows as the rows [top, top + rows.GetHeight()) of the picture.
+    bool Write(size_t top, const Matrix<Bitmap::PrimitivePixel>& rows);
+
+protected:
+    std::ofstream file_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    bool top_down_ = false;
 };
 
 #endif
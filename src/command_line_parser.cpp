@@ -1,75 +1,138 @@
-#include "command_line_parser.h"
-
-bool CommandLineParser::Parse(int argc, char* argv[]) {
-    if (argc < MIN_ARG_NUM) {
-        if (argc == 2) {
-            if (argv[HELP_INDEX][0] == '-') {
-                is_used_for_help_ = true;
-                desired_function_ = argv[HELP_INDEX];
-            }
-            return false;
-        }
-        is_used_for_help_ = true;
-        desired_function_ = "-h";
-        return false;
-    }
-    input_file_name_ = argv[INPUT_FILE_INDEX];
-    output_file_name_ = argv[OUTPUT_FILE_INDEX];
-    if (argc > MIN_ARG_NUM) {
-        FilterDescriptor current_descriptor;
-        bool is_void = true;
-        for (size_t i = 3; i < argc; ++i) {
-            if (argv[i][0] == '-') {
-                if (is_void) {
-                    is_void = false;
-                } else {
-                    descriptions_.push_back(current_descriptor);
-                    current_descriptor = FilterDescriptor();
-                }
-                current_descriptor.SetFilterName({argv[i], strlen(argv[i])});
-            } else {
-                if (is_void) {
-                    return false;
-                }
-                current_descriptor.AddParameter({argv[i], strlen(argv[i])});
-            }
-        }
-        descriptions_.push_back(current_descriptor);
-    }
-    return true;
-}
-
-CommandLineParser::CommandLineParser()
-    : descriptions_(std::vector<FilterDescriptor>(0)), is_used_for_help_(false), desired_function_() {
-}
-
-std::vector<FilterDescriptor> CommandLineParser::GetDescriptions() const {
-    return descriptions_;
-}
-
-bool CommandLineParser::IsUsedForHelp() const {
-    return is_used_for_help_;
-}
-std::string CommandLineParser::GetDesiredFunction() const {
-    return desired_function_;
-}
-
-void FilterDescriptor::SetFilterName(std::string_view new_name) {
-    filter_name_ = new_name;
-}
-
-void FilterDescriptor::SetParams(const std::vector<std::string_view>& params) {
-    params_ = params;
-}
-
-void FilterDescriptor::AddParameter(std::string_view new_param) {
-    params_.push_back(new_param);
-}
-
-std::string_view FilterDescriptor::GetFilterName() const {
-    return filter_name_;
-}
-
-std::vector<std::string_view> FilterDescriptor::GetParams() const {
-    return params_;
-}
+#include "command_line_parser.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace {
+// Negative numbers (e.g. kernel weights of -conv) are parameters, not filter names.
+bool IsNegativeNumber(const char* argument) {
+    return argument[0] == '-' && (std::isdigit(static_cast<unsigned char>(argument[1])) || argument[1] == '.');
+}
+}  // namespace
+
+bool CommandLineParser::Parse(int argc, char* argv[]) {
+    if (argc < MIN_ARG_NUM) {
+        if (argc == 2) {
+            if (argv[HELP_INDEX][0] == '-') {
+                is_used_for_help_ = true;
+                desired_function_ = argv[HELP_INDEX];
+            }
+            return false;
+        }
+        is_used_for_help_ = true;
+        desired_function_ = "-h";
+        return false;
+    }
+    input_file_name_ = argv[INPUT_FILE_INDEX];
+    output_file_name_ = argv[OUTPUT_FILE_INDEX];
+    branches_.push_back({output_file_name_, {}});
+    if (argc > MIN_ARG_NUM) {
+        FilterDescriptor current_descriptor;
+        bool is_void = true;
+        size_t count = static_cast<size_t>(argc);
+        for (size_t i = 3; i < count; ++i) {
+            if (argv[i][0] == '-' && argv[i][1] == '-') {
+                if (i + 1 >= count) {
+                    return false;
+                }
+                if (!is_void) {
+                    branches_.back().descriptions.push_back(current_descriptor);
+                    current_descriptor = FilterDescriptor();
+                    is_void = true;
+                }
+                std::string_view name = {argv[i], strlen(argv[i])};
+                std::string_view value = {argv[i + 1], strlen(argv[i + 1])};
+                if (name == OUTPUT_OPTION) {
+                    branches_.push_back({value, {}});
+                } else {
+                    options_[name] = value;
+                }
+                ++i;
+            } else if (argv[i][0] == '-' && !IsNegativeNumber(argv[i])) {
+                if (is_void) {
+                    is_void = false;
+                } else {
+                    branches_.back().descriptions.push_back(current_descriptor);
+                    current_descriptor = FilterDescriptor();
+                }
+                current_descriptor.SetFilterName({argv[i], strlen(argv[i])});
+            } else {
+                if (is_void) {
+                    return false;
+                }
+                current_descriptor.AddParameter({argv[i], strlen(argv[i])});
+            }
+        }
+        if (!is_void) {
+            branches_.back().descriptions.push_back(current_descriptor);
+        }
+    }
+    return true;
+}
+
+CommandLineParser::CommandLineParser()
+    : branches_(), is_used_for_help_(false), desired_function_() {
+}
+
+std::vector<FilterDescriptor> CommandLineParser::GetDescriptions() const {
+    if (branches_.empty()) {
+        return {};
+    }
+    return branches_.front().descriptions;
+}
+
+const CommandLineParser::Branches& CommandLineParser::GetBranches() const {
+    return branches_;
+}
+
+bool CommandLineParser::IsUsedForHelp() const {
+    return is_used_for_help_;
+}
+std::string CommandLineParser::GetDesiredFunction() const {
+    return desired_function_;
+}
+
+const CommandLineParser::Options& CommandLineParser::GetOptions() const {
+    return options_;
+}
+
+bool CommandLineParser::HasOption(std::string_view name) const {
+    return options_.find(name) != options_.end();
+}
+
+std::string_view CommandLineParser::GetOption(std::string_view name) const {
+    auto option = options_.find(name);
+    if (option == options_.end()) {
+        return {};
+    }
+    return option->second;
+}
+
+void FilterDescriptor::SetFilterName(std::string_view new_name) {
+    filter_name_ = new_name;
+}
+
+void FilterDescriptor::SetParams(const std::vector<std::string_view>& params) {
+    params_ = params;
+}
+
+void FilterDescriptor::AddParameter(std::string_view new_param) {
+    params_.push_back(new_param);
+}
+
+std::string_view FilterDescriptor::GetFilterName() const {
+    return filter_name_;
+}
+
+std::vector<std::string_view> FilterDescriptor::GetParams() const {
+    return params_;
+}
+
+std::string FilterDescriptor::GetCanonicalForm() const {
+    std::string canonical_form(filter_name_);
+    for (std::string_view param : params_) {
+        canonical_form += ' ';
+        canonical_form += param;
+    }
+    return canonical_form;
+}
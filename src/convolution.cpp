@@ -0,0 +1,240 @@
+#include "convolution.h"
+
+#include <cmath>
+
+namespace {
+// The transform size for a kernel of kernel_size taps minimising the work per picture element,
+// tiles are kept not shorter than the kernel's spill.
+size_t ChooseTransformSize(size_t kernel_size) {
+    size_t smallest = Fft::GetGoodSize(std::max(2 * kernel_size, ConvolutionParameters::MIN_TRANSFORM_SIZE));
+    size_t best = smallest;
+    double best_cost = HUGE_VAL;
+    for (size_t size = smallest; size <= ConvolutionParameters::MAX_TRANSFORM_SIZE;
+         size = Fft::GetGoodSize(size + 1)) {
+        double cost = static_cast<double>(size) * std::log2(static_cast<double>(size)) /
+                      static_cast<double>(size - kernel_size + 1);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = size;
+        }
+    }
+    return best;
+}
+}  // namespace
+
+ConvolutionEngine::ConvolutionEngine(const Kernel& kernel)
+    : kernel_(kernel),
+      row_plan_(ChooseTransformSize(kernel.GetWidth())),
+      column_plan_(ChooseTransformSize(kernel.GetHeight())),
+      tile_width_(row_plan_.GetSize() - kernel.GetWidth() + 1),
+      tile_height_(column_plan_.GetSize() - kernel.GetHeight() + 1) {
+    size_t transform_width = row_plan_.GetSize();
+    size_t transform_height = column_plan_.GetSize();
+    spectrum_.resize(transform_width * transform_height);
+    double scale = 1.0 / static_cast<double>(spectrum_.size());
+    size_t kernel_width = kernel.GetWidth();
+    size_t kernel_height = kernel.GetHeight();
+    for (size_t y = 0; y < kernel_height; ++y) {
+        for (size_t x = 0; x < kernel_width; ++x) {
+            spectrum_[y * transform_width + x] =
+                kernel.GetElement(kernel_width - 1 - x, kernel_height - 1 - y) * scale;
+        }
+    }
+    std::vector<Fft::Complex> scratch(std::max(transform_width, transform_height) * 2);
+    TransformTile(spectrum_, kernel_height, false, scratch);
+}
+
+void ConvolutionEngine::TransformTile(std::vector<Fft::Complex>& tile, size_t rows, bool is_inverse,
+                                      std::vector<Fft::Complex>& scratch) const {
+    size_t transform_width = row_plan_.GetSize();
+    size_t transform_height = column_plan_.GetSize();
+    Fft::Complex* column = scratch.data() + transform_height;
+    // Forward transforms go by rows first, which skips the rows known to be zero, inverse ones by columns first.
+    auto transform_rows = [&]() {
+        for (size_t y = 0; y < rows; ++y) {
+            row_plan_.Transform(tile.data() + y * transform_width, is_inverse, scratch.data());
+        }
+    };
+    auto transform_columns = [&]() {
+        for (size_t x = 0; x < transform_width; ++x) {
+            for (size_t y = 0; y < transform_height; ++y) {
+                column[y] = tile[y * transform_width + x];
+            }
+            column_plan_.Transform(column, is_inverse, scratch.data());
+            for (size_t y = 0; y < transform_height; ++y) {
+                tile[y * transform_width + x] = column[y];
+            }
+        }
+    };
+    if (is_inverse) {
+        transform_columns();
+        transform_rows();
+    } else {
+        transform_rows();
+        transform_columns();
+    }
+}
+
+void ConvolutionEngine::MultiplyBySpectrum(std::vector<Fft::Complex>& tile) const {
+    for (size_t i = 0; i < tile.size(); ++i) {
+        tile[i] = Fft::Multiply(tile[i], spectrum_[i]);
+    }
+}
+
+double ConvolutionEngine::GetDirectCost(size_t width, size_t height, size_t planes) const {
+    return static_cast<double>(width * height * planes) * static_cast<double>(kernel_.GetWidth() * kernel_.GetHeight());
+}
+
+double ConvolutionEngine::GetFftCost(size_t width, size_t height, size_t planes) const {
+    if (tile_width_ == 0 || tile_height_ == 0) {
+        return HUGE_VAL;
+    }
+    size_t tiles_x = (width + kernel_.GetWidth() - 1 + tile_width_ - 1) / tile_width_;
+    size_t tiles_y = (height + kernel_.GetHeight() - 1 + tile_height_ - 1) / tile_height_;
+    size_t transforms = tiles_y * ((tiles_x * planes + 1) / 2);
+    double transform_width = static_cast<double>(row_plan_.GetSize());
+    double transform_height = static_cast<double>(column_plan_.GetSize());
+    double levels = std::log2(transform_width) + std::log2(transform_height);
+    return static_cast<double>(transforms) * transform_width * transform_height *
+           (2 * ConvolutionParameters::TRANSFORM_COST * levels + ConvolutionParameters::TILE_ELEMENT_COST);
+}
+
+bool ConvolutionEngine::IsFftCheaper(size_t width, size_t height, size_t planes) const {
+    return GetFftCost(width, height, planes) < GetDirectCost(width, height, planes);
+}
+
+KernelAnalysis AnalyseKernel(const Matrix<ConvolutionParameters::KernelType>& kernel) {
+    KernelAnalysis analysis;
+    analysis.width = kernel.GetWidth();
+    analysis.height = kernel.GetHeight();
+    if (analysis.width == 0) {
+        return analysis;
+    }
+    double norm = 0;
+    for (size_t y = 0; y < analysis.height; ++y) {
+        for (size_t x = 0; x < analysis.width; ++x) {
+            norm = std::max(norm, std::abs(kernel.GetElement(x, y)));
+        }
+    }
+    double eps = ConvolutionParameters::ANALYSIS_EPS * std::max(norm, 1.0);
+    analysis.is_symmetric = true;
+    analysis.is_integer = true;
+    for (size_t y = 0; y < analysis.height; ++y) {
+        for (size_t x = 0; x < analysis.width; ++x) {
+            double weight = kernel.GetElement(x, y);
+            analysis.zero_taps += weight == 0;
+            analysis.is_integer = analysis.is_integer && weight == std::round(weight);
+            analysis.is_symmetric =
+                analysis.is_symmetric &&
+                std::abs(weight - kernel.GetElement(analysis.width - 1 - x, analysis.height - 1 - y)) <= eps;
+        }
+    }
+
+    // Power iteration for the largest singular value and its vectors, started from the heaviest row,
+    // converges at once for kernels of rank 1.
+    std::vector<double> row(analysis.width);
+    std::vector<double> column(analysis.height);
+    double heaviest = -1;
+    for (size_t y = 0; y < analysis.height; ++y) {
+        double weight = 0;
+        for (size_t x = 0; x < analysis.width; ++x) {
+            weight += kernel.GetElement(x, y) * kernel.GetElement(x, y);
+        }
+        if (weight > heaviest) {
+            heaviest = weight;
+            for (size_t x = 0; x < analysis.width; ++x) {
+                row[x] = kernel.GetElement(x, y);
+            }
+        }
+    }
+    if (heaviest == 0) {
+        return analysis;
+    }
+    auto normalise = [](std::vector<double>& vector) {
+        double length = 0;
+        for (double element : vector) {
+            length += element * element;
+        }
+        length = std::sqrt(length);
+        for (double& element : vector) {
+            element /= length;
+        }
+        return length;
+    };
+    normalise(row);
+    double singular_value = 0;
+    for (size_t iteration = 0; iteration < ConvolutionParameters::POWER_ITERATIONS; ++iteration) {
+        for (size_t y = 0; y < analysis.height; ++y) {
+            column[y] = 0;
+            for (size_t x = 0; x < analysis.width; ++x) {
+                column[y] += kernel.GetElement(x, y) * row[x];
+            }
+        }
+        singular_value = normalise(column);
+        std::vector<double> previous = row;
+        for (size_t x = 0; x < analysis.width; ++x) {
+            row[x] = 0;
+            for (size_t y = 0; y < analysis.height; ++y) {
+                row[x] += kernel.GetElement(x, y) * column[y];
+            }
+        }
+        singular_value = normalise(row);
+        double change = 0;
+        for (size_t x = 0; x < analysis.width; ++x) {
+            change = std::max(change, std::abs(row[x] - previous[x]));
+        }
+        if (change <= ConvolutionParameters::ANALYSIS_EPS) {
+            break;
+        }
+    }
+    analysis.is_separable = true;
+    for (size_t y = 0; y < analysis.height; ++y) {
+        for (size_t x = 0; x < analysis.width; ++x) {
+            double residual = kernel.GetElement(x, y) - singular_value * column[y] * row[x];
+            analysis.is_separable = analysis.is_separable && std::abs(residual) <= eps;
+        }
+    }
+    if (analysis.is_separable) {
+        for (double& element : column) {
+            element *= singular_value;
+        }
+        analysis.column = std::move(column);
+        analysis.row = std::move(row);
+    }
+    return analysis;
+}
+
+TapConvolution::TapConvolution(const Matrix<ConvolutionParameters::KernelType>& kernel)
+    : width_(kernel.GetWidth()), height_(kernel.GetHeight()) {
+    // Taps are visited by rows, each pair is taken at its first tap.
+    for (size_t y = 0; y < height_; ++y) {
+        for (size_t x = 0; x < width_; ++x) {
+            ConvolutionParameters::KernelType weight = kernel.GetElement(x, y);
+            size_t mirror_x = width_ - 1 - x;
+            size_t mirror_y = height_ - 1 - y;
+            size_t index = y * width_ + x;
+            size_t mirror_index = mirror_y * width_ + mirror_x;
+            if (weight == 0 || mirror_index < index) {
+                if (weight != 0 && kernel.GetElement(mirror_x, mirror_y) != weight) {
+                    taps_.push_back({x, y, mirror_x, mirror_y, false, weight});
+                }
+                continue;
+            }
+            bool is_paired = mirror_index != index && kernel.GetElement(mirror_x, mirror_y) == weight;
+            taps_.push_back({x, y, mirror_x, mirror_y, is_paired, weight});
+        }
+    }
+}
+
+IntegerConvolution::IntegerConvolution(const Matrix<ConvolutionParameters::KernelType>& kernel)
+    : TapConvolution(kernel), weight_sum_(0) {
+    for (size_t y = 0; y < height_; ++y) {
+        for (size_t x = 0; x < width_; ++x) {
+            ConvolutionParameters::KernelType weight = kernel.GetElement(x, y);
+            if (weight != std::round(weight) || std::abs(weight) > std::numeric_limits<int16_t>::max()) {
+                throw std::invalid_argument("the integer convolution needs integer weights");
+            }
+            weight_sum_ += static_cast<uint64_t>(std::abs(weight));
+        }
+    }
+}
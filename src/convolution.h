@@ -0,0 +1,385 @@
+#ifndef IMAGE_PROCESSOR_CONVOLUTION_H
+#define IMAGE_PROCESSOR_CONVOLUTION_H
+
+#include "fft.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "pixel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace ConvolutionParameters {
+using KernelType = double;
+// Tiles are not made larger than this per dimension.
+const size_t MAX_TRANSFORM_SIZE = 512;
+const size_t MIN_TRANSFORM_SIZE = 16;
+// Measured costs of a transform butterfly per element and level and of the per-element work around it
+// (loading, spectrum multiplication, accumulation), in multiply-adds of the direct convolution.
+const double TRANSFORM_COST = 3.6;
+const double TILE_ELEMENT_COST = 16;
+// Relative tolerance of the kernel analysis (symmetry, rank-1 residual).
+const double ANALYSIS_EPS = 1e-9;
+const size_t POWER_ITERATIONS = 100;
+// Integer kernels with more taps are cheaper as separable passes or through the FFT in double.
+const size_t MAX_INTEGER_TAPS = 49;
+}  // namespace ConvolutionParameters
+
+// Planes of the elements convolved independently, the FFT path transforms them one by one.
+template <typename ElementType>
+struct ConvolutionPlanes {
+    static constexpr size_t COUNT = 1;
+    static ElementType& Get(ElementType& element, size_t) {
+        return element;
+    }
+    static ElementType Get(const ElementType& element, size_t) {
+        return element;
+    }
+};
+
+template <>
+struct ConvolutionPlanes<ColourValue> {
+    static constexpr size_t COUNT = 3;
+    static ColourParameters::ColourType& Get(ColourValue& element, size_t plane) {
+        return plane == 0 ? element.red : (plane == 1 ? element.green : element.blue);
+    }
+    static ColourParameters::ColourType Get(const ColourValue& element, size_t plane) {
+        return plane == 0 ? element.red : (plane == 1 ? element.green : element.blue);
+    }
+};
+
+// What decides how to convolve with a kernel.
+struct KernelAnalysis {
+    size_t width = 0;
+    size_t height = 0;
+    size_t zero_taps = 0;
+    // Equal to itself turned by 180 degrees, so the taps come in pairs of equal weights.
+    bool is_symmetric = false;
+    // Exactly, so that IntegerConvolution takes the kernel.
+    bool is_integer = false;
+    // Of rank 1: kernel(x, y) = column[y] * row[x], found by the power iteration for its largest singular value.
+    bool is_separable = false;
+    std::vector<ConvolutionParameters::KernelType> column;
+    std::vector<ConvolutionParameters::KernelType> row;
+};
+
+KernelAnalysis AnalyseKernel(const Matrix<ConvolutionParameters::KernelType>& kernel);
+
+// Convolution by the list of the kernel's non-zero taps, pairs of equal weights placed symmetrically share
+// a multiplication. Gives the result of Matrix::Convolution.
+class TapConvolution {
+public:
+    TapConvolution() : width_(0), height_(0){};
+    explicit TapConvolution(const Matrix<ConvolutionParameters::KernelType>& kernel);
+
+    size_t GetTapCount() const {
+        return taps_.size();
+    }
+    template <typename ElementType>
+    void Apply(Matrix<ElementType>& data) const;
+
+protected:
+    // Taps are offsets in the kernel, a paired tap adds the element at (mirror_x, mirror_y) with the same weight.
+    struct Tap {
+        size_t x;
+        size_t y;
+        size_t mirror_x;
+        size_t mirror_y;
+        bool is_paired;
+        ConvolutionParameters::KernelType weight;
+    };
+
+    size_t width_;
+    size_t height_;
+    std::vector<Tap> taps_;
+};
+
+template <typename ElementType>
+void TapConvolution::Apply(Matrix<ElementType>& data) const {
+    size_t width = data.GetWidth();
+    size_t height = data.GetHeight();
+    if (width == 0 || height == 0 || height_ == 0) {
+        return;
+    }
+    size_t mid_width = width_ / 2;
+    size_t mid_height = height_ / 2;
+    const Matrix<ElementType>& source = data;
+    Matrix<ElementType> result(width, height);
+    result.ForEachRow([&](size_t i, std::span<ElementType> result_row) {
+        // padded[y] is the source row i + y - mid_height extended by copies of its ends.
+        std::vector<std::vector<ElementType>> padded(height_, std::vector<ElementType>(width + width_ - 1));
+        for (size_t y = 0; y < height_; ++y) {
+            size_t source_y = y + i < mid_height ? 0 : std::min(y + i - mid_height, height - 1);
+            std::span<const ElementType> source_row = source.Row(source_y);
+            for (size_t k = 0; k < padded[y].size(); ++k) {
+                padded[y][k] = source_row[mid_width > k ? 0 : std::min(k - mid_width, width - 1)];
+            }
+        }
+        for (const Tap& tap : taps_) {
+            const ElementType* shifted = padded[tap.y].data() + tap.x;
+            if (tap.is_paired) {
+                const ElementType* mirrored = padded[tap.mirror_y].data() + tap.mirror_x;
+                for (size_t j = 0; j < width; ++j) {
+                    result_row[j] += (shifted[j] + mirrored[j]) * tap.weight;
+                }
+            } else {
+                for (size_t j = 0; j < width; ++j) {
+                    result_row[j] += shifted[j] * tap.weight;
+                }
+            }
+        }
+    });
+    data = std::move(result);
+}
+
+// TapConvolution of integer channels (8- or 16-bit) with a kernel of integer weights. The sums are exact
+// in the accumulator (int16_t when they fit, int32_t otherwise) and saturated once to the channel range,
+// so the result is the double convolution of the same channels rounded back to them. Rows are processed as
+// runs of interleaved channels of one type by the vector multiply-adds of Simd::MultiplyAdd.
+class IntegerConvolution : public TapConvolution {
+public:
+    IntegerConvolution() : weight_sum_(0){};
+    // Throws std::invalid_argument for kernels with weights that are not integers.
+    explicit IntegerConvolution(const Matrix<ConvolutionParameters::KernelType>& kernel);
+
+    // Whether every partial sum over Channel values fits into int32_t.
+    template <typename Channel>
+    bool IsApplicable() const {
+        return weight_sum_ * std::numeric_limits<Channel>::max() <=
+               static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+    }
+    // source and destination are rows of elements of channels interleaved channels each (e.g. 3 for BGR),
+    // their width is counted in channels. Throws std::logic_error if the filter is not applicable.
+    template <typename Channel>
+    void Apply(const MatrixView<const Channel>& source, const MatrixView<Channel>& destination, size_t channels) const;
+
+protected:
+    template <typename Accumulator, typename Channel>
+    void Accumulate(const MatrixView<const Channel>& source, const MatrixView<Channel>& destination,
+                    size_t channels) const;
+
+    // Sum of the absolute weights, bounds every partial sum together with the largest channel value.
+    uint64_t weight_sum_;
+};
+
+template <typename Channel>
+void IntegerConvolution::Apply(const MatrixView<const Channel>& source, const MatrixView<Channel>& destination,
+                               size_t channels) const {
+    if (!IsApplicable<Channel>()) {
+        throw std::logic_error("the sums of the integer convolution do not fit into 32 bits");
+    }
+    if (weight_sum_ * std::numeric_limits<Channel>::max() <=
+        static_cast<uint64_t>(std::numeric_limits<int16_t>::max())) {
+        Accumulate<int16_t>(source, destination, channels);
+    } else {
+        Accumulate<int32_t>(source, destination, channels);
+    }
+}
+
+template <typename Accumulator, typename Channel>
+void IntegerConvolution::Accumulate(const MatrixView<const Channel>& source, const MatrixView<Channel>& destination,
+                                    size_t channels) const {
+    size_t row_length = source.width;
+    size_t width = row_length / channels;
+    size_t height = source.height;
+    if (width == 0 || height == 0 || height_ == 0) {
+        return;
+    }
+    size_t mid_width = width_ / 2;
+    size_t mid_height = height_ / 2;
+    size_t padded_length = (width + width_ - 1) * channels;
+    Parallel::ForBlocks(height, [&](size_t begin, size_t end) {
+        // rows[y] holds the source row i + y - mid_height (clamped to the picture) widened to Accumulator
+        // and extended by copies of its end elements, the window rolls down by one row per result row.
+        std::vector<std::vector<Accumulator>> rows(height_, std::vector<Accumulator>(padded_length));
+        std::vector<Accumulator> sums(row_length);
+        auto load_row = [&](std::vector<Accumulator>& buffer, size_t i, size_t y) {
+            size_t source_y = y + i < mid_height ? 0 : std::min(y + i - mid_height, height - 1);
+            const Channel* source_row = source.Row(source_y).data();
+            for (size_t element = 0; element < width + width_ - 1; ++element) {
+                size_t source_element = element < mid_width ? 0 : std::min(element - mid_width, width - 1);
+                for (size_t channel = 0; channel < channels; ++channel) {
+                    buffer[element * channels + channel] = source_row[source_element * channels + channel];
+                }
+            }
+        };
+        for (size_t y = 0; y < height_; ++y) {
+            load_row(rows[y], begin, y);
+        }
+        for (size_t i = begin; i < end; ++i) {
+            if (i > begin) {
+                std::rotate(rows.begin(), rows.begin() + 1, rows.end());
+                load_row(rows.back(), i, height_ - 1);
+            }
+            std::fill(sums.begin(), sums.end(), Accumulator{});
+            Accumulator* sum = sums.data();
+            for (const Tap& tap : taps_) {
+                const Accumulator* shifted = rows[tap.y].data() + tap.x * channels;
+                const Accumulator* mirrored =
+                    tap.is_paired ? rows[tap.mirror_y].data() + tap.mirror_x * channels : nullptr;
+                Simd::MultiplyAdd(sum, shifted, mirrored, static_cast<Accumulator>(std::lround(tap.weight)),
+                                  row_length);
+            }
+            std::span<Channel> result_row = destination.Row(i);
+            for (size_t j = 0; j < row_length; ++j) {
+                result_row[j] = static_cast<Channel>(
+                    std::clamp<Accumulator>(sum[j], 0, static_cast<Accumulator>(std::numeric_limits<Channel>::max())));
+            }
+        }
+    });
+}
+
+// A kernel together with what its FFT path needs, computed once: the tile geometry and the kernel spectrum.
+// Apply gives the result of Matrix::Convolution (borders extended by their closest elements), taking
+// the direct or the FFT path by their estimated costs. The FFT path works by overlap-add over tiles of
+// the border-extended picture, two real planes or tiles packed into one complex transform.
+class ConvolutionEngine {
+public:
+    using Kernel = Matrix<ConvolutionParameters::KernelType>;
+
+    ConvolutionEngine() : tile_width_(0), tile_height_(0){};
+    explicit ConvolutionEngine(const Kernel& kernel);
+
+    const Kernel& GetKernel() const {
+        return kernel_;
+    }
+    // Estimated costs of convolving a width x height picture of planes planes, in multiply-adds.
+    double GetDirectCost(size_t width, size_t height, size_t planes) const;
+    double GetFftCost(size_t width, size_t height, size_t planes) const;
+    bool IsFftCheaper(size_t width, size_t height, size_t planes) const;
+
+    template <typename ElementType>
+    void Apply(Matrix<ElementType>& data) const {
+        if (IsFftCheaper(data.GetWidth(), data.GetHeight(), ConvolutionPlanes<ElementType>::COUNT)) {
+            ApplyFft(data);
+        } else {
+            ApplyDirect(data);
+        }
+    }
+    template <typename ElementType>
+    void ApplyDirect(Matrix<ElementType>& data) const {
+        data.Convolution(kernel_);
+    }
+    template <typename ElementType>
+    void ApplyFft(Matrix<ElementType>& data) const;
+
+protected:
+    // 2D transform of a row_plan_ x column_plan_ tile stored by rows, only its first rows rows may be non-zero.
+    void TransformTile(std::vector<Fft::Complex>& tile, size_t rows, bool is_inverse,
+                       std::vector<Fft::Complex>& scratch) const;
+    void MultiplyBySpectrum(std::vector<Fft::Complex>& tile) const;
+
+    Kernel kernel_;
+    Fft::Plan row_plan_;
+    Fft::Plan column_plan_;
+    // Size of the picture part each tile takes, the rest of the transform holds the kernel's spill.
+    size_t tile_width_;
+    size_t tile_height_;
+    // Transform of the kernel turned by 180 degrees, divided by the transform size.
+    std::vector<Fft::Complex> spectrum_;
+};
+
+template <typename ElementType>
+void ConvolutionEngine::ApplyFft(Matrix<ElementType>& data) const {
+    using Planes = ConvolutionPlanes<ElementType>;
+    size_t width = data.GetWidth();
+    size_t height = data.GetHeight();
+    if (width == 0 || height == 0 || kernel_.GetWidth() == 0) {
+        return;
+    }
+    size_t kernel_width = kernel_.GetWidth();
+    size_t kernel_height = kernel_.GetHeight();
+    size_t mid_width = kernel_width / 2;
+    size_t mid_height = kernel_height / 2;
+    size_t transform_width = row_plan_.GetSize();
+    size_t transform_height = column_plan_.GetSize();
+    size_t padded_width = width + kernel_width - 1;
+    size_t padded_height = height + kernel_height - 1;
+    size_t tiles_x = (padded_width + tile_width_ - 1) / tile_width_;
+    size_t tiles_y = (padded_height + tile_height_ - 1) / tile_height_;
+    // A job is one plane of one tile, jobs of a tile row are taken two at a time.
+    size_t jobs = tiles_x * Planes::COUNT;
+
+    const Matrix<ElementType>& source = data;
+    Matrix<ElementType> result(width, height);
+    auto run_tile_row = [&](size_t tile_y) {
+        std::vector<Fft::Complex> tile(transform_width * transform_height);
+        std::vector<Fft::Complex> scratch(std::max(transform_width, transform_height) * 2);
+        size_t top = tile_y * tile_height_;
+        size_t rows = std::min(tile_height_, padded_height - top);
+        for (size_t job = 0; job < jobs; job += 2) {
+            std::fill(tile.begin(), tile.end(), Fft::Complex());
+            size_t parts = std::min<size_t>(2, jobs - job);
+            for (size_t part = 0; part < parts; ++part) {
+                size_t left = (job + part) / Planes::COUNT * tile_width_;
+                size_t plane = (job + part) % Planes::COUNT;
+                size_t columns = std::min(tile_width_, padded_width - left);
+                for (size_t y = 0; y < rows; ++y) {
+                    size_t source_y = top + y < mid_height ? 0 : std::min(top + y - mid_height, height - 1);
+                    std::span<const ElementType> source_row = source.Row(source_y);
+                    Fft::Complex* tile_row = tile.data() + y * transform_width;
+                    for (size_t x = 0; x < columns; ++x) {
+                        size_t source_x = left + x < mid_width ? 0 : std::min(left + x - mid_width, width - 1);
+                        double value = Planes::Get(source_row[source_x], plane);
+                        if (part == 0) {
+                            tile_row[x].real(value);
+                        } else {
+                            tile_row[x].imag(value);
+                        }
+                    }
+                }
+            }
+            TransformTile(tile, rows, false, scratch);
+            MultiplyBySpectrum(tile);
+            TransformTile(tile, transform_height, true, scratch);
+            // Full convolution element (x, y) of the extended picture is the result element
+            // (x - kernel_width + 1, y - kernel_height + 1).
+            for (size_t part = 0; part < parts; ++part) {
+                size_t left = (job + part) / Planes::COUNT * tile_width_;
+                size_t plane = (job + part) % Planes::COUNT;
+                for (size_t y = 0; y < transform_height; ++y) {
+                    if (top + y + 1 < kernel_height) {
+                        continue;
+                    }
+                    size_t result_y = top + y + 1 - kernel_height;
+                    if (result_y >= height) {
+                        break;
+                    }
+                    std::span<ElementType> result_row = result.Row(result_y);
+                    const Fft::Complex* tile_row = tile.data() + y * transform_width;
+                    for (size_t x = 0; x < transform_width; ++x) {
+                        if (left + x + 1 < kernel_width) {
+                            continue;
+                        }
+                        size_t result_x = left + x + 1 - kernel_width;
+                        if (result_x >= width) {
+                            break;
+                        }
+                        Planes::Get(result_row[result_x], plane) += part == 0 ? tile_row[x].real() : tile_row[x].imag();
+                    }
+                }
+            }
+        }
+    };
+    // Tiles are at least as high as the kernel's spill, so tile rows two apart never add to the same
+    // result rows: even rows go concurrently first, then odd ones.
+    for (size_t parity = 0; parity < 2; ++parity) {
+        Parallel::ForBlocks(
+            (tiles_y + 1 - parity) / 2,
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    run_tile_row(2 * i + parity);
+                }
+            },
+            1);
+    }
+    data = std::move(result);
+}
+
+#endif  // IMAGE_PROCESSOR_CONVOLUTION_H
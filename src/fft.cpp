@@ -0,0 +1,153 @@
+#include "fft.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace Fft {
+size_t GetGoodSize(size_t size) {
+    size_t best = 1;
+    while (best < size) {
+        best *= 2;
+    }
+    for (size_t power_5 = 1; power_5 < best; power_5 *= 5) {
+        for (size_t power_35 = power_5; power_35 < best; power_35 *= 3) {
+            size_t candidate = power_35;
+            while (candidate < size) {
+                candidate *= 2;
+            }
+            best = std::min(best, candidate);
+        }
+    }
+    return best;
+}
+
+Plan::Plan(size_t size) : size_(size) {
+    if (size == 0) {
+        throw std::invalid_argument("the transform size must be positive");
+    }
+    size_t left = size;
+    for (size_t radix : {4, 2, 3, 5}) {
+        while (left % radix == 0) {
+            factors_.push_back(radix);
+            left /= radix;
+            remainders_.push_back(left);
+        }
+    }
+    for (size_t radix = 7; left > 1; radix += 2) {
+        while (left % radix == 0) {
+            factors_.push_back(radix);
+            left /= radix;
+            remainders_.push_back(left);
+        }
+    }
+    twiddles_.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        double phase = -2 * M_PI * static_cast<double>(i) / static_cast<double>(size);
+        twiddles_[i] = {std::cos(phase), std::sin(phase)};
+    }
+}
+
+void Plan::Transform(Complex* data, bool is_inverse, Complex* scratch) const {
+    if (factors_.empty()) {
+        return;
+    }
+    std::copy(data, data + size_, scratch);
+    Work(data, scratch, 1, 0, is_inverse);
+}
+
+void Plan::Work(Complex* out, const Complex* in, size_t stride, size_t factor_index, bool is_inverse) const {
+    size_t radix = factors_[factor_index];
+    size_t length = remainders_[factor_index];
+    if (length == 1) {
+        for (size_t q = 0; q < radix; ++q) {
+            out[q] = in[q * stride];
+        }
+    } else {
+        for (size_t q = 0; q < radix; ++q) {
+            Work(out + q * length, in + q * stride, stride * radix, factor_index + 1, is_inverse);
+        }
+    }
+
+    // Twiddles of the inverse transform are the conjugated forward ones.
+    auto twiddle = [this, is_inverse](size_t index) {
+        return is_inverse ? std::conj(twiddles_[index]) : twiddles_[index];
+    };
+    if (radix == 2) {
+        for (size_t k = 0; k < length; ++k) {
+            Complex t = Multiply(out[k + length], twiddle(k * stride));
+            out[k + length] = out[k] - t;
+            out[k] += t;
+        }
+    } else if (radix == 4) {
+        for (size_t k = 0; k < length; ++k) {
+            Complex s0 = Multiply(out[k + length], twiddle(k * stride));
+            Complex s1 = Multiply(out[k + 2 * length], twiddle(2 * k * stride));
+            Complex s2 = Multiply(out[k + 3 * length], twiddle(3 * k * stride));
+            Complex s5 = out[k] - s1;
+            out[k] += s1;
+            Complex s3 = s0 + s2;
+            Complex s4 = s0 - s2;
+            out[k + 2 * length] = out[k] - s3;
+            out[k] += s3;
+            // Multiplication of s4 by -i (forward) or i (inverse).
+            Complex rotated = is_inverse ? Complex(-s4.imag(), s4.real()) : Complex(s4.imag(), -s4.real());
+            out[k + length] = s5 + rotated;
+            out[k + 3 * length] = s5 - rotated;
+        }
+    } else if (radix == 3) {
+        Complex rotation = twiddle(stride * length);
+        for (size_t k = 0; k < length; ++k) {
+            Complex s1 = Multiply(out[k + length], twiddle(k * stride));
+            Complex s2 = Multiply(out[k + 2 * length], twiddle(2 * k * stride));
+            Complex s3 = s1 + s2;
+            Complex s0 = (s1 - s2) * rotation.imag();
+            out[k + length] = out[k] - s3 * 0.5;
+            out[k] += s3;
+            out[k + 2 * length] = out[k + length] + Complex(s0.imag(), -s0.real());
+            out[k + length] += Complex(-s0.imag(), s0.real());
+        }
+    } else if (radix == 5) {
+        Complex rotation_a = twiddle(stride * length);
+        Complex rotation_b = twiddle(2 * stride * length);
+        for (size_t k = 0; k < length; ++k) {
+            Complex s0 = out[k];
+            Complex s1 = Multiply(out[k + length], twiddle(k * stride));
+            Complex s2 = Multiply(out[k + 2 * length], twiddle(2 * k * stride));
+            Complex s3 = Multiply(out[k + 3 * length], twiddle(3 * k * stride));
+            Complex s4 = Multiply(out[k + 4 * length], twiddle(4 * k * stride));
+            Complex s7 = s1 + s4;
+            Complex s10 = s1 - s4;
+            Complex s8 = s2 + s3;
+            Complex s9 = s2 - s3;
+            out[k] = s0 + s7 + s8;
+            Complex s5 = s0 + s7 * rotation_a.real() + s8 * rotation_b.real();
+            Complex s6(s10.imag() * rotation_a.imag() + s9.imag() * rotation_b.imag(),
+                       -s10.real() * rotation_a.imag() - s9.real() * rotation_b.imag());
+            out[k + length] = s5 - s6;
+            out[k + 4 * length] = s5 + s6;
+            Complex s11 = s0 + s7 * rotation_b.real() + s8 * rotation_a.real();
+            Complex s12(-s10.imag() * rotation_b.imag() + s9.imag() * rotation_a.imag(),
+                        s10.real() * rotation_b.imag() - s9.real() * rotation_a.imag());
+            out[k + 2 * length] = s11 + s12;
+            out[k + 3 * length] = s11 - s12;
+        }
+    } else {
+        std::vector<Complex> column(radix);
+        for (size_t u = 0; u < length; ++u) {
+            for (size_t q = 0; q < radix; ++q) {
+                column[q] = out[u + q * length];
+            }
+            for (size_t q = 0; q < radix; ++q) {
+                size_t k = u + q * length;
+                size_t index = 0;
+                Complex sum = column[0];
+                for (size_t j = 1; j < radix; ++j) {
+                    index = (index + stride * k) % size_;
+                    sum += Multiply(column[j], twiddle(index));
+                }
+                out[k] = sum;
+            }
+        }
+    }
+}
+}  // namespace Fft
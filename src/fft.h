@@ -0,0 +1,44 @@
+#ifndef IMAGE_PROCESSOR_FFT_H
+#define IMAGE_PROCESSOR_FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace Fft {
+using Complex = std::complex<double>;
+
+// std::complex multiplication checks for infinities and NaNs on every call, these do not.
+inline Complex Multiply(const Complex& a, const Complex& b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// The smallest size of the form 2^a * 3^b * 5^c not less than size, transforms of such sizes are the fastest.
+size_t GetGoodSize(size_t size);
+
+// Mixed-radix transform of a fixed size: radix 2, 3, 4 and 5 butterflies, a generic one for the other factors.
+// Twiddles are computed once per plan, a plan can be shared by threads.
+class Plan {
+public:
+    explicit Plan(size_t size = 1);
+
+    size_t GetSize() const {
+        return size_;
+    }
+    // In place, forward computes X_k = sum x_j exp(-2 pi i j k / n), the inverse one is not divided by n.
+    // scratch must hold GetSize() elements.
+    void Transform(Complex* data, bool is_inverse, Complex* scratch) const;
+
+protected:
+    // Transforms the elements in[0], in[stride], ... of the current stage into out, decimating in time.
+    void Work(Complex* out, const Complex* in, size_t stride, size_t factor_index, bool is_inverse) const;
+
+    size_t size_;
+    // factors_[i] is the radix of the i-th stage, remainders_[i] the size left after it.
+    std::vector<size_t> factors_;
+    std::vector<size_t> remainders_;
+    std::vector<Complex> twiddles_;
+};
+}  // namespace Fft
+
+#endif  // IMAGE_PROCESSOR_FFT_H
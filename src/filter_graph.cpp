@@ -0,0 +1,74 @@
+#include "filter_graph.h"
+
+#include <future>
+
+FilterGraph::FilterGraph() : nodes_(1) {
+}
+
+FilterGraph::FilterGraph(FilterGraph&& other) : nodes_(1) {
+    std::swap(nodes_, other.nodes_);
+}
+
+FilterGraph::~FilterGraph() {
+    for (Node& node : nodes_) {
+        delete node.manipulator;
+    }
+}
+
+size_t FilterGraph::FindChild(size_t parent, std::string_view canonical_form) const {
+    for (size_t child : nodes_.at(parent).children) {
+        if (nodes_[child].canonical_form == canonical_form) {
+            return child;
+        }
+    }
+    return ROOT;
+}
+
+size_t FilterGraph::AddNode(size_t parent, Manipulator* manipulator, std::string canonical_form) {
+    size_t index = nodes_.size();
+    nodes_.at(parent).children.push_back(index);
+    nodes_.push_back({manipulator, std::move(canonical_form), {}, {}});
+    return index;
+}
+
+void FilterGraph::AddOutput(size_t node, std::string_view output_file_name) {
+    nodes_.at(node).outputs.push_back(output_file_name);
+}
+
+const std::vector<FilterGraph::Node>& FilterGraph::GetNodes() const {
+    return nodes_;
+}
+
+std::vector<std::string_view> FilterGraph::Apply(const Bitmap& input) const {
+    std::vector<std::string_view> failed_outputs;
+    std::mutex failed_outputs_mutex;
+    Execute(ROOT, input, failed_outputs, failed_outputs_mutex);
+    return failed_outputs;
+}
+
+void FilterGraph::Execute(size_t node_index, Bitmap bitmap, std::vector<std::string_view>& failed_outputs,
+                          std::mutex& failed_outputs_mutex) const {
+    const Node& node = nodes_[node_index];
+    if (node.manipulator != nullptr) {
+        node.manipulator->ApplyToBitmap(bitmap);
+    }
+    for (std::string_view output : node.outputs) {
+        if (!bitmap.save(std::string(output).c_str())) {
+            std::lock_guard lock(failed_outputs_mutex);
+            failed_outputs.push_back(output);
+        }
+    }
+    if (node.children.empty()) {
+        return;
+    }
+    // Every branch but the last works on its own copy, the last one inherits this node's image.
+    std::vector<std::future<void>> branches;
+    for (size_t i = 0; i + 1 < node.children.size(); ++i) {
+        branches.push_back(std::async(std::launch::async, &FilterGraph::Execute, this, node.children[i], Bitmap(bitmap),
+                                      std::ref(failed_outputs), std::ref(failed_outputs_mutex)));
+    }
+    Execute(node.children.back(), std::move(bitmap), failed_outputs, failed_outputs_mutex);
+    for (std::future<void>& branch : branches) {
+        branch.get();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef IMAGE_PROCESSOR_FILTER_GRAPH_H
+#define IMAGE_PROCESSOR_FILTER_GRAPH_H
+
+#include "bitmap.h"
+#include "image_manipulators.h"
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Several filter chains applied to one decoded input, merged into a prefix tree:
+// chains sharing their first filters share the nodes computing them, every fork runs its branches concurrently,
+// and a node's image is released as soon as the last of its branches has taken it over.
+class FilterGraph {
+public:
+    static const size_t ROOT = 0;
+
+    struct Node {
+        Manipulator* manipulator = nullptr;
+        std::string canonical_form;
+        std::vector<size_t> children;
+        std::vector<std::string_view> outputs;
+    };
+
+    FilterGraph();
+    FilterGraph(const FilterGraph& other) = delete;
+    FilterGraph(FilterGraph&& other);
+    FilterGraph& operator=(const FilterGraph& other) = delete;
+    FilterGraph& operator=(FilterGraph&& other) = delete;
+    ~FilterGraph();
+
+    // Returns the child of parent computing canonical_form, or 0 (the root is never a child) if there is none.
+    size_t FindChild(size_t parent, std::string_view canonical_form) const;
+    size_t AddNode(size_t parent, Manipulator* manipulator, std::string canonical_form);
+    void AddOutput(size_t node, std::string_view output_file_name);
+    const std::vector<Node>& GetNodes() const;
+
+    // Applies every chain to input and saves every result, returns the outputs that could not be saved.
+    std::vector<std::string_view> Apply(const Bitmap& input) const;
+
+protected:
+    void Execute(size_t node, Bitmap bitmap, std::vector<std::string_view>& failed_outputs,
+                 std::mutex& failed_outputs_mutex) const;
+
+    std::vector<Node> nodes_;
+};
+
+#endif  // IMAGE_PROCESSOR_FILTER_GRAPH_H
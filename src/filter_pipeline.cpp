@@ -4,12 +4,31 @@ Bitmap FilterPipeline::Apply(const Bitmap& PicStream) {
     Bitmap temp = PicStream;
     for (const Manipulator* manipulator : pipeline_) {
         if (manipulator != nullptr) {
-            manipulator->Apply(*temp.GetData());
+            manipulator->ApplyToBitmap(temp);
         }
     }
     return temp;
 }
 
+void FilterPipeline::Apply(Matrix<Pixel>& data) const {
+    for (const Manipulator* manipulator : pipeline_) {
+        if (manipulator != nullptr) {
+            manipulator->Apply(data);
+        }
+    }
+}
+
+void FilterPipeline::ApplyStage(size_t stage, Bitmap& bitmap) const {
+    const Manipulator* manipulator = pipeline_.at(stage);
+    if (manipulator != nullptr) {
+        manipulator->ApplyToBitmap(bitmap);
+    }
+}
+
+size_t FilterPipeline::GetSize() const {
+    return pipeline_.size();
+}
+
 FilterPipeline::~FilterPipeline() {
     for (Manipulator* i : pipeline_) {
         delete i;
@@ -13,6 +13,10 @@ public:
 
     FilterPipeline() : pipeline_() {};
     Bitmap Apply(const Bitmap& PicStream);
+    void Apply(Matrix<Pixel>& data) const;
+    // Applies the filter of one stage as Apply(const Bitmap&) would, in whatever storage it accepts.
+    void ApplyStage(size_t stage, Bitmap& bitmap) const;
+    size_t GetSize() const;
     Pipeline& GetPipeline();
     FilterPipeline(const FilterPipeline& other) = delete;
     FilterPipeline& operator=(const FilterPipeline& other) = delete;
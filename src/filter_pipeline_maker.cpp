@@ -1,25 +1,91 @@
-#include "filter_pipeline_maker.h"
-
-Manipulator* FilterPipelineMaker::MakeFilter(const FilterDescriptor& fd) const {
-    FilterMakerPtr maker = GetFilterMaker(fd.GetFilterName());
-    if (!maker) {
-        return nullptr;
-    }
-
-    return maker(fd);
-}
-
-FilterPipelineMaker::FilterMakerPtr FilterPipelineMaker::GetFilterMaker(std::string_view name) const {
-    auto ix = filter_creators_.find(name);
-    if (ix == filter_creators_.end()) {
-        return nullptr;
-    }
-    return ix->second;
-}
-FilterPipeline FilterPipelineMaker::BuildPipeline(const std::vector<FilterDescriptor>& descriptions) {
-    FilterPipeline pipeline;
-    for (const FilterDescriptor& descriptor : descriptions) {
-        pipeline.GetPipeline().push_back(MakeFilter(descriptor));
-    }
-    return pipeline;
-}
+#include "filter_pipeline_maker.h"
+
+Manipulator* FilterPipelineMaker::MakeFilter(const FilterDescriptor& fd) const {
+    FilterMakerPtr maker = GetFilterMaker(fd.GetFilterName());
+    if (!maker) {
+        return nullptr;
+    }
+
+    return maker(fd);
+}
+
+Manipulator* FilterPipelineMaker::MakeFilter(const std::vector<FilterDescriptor>& descriptions,
+                                             size_t& position) const {
+    auto wrapper = wrapper_creators_.find(descriptions.at(position).GetFilterName());
+    if (wrapper == wrapper_creators_.end()) {
+        return MakeFilter(descriptions[position]);
+    }
+    size_t wrapper_position = position;
+    if (++position == descriptions.size()) {
+        throw std::invalid_argument("no filter follows " + std::string(wrapper->first));
+    }
+    Manipulator* filter = MakeFilter(descriptions, position);
+    if (filter == nullptr) {
+        throw std::invalid_argument("unknown filter follows " + std::string(wrapper->first));
+    }
+    try {
+        return wrapper->second(descriptions[wrapper_position], filter);
+    } catch (...) {
+        delete filter;
+        throw;
+    }
+}
+
+std::vector<size_t> FilterPipelineMaker::GetStageEnds(const std::vector<FilterDescriptor>& descriptions) const {
+    std::vector<size_t> ends;
+    for (size_t position = 0; position < descriptions.size(); ++position) {
+        while (position + 1 < descriptions.size() &&
+               wrapper_creators_.contains(descriptions[position].GetFilterName())) {
+            ++position;
+        }
+        ends.push_back(position + 1);
+    }
+    return ends;
+}
+
+FilterPipelineMaker::FilterMakerPtr FilterPipelineMaker::GetFilterMaker(std::string_view name) const {
+    auto ix = filter_creators_.find(name);
+    if (ix == filter_creators_.end()) {
+        return nullptr;
+    }
+    return ix->second;
+}
+
+FilterPipelineMaker::WrapperMakerPtr FilterPipelineMaker::GetWrapperMaker(std::string_view name) const {
+    auto wrapper = wrapper_creators_.find(name);
+    if (wrapper == wrapper_creators_.end()) {
+        return nullptr;
+    }
+    return wrapper->second;
+}
+
+FilterPipeline FilterPipelineMaker::BuildPipeline(const std::vector<FilterDescriptor>& descriptions) {
+    FilterPipeline pipeline;
+    for (size_t position = 0; position < descriptions.size(); ++position) {
+        pipeline.GetPipeline().push_back(MakeFilter(descriptions, position));
+    }
+    return pipeline;
+}
+
+FilterGraph FilterPipelineMaker::BuildGraph(const CommandLineParser::Branches& branches) {
+    FilterGraph graph;
+    for (const CommandLineParser::Branch& branch : branches) {
+        size_t node = FilterGraph::ROOT;
+        for (size_t position = 0; position < branch.descriptions.size(); ++position) {
+            // A wrapped filter is one node named after all of its descriptors.
+            size_t first = position;
+            std::string canonical_form = branch.descriptions[position].GetCanonicalForm();
+            while (position + 1 < branch.descriptions.size() &&
+                   wrapper_creators_.contains(branch.descriptions[position].GetFilterName())) {
+                canonical_form += " " + branch.descriptions[++position].GetCanonicalForm();
+            }
+            size_t child = graph.FindChild(node, canonical_form);
+            if (child == FilterGraph::ROOT) {
+                child = graph.AddNode(node, MakeFilter(branch.descriptions, first), std::move(canonical_form));
+            }
+            node = child;
+        }
+        graph.AddOutput(node, branch.output_file_name);
+    }
+    return graph;
+}
@@ -1,30 +1,46 @@
-#ifndef PROJECT_FILTER_PIPELINE_MAKER_H
-#define PROJECT_FILTER_PIPELINE_MAKER_H
-
-#include <cstdlib>
-#include <map>
-#include <string_view>
-
-#include "command_line_parser.h"
-#include "filter_pipeline.h"
-#include "image_manipulators.h"
-
-class FilterPipelineMaker {
-public:
-    using FilterMakerPtr = Manipulator* (*)(const FilterDescriptor&);
-    using FilterCreators = std::map<std::string_view, FilterMakerPtr>;
-
-public:
-    void AddFilterCreator(std::string_view filter_name, FilterMakerPtr filter_maker) {
-        filter_creators_.insert({filter_name, filter_maker});
-    }
-
-    Manipulator* MakeFilter(const FilterDescriptor& fd) const;
-    FilterMakerPtr GetFilterMaker(std::string_view name) const;
-    FilterPipeline BuildPipeline(const std::vector<FilterDescriptor>& descriptions);
-
-protected:
-    FilterCreators filter_creators_;
-};
-
-#endif  // PROJECT_FILTER_PIPELINE_MAKER_H
+#ifndef PROJECT_FILTER_PIPELINE_MAKER_H
+#define PROJECT_FILTER_PIPELINE_MAKER_H
+
+#include <cstdlib>
+#include <map>
+#include <string_view>
+
+#include "command_line_parser.h"
+#include "filter_graph.h"
+#include "filter_pipeline.h"
+#include "image_manipulators.h"
+
+class FilterPipelineMaker {
+public:
+    using FilterMakerPtr = Manipulator* (*)(const FilterDescriptor&);
+    using FilterCreators = std::map<std::string_view, FilterMakerPtr>;
+    // Makers of filters modifying the filter that follows them (e.g. -roi), they take ownership of it.
+    using WrapperMakerPtr = Manipulator* (*)(const FilterDescriptor&, Manipulator*);
+    using WrapperCreators = std::map<std::string_view, WrapperMakerPtr>;
+
+public:
+    void AddFilterCreator(std::string_view filter_name, FilterMakerPtr filter_maker) {
+        filter_creators_.insert({filter_name, filter_maker});
+    }
+    void AddWrapperCreator(std::string_view wrapper_name, WrapperMakerPtr wrapper_maker) {
+        wrapper_creators_.insert({wrapper_name, wrapper_maker});
+    }
+
+    Manipulator* MakeFilter(const FilterDescriptor& fd) const;
+    // Makes the filter described from descriptions[position] on, together with the wrappers preceding it,
+    // and moves position to its last descriptor. Throws std::invalid_argument if a wrapper has nothing to wrap.
+    Manipulator* MakeFilter(const std::vector<FilterDescriptor>& descriptions, size_t& position) const;
+    FilterMakerPtr GetFilterMaker(std::string_view name) const;
+    // nullptr unless name is a wrapper.
+    WrapperMakerPtr GetWrapperMaker(std::string_view name) const;
+    // For every filter of the pipeline built from descriptions, the number of descriptors up to its end.
+    std::vector<size_t> GetStageEnds(const std::vector<FilterDescriptor>& descriptions) const;
+    FilterPipeline BuildPipeline(const std::vector<FilterDescriptor>& descriptions);
+    FilterGraph BuildGraph(const CommandLineParser::Branches& branches);
+
+protected:
+    FilterCreators filter_creators_;
+    WrapperCreators wrapper_creators_;
+};
+
+#endif  // PROJECT_FILTER_PIPELINE_MAKER_H
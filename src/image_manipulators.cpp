@@ -1,15 +1,186 @@
 #include "image_manipulators.h"
 
+void Manipulator::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    throw std::logic_error("the filter cannot be applied to 8-bit data");
+}
+
+void Manipulator::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    throw std::logic_error("the filter cannot be applied to a single plane");
+}
+
+void Manipulator::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<Pixel> region(view.width, view.height);
+    for (size_t y = 0; y < view.height; ++y) {
+        std::copy(view.Row(y).begin(), view.Row(y).end(), region.Row(y).begin());
+    }
+    Apply(region);
+    if (region.GetWidth() != view.width || region.GetHeight() != view.height) {
+        throw std::logic_error("the filter changes the size, it cannot be applied to a region");
+    }
+    for (size_t y = 0; y < view.height; ++y) {
+        std::copy(region.Row(y).begin(), region.Row(y).end(), view.Row(y).begin());
+    }
+}
+
+BitmapParameters::StorageFormats Manipulator::GetAcceptedFormats() const {
+    return BitmapParameters::StorageFormat::Colours;
+}
+
+size_t Manipulator::GetHalo() const {
+    return ManipulatorParameters::UNBOUNDED_HALO;
+}
+
+size_t ConvolutionalManipulator::GetHalo() const {
+    return std::max(filter_.GetWidth(), filter_.GetHeight()) / 2;
+}
+
+std::pair<size_t, size_t> Manipulator::GetOutputSize(size_t width, size_t height) const {
+    return {width, height};
+}
+
+BitmapParameters::StorageFormat Manipulator::ChooseFormat(BitmapParameters::StorageFormats accepted,
+                                                          BitmapParameters::StorageFormat format, bool is_greyscale) {
+    if (accepted & format) {
+        return format;
+    }
+    if (is_greyscale && (accepted & BitmapParameters::StorageFormat::Greyscale)) {
+        return BitmapParameters::StorageFormat::Greyscale;
+    }
+    if (accepted & BitmapParameters::StorageFormat::Colours) {
+        return BitmapParameters::StorageFormat::Colours;
+    }
+    if (accepted & BitmapParameters::StorageFormat::Bytes) {
+        return BitmapParameters::StorageFormat::Bytes;
+    }
+    return BitmapParameters::StorageFormat::Greyscale;
+}
+
+void Manipulator::ApplyToBitmap(Bitmap& bitmap) const {
+    BitmapParameters::StorageFormat format =
+        ChooseFormat(GetAcceptedFormats(), bitmap.GetStorageFormat(), bitmap.IsGreyscale());
+    if (format == BitmapParameters::StorageFormat::Bytes) {
+        ApplyBytes(*bitmap.GetBytes());
+    } else if (format == BitmapParameters::StorageFormat::Greyscale) {
+        ApplyGreyscale(*bitmap.GetGreyscale());
+    } else {
+        Apply(*bitmap.GetData());
+    }
+}
+
+namespace {
+const BitmapParameters::StorageFormats ALL_STORAGE_FORMATS = BitmapParameters::StorageFormat::Colours |
+                                                             BitmapParameters::StorageFormat::Bytes |
+                                                             BitmapParameters::StorageFormat::Greyscale;
+const BitmapParameters::StorageFormats PLANAR_STORAGE_FORMATS =
+    BitmapParameters::StorageFormat::Colours | BitmapParameters::StorageFormat::Greyscale;
+// The binomial weights 1 4 6 4 1 of a pyramid reduction by the distance from the centre.
+const double PYRAMID_REDUCE_WEIGHTS[] = {6.0 / 16, 4.0 / 16, 1.0 / 16};
+
+ColourParameters::ColourType GetLuma(ColourParameters::ColourType red, ColourParameters::ColourType green,
+                                     ColourParameters::ColourType blue) {
+    return std::clamp(0.299 * red + 0.587 * green + 0.114 * blue, 0.0, 1.0);
+}
+
+// Convolutions run on plain ColourValues, their inner loops are then nothing but multiply-adds.
+Matrix<ColourValue> ToColourValues(const MatrixView<Pixel>& data) {
+    Matrix<ColourValue> values(data.width, data.height);
+    values.ForEachRow([&data](size_t y, std::span<ColourValue> row) {
+        std::span<const Pixel> source = data.Row(y);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = source[x].GetColourValue();
+        }
+    });
+    return values;
+}
+
+void FromColourValues(const Matrix<ColourValue>& values, const MatrixView<Pixel>& data) {
+    data.ForEachRow([&values](size_t y, std::span<Pixel> row) {
+        std::span<const ColourValue> source = values.Row(y);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = Pixel(source[x]);
+        }
+    });
+}
+
+ColourValue Saturate(const ColourValue& value) {
+    return value.Saturated();
+}
+
+ColourParameters::ColourType Saturate(ColourParameters::ColourType value) {
+    return std::clamp(value, 0.0, 1.0);
+}
+
+// The channels of 8-bit pixels are convolved as one run per row.
+void ConvolveBytes(const IntegerConvolution& convolution, Matrix<Bitmap::PrimitivePixel>& data) {
+    static_assert(sizeof(Bitmap::PrimitivePixel) == 3 * sizeof(uint8_t));
+    const size_t channels = 3;
+    Matrix<Bitmap::PrimitivePixel> result(data.GetWidth(), data.GetHeight());
+    MatrixView<const Bitmap::PrimitivePixel> source = static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data).GetView();
+    MatrixView<Bitmap::PrimitivePixel> destination = result.GetView();
+    convolution.Apply(MatrixView<const uint8_t>{reinterpret_cast<const uint8_t*>(source.data), channels * source.width,
+                                                source.height, channels * source.stride},
+                      MatrixView<uint8_t>{reinterpret_cast<uint8_t*>(destination.data), channels * destination.width,
+                                          destination.height, channels * destination.stride},
+                      channels);
+    data = std::move(result);
+}
+
+// The channels of pixels as rows of interleaved elements: blue, green and red for 8-bit pixels, red, green and
+// blue for ColourValues.
+MatrixView<const uint8_t> GetChannels(const Matrix<Bitmap::PrimitivePixel>& data) {
+    MatrixView<const Bitmap::PrimitivePixel> view = data.GetView();
+    return {reinterpret_cast<const uint8_t*>(view.data), 3 * view.width, view.height, 3 * view.stride};
+}
+
+MatrixView<const ColourParameters::ColourType> GetChannels(const Matrix<ColourValue>& data) {
+    static_assert(sizeof(ColourValue) == 3 * sizeof(ColourParameters::ColourType));
+    MatrixView<const ColourValue> view = data.GetView();
+    return {reinterpret_cast<const ColourParameters::ColourType*>(view.data), 3 * view.width, view.height,
+            3 * view.stride};
+}
+
+std::vector<Statistics::Channel> ComputeStatistics(const Matrix<Bitmap::PrimitivePixel>& data) {
+    return Statistics::Compute(GetChannels(data), 3, ColourParameters::FromByte);
+}
+
+std::vector<Statistics::Channel> ComputeStatistics(const Matrix<ColourValue>& data) {
+    return Statistics::Compute(GetChannels(data), 3, std::identity{});
+}
+
+std::vector<Statistics::Channel> ComputeStatistics(const Matrix<ColourParameters::ColourType>& data) {
+    return Statistics::Compute(data.GetView(), 1, std::identity{});
+}
+}  // namespace
+
 ToGreyscaleFilter::ToGreyscaleFilter() = default;
 
 SharpeningFilter::SharpeningFilter() {
     filter_ = Matrix<ManipulatorParameters::ManipulatorBaseType>(ManipulatorParameters::SharpeningFilterBase);
+    integer_convolution_ = IntegerConvolution(filter_);
 }
 
 void SharpeningFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void SharpeningFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    values.Convolution(filter_);
+    FromColourValues(values, view);
+}
+
+void SharpeningFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    ConvolveBytes(integer_convolution_, data);
+}
+
+void SharpeningFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
     data.Convolution(filter_);
 }
 
+BitmapParameters::StorageFormats SharpeningFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
 std::string SharpeningFilter::GetHelp() {
     return "Sharpening Filter (-sharp):\n"
            "Makes the picture sharper.\n\n"
@@ -17,12 +188,47 @@ std::string SharpeningFilter::GetHelp() {
 }
 
 void ToGreyscaleFilter::Apply(Matrix<Pixel>& data) const {
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            Pixel& temp = data.GetElement(x, y);
-            temp = Pixel(0.299 * temp.GetRed() + 0.587 * temp.GetGreen() + 0.114 * temp.GetBlue());
-        }
+    ApplyView(data.GetView());
+}
+
+void ToGreyscaleFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    view.Transform([](const Pixel& temp) {
+        return Pixel(0.299 * temp.GetRed() + 0.587 * temp.GetGreen() + 0.114 * temp.GetBlue());
+    });
+}
+
+void ToGreyscaleFilter::ApplyToBitmap(Bitmap& bitmap) const {
+    BitmapParameters::StorageFormat format = bitmap.GetStorageFormat();
+    if (format == BitmapParameters::StorageFormat::Greyscale) {
+        bitmap.GetGreyscale()->Transform([](ColourParameters::ColourType temp) { return std::clamp(temp, 0.0, 1.0); });
+        return;
+    }
+    Matrix<ColourParameters::ColourType> plane;
+    if (format == BitmapParameters::StorageFormat::Bytes) {
+        const Matrix<Bitmap::PrimitivePixel>& data = *bitmap.GetBytes();
+        plane = Matrix<ColourParameters::ColourType>(data.GetWidth(), data.GetHeight());
+        plane.ForEachRow([&data](size_t y, std::span<ColourParameters::ColourType> row) {
+            std::span<const Bitmap::PrimitivePixel> source = data.Row(y);
+            for (size_t x = 0; x < row.size(); ++x) {
+                row[x] = GetLuma(ColourParameters::FromByte(source[x].red), ColourParameters::FromByte(source[x].green),
+                                 ColourParameters::FromByte(source[x].blue));
+            }
+        });
+    } else {
+        const Matrix<Pixel>& data = *bitmap.GetData();
+        plane = Matrix<ColourParameters::ColourType>(data.GetWidth(), data.GetHeight());
+        plane.ForEachRow([&data](size_t y, std::span<ColourParameters::ColourType> row) {
+            std::span<const Pixel> source = data.Row(y);
+            for (size_t x = 0; x < row.size(); ++x) {
+                row[x] = GetLuma(source[x].GetRed(), source[x].GetGreen(), source[x].GetBlue());
+            }
+        });
     }
+    bitmap.SetGreyscale(std::move(plane));
+}
+
+size_t ToGreyscaleFilter::GetHalo() const {
+    return 0;
 }
 
 std::string ToGreyscaleFilter::GetHelp() {
@@ -38,41 +244,218 @@ EdgeDetectionFilter::EdgeDetectionFilter(double threshold, Pixel black, Pixel wh
     white_ = white;
 }
 
-void EdgeDetectionFilter::Apply(Matrix<Pixel>& data) const {
-
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            data.GetElement(x, y).ToGreyscale();
+template <typename RowReader>
+BitMask EdgeDetectionFilter::DetectEdges(size_t width, size_t height, RowReader read_row) const {
+    BitMask mask(width, height);
+    if (mask.GetWidth() == 0) {
+        return mask;
+    }
+    size_t kernel_height = filter_.GetHeight();
+    size_t kernel_width = filter_.GetWidth();
+    size_t mid_height = kernel_height / 2;
+    size_t mid_width = kernel_width / 2;
+    // Zero taps are skipped, the rest are summed in the same order as Matrix::Convolution does.
+    struct Tap {
+        size_t x;
+        size_t row;
+        ManipulatorParameters::ManipulatorBaseType weight;
+    };
+    std::vector<Tap> taps;
+    for (size_t y = 0; y < kernel_height; ++y) {
+        for (size_t x = 0; x < kernel_width; ++x) {
+            if (filter_.GetElement(x, y) != 0) {
+                taps.push_back({x, y, filter_.GetElement(x, y)});
+            }
         }
     }
-    data.Convolution(filter_);
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            Pixel& pixel_xy = data.GetElement(x, y);
-            if (pixel_xy.GetRed() >= threshold_) {
-                pixel_xy = white_;
+    // rows[i] holds the grey values of the row y - mid_height + i (clamped to the picture),
+    // padded with copies of its ends so that the taps never leave the buffer.
+    std::vector<std::vector<ColourParameters::ColourType>> rows(
+        kernel_height, std::vector<ColourParameters::ColourType>(width + 2 * mid_width));
+    auto load_row = [&](std::vector<ColourParameters::ColourType>& buffer, size_t y, size_t i) {
+        size_t source_y = std::min(y + i < mid_height ? 0 : y + i - mid_height, height - 1);
+        read_row(source_y, buffer.data() + mid_width);
+        std::fill(buffer.begin(), buffer.begin() + mid_width, buffer[mid_width]);
+        std::fill(buffer.end() - mid_width, buffer.end(), buffer[mid_width + width - 1]);
+    };
+    for (size_t i = 0; i < kernel_height; ++i) {
+        load_row(rows[i], 0, i);
+    }
+    // The local and the automatic thresholds need the responses of the whole picture: they are kept.
+    bool keeps_responses = radius_ > 0 || strongest_ > 0;
+    Matrix<ColourParameters::ColourType> responses(keeps_responses ? width : 0, keeps_responses ? height : 0);
+    for (size_t y = 0; y < height; ++y) {
+        if (y > 0) {
+            std::rotate(rows.begin(), rows.begin() + 1, rows.end());
+            load_row(rows.back(), y, kernel_height - 1);
+        }
+        BitMask::Word* mask_row = mask.GetRow(y);
+        for (size_t x = 0; x < width; ++x) {
+            ColourParameters::ColourType sum{};
+            for (const Tap& tap : taps) {
+                sum += rows[tap.row][x + tap.x] * tap.weight;
+            }
+            if (keeps_responses) {
+                responses.GetElement(x, y) = sum;
             } else {
-                pixel_xy = black_;
+                mask_row[x / BitMask::WORD_BITS] |= static_cast<BitMask::Word>(sum >= threshold_)
+                                                    << (x % BitMask::WORD_BITS);
             }
         }
     }
+    if (strongest_ > 0) {
+        // The responses lie within the sum of the weights' magnitudes, their histogram is that wide.
+        double bound = 0;
+        for (const Tap& tap : taps) {
+            bound += std::abs(tap.weight);
+        }
+        MatrixView<const ColourParameters::ColourType> kept =
+            static_cast<const Matrix<ColourParameters::ColourType>&>(responses).GetView();
+        double threshold =
+            Statistics::Compute(kept, 1, std::identity{},
+                                Statistics::Channel(-bound, bound, StatisticsParameters::RESPONSE_BINS))[0]
+                .GetPercentile(1 - strongest_);
+        // Strictly above: a flat picture, all of whose responses are the percentile, has no edges.
+        Parallel::ForBlocks(height, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                BitMask::Word* mask_row = mask.GetRow(y);
+                std::span<const ColourParameters::ColourType> row = kept.Row(y);
+                for (size_t x = 0; x < width; ++x) {
+                    mask_row[x / BitMask::WORD_BITS] |= static_cast<BitMask::Word>(row[x] > threshold)
+                                                        << (x % BitMask::WORD_BITS);
+                }
+            }
+        });
+    } else if (radius_ > 0) {
+        // The local thresholds need the responses around every pixel: they are summed.
+        Integral::SummedAreaTable<ColourParameters::ColourType> magnitudes(
+            static_cast<const Matrix<ColourParameters::ColourType>&>(responses).GetView(), 1,
+            [](ColourParameters::ColourType response) { return std::abs(response); });
+        Parallel::ForBlocks(height, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                BitMask::Word* mask_row = mask.GetRow(y);
+                std::span<const ColourParameters::ColourType> row =
+                    static_cast<const Matrix<ColourParameters::ColourType>&>(responses).Row(y);
+                for (size_t x = 0; x < width; ++x) {
+                    Integral::Rectangle window = magnitudes.GetWindow(x, y, radius_);
+                    double mean = magnitudes.GetSum(window, 0) / static_cast<double>(window.GetArea());
+                    mask_row[x / BitMask::WORD_BITS] |= static_cast<BitMask::Word>(row[x] >= threshold_ + mean)
+                                                        << (x % BitMask::WORD_BITS);
+                }
+            }
+        });
+    }
+    return mask;
+}
+
+void EdgeDetectionFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void EdgeDetectionFilter::ApplyView(const MatrixView<Pixel>& data) const {
+    BitMask mask = DetectEdges(data.width, data.height, [&data](size_t y, ColourParameters::ColourType* row) {
+        std::span<const Pixel> source = data.Row(y);
+        for (size_t x = 0; x < source.size(); ++x) {
+            row[x] = source[x].GetValue();
+        }
+    });
+    data.ForEachRow([this, &mask](size_t y, std::span<Pixel> row) {
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = mask.GetElement(x, y) ? white_ : black_;
+        }
+    });
+}
+
+void EdgeDetectionFilter::ApplyToBitmap(Bitmap& bitmap) const {
+    BitMask mask;
+    BitmapParameters::StorageFormat format = bitmap.GetStorageFormat();
+    if (format == BitmapParameters::StorageFormat::Bytes) {
+        const Matrix<Bitmap::PrimitivePixel>& data = *bitmap.GetBytes();
+        mask = DetectEdges(data.GetWidth(), data.GetHeight(), [&data](size_t y, ColourParameters::ColourType* row) {
+            std::span<const Bitmap::PrimitivePixel> source = data.Row(y);
+            for (size_t x = 0; x < source.size(); ++x) {
+                row[x] = (ColourParameters::FromByte(source[x].red) + ColourParameters::FromByte(source[x].green) +
+                          ColourParameters::FromByte(source[x].blue)) / 3;
+            }
+        });
+    } else if (format == BitmapParameters::StorageFormat::Greyscale) {
+        const Matrix<ColourParameters::ColourType>& data = *bitmap.GetGreyscale();
+        mask = DetectEdges(data.GetWidth(), data.GetHeight(), [&data](size_t y, ColourParameters::ColourType* row) {
+            std::span<const ColourParameters::ColourType> source = data.Row(y);
+            std::copy(source.begin(), source.end(), row);
+        });
+    } else if (format == BitmapParameters::StorageFormat::Mask) {
+        const BitMask& data = *bitmap.GetMask();
+        const auto palette = bitmap.GetMaskPalette();
+        mask = DetectEdges(data.GetWidth(), data.GetHeight(), [&data, &palette](size_t y, ColourParameters::ColourType* row) {
+            for (size_t x = 0; x < data.GetWidth(); ++x) {
+                row[x] = palette[data.GetElement(x, y)].GetValue();
+            }
+        });
+    } else {
+        const Matrix<Pixel>& data = *bitmap.GetData();
+        mask = DetectEdges(data.GetWidth(), data.GetHeight(), [&data](size_t y, ColourParameters::ColourType* row) {
+            std::span<const Pixel> source = data.Row(y);
+            for (size_t x = 0; x < source.size(); ++x) {
+                row[x] = source[x].GetValue();
+            }
+        });
+    }
+    bitmap.SetMask(std::move(mask), black_, white_);
 }
 
 std::string EdgeDetectionFilter::GetHelp() {
     return "Edge Detection Filter (-edge threshold):\n"
            "Converts the picture to greyscale using naive formula, then applies the detection using convolution."
            "If the pixel is brighter than threshold, it is painted white, otherwise is painted black.\n"
-           "Parameters: double threshold - [0, 1]";
+           "All of it is done in one sweep producing a two-colour mask (see --output-bpp 1).\n"
+           "Parameters: double threshold - [0, 1]\n"
+           "(\"-edge adaptive radius [offset]\" compares every response with the mean magnitude of the responses "
+           "within radius plus offset, 0.05 by default, instead of the single threshold; \"-edge auto [fraction]\" "
+           "paints white the given fraction of the pixels with the strongest responses, 0.1 by default)";
+}
+
+AdaptiveEdgeDetectionFilter::AdaptiveEdgeDetectionFilter(size_t radius, double offset, Pixel black, Pixel white)
+    : EdgeDetectionFilter(offset, black, white) {
+    if (radius > ManipulatorParameters::MAX_WINDOW_RADIUS) {
+        throw std::invalid_argument("the window radius must not exceed " +
+                                    std::to_string(ManipulatorParameters::MAX_WINDOW_RADIUS));
+    }
+    radius_ = radius;
+}
+
+size_t AdaptiveEdgeDetectionFilter::GetHalo() const {
+    return EdgeDetectionFilter::GetHalo() + radius_;
+}
+
+AutoEdgeDetectionFilter::AutoEdgeDetectionFilter(double fraction, Pixel black, Pixel white)
+    : EdgeDetectionFilter(0, black, white) {
+    if (!(fraction > 0 && fraction <= 1)) {
+        throw std::invalid_argument("the fraction of edges must lie in (0, 1]");
+    }
+    strongest_ = fraction;
+}
+
+size_t AutoEdgeDetectionFilter::GetHalo() const {
+    return ManipulatorParameters::UNBOUNDED_HALO;
 }
 
 ToGreyscaleBasicFilter::ToGreyscaleBasicFilter() = default;
 
 void ToGreyscaleBasicFilter::Apply(Matrix<Pixel>& data) const {
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            data.GetElement(x, y).ToGreyscale();
-        }
-    }
+    ApplyView(data.GetView());
+}
+
+void ToGreyscaleBasicFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    view.Transform([](Pixel temp) { return temp.ToGreyscale(); });
+}
+
+void ToGreyscaleBasicFilter::ApplyToBitmap(Bitmap& bitmap) const {
+    bitmap.Convert(BitmapParameters::StorageFormat::Greyscale);
+}
+
+size_t ToGreyscaleBasicFilter::GetHalo() const {
+    return 0;
 }
 
 std::string ToGreyscaleBasicFilter::GetHelp() {
@@ -82,12 +465,31 @@ std::string ToGreyscaleBasicFilter::GetHelp() {
 }
 
 void NegativeFilter::Apply(Matrix<Pixel>& data) const {
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            Pixel& temp = data.GetElement(x, y);
-            temp.ToNegative();
-        }
-    }
+    ApplyView(data.GetView());
+}
+
+void NegativeFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    view.Transform([](Pixel temp) { return temp.ToNegative(); });
+}
+
+void NegativeFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    data.Transform([](const Bitmap::PrimitivePixel& temp) {
+        return Bitmap::PrimitivePixel(static_cast<uint8_t>(UINT8_MAX - temp.red),
+                                      static_cast<uint8_t>(UINT8_MAX - temp.green),
+                                      static_cast<uint8_t>(UINT8_MAX - temp.blue));
+    });
+}
+
+void NegativeFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    data.Transform([](ColourParameters::ColourType temp) { return 1 - temp; });
+}
+
+BitmapParameters::StorageFormats NegativeFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+size_t NegativeFilter::GetHalo() const {
+    return 0;
 }
 
 std::string NegativeFilter::GetHelp() {
@@ -96,56 +498,130 @@ std::string NegativeFilter::GetHelp() {
            "Parameters: none";
 }
 
-void GaussianBlurFilter::HorizontalGaussianBlur(Matrix<Pixel>& data) const {
+GaussianBlurFilter::GaussianBlurFilter(double sigma, double epsilon) : sigma_(sigma) {
+    if (!(epsilon > 0)) {
+        throw std::invalid_argument("the error bound of the Gaussian blur must be positive");
+    }
+    if (sigma <= 0) {
+        weights_ = {1};
+        return;
+    }
+    // The weights from d on sum up to at most weight(d) / (1 - q) with q = exp(-d / sigma^2), since
+    // (d + j)^2 >= d^2 + 2dj. They are dropped once that, for both sides, fits in the half of epsilon each pass
+    // may lose.
+    auto weight = [sigma](size_t d) {
+        return exp(-static_cast<double>(d * d) / (2 * sigma * sigma)) / (sqrt(2 * M_PI) * sigma);
+    };
+    weights_.push_back(weight(0));
+    for (size_t d = 1;; ++d) {
+        double q = exp(-static_cast<double>(d) / (sigma * sigma));
+        if (2 * weight(d) / (1 - q) <= epsilon / 2) {
+            break;
+        }
+        weights_.push_back(weight(d));
+    }
+}
 
+template <typename ElementType>
+void GaussianBlurFilter::HorizontalGaussianBlur(Matrix<ElementType>& data) const {
     size_t width = data.GetWidth();
-    size_t height = data.GetHeight();
-    Matrix<Pixel> temp(width, height);
-    for (size_t y = 0; y < height; ++y) {
+    size_t radius = std::min(GetRadius(), width);
+    const Matrix<ElementType>& source = data;
+    Matrix<ElementType> temp(width, data.GetHeight());
+    temp.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        // The row with radius zeros on both sides, pixels d apart on both sides share their weight.
+        std::vector<ElementType> padded(width + 2 * radius);
+        std::span<const ElementType> source_row = source.Row(y);
+        std::copy(source_row.begin(), source_row.end(), padded.begin() + radius);
+        const ElementType* centre = padded.data() + radius;
         for (size_t x = 0; x < width; ++x) {
-            Pixel temp_xy(0);
-            for (size_t x_i = 0; x_i < width; ++x_i) {
-                int64_t modulo_x = pow((std::max(x_i, x) - std::min(x_i, x)), 2);
-                temp_xy += data.GetElement(x_i, y) * ((1 / (sqrt(2 * M_PI) * sigma_)) *
-                                                      exp(-static_cast<double>(modulo_x) / (2 * sigma_ * sigma_)));
+            row[x] = centre[x] * weights_[0];
+        }
+        for (size_t d = 1; d <= radius; ++d) {
+            for (size_t x = 0; x < width; ++x) {
+                row[x] += (centre[x - d] + centre[x + d]) * weights_[d];
             }
-            temp.GetElement(x, y) = temp_xy;
         }
-    }
-    data = temp;
+        for (ElementType& element : row) {
+            element = Saturate(element);
+        }
+    });
+    data = std::move(temp);
 }
 
-void GaussianBlurFilter::VerticalGaussianBlur(Matrix<Pixel>& data) const {
-
-    size_t width = data.GetWidth();
+template <typename ElementType>
+void GaussianBlurFilter::VerticalGaussianBlur(Matrix<ElementType>& data) const {
     size_t height = data.GetHeight();
-    Matrix<Pixel> temp(width, height);
-    std::cout << temp.GetHeight() << temp.GetWidth() << std::endl;
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
-            Pixel temp_xy(0);
-            for (size_t y_i = 0; y_i < height; ++y_i) {
-                int64_t modulo_y = pow((std::max(y_i, y) - std::min(y_i, y)), 2);
-                temp_xy += data.GetElement(x, y_i) * ((1 / (sqrt(2 * M_PI) * sigma_)) *
-                                                      exp(-static_cast<double>(modulo_y) / (2 * sigma_ * sigma_)));
+    size_t radius = std::min(GetRadius(), height);
+    const Matrix<ElementType>& source = data;
+    Matrix<ElementType> temp(data.GetWidth(), height);
+    temp.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        std::span<const ElementType> centre = source.Row(y);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = centre[x] * weights_[0];
+        }
+        for (size_t d = 1; d <= radius; ++d) {
+            if (y >= d) {
+                std::span<const ElementType> above = source.Row(y - d);
+                for (size_t x = 0; x < row.size(); ++x) {
+                    row[x] += above[x] * weights_[d];
+                }
+            }
+            if (y + d < height) {
+                std::span<const ElementType> below = source.Row(y + d);
+                for (size_t x = 0; x < row.size(); ++x) {
+                    row[x] += below[x] * weights_[d];
+                }
             }
-            temp.GetElement(x, y) = temp_xy;
         }
-    }
-    data = temp;
+        for (ElementType& element : row) {
+            element = Saturate(element);
+        }
+    });
+    data = std::move(temp);
 }
 
-void GaussianBlurFilter::Apply(Matrix<Pixel>& data) const {
+template <typename ElementType>
+void GaussianBlurFilter::Blur(Matrix<ElementType>& data) const {
     VerticalGaussianBlur(data);
     HorizontalGaussianBlur(data);
 }
 
-std::string GaussianBlurFilter::GetHelp() {
-    return "Gaussian Blur Filter (unspecified):\n"
-           "Implementing the Gaussian blur using 2D full-width/height kernel\n"
-           "Parameters: double sigma - [0, +inf)";
+void GaussianBlurFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void GaussianBlurFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    Blur(values);
+    FromColourValues(values, view);
 }
-GaussianBlurFilter::GaussianBlurFilter(double sigma) : sigma_(sigma) {
+
+void GaussianBlurFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Blur(data);
+}
+
+BitmapParameters::StorageFormats GaussianBlurFilter::GetAcceptedFormats() const {
+    return PLANAR_STORAGE_FORMATS;
+}
+
+size_t GaussianBlurFilter::GetHalo() const {
+    return GetRadius();
+}
+
+const std::vector<ManipulatorParameters::ManipulatorBaseType>& GaussianBlurFilter::GetWeights() const {
+    return weights_;
+}
+
+size_t GaussianBlurFilter::GetRadius() const {
+    return weights_.size() - 1;
+}
+
+std::string GaussianBlurFilter::GetHelp() {
+    return "Gaussian Blur Filter (-blur sigma precise [epsilon]):\n"
+           "The reference Gaussian blur: the exact weights over the whole picture, cut only where the error "
+           "stays below epsilon (1e-6 by default).\n"
+           "Parameters: double sigma - [0, +inf), double epsilon - (0, 1)";
 }
 
 FastGaussianBlurFilter::FastGaussianBlurFilter(double sigma) : sigma_(sigma) {
@@ -166,25 +642,674 @@ FastGaussianBlurFilter::FastGaussianBlurFilter(double sigma) : sigma_(sigma) {
 }
 
 void FastGaussianBlurFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void FastGaussianBlurFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    values.Convolution(vertical_convolution_);
+    values.Convolution(horizontal_convolution_);
+    FromColourValues(values, view);
+}
 
+void FastGaussianBlurFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
     data.Convolution(vertical_convolution_);
     data.Convolution(horizontal_convolution_);
 }
 
+BitmapParameters::StorageFormats FastGaussianBlurFilter::GetAcceptedFormats() const {
+    return PLANAR_STORAGE_FORMATS;
+}
+
+size_t FastGaussianBlurFilter::GetHalo() const {
+    return vertical_convolution_.GetHeight() / 2;
+}
+
 std::string FastGaussianBlurFilter::GetHelp() {
     return "Fast Gaussian Blur Filter (-blur):\n"
            "Implementing the Gaussian blur using 2D shortened kernel\n"
            "Parameters: double sigma - [0, +inf)\n"
-           "(p.s. not recommended for precise calculations, use Gaussian Blur Filter instead)";
+           "(p.s. not recommended for precise calculations, use \"-blur sigma precise [epsilon]\" instead: "
+           "the exact weights, cut only where the error stays below epsilon, 1e-6 by default;\n"
+           "for sigma in the tens and hundreds \"-blur sigma pyramid\" blurs a downsampled copy, as fast for any sigma)";
+}
+
+PyramidGaussianBlurFilter::PyramidGaussianBlurFilter(double sigma) : sigma_(sigma), level_(0), scale_(1) {
+    // Every reduction adds the variance 1 in the units of its level, (scale^2 - 1) / 3 in all; the linear
+    // interpolation adds (scale^2 - 1) / 6 on average over the phases. The coarse blur is left with the rest.
+    auto coarse_sigma = [sigma](size_t scale) {
+        double left = sigma * sigma - static_cast<double>(scale * scale - 1) / 2;
+        return left > 0 ? sqrt(left) / static_cast<double>(scale) : 0;
+    };
+    while (coarse_sigma(scale_ * 2) >= ManipulatorParameters::PYRAMID_MIN_COARSE_SIGMA) {
+        ++level_;
+        scale_ *= 2;
+    }
+    double sigma_left = coarse_sigma(scale_);
+    if (sigma_left <= 0) {
+        coarse_weights_ = {1};
+    } else {
+        size_t radius = ceil(ManipulatorParameters::PYRAMID_KERNEL_SIGMAS * sigma_left);
+        double sum = 0;
+        for (size_t d = 0; d <= radius; ++d) {
+            coarse_weights_.push_back(exp(-static_cast<double>(d * d) / (2 * sigma_left * sigma_left)));
+            sum += d == 0 ? coarse_weights_[d] : 2 * coarse_weights_[d];
+        }
+        for (double& weight : coarse_weights_) {
+            weight /= sum;
+        }
+    }
+    // The picture is taken as zeros beyond the borders by both filters, so every output pixel of the same phase
+    // sees the same weights. The two-dimensional weights are products of the one-dimensional ones a and g, and
+    // a x a' - g x g = (a - g) x a' + g x (a' - g) bounds the difference by max |a - g| * (|a'| + |g|).
+    std::vector<ManipulatorParameters::ManipulatorBaseType> exact = GaussianBlurFilter(sigma).GetWeights();
+    double exact_sum = exact[0];
+    for (size_t d = 1; d < exact.size(); ++d) {
+        exact_sum += 2 * exact[d];
+    }
+    double max_difference = 0;
+    size_t halo = GetHalo();
+    for (size_t phase = 0; phase < scale_; ++phase) {
+        std::vector<double> weights = GetEffectiveWeights(phase);
+        double difference = 0;
+        for (size_t i = 0; i < weights.size(); ++i) {
+            size_t d = std::max(i, halo) - std::min(i, halo);
+            difference += std::abs(weights[i] - (d < exact.size() ? exact[d] : 0));
+        }
+        for (size_t d = halo + 1; d < exact.size(); ++d) {
+            difference += 2 * exact[d];
+        }
+        max_difference = std::max(max_difference, difference);
+    }
+    error_bound_ = max_difference * (1 + exact_sum);
+}
+
+std::vector<double> PyramidGaussianBlurFilter::GetEffectiveWeights(size_t phase) const {
+    // The weights of the coarse node 0 on the full-resolution pixels -reach ... reach: every level convolves
+    // the previous one with the binomial weights spread 2^level apart.
+    int64_t scale = static_cast<int64_t>(scale_);
+    int64_t reach = 2 * (scale - 1);
+    std::vector<double> node(2 * reach + 1);
+    node[reach] = 1;
+    for (int64_t step = 1; step < scale; step *= 2) {
+        std::vector<double> next(node.size());
+        for (int64_t i = 0; i < static_cast<int64_t>(node.size()); ++i) {
+            for (int64_t t = -2; t <= 2; ++t) {
+                if (i - t * step >= 0 && i - t * step < static_cast<int64_t>(node.size())) {
+                    next[i] += PYRAMID_REDUCE_WEIGHTS[std::abs(t)] * node[i - t * step];
+                }
+            }
+        }
+        node = std::move(next);
+    }
+    int64_t halo = static_cast<int64_t>(GetHalo());
+    int64_t radius = static_cast<int64_t>(coarse_weights_.size()) - 1;
+    double fraction = static_cast<double>(phase) / static_cast<double>(scale_);
+    std::vector<double> weights(2 * halo + 1);
+    // The output pixel interpolates the blurred nodes 0 and 1, each of them sums the nodes up to radius apart.
+    for (int64_t blurred = 0; blurred <= 1; ++blurred) {
+        for (int64_t k = blurred - radius; k <= blurred + radius; ++k) {
+            double weight = (blurred == 0 ? 1 - fraction : fraction) * coarse_weights_[std::abs(k - blurred)];
+            for (int64_t i = -reach; i <= reach; ++i) {
+                weights[k * scale + i - static_cast<int64_t>(phase) + halo] += weight * node[i + reach];
+            }
+        }
+    }
+    return weights;
+}
+
+size_t PyramidGaussianBlurFilter::GetReducedSize(size_t size) {
+    return size / 2 + 2;
+}
+
+template <typename ElementType>
+void PyramidGaussianBlurFilter::ReduceRow(std::span<const ElementType> row, std::span<ElementType> reduced) {
+    for (size_t k = 0; k < reduced.size(); ++k) {
+        // The node k of the reduced row lies at 2k - 1 of row, both counting from the position -1.
+        ElementType sum{};
+        for (size_t i = std::max<size_t>(2 * k, 3) - 3; i < std::min(row.size(), 2 * k + 2); ++i) {
+            size_t d = std::max(i + 1, 2 * k) - std::min(i + 1, 2 * k);
+            sum += row[i] * PYRAMID_REDUCE_WEIGHTS[d];
+        }
+        reduced[k] = sum;
+    }
+}
+
+template <typename ElementType>
+void PyramidGaussianBlurFilter::Blur(Matrix<ElementType>& data) const {
+    size_t width = data.GetWidth();
+    size_t height = data.GetHeight();
+    if (width == 0) {
+        return;
+    }
+    // Every level holds the nodes from the position -1 on: beyond the picture they are not zero any more.
+    // The full-resolution level is given a zero on both sides.
+    std::vector<size_t> widths = {width + 2};
+    std::vector<size_t> heights = {height + 2};
+    for (size_t level = 0; level < level_; ++level) {
+        widths.push_back(GetReducedSize(widths.back()));
+        heights.push_back(GetReducedSize(heights.back()));
+    }
+    size_t coarse_width = widths.back();
+    size_t coarse_height = heights.back();
+    const Matrix<ElementType>& source = data;
+    // Going down: all the levels along the rows, then along the columns of the narrow result.
+    Matrix<ElementType> reduced(coarse_width, height + 2);
+    reduced.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        if (y == 0 || y > height) {
+            return;
+        }
+        std::vector<ElementType> current(width + 2);
+        std::span<const ElementType> source_row = source.Row(y - 1);
+        std::copy(source_row.begin(), source_row.end(), current.begin() + 1);
+        for (size_t level = 1; level <= level_; ++level) {
+            std::vector<ElementType> next(widths[level]);
+            ReduceRow<ElementType>(current, next);
+            current = std::move(next);
+        }
+        std::copy(current.begin(), current.end(), row.begin());
+    });
+    for (size_t level = 1; level <= level_; ++level) {
+        Matrix<ElementType> next(coarse_width, heights[level]);
+        next.ForEachRow([&](size_t k, std::span<ElementType> row) {
+            for (size_t i = std::max<size_t>(2 * k, 3) - 3; i < std::min(heights[level - 1], 2 * k + 2); ++i) {
+                size_t d = std::max(i + 1, 2 * k) - std::min(i + 1, 2 * k);
+                std::span<const ElementType> reduced_row = reduced.Row(i);
+                for (size_t x = 0; x < coarse_width; ++x) {
+                    row[x] += reduced_row[x] * PYRAMID_REDUCE_WEIGHTS[d];
+                }
+            }
+        });
+        reduced = std::move(next);
+    }
+    // The coarse blur, nodes beyond the reduced ones are zeros.
+    size_t radius = coarse_weights_.size() - 1;
+    Matrix<ElementType> horizontal(coarse_width, coarse_height);
+    horizontal.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        std::vector<ElementType> padded(coarse_width + 2 * radius);
+        std::span<const ElementType> reduced_row = reduced.Row(y);
+        std::copy(reduced_row.begin(), reduced_row.end(), padded.begin() + radius);
+        const ElementType* centre = padded.data() + radius;
+        for (size_t x = 0; x < coarse_width; ++x) {
+            row[x] = centre[x] * coarse_weights_[0];
+        }
+        for (size_t d = 1; d <= radius; ++d) {
+            for (size_t x = 0; x < coarse_width; ++x) {
+                row[x] += (centre[x - d] + centre[x + d]) * coarse_weights_[d];
+            }
+        }
+    });
+    Matrix<ElementType> blurred(coarse_width, coarse_height);
+    blurred.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        for (size_t i = std::max(y, radius) - radius; i < std::min(coarse_height, y + radius + 1); ++i) {
+            size_t d = std::max(i, y) - std::min(i, y);
+            std::span<const ElementType> horizontal_row = horizontal.Row(i);
+            for (size_t x = 0; x < coarse_width; ++x) {
+                row[x] += horizontal_row[x] * coarse_weights_[d];
+            }
+        }
+    });
+    // Going up: the full-resolution pixel x lies between the nodes x / scale and x / scale + 1, which are
+    // the elements 1 and 2 further in blurred.
+    std::vector<double> fraction_x(width);
+    for (size_t x = 0; x < width; ++x) {
+        fraction_x[x] = static_cast<double>(x % scale_) / static_cast<double>(scale_);
+    }
+    data.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        double fraction_y = static_cast<double>(y % scale_) / static_cast<double>(scale_);
+        std::span<const ElementType> upper_row = blurred.Row(y / scale_ + 1);
+        std::span<const ElementType> lower_row = blurred.Row(y / scale_ + 2);
+        std::vector<ElementType> interpolated(coarse_width);
+        for (size_t x = 0; x < coarse_width; ++x) {
+            interpolated[x] = upper_row[x] * (1 - fraction_y) + lower_row[x] * fraction_y;
+        }
+        for (size_t x = 0; x < width; ++x) {
+            size_t node = x / scale_ + 1;
+            row[x] = Saturate(interpolated[node] * (1 - fraction_x[x]) + interpolated[node + 1] * fraction_x[x]);
+        }
+    });
+}
+
+void PyramidGaussianBlurFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void PyramidGaussianBlurFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    Blur(values);
+    FromColourValues(values, view);
+}
+
+void PyramidGaussianBlurFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Blur(data);
+}
+
+BitmapParameters::StorageFormats PyramidGaussianBlurFilter::GetAcceptedFormats() const {
+    return PLANAR_STORAGE_FORMATS;
+}
+
+size_t PyramidGaussianBlurFilter::GetHalo() const {
+    return (coarse_weights_.size() + 2) * scale_;
+}
+
+size_t PyramidGaussianBlurFilter::GetLevel() const {
+    return level_;
+}
+
+double PyramidGaussianBlurFilter::GetErrorBound() const {
+    return error_bound_;
+}
+
+std::string PyramidGaussianBlurFilter::GetHelp() {
+    return "Pyramid Gaussian Blur Filter (-blur sigma pyramid):\n"
+           "The Gaussian blur for large sigma computed on a downsampled copy of the picture and interpolated back, "
+           "the time does not grow with sigma. The bound of the difference from \"-blur sigma precise\" is printed.\n"
+           "Parameters: double sigma - [0, +inf)";
+}
+
+ConvolutionFilter::ConvolutionFilter(const Matrix<ManipulatorParameters::ManipulatorBaseType>& kernel)
+    : analysis_(AnalyseKernel(kernel)), taps_(kernel), is_integer_(false) {
+    filter_ = kernel;
+    if (analysis_.is_integer && taps_.GetTapCount() <= ConvolutionParameters::MAX_INTEGER_TAPS) {
+        integer_convolution_ = IntegerConvolution(kernel);
+        is_integer_ = integer_convolution_.IsApplicable<uint8_t>();
+    }
+    if (analysis_.is_separable) {
+        Matrix<ManipulatorParameters::ManipulatorBaseType> column(1, analysis_.height);
+        Matrix<ManipulatorParameters::ManipulatorBaseType> row(analysis_.width, 1);
+        for (size_t y = 0; y < analysis_.height; ++y) {
+            column.GetElement(0, y) = analysis_.column[y];
+        }
+        for (size_t x = 0; x < analysis_.width; ++x) {
+            row.GetElement(x, 0) = analysis_.row[x];
+        }
+        column_taps_ = TapConvolution(column);
+        row_taps_ = TapConvolution(row);
+    } else {
+        engine_ = ConvolutionEngine(kernel);
+    }
+}
+
+ConvolutionFilter::Method ConvolutionFilter::GetMethod(size_t width, size_t height, size_t planes) const {
+    if (analysis_.is_separable) {
+        return Method::Separable;
+    }
+    // The tap list does the direct convolution's work for the non-zero taps only.
+    double taps_cost = engine_.GetDirectCost(width, height, planes) * static_cast<double>(taps_.GetTapCount()) /
+                       static_cast<double>(filter_.GetWidth() * filter_.GetHeight());
+    return engine_.GetFftCost(width, height, planes) < taps_cost ? Method::Fft : Method::Taps;
+}
+
+template <typename ElementType>
+void ConvolutionFilter::Convolve(Matrix<ElementType>& data) const {
+    Method method = GetMethod(data.GetWidth(), data.GetHeight(), ConvolutionPlanes<ElementType>::COUNT);
+    if (method == Method::Separable) {
+        column_taps_.Apply(data);
+        row_taps_.Apply(data);
+    } else if (method == Method::Fft) {
+        engine_.ApplyFft(data);
+    } else {
+        taps_.Apply(data);
+    }
+}
+
+void ConvolutionFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void ConvolutionFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    Convolve(values);
+    FromColourValues(values, view);
+}
+
+void ConvolutionFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    if (!is_integer_) {
+        Manipulator::ApplyBytes(data);
+        return;
+    }
+    ConvolveBytes(integer_convolution_, data);
+}
+
+void ConvolutionFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Convolve(data);
+}
+
+BitmapParameters::StorageFormats ConvolutionFilter::GetAcceptedFormats() const {
+    return is_integer_ ? ALL_STORAGE_FORMATS : PLANAR_STORAGE_FORMATS;
+}
+
+const KernelAnalysis& ConvolutionFilter::GetAnalysis() const {
+    return analysis_;
+}
+
+std::string ConvolutionFilter::GetHelp() {
+    return "Convolution Filter (-conv):\n"
+           "Convolves the picture with the given kernel, borders are extended by their closest pixels. "
+           "The kernel is analysed first: separable kernels are applied in two one-dimensional passes, "
+           "zero taps are skipped, symmetric taps share multiplications and large kernels go through the FFT.\n"
+           "Parameters: width height w_1 ... w_(width * height) - the kernel row by row, "
+           "or path - a text file with a kernel row on every line.";
+}
+
+MedianFilter::MedianFilter(size_t radius) : radius_(radius) {
+    if (radius > MedianParameters::MAX_RADIUS) {
+        throw std::invalid_argument("the median radius must not exceed " + std::to_string(MedianParameters::MAX_RADIUS));
+    }
+}
+
+void MedianFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void MedianFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    const size_t channels = 3;
+    Matrix<ColourValue> values = ToColourValues(view);
+    Matrix<uint8_t> bytes(channels * view.width, view.height);
+    bytes.ForEachRow([&values](size_t y, std::span<uint8_t> row) {
+        std::span<const ColourValue> values_row = values.Row(y);
+        for (size_t x = 0; x < values_row.size(); ++x) {
+            row[channels * x] = ColourParameters::ToByte(values_row[x].red);
+            row[channels * x + 1] = ColourParameters::ToByte(values_row[x].green);
+            row[channels * x + 2] = ColourParameters::ToByte(values_row[x].blue);
+        }
+    });
+    Matrix<uint8_t> medians(bytes.GetWidth(), bytes.GetHeight());
+    Median::Apply(static_cast<const Matrix<uint8_t>&>(bytes).GetView(), medians.GetView(), channels, radius_);
+    values.ForEachRow([&medians](size_t y, std::span<ColourValue> row) {
+        std::span<const uint8_t> medians_row = static_cast<const Matrix<uint8_t>&>(medians).Row(y);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = {ColourParameters::FromByte(medians_row[channels * x]),
+                      ColourParameters::FromByte(medians_row[channels * x + 1]),
+                      ColourParameters::FromByte(medians_row[channels * x + 2])};
+        }
+    });
+    FromColourValues(values, view);
+}
+
+void MedianFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    const size_t channels = 3;
+    Matrix<Bitmap::PrimitivePixel> result(data.GetWidth(), data.GetHeight());
+    MatrixView<const Bitmap::PrimitivePixel> source = static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data).GetView();
+    MatrixView<Bitmap::PrimitivePixel> destination = result.GetView();
+    Median::Apply(MatrixView<const uint8_t>{reinterpret_cast<const uint8_t*>(source.data), channels * source.width,
+                                            source.height, channels * source.stride},
+                  MatrixView<uint8_t>{reinterpret_cast<uint8_t*>(destination.data), channels * destination.width,
+                                      destination.height, channels * destination.stride},
+                  channels, radius_);
+    data = std::move(result);
+}
+
+void MedianFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Matrix<uint8_t> bytes(data.GetWidth(), data.GetHeight());
+    bytes.ForEachRow([&data](size_t y, std::span<uint8_t> row) {
+        std::span<const ColourParameters::ColourType> data_row = data.Row(y);
+        std::transform(data_row.begin(), data_row.end(), row.begin(), ColourParameters::ToByte);
+    });
+    Matrix<uint8_t> medians(bytes.GetWidth(), bytes.GetHeight());
+    Median::Apply(static_cast<const Matrix<uint8_t>&>(bytes).GetView(), medians.GetView(), 1, radius_);
+    data.ForEachRow([&medians](size_t y, std::span<ColourParameters::ColourType> row) {
+        std::span<const uint8_t> medians_row = static_cast<const Matrix<uint8_t>&>(medians).Row(y);
+        std::transform(medians_row.begin(), medians_row.end(), row.begin(), ColourParameters::FromByte);
+    });
+}
+
+BitmapParameters::StorageFormats MedianFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+size_t MedianFilter::GetHalo() const {
+    return radius_;
+}
+
+std::string MedianFilter::GetHelp() {
+    return "Median Filter (-median):\n"
+           "Replaces every channel by its median over the square of the side 2 * radius + 1, removes noise keeping "
+           "the edges. Works on 8-bit values, as fast for any radius.\n"
+           "Parameters: size_t radius - [0, " +
+           std::to_string(MedianParameters::MAX_RADIUS) + "], 1 by default";
+}
+
+BoxBlurFilter::BoxBlurFilter(size_t radius) : radius_(radius) {
+    if (radius > ManipulatorParameters::MAX_WINDOW_RADIUS) {
+        throw std::invalid_argument("the box radius must not exceed " +
+                                    std::to_string(ManipulatorParameters::MAX_WINDOW_RADIUS));
+    }
+}
+
+void BoxBlurFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void BoxBlurFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    const size_t channels = 3;
+    static_assert(sizeof(ColourValue) == channels * sizeof(ColourParameters::ColourType));
+    Matrix<ColourValue> values = ToColourValues(view);
+    Matrix<ColourValue> result(view.width, view.height);
+    MatrixView<const ColourValue> source = static_cast<const Matrix<ColourValue>&>(values).GetView();
+    MatrixView<ColourValue> destination = result.GetView();
+    Integral::BoxMean<double>(
+        MatrixView<const ColourParameters::ColourType>{reinterpret_cast<const ColourParameters::ColourType*>(source.data),
+                                                       channels * source.width, source.height, channels * source.stride},
+        MatrixView<ColourParameters::ColourType>{reinterpret_cast<ColourParameters::ColourType*>(destination.data),
+                                                 channels * destination.width, destination.height,
+                                                 channels * destination.stride},
+        channels, radius_);
+    FromColourValues(result, view);
+}
+
+void BoxBlurFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    const size_t channels = 3;
+    Matrix<Bitmap::PrimitivePixel> result(data.GetWidth(), data.GetHeight());
+    MatrixView<const Bitmap::PrimitivePixel> source = static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data).GetView();
+    MatrixView<Bitmap::PrimitivePixel> destination = result.GetView();
+    MatrixView<const uint8_t> source_bytes{reinterpret_cast<const uint8_t*>(source.data), channels * source.width,
+                                           source.height, channels * source.stride};
+    MatrixView<uint8_t> destination_bytes{reinterpret_cast<uint8_t*>(destination.data), channels * destination.width,
+                                          destination.height, channels * destination.stride};
+    // 32-bit sums halve the table unless a window with the rounding term could overflow them.
+    uint64_t side = 2 * static_cast<uint64_t>(radius_) + 1;
+    if (Integral::Fits<uint32_t>(256 * std::min(side * side, static_cast<uint64_t>(data.GetWidth()) * data.GetHeight()))) {
+        Integral::BoxMean<uint32_t>(source_bytes, destination_bytes, channels, radius_);
+    } else {
+        Integral::BoxMean<uint64_t>(source_bytes, destination_bytes, channels, radius_);
+    }
+    data = std::move(result);
+}
+
+void BoxBlurFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Matrix<ColourParameters::ColourType> result(data.GetWidth(), data.GetHeight());
+    Integral::BoxMean<double>(static_cast<const Matrix<ColourParameters::ColourType>&>(data).GetView(),
+                              result.GetView(), 1, radius_);
+    data = std::move(result);
+}
+
+BitmapParameters::StorageFormats BoxBlurFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+size_t BoxBlurFilter::GetHalo() const {
+    return radius_;
+}
+
+std::string BoxBlurFilter::GetHelp() {
+    return "Box Blur Filter (-boxblur):\n"
+           "Replaces every channel by its mean over the square of the side 2 * radius + 1, cut at the borders. "
+           "As fast for any radius.\n"
+           "Parameters: size_t radius - [0, +inf)";
+}
+
+MorphologyFilter::MorphologyFilter(MorphologyParameters::Operation operation, size_t width, size_t height)
+    : operation_(operation), horizontal_(Morphology::Window::Centred(width)), vertical_(Morphology::Window::Centred(height)) {
+    if (width == 0 || height == 0) {
+        throw std::invalid_argument("the structuring element must not be empty");
+    }
+    if (width > MorphologyParameters::MAX_SIZE || height > MorphologyParameters::MAX_SIZE) {
+        throw std::invalid_argument("the structuring element must not exceed " +
+                                    std::to_string(MorphologyParameters::MAX_SIZE) + " pixels a side");
+    }
+}
+
+void MorphologyFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void MorphologyFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    const size_t channels = 3;
+    Matrix<ColourValue> values = ToColourValues(view);
+    Matrix<ColourValue> result(view.width, view.height);
+    MatrixView<const ColourValue> source = static_cast<const Matrix<ColourValue>&>(values).GetView();
+    MatrixView<ColourValue> destination = result.GetView();
+    Morphology::Apply(
+        operation_,
+        MatrixView<const ColourParameters::ColourType>{reinterpret_cast<const ColourParameters::ColourType*>(source.data),
+                                                       channels * source.width, source.height, channels * source.stride},
+        MatrixView<ColourParameters::ColourType>{reinterpret_cast<ColourParameters::ColourType*>(destination.data),
+                                                 channels * destination.width, destination.height,
+                                                 channels * destination.stride},
+        channels, horizontal_, vertical_);
+    FromColourValues(result, view);
+}
+
+void MorphologyFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    const size_t channels = 3;
+    Matrix<Bitmap::PrimitivePixel> result(data.GetWidth(), data.GetHeight());
+    MatrixView<const Bitmap::PrimitivePixel> source = static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data).GetView();
+    MatrixView<Bitmap::PrimitivePixel> destination = result.GetView();
+    Morphology::Apply(operation_,
+                      MatrixView<const uint8_t>{reinterpret_cast<const uint8_t*>(source.data), channels * source.width,
+                                                source.height, channels * source.stride},
+                      MatrixView<uint8_t>{reinterpret_cast<uint8_t*>(destination.data), channels * destination.width,
+                                          destination.height, channels * destination.stride},
+                      channels, horizontal_, vertical_);
+    data = std::move(result);
+}
+
+void MorphologyFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Matrix<ColourParameters::ColourType> result(data.GetWidth(), data.GetHeight());
+    Morphology::Apply(operation_, static_cast<const Matrix<ColourParameters::ColourType>&>(data).GetView(),
+                      result.GetView(), 1, horizontal_, vertical_);
+    data = std::move(result);
+}
+
+void MorphologyFilter::ApplyToBitmap(Bitmap& bitmap) const {
+    if (bitmap.GetStorageFormat() != BitmapParameters::StorageFormat::Mask) {
+        Manipulator::ApplyToBitmap(bitmap);
+        return;
+    }
+    // The set bits are dilated, so with the darker colour set every operation turns into its dual.
+    using MorphologyParameters::Operation;
+    const auto& palette = bitmap.GetMaskPalette();
+    Operation operation = operation_;
+    if (palette[1].GetValue() < palette[0].GetValue()) {
+        const Operation duals[] = {Operation::Dilate, Operation::Erode, Operation::Close, Operation::Open};
+        operation = duals[static_cast<size_t>(operation_)];
+    }
+    *bitmap.GetMask() = Morphology::Apply(operation, *bitmap.GetMask(), horizontal_, vertical_);
+}
+
+BitmapParameters::StorageFormats MorphologyFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+size_t MorphologyFilter::GetHalo() const {
+    size_t halo = std::max({horizontal_.before, horizontal_.Reflected().before, vertical_.before,
+                            vertical_.Reflected().before});
+    bool twice = operation_ == MorphologyParameters::Operation::Open ||
+                 operation_ == MorphologyParameters::Operation::Close;
+    return twice ? 2 * halo : halo;
+}
+
+std::string MorphologyFilter::GetHelp() {
+    return "Morphology Filters (-erode, -dilate, -open, -close):\n"
+           "Replace every channel by its minimum (-erode) or maximum (-dilate) over a width x height rectangle; "
+           "-open erodes and then dilates, removing bright specks, -close does the opposite, filling dark holes. "
+           "As fast for any size, two-colour masks (e.g. after -edge) are processed packed.\n"
+           "Parameters: size_t width - [1, +inf), size_t height - [1, +inf), equal to width by default";
+}
+
+BilateralFilter::BilateralFilter(double sigma_spatial, double sigma_range)
+    : sigma_spatial_(sigma_spatial), sigma_range_(sigma_range) {
+    if (!(sigma_spatial > 0) || !(sigma_range > 0)) {
+        throw std::invalid_argument("the sigmas of the bilateral filter must be positive");
+    }
+}
+
+void BilateralFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void BilateralFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    Matrix<ColourParameters::ColourType> luma(view.width, view.height);
+    luma.ForEachRow([&values](size_t y, std::span<ColourParameters::ColourType> row) {
+        std::span<const ColourValue> values_row = values.Row(y);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = GetLuma(values_row[x].red, values_row[x].green, values_row[x].blue);
+        }
+    });
+    Matrix<ColourValue> result(view.width, view.height);
+    Bilateral::Apply(static_cast<const Matrix<ColourValue>&>(values).GetView(),
+                     static_cast<const Matrix<ColourParameters::ColourType>&>(luma).GetView(), result.GetView(),
+                     sigma_spatial_, sigma_range_);
+    FromColourValues(result, view);
+}
+
+void BilateralFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Matrix<ColourParameters::ColourType> result(data.GetWidth(), data.GetHeight());
+    MatrixView<const ColourParameters::ColourType> source =
+        static_cast<const Matrix<ColourParameters::ColourType>&>(data).GetView();
+    Bilateral::Apply(source, source, result.GetView(), sigma_spatial_, sigma_range_);
+    data = std::move(result);
+}
+
+BitmapParameters::StorageFormats BilateralFilter::GetAcceptedFormats() const {
+    return PLANAR_STORAGE_FORMATS;
+}
+
+size_t BilateralFilter::GetHalo() const {
+    // The grid cells are anchored to the origin of the picture filtered: a region or a strip filtered on its own
+    // would put them elsewhere and come out slightly different.
+    return ManipulatorParameters::UNBOUNDED_HALO;
+}
+
+std::string BilateralFilter::GetHelp() {
+    return "Bilateral Filter (-bilateral):\n"
+           "Smooths the picture keeping the edges: pixels are averaged with the Gaussian weights of their distance "
+           "and of the difference of their values, computed on a downsampled grid.\n"
+           "Parameters: double sigma_s - (0, +inf) in pixels, double sigma_r - (0, +inf) in values from 0 to 1";
 }
 
 CropFilter::CropFilter(size_t width, size_t height) : width_(width), height_(height) {
 }
 
+template <typename ElementType>
+void CropFilter::Crop(Matrix<ElementType>& data) const {
+    data.Crop(0, 0, std::min(data.GetWidth(), width_), std::min(data.GetHeight(), height_));
+}
+
 void CropFilter::Apply(Matrix<Pixel>& data) const {
-    if (width_ < data.GetWidth() || height_ < data.GetHeight()) {
-        data.Resize(std::min(data.GetWidth(), width_), (data.GetHeight(), height_));
-    }
+    Crop(data);
+}
+
+void CropFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    throw std::logic_error("cropping changes the size, it cannot be applied to a region");
+}
+
+void CropFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    Crop(data);
+}
+
+void CropFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Crop(data);
+}
+
+BitmapParameters::StorageFormats CropFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+std::pair<size_t, size_t> CropFilter::GetOutputSize(size_t width, size_t height) const {
+    return {std::min(width, width_), std::min(height, height_)};
 }
 
 std::string CropFilter::GetHelp() {
@@ -194,21 +1319,510 @@ std::string CropFilter::GetHelp() {
            "Parameters: width, height > 0 - positive values.\n";
 }
 
+OrientationFilter::OrientationFilter(OrientationParameters::Operation operation) : operation_(operation) {
+}
+
+template <typename ElementType>
+void OrientationFilter::Orient(Matrix<ElementType>& data) const {
+    data = Orientation::Apply(operation_, static_cast<const Matrix<ElementType>&>(data).GetView());
+}
+
+void OrientationFilter::Apply(Matrix<Pixel>& data) const {
+    Orient(data);
+}
+
+void OrientationFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    if (Orientation::IsTransposing(operation_)) {
+        throw std::logic_error("transposing changes the size, it cannot be applied to a region");
+    }
+    Matrix<Pixel> result = Orientation::Apply(operation_, MatrixView<const Pixel>{view.data, view.width, view.height,
+                                                                                     view.stride});
+    view.ForEachRow([&result](size_t y, std::span<Pixel> row) {
+        std::span<const Pixel> result_row = static_cast<const Matrix<Pixel>&>(result).Row(y);
+        std::copy(result_row.begin(), result_row.end(), row.begin());
+    });
+}
+
+void OrientationFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    Orient(data);
+}
+
+void OrientationFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Orient(data);
+}
+
+BitmapParameters::StorageFormats OrientationFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+std::pair<size_t, size_t> OrientationFilter::GetOutputSize(size_t width, size_t height) const {
+    if (Orientation::IsTransposing(operation_)) {
+        return {height, width};
+    }
+    return {width, height};
+}
+
+std::string OrientationFilter::GetHelp() {
+    return "Orientation Filters (-rotate, -flip, -transpose):\n"
+           "-rotate turns the picture clockwise by 90, 180 or 270 degrees, -flip mirrors it left to right (h) "
+           "or upside down (v), -transpose mirrors it in the diagonal from the upper left corner.\n"
+           "Parameters: -rotate angle - 90, 180 or 270; -flip direction - h (default) or v; -transpose - none";
+}
+
+ResizeFilter::ResizeFilter(size_t width, size_t height, ResampleParameters::Kernel kernel)
+    : width_(width), height_(height), kernel_(kernel) {
+    if (width == 0 || height == 0) {
+        throw std::invalid_argument("the size of the resized picture must be positive");
+    }
+    if (width > ResampleParameters::MAX_SIZE || height > ResampleParameters::MAX_SIZE) {
+        throw std::invalid_argument("the resized picture must not exceed " +
+                                    std::to_string(ResampleParameters::MAX_SIZE) + " pixels a side");
+    }
+}
+
+template <typename Channel>
+void ResizeFilter::Resize(MatrixView<const Channel> source, MatrixView<Channel> destination, size_t channels) const {
+    size_t factor_x = Resample::GetBoxFactor(source.width / channels, width_);
+    size_t factor_y = Resample::GetBoxFactor(source.height, height_);
+    Matrix<Channel> reduced;
+    if (factor_x > 1 || factor_y > 1) {
+        reduced = Resample::BoxReduce(source, channels, factor_x, factor_y);
+        source = static_cast<const Matrix<Channel>&>(reduced).GetView();
+    }
+    Resample::Resize(source, destination, channels, kernel_);
+}
+
+void ResizeFilter::Apply(Matrix<Pixel>& data) const {
+    static_assert(sizeof(ColourValue) == 3 * sizeof(ColourParameters::ColourType));
+    const size_t channels = 3;
+    if (data.GetWidth() == 0) {
+        return;
+    }
+    Matrix<ColourValue> values = ToColourValues(data.GetView());
+    Matrix<ColourValue> resized(width_, height_);
+    MatrixView<const ColourValue> source = static_cast<const Matrix<ColourValue>&>(values).GetView();
+    MatrixView<ColourValue> destination = resized.GetView();
+    Resize(MatrixView<const ColourParameters::ColourType>{reinterpret_cast<const ColourParameters::ColourType*>(source.data),
+                                                          channels * source.width, source.height, channels * source.stride},
+           MatrixView<ColourParameters::ColourType>{reinterpret_cast<ColourParameters::ColourType*>(destination.data),
+                                                    channels * destination.width, destination.height,
+                                                    channels * destination.stride},
+           channels);
+    Matrix<Pixel> result(width_, height_);
+    FromColourValues(resized, result.GetView());
+    data = std::move(result);
+}
+
+void ResizeFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    throw std::logic_error("resizing changes the size, it cannot be applied to a region");
+}
+
+void ResizeFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    const size_t channels = 3;
+    if (data.GetWidth() == 0) {
+        return;
+    }
+    Matrix<Bitmap::PrimitivePixel> result(width_, height_);
+    MatrixView<const Bitmap::PrimitivePixel> source = static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data).GetView();
+    MatrixView<Bitmap::PrimitivePixel> destination = result.GetView();
+    Resize(MatrixView<const uint8_t>{reinterpret_cast<const uint8_t*>(source.data), channels * source.width,
+                                     source.height, channels * source.stride},
+           MatrixView<uint8_t>{reinterpret_cast<uint8_t*>(destination.data), channels * destination.width,
+                               destination.height, channels * destination.stride},
+           channels);
+    data = std::move(result);
+}
+
+void ResizeFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    if (data.GetWidth() == 0) {
+        return;
+    }
+    Matrix<ColourParameters::ColourType> result(width_, height_);
+    Resize(static_cast<const Matrix<ColourParameters::ColourType>&>(data).GetView(), result.GetView(), 1);
+    data = std::move(result);
+}
+
+BitmapParameters::StorageFormats ResizeFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+std::pair<size_t, size_t> ResizeFilter::GetOutputSize(size_t width, size_t height) const {
+    return {width_, height_};
+}
+
+std::pair<size_t, size_t> ResizeFilter::GetMinLoadSize() const {
+    return {ResampleParameters::REDUCING_GAP * width_, ResampleParameters::REDUCING_GAP * height_};
+}
+
+std::string ResizeFilter::GetHelp() {
+    return "Resize Filter (-resize):\n"
+           "Resizes the picture to width x height with the chosen kernel, large reductions are box-averaged "
+           "by whole factors first.\n"
+           "Parameters: width, height > 0, kernel - box, bilinear, bicubic (default) or lanczos";
+}
+
 CurvesFilter::CurvesFilter(std::vector<ColourParameters::ColourType> x, std::vector<ColourParameters::ColourType> y)
     : lagrange_poly_(x, y){};
 
 void CurvesFilter::Apply(Matrix<Pixel>& data) const {
-    for (size_t y = 0; y < data.GetHeight(); ++y) {
-        for (size_t x = 0; x < data.GetWidth(); ++x) {
-            Pixel& elem_xy = data.GetElement(x, y);
-            elem_xy = lagrange_poly_(elem_xy);
+    ApplyView(data.GetView());
+}
+
+void CurvesFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    // Channels of a row are evaluated as one span.
+    view.ForEachRow([this](size_t, std::span<Pixel> row) {
+        std::vector<ColourParameters::ColourType> channels(3 * row.size());
+        for (size_t x = 0; x < row.size(); ++x) {
+            channels[3 * x] = row[x].GetRed();
+            channels[3 * x + 1] = row[x].GetGreen();
+            channels[3 * x + 2] = row[x].GetBlue();
         }
-    }
+        lagrange_poly_.Evaluate(channels, channels);
+        for (size_t x = 0; x < row.size(); ++x) {
+            row[x] = Pixel(channels[3 * x], channels[3 * x + 1], channels[3 * x + 2]);
+        }
+    });
+}
+
+void CurvesFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    data.ForEachRow([this](size_t, std::span<ColourParameters::ColourType> row) { lagrange_poly_.Evaluate(row, row); });
+}
+
+BitmapParameters::StorageFormats CurvesFilter::GetAcceptedFormats() const {
+    return PLANAR_STORAGE_FORMATS;
+}
+
+size_t CurvesFilter::GetHalo() const {
+    return 0;
 }
 
 std::string CurvesFilter::GetHelp() {
     return "Curves Filter (-curves):\n"
-           "Makes the \"Curves\" transformation from Photoshop using Lagrangian polynomial."
+           "Makes the \"Curves\" transformation from Photoshop using Lagrangian polynomial "
+           "(evaluated in the barycentric form, O(n) per channel value).\n"
            "Parameters: 2n points of type (x_i, y_i) - [0, 1].\n"
            "P.S. Throws exception if identical x-coordinates are found or the number of arguments is odd.";
-}
\ No newline at end of file
+}
+StatisticsFilter::StatisticsFilter(std::string path) : path_(std::move(path)) {
+}
+
+void StatisticsFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void StatisticsFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Write(view.width, view.height, {"red", "green", "blue"}, ComputeStatistics(ToColourValues(view)));
+}
+
+void StatisticsFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    std::vector<Statistics::Channel> channels = ComputeStatistics(static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data));
+    std::reverse(channels.begin(), channels.end());
+    Write(data.GetWidth(), data.GetHeight(), {"red", "green", "blue"}, channels);
+}
+
+void StatisticsFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    Write(data.GetWidth(), data.GetHeight(), {"grey"},
+          ComputeStatistics(static_cast<const Matrix<ColourParameters::ColourType>&>(data)));
+}
+
+void StatisticsFilter::Write(size_t width, size_t height, const std::vector<std::string>& names,
+                             const std::vector<Statistics::Channel>& channels) const {
+    std::ofstream file(path_);
+    file << Statistics::ToJson(width, height, names, channels);
+    if (!file) {
+        throw std::runtime_error("statistics could not be written to " + path_);
+    }
+}
+
+BitmapParameters::StorageFormats StatisticsFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+std::string StatisticsFilter::GetHelp() {
+    return "Statistics Filter (-stats):\n"
+           "Writes the count, minimum, maximum, mean, variance, percentiles and 256-bin histogram of every channel "
+           "([0, 1] values) to a JSON file and passes the picture on unchanged, all in one pass over it.\n"
+           "Parameters: string path - the JSON file";
+}
+
+AutoLevelsFilter::AutoLevelsFilter(double low, double high) : low_(low), high_(high) {
+    if (!(0 <= low && low < high && high <= 1)) {
+        throw std::invalid_argument("the auto levels need 0 <= low < high <= 1");
+    }
+}
+
+std::vector<std::pair<double, double>> AutoLevelsFilter::GetLevels(
+    const std::vector<Statistics::Channel>& channels) const {
+    std::vector<std::pair<double, double>> levels;
+    for (const Statistics::Channel& channel : channels) {
+        double black = channel.GetPercentile(low_);
+        double white = channel.GetPercentile(high_);
+        if (white - black < ColourParameters::EPS) {
+            levels.emplace_back(0, 1);
+        } else {
+            levels.emplace_back(black, 1 / (white - black));
+        }
+    }
+    return levels;
+}
+
+void AutoLevelsFilter::Apply(Matrix<Pixel>& data) const {
+    ApplyView(data.GetView());
+}
+
+void AutoLevelsFilter::ApplyView(const MatrixView<Pixel>& view) const {
+    Matrix<ColourValue> values = ToColourValues(view);
+    std::vector<std::pair<double, double>> levels = GetLevels(ComputeStatistics(values));
+    values.ForEachRow([&levels](size_t, std::span<ColourValue> row) {
+        for (ColourValue& value : row) {
+            value = Saturate(ColourValue{(value.red - levels[0].first) * levels[0].second,
+                                         (value.green - levels[1].first) * levels[1].second,
+                                         (value.blue - levels[2].first) * levels[2].second});
+        }
+    });
+    FromColourValues(values, view);
+}
+
+void AutoLevelsFilter::ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const {
+    // Channels in the order of the bytes: blue, green, red.
+    std::vector<std::pair<double, double>> levels =
+        GetLevels(ComputeStatistics(static_cast<const Matrix<Bitmap::PrimitivePixel>&>(data)));
+    std::array<std::array<uint8_t, 256>, 3> tables{};
+    for (size_t c = 0; c < tables.size(); ++c) {
+        for (size_t i = 0; i < tables[c].size(); ++i) {
+            tables[c][i] = ColourParameters::ToByte(
+                (ColourParameters::FromByte(static_cast<uint8_t>(i)) - levels[c].first) * levels[c].second);
+        }
+    }
+    data.ForEachRow([&tables](size_t, std::span<Bitmap::PrimitivePixel> row) {
+        for (Bitmap::PrimitivePixel& pixel : row) {
+            pixel.blue = tables[0][pixel.blue];
+            pixel.green = tables[1][pixel.green];
+            pixel.red = tables[2][pixel.red];
+        }
+    });
+}
+
+void AutoLevelsFilter::ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const {
+    std::pair<double, double> level =
+        GetLevels(ComputeStatistics(static_cast<const Matrix<ColourParameters::ColourType>&>(data)))[0];
+    data.ForEachRow([&level](size_t, std::span<ColourParameters::ColourType> row) {
+        for (ColourParameters::ColourType& value : row) {
+            value = Saturate((value - level.first) * level.second);
+        }
+    });
+}
+
+BitmapParameters::StorageFormats AutoLevelsFilter::GetAcceptedFormats() const {
+    return ALL_STORAGE_FORMATS;
+}
+
+std::string AutoLevelsFilter::GetHelp() {
+    return "Auto Levels Filter (-autolevels):\n"
+           "Stretches every channel linearly so that its low percentile becomes black and its high percentile "
+           "white, clipping the values beyond. The percentiles come from one pass over the picture.\n"
+           "Parameters: double low, double high - 0 <= low < high <= 1, 0.005 and 0.995 by default";
+}
+
+RegionFilter::RegionFilter(Manipulator* filter, std::vector<Region> regions)
+    : filter_(filter), regions_(std::move(regions)), is_masked_(false) {
+}
+
+RegionFilter::RegionFilter(Manipulator* filter, BitMask mask)
+    : filter_(filter), mask_(std::move(mask)), is_masked_(true) {
+}
+
+RegionFilter::~RegionFilter() {
+    delete filter_;
+}
+
+size_t RegionFilter::GetHalo() const {
+    return filter_->GetHalo();
+}
+
+std::vector<RegionFilter::Region> RegionFilter::GetMaskRegions() const {
+    // A tile is a word of the mask wide, so its column is the word's index.
+    const size_t tile_size = BitMask::WORD_BITS;
+    size_t columns = mask_.GetWordsPerRow();
+    size_t rows = (mask_.GetHeight() + tile_size - 1) / tile_size;
+    struct Box {
+        size_t left;
+        size_t top;
+        size_t right;
+        size_t bottom;  // 0 for tiles without set pixels
+    };
+    std::vector<Box> boxes(columns * rows, {SIZE_MAX, SIZE_MAX, 0, 0});
+    for (size_t y = 0; y < mask_.GetHeight(); ++y) {
+        const BitMask::Word* row = mask_.GetRow(y);
+        for (size_t word = 0; word < columns; ++word) {
+            if (row[word] == 0) {
+                continue;
+            }
+            Box& box = boxes[y / tile_size * columns + word];
+            box.left = std::min(box.left, word * BitMask::WORD_BITS + std::countr_zero(row[word]));
+            box.right = std::max(box.right, word * BitMask::WORD_BITS + std::bit_width(row[word]));
+            box.top = std::min(box.top, y);
+            box.bottom = y + 1;
+        }
+    }
+    auto get_area = [](const Box& box) { return (box.right - box.left) * (box.bottom - box.top); };
+    std::vector<Region> regions;
+    std::vector<bool> is_visited(boxes.size(), false);
+    for (size_t start = 0; start < boxes.size(); ++start) {
+        if (boxes[start].bottom == 0 || is_visited[start]) {
+            continue;
+        }
+        // Tiles touching each other, diagonally too, make a group.
+        std::vector<size_t> group = {start};
+        is_visited[start] = true;
+        for (size_t i = 0; i < group.size(); ++i) {
+            size_t column = group[i] % columns;
+            size_t row = group[i] / columns;
+            for (size_t y = (row == 0 ? 0 : row - 1); y <= std::min(row + 1, rows - 1); ++y) {
+                for (size_t x = (column == 0 ? 0 : column - 1); x <= std::min(column + 1, columns - 1); ++x) {
+                    size_t tile = y * columns + x;
+                    if (boxes[tile].bottom != 0 && !is_visited[tile]) {
+                        is_visited[tile] = true;
+                        group.push_back(tile);
+                    }
+                }
+            }
+        }
+        Box whole = boxes[start];
+        size_t area = 0;
+        for (size_t tile : group) {
+            whole = {std::min(whole.left, boxes[tile].left), std::min(whole.top, boxes[tile].top),
+                     std::max(whole.right, boxes[tile].right), std::max(whole.bottom, boxes[tile].bottom)};
+            area += get_area(boxes[tile]);
+        }
+        if (get_area(whole) <= ManipulatorParameters::MASK_BOX_SPARSENESS * area) {
+            regions.push_back({whole.left, whole.top, whole.right - whole.left, whole.bottom - whole.top});
+            continue;
+        }
+        for (size_t tile : group) {
+            const Box& box = boxes[tile];
+            regions.push_back({box.left, box.top, box.right - box.left, box.bottom - box.top});
+        }
+    }
+    return regions;
+}
+
+void RegionFilter::ApplyInPlace(Matrix<Pixel>& data, const Region& region, size_t halo) const {
+    size_t left = region.x - std::min(region.x, halo);
+    size_t top = region.y - std::min(region.y, halo);
+    size_t right = std::min(region.x + region.width + halo, data.GetWidth());
+    size_t bottom = std::min(region.y + region.height + halo, data.GetHeight());
+    // Calls function on the pixels of the grown region that must stay as they are, always in the same order.
+    auto for_each_kept = [&](auto function) {
+        for (size_t y = top; y < bottom; ++y) {
+            std::span<Pixel> row = data.Row(y);
+            if (y < region.y || y >= region.y + region.height) {
+                std::for_each(row.begin() + left, row.begin() + right, function);
+                continue;
+            }
+            std::for_each(row.begin() + left, row.begin() + region.x, function);
+            if (is_masked_) {
+                for (size_t x = region.x; x < region.x + region.width; ++x) {
+                    if (!mask_.GetElement(x, y)) {
+                        function(row[x]);
+                    }
+                }
+            }
+            std::for_each(row.begin() + region.x + region.width, row.begin() + right, function);
+        }
+    };
+    std::vector<Pixel> kept;
+    for_each_kept([&kept](const Pixel& pixel) { kept.push_back(pixel); });
+    filter_->ApplyView(data.GetView(left, top, right - left, bottom - top));
+    auto source = kept.begin();
+    for_each_kept([&source](Pixel& pixel) { pixel = *source++; });
+}
+
+Matrix<Pixel> RegionFilter::ApplyGrown(const Matrix<Pixel>& data, const Region& region, size_t& offset_x,
+                                       size_t& offset_y) const {
+    size_t halo = std::min(filter_->GetHalo(), std::max(data.GetWidth(), data.GetHeight()));
+    offset_x = std::min(region.x, halo);
+    offset_y = std::min(region.y, halo);
+    size_t grown_width = std::min(region.x + region.width + halo, data.GetWidth()) - (region.x - offset_x);
+    size_t grown_height = std::min(region.y + region.height + halo, data.GetHeight()) - (region.y - offset_y);
+    Matrix<Pixel> grown(grown_width, grown_height);
+    for (size_t y = 0; y < grown_height; ++y) {
+        std::span<const Pixel> row = data.Row(region.y - offset_y + y).subspan(region.x - offset_x, grown_width);
+        std::copy(row.begin(), row.end(), grown.Row(y).begin());
+    }
+    filter_->Apply(grown);
+    if (grown.GetWidth() != grown_width || grown.GetHeight() != grown_height) {
+        throw std::logic_error("the filter changes the size, it cannot be applied to a region");
+    }
+    return grown;
+}
+
+void RegionFilter::Apply(Matrix<Pixel>& data) const {
+    std::vector<Region> regions;
+    if (is_masked_) {
+        if (mask_.GetWidth() != data.GetWidth() || mask_.GetHeight() != data.GetHeight()) {
+            throw std::invalid_argument("the region mask does not match the size of the picture");
+        }
+        regions = GetMaskRegions();
+    } else {
+        for (const Region& region : regions_) {
+            if (region.x < data.GetWidth() && region.y < data.GetHeight()) {
+                regions.push_back({region.x, region.y, std::min(region.width, data.GetWidth() - region.x),
+                                   std::min(region.height, data.GetHeight() - region.y)});
+            }
+        }
+    }
+    size_t halo = std::min(filter_->GetHalo(), std::max(data.GetWidth(), data.GetHeight()));
+    auto is_within_reach = [halo](const Region& a, const Region& b) {
+        return a.x < b.x + b.width + halo && b.x < a.x + a.width + halo && a.y < b.y + b.height + halo &&
+               b.y < a.y + a.height + halo;
+    };
+    // Regions with no other region within the filter's reach are filtered in place. The others are computed on
+    // copies of the grown regions, all of them before any result is written back, so every region sees the
+    // unfiltered picture. Filters of unbounded reach always work on copies.
+    std::vector<bool> is_alone(regions.size(), filter_->GetHalo() != ManipulatorParameters::UNBOUNDED_HALO);
+    for (size_t i = 0; i < regions.size(); ++i) {
+        for (size_t j = i + 1; j < regions.size(); ++j) {
+            if (is_within_reach(regions[i], regions[j])) {
+                is_alone[i] = false;
+                is_alone[j] = false;
+            }
+        }
+    }
+    struct Result {
+        Matrix<Pixel> pixels;
+        size_t offset_x;
+        size_t offset_y;
+    };
+    std::vector<Result> results(regions.size());
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (is_alone[i]) {
+            ApplyInPlace(data, regions[i], halo);
+        } else {
+            results[i].pixels = ApplyGrown(data, regions[i], results[i].offset_x, results[i].offset_y);
+        }
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (is_alone[i]) {
+            continue;
+        }
+        const Region& region = regions[i];
+        data.GetView(region.x, region.y, region.width, region.height).ForEachRow([&](size_t y, std::span<Pixel> row) {
+            std::span<const Pixel> source =
+                results[i].pixels.Row(results[i].offset_y + y).subspan(results[i].offset_x, region.width);
+            for (size_t x = 0; x < row.size(); ++x) {
+                if (!is_masked_ || mask_.GetElement(region.x + x, region.y + y)) {
+                    row[x] = source[x];
+                }
+            }
+        });
+    }
+}
+
+std::string RegionFilter::GetHelp() {
+    return "Region Of Interest (-roi x y width height ..., -roi-mask path):\n"
+           "Applies the filter following it only inside the given rectangles (-roi, any number of them) "
+           "or the white pixels of a mask picture of the same size (-roi-mask), the rest is left untouched.\n"
+           "Only the regions and the pixels within the filter's reach around them are processed.\n"
+           "Parameters: x, y, width, height - non-negative integers / path - mask BMP file.";
+}
@@ -1,15 +1,33 @@
 #ifndef IMAGE_PROCESSOR_IMAGE_MANIPULATORS_H
 #define IMAGE_PROCESSOR_IMAGE_MANIPULATORS_H
 
+#include "bilateral.h"
+#include "bit_mask.h"
 #include "bitmap.h"
+#include "convolution.h"
+#include "integral.h"
 #include "lagrange_polynomial.h"
 #include "matrix.h"
+#include "median.h"
+#include "morphology.h"
+#include "orientation.h"
 #include "pixel.h"
 #include "poly.h"
+#include "resample.h"
+#include "statistics.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace ManipulatorParameters {
 using ManipulatorBaseType = double;
@@ -18,11 +36,54 @@ const std::vector<std::vector<ManipulatorBaseType> > SharpeningFilterBase =
 
 const std::vector<std::vector<ManipulatorBaseType> > EdgeDetectionFilterBase =
     std::vector<std::vector<ManipulatorBaseType> >({{0, -1, 0}, {-1, 4, -1}, {0, -1, 0}});
+
+// Error bound of the precise Gaussian blur, far below 8-bit quantisation.
+const double GAUSSIAN_EPSILON = 1e-6;
+
+// The pyramid blur goes down while the blur left for the coarse level stays this wide (in coarse pixels),
+// and cuts its coarse kernel this many sigmas away.
+const double PYRAMID_MIN_COARSE_SIGMA = 12;
+const double PYRAMID_KERNEL_SIGMAS = 5;
+
+// Largest radius of the windows of -boxblur and -edge adaptive: wider windows cover any picture anyway, and
+// their areas would overflow.
+const size_t MAX_WINDOW_RADIUS = static_cast<size_t>(1) << 15;
+
+// Halo of filters whose every output pixel may depend on the whole picture.
+const size_t UNBOUNDED_HALO = SIZE_MAX;
+
+// The set pixels of a -roi-mask are filtered in boxes around connected groups of 64 x 64 tiles, unless such
+// a box is this many times larger than the boxes of its tiles, then every tile is filtered in its own box.
+const size_t MASK_BOX_SPARSENESS = 4;
 }  // namespace ManipulatorParameters
 
 class Manipulator {
 public:
     virtual void Apply(Matrix<Pixel>& data) const = 0;
+    // Runs the filter in place on a region of a bigger picture, the region's edges act as the picture's edges.
+    // The default copies the region out and back, filters override it to work on the view directly.
+    // Throws std::logic_error for filters changing the size.
+    virtual void ApplyView(const MatrixView<Pixel>& view) const;
+    // 8-bit path, called only for filters having Bytes among their accepted formats.
+    virtual void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const;
+    // Single-plane path, called only for filters having Greyscale among their accepted formats.
+    virtual void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const;
+    // Storage formats the filter can work on directly without changing the result.
+    virtual BitmapParameters::StorageFormats GetAcceptedFormats() const;
+    // How far (in pixels) from an output pixel its inputs may lie: 0 for pointwise filters, the kernel radius
+    // for convolutions, UNBOUNDED_HALO (the default) if unknown.
+    virtual size_t GetHalo() const;
+    // Size of the result of a width x height picture, the same size by default.
+    virtual std::pair<size_t, size_t> GetOutputSize(size_t width, size_t height) const;
+    // The storage ApplyToBitmap runs a filter accepting the formats on, for a bitmap kept in format
+    // (is_greyscale if it is a single plane or a grey mask).
+    static BitmapParameters::StorageFormat ChooseFormat(BitmapParameters::StorageFormats accepted,
+                                                        BitmapParameters::StorageFormat format, bool is_greyscale);
+    // Applies the filter to the storage the bitmap already has if it is accepted, converting the bitmap to
+    // the filter's preferred format (Colours, then Bytes, then Greyscale) otherwise.
+    // Greyscale and grey masks are preferred to be taken as a single plane. Filters changing the channel count
+    // override it.
+    virtual void ApplyToBitmap(Bitmap& bitmap) const;
     Manipulator() = default;
     Manipulator(const Manipulator& other) = delete;
     Manipulator& operator=(const Manipulator& other) = delete;
@@ -30,6 +91,9 @@ public:
 };
 
 class ConvolutionalManipulator : public Manipulator {
+public:
+    size_t GetHalo() const override;
+
 protected:
     Matrix<ManipulatorParameters::ManipulatorBaseType> filter_;
 };
@@ -40,6 +104,9 @@ class ToGreyscaleFilter : public CustomManipulator {
 public:
     ToGreyscaleFilter();
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyToBitmap(Bitmap& bitmap) const override;
+    size_t GetHalo() const override;
     static std::string GetHelp();
 };
 
@@ -47,6 +114,9 @@ class ToGreyscaleBasicFilter : public CustomManipulator {
 public:
     ToGreyscaleBasicFilter();
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyToBitmap(Bitmap& bitmap) const override;
+    size_t GetHalo() const override;
     static std::string GetHelp();
 };
 
@@ -54,44 +124,106 @@ class SharpeningFilter : public ConvolutionalManipulator {
 public:
     SharpeningFilter();
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    // Integer weights: 8-bit data is convolved in fixed point, giving the same bytes as the double path.
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
     static std::string GetHelp();
+
+protected:
+    IntegerConvolution integer_convolution_;
 };
 
 class EdgeDetectionFilter : public ConvolutionalManipulator {
 public:
     explicit EdgeDetectionFilter(double threshold, Pixel black = {0, 0, 0}, Pixel white = {1, 1, 1});
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    // Leaves the bitmap with a Mask storage of black and white.
+    void ApplyToBitmap(Bitmap& bitmap) const override;
     static std::string GetHelp();
 
 protected:
+    // Greyscale conversion, convolution and threshold fused into one sweep over a rolling window of rows,
+    // read_row(y, row) writes the grey values of the row y to row.
+    template <typename RowReader>
+    BitMask DetectEdges(size_t width, size_t height, RowReader read_row) const;
+
     double threshold_;
     Pixel black_;
     Pixel white_;
+    // Radius of the window whose mean response magnitude is added to threshold_, 0 for the global threshold.
+    size_t radius_ = 0;
+    // Fraction of the strongest responses painted white instead of the ones above threshold_, 0 for the latter.
+    double strongest_ = 0;
+};
+
+// The edge detection thresholding every pixel against the mean magnitude of the responses around it plus an
+// offset, so edges stand out in flat regions and texture does not flood busy ones. The means come from a
+// summed-area table, the radius does not change the cost.
+class AdaptiveEdgeDetectionFilter : public EdgeDetectionFilter {
+public:
+    AdaptiveEdgeDetectionFilter(size_t radius, double offset, Pixel black = {0, 0, 0}, Pixel white = {1, 1, 1});
+    size_t GetHalo() const override;
+};
+
+// The edge detection choosing its threshold from the histogram of the responses: the given fraction of the
+// pixels with the strongest responses is painted white, whatever the contrast of the picture.
+class AutoEdgeDetectionFilter : public EdgeDetectionFilter {
+public:
+    explicit AutoEdgeDetectionFilter(double fraction, Pixel black = {0, 0, 0}, Pixel white = {1, 1, 1});
+    size_t GetHalo() const override;
 };
 
 class NegativeFilter : public CustomManipulator {
 public:
     NegativeFilter() = default;
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
     static std::string GetHelp();
 };
 
+// The reference blur: every pass sums the pixels of the picture with the unnormalised Gaussian weights
+// exp(-d^2 / (2 sigma^2)) / (sqrt(2 pi) sigma), nothing is assumed beyond the borders. The weights are computed
+// once and cut where the dropped tails add up to less than epsilon per pixel over both passes.
 class GaussianBlurFilter : public CustomManipulator {
 public:
-    explicit GaussianBlurFilter(double sigma);
+    explicit GaussianBlurFilter(double sigma, double epsilon = ManipulatorParameters::GAUSSIAN_EPSILON);
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    // weights[d] is the weight of the pixels d apart, d <= GetRadius().
+    const std::vector<ManipulatorParameters::ManipulatorBaseType>& GetWeights() const;
+    size_t GetRadius() const;
     static std::string GetHelp();
 
 protected:
-    void VerticalGaussianBlur(Matrix<Pixel>& data) const;
-    void HorizontalGaussianBlur(Matrix<Pixel>& data) const;
+    template <typename ElementType>
+    void Blur(Matrix<ElementType>& data) const;
+    template <typename ElementType>
+    void VerticalGaussianBlur(Matrix<ElementType>& data) const;
+    template <typename ElementType>
+    void HorizontalGaussianBlur(Matrix<ElementType>& data) const;
+
     double sigma_;
+    std::vector<ManipulatorParameters::ManipulatorBaseType> weights_;
 };
 
 class FastGaussianBlurFilter : public CustomManipulator {
 public:
     explicit FastGaussianBlurFilter(double sigma);
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
     static std::string GetHelp();
 
 protected:
@@ -100,25 +232,306 @@ protected:
     Matrix<PixelParameters::Scalar> horizontal_convolution_;
 };
 
+// Approximation of GaussianBlurFilter for large sigma working at a coarse level of the picture's Gaussian
+// pyramid: every level halves the previous one after the binomial blur 1 4 6 4 1, the coarsest level is blurred
+// with what is left of sigma and interpolated back linearly. The full-resolution pixels are read and written
+// once, whatever sigma is. The bound of the difference from the exact filter is computed from the two kernels.
+class PyramidGaussianBlurFilter : public CustomManipulator {
+public:
+    explicit PyramidGaussianBlurFilter(double sigma);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    size_t GetLevel() const;
+    // Largest difference from GaussianBlurFilter with the same sigma for channels in [0, 1].
+    double GetErrorBound() const;
+    static std::string GetHelp();
+
+protected:
+    template <typename ElementType>
+    void Blur(Matrix<ElementType>& data) const;
+    // Both rows hold the nodes of their level from the position -1 on.
+    template <typename ElementType>
+    static void ReduceRow(std::span<const ElementType> row, std::span<ElementType> reduced);
+    static size_t GetReducedSize(size_t size);
+    // One-dimensional weights of the output pixel at phase (its position modulo the scale) on the input pixels
+    // from phase - GetHalo() to phase + GetHalo().
+    std::vector<double> GetEffectiveWeights(size_t phase) const;
+
+    double sigma_;
+    size_t level_;
+    // 2^level_, the distance between the coarse nodes in full-resolution pixels.
+    size_t scale_;
+    // Normalised weights of the coarse blur, coarse_weights_[d] for the nodes d apart.
+    std::vector<double> coarse_weights_;
+    double error_bound_;
+};
+
+// Convolution with a user kernel. The kernel is analysed once and every picture goes to the cheapest engine
+// that fits it: two one-dimensional passes for separable kernels, the tap list (zero taps skipped, symmetric
+// pairs folded) for small ones and the FFT for large ones.
+class ConvolutionFilter : public ConvolutionalManipulator {
+public:
+    enum class Method {
+        Separable,
+        Taps,
+        Fft
+    };
+
+    explicit ConvolutionFilter(const Matrix<ManipulatorParameters::ManipulatorBaseType>& kernel);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    // Taken by small kernels of integer weights, see SharpeningFilter.
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    const KernelAnalysis& GetAnalysis() const;
+    Method GetMethod(size_t width, size_t height, size_t planes) const;
+    static std::string GetHelp();
+
+protected:
+    template <typename ElementType>
+    void Convolve(Matrix<ElementType>& data) const;
+
+    KernelAnalysis analysis_;
+    TapConvolution taps_;
+    TapConvolution column_taps_;
+    TapConvolution row_taps_;
+    ConvolutionEngine engine_;
+    IntegerConvolution integer_convolution_;
+    bool is_integer_;
+};
+
+// Median of every channel over the (2 * radius + 1)^2 window, on 8-bit values: colours and grey planes are
+// rounded to bytes first. The time per pixel does not depend on the radius.
+class MedianFilter : public CustomManipulator {
+public:
+    explicit MedianFilter(size_t radius);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+
+protected:
+    size_t radius_;
+};
+
+// Mean of every channel over the (2 * radius + 1)^2 window cut at the borders, from a summed-area table: the
+// time per pixel does not depend on the radius.
+class BoxBlurFilter : public CustomManipulator {
+public:
+    explicit BoxBlurFilter(size_t radius);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+
+protected:
+    size_t radius_;
+};
+
+// Erosion, dilation, opening or closing by a width x height rectangle, every channel separately (the darker
+// and the brighter values win). Two-colour masks are processed packed, 64 pixels per operation.
+class MorphologyFilter : public CustomManipulator {
+public:
+    MorphologyFilter(MorphologyParameters::Operation operation, size_t width, size_t height);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    // Masks stay masks, the brighter of their two colours is the one dilated.
+    void ApplyToBitmap(Bitmap& bitmap) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+
+protected:
+    MorphologyParameters::Operation operation_;
+    Morphology::Window horizontal_;
+    Morphology::Window vertical_;
+};
+
+// Edge-preserving smoothing: the bilateral filter with the spatial sigma in pixels and the range one in channel
+// values, computed on a bilateral grid. Colours are weighted by the closeness of their luma.
+class BilateralFilter : public CustomManipulator {
+public:
+    BilateralFilter(double sigma_spatial, double sigma_range);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+
+protected:
+    double sigma_spatial_;
+    double sigma_range_;
+};
+
 class CropFilter : public CustomManipulator {
 public:
     explicit CropFilter(size_t width, size_t height);
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    std::pair<size_t, size_t> GetOutputSize(size_t width, size_t height) const override;
     static std::string GetHelp();
 
 protected:
+    template <typename ElementType>
+    void Crop(Matrix<ElementType>& data) const;
+
     size_t width_;
     size_t height_;
 };
 
+// Flips, rotations by quarter turns and the transposition. Transposing ones swap the width and the height and
+// cannot be applied to a region.
+class OrientationFilter : public CustomManipulator {
+public:
+    explicit OrientationFilter(OrientationParameters::Operation operation);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    std::pair<size_t, size_t> GetOutputSize(size_t width, size_t height) const override;
+    static std::string GetHelp();
+
+protected:
+    template <typename ElementType>
+    void Orient(Matrix<ElementType>& data) const;
+
+    OrientationParameters::Operation operation_;
+};
+
+// Resizes the picture to width x height with a separable kernel. Reductions by more than REDUCING_GAP times
+// box-average whole blocks of pixels first, the kernel then spans only a few of the remaining ones.
+class ResizeFilter : public CustomManipulator {
+public:
+    ResizeFilter(size_t width, size_t height, ResampleParameters::Kernel kernel = ResampleParameters::Kernel::Bicubic);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    std::pair<size_t, size_t> GetOutputSize(size_t width, size_t height) const override;
+    // Bitmap::load may box-reduce 24-bit pictures down to this size while reading: the filter would do the same.
+    std::pair<size_t, size_t> GetMinLoadSize() const;
+    static std::string GetHelp();
+
+protected:
+    // destination holds width_ x height_ pixels of channels interleaved channels.
+    template <typename Channel>
+    void Resize(MatrixView<const Channel> source, MatrixView<Channel> destination, size_t channels) const;
+
+    size_t width_;
+    size_t height_;
+    ResampleParameters::Kernel kernel_;
+};
+
 class CurvesFilter : public CustomManipulator {
 public:
     explicit CurvesFilter(std::vector<ColourParameters::ColourType> x, std::vector<ColourParameters::ColourType> y);
     void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+
+protected:
+    BarycentricLagrangePolynomial<ColourParameters::ColourType> lagrange_poly_;
+};
+
+// Writes the statistics of every channel of the picture (see Statistics::ToJson) to a JSON file and leaves the
+// picture as it is. The statistics come from one parallel pass over the storage the picture is kept in.
+class StatisticsFilter : public CustomManipulator {
+public:
+    explicit StatisticsFilter(std::string path);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
+    static std::string GetHelp();
+
+protected:
+    // Throws std::runtime_error if the file cannot be written.
+    void Write(size_t width, size_t height, const std::vector<std::string>& names,
+               const std::vector<Statistics::Channel>& channels) const;
+
+    std::string path_;
+};
+
+// Stretches every channel linearly so that its low and high percentiles become 0 and 1, the values beyond are
+// clipped. The percentiles come from the histograms of one pass over the picture, 8-bit data then goes through
+// a lookup table.
+class AutoLevelsFilter : public CustomManipulator {
+public:
+    AutoLevelsFilter(double low, double high);
+    void Apply(Matrix<Pixel>& data) const override;
+    void ApplyView(const MatrixView<Pixel>& view) const override;
+    void ApplyBytes(Matrix<Bitmap::PrimitivePixel>& data) const override;
+    void ApplyGreyscale(Matrix<ColourParameters::ColourType>& data) const override;
+    BitmapParameters::StorageFormats GetAcceptedFormats() const override;
     static std::string GetHelp();
 
 protected:
-    PixelLagrangePolynomial<ColourParameters::ColourType> lagrange_poly_;
+    // (offset, scale) of every channel, the value v goes to (v - offset) * scale. Channels whose percentiles
+    // coincide are left as they are.
+    std::vector<std::pair<double, double>> GetLevels(const std::vector<Statistics::Channel>& channels) const;
+
+    double low_;
+    double high_;
+};
+
+// Applies another filter only inside a set of rectangles or the set pixels of a mask, the rest of the picture
+// is left untouched. Only the regions grown by the filter's halo are read, so pixels near a region's edge see
+// their true neighbours, as if the whole picture was filtered. Takes ownership of the filter.
+class RegionFilter : public Manipulator {
+public:
+    struct Region {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+    };
+
+    RegionFilter(Manipulator* filter, std::vector<Region> regions);
+    // The mask must have the size of the pictures the filter is applied to, std::invalid_argument is thrown
+    // otherwise.
+    RegionFilter(Manipulator* filter, BitMask mask);
+    void Apply(Matrix<Pixel>& data) const override;
+    size_t GetHalo() const override;
+    static std::string GetHelp();
+    ~RegionFilter() override;
+
+protected:
+    // Boxes around the set pixels of the mask, see ManipulatorParameters::MASK_BOX_SPARSENESS.
+    std::vector<Region> GetMaskRegions() const;
+    // Runs the filter on the region grown by the halo in place, then puts back the pixels around the region
+    // (and the unset pixels of the mask inside it).
+    void ApplyInPlace(Matrix<Pixel>& data, const Region& region, size_t halo) const;
+    // Runs the filter on a copy of the region grown by the halo and returns it with the offset of the region
+    // inside the copy.
+    Matrix<Pixel> ApplyGrown(const Matrix<Pixel>& data, const Region& region, size_t& offset_x,
+                             size_t& offset_y) const;
+
+    Manipulator* filter_;
+    std::vector<Region> regions_;
+    BitMask mask_;
+    bool is_masked_;
 };
 
 #endif  // IMAGE_PROCESSOR_IMAGE_MANIPULATORS_H
@@ -0,0 +1,232 @@
+#include "image_processor_api.h"
+
+#include "application.h"
+#include "bitmap.h"
+#include "filter_pipeline.h"
+#include "filter_pipeline_maker.h"
+
+#include <stdexcept>
+
+namespace ImageProcessor {
+
+namespace {
+struct ChannelOffsets {
+    size_t red;
+    size_t green;
+    size_t blue;
+};
+
+ChannelOffsets GetChannelOffsets(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::BGR24:
+        case PixelFormat::BGRA32:
+            return {2, 1, 0};
+        case PixelFormat::RGB24:
+        case PixelFormat::RGBA32:
+            return {0, 1, 2};
+        case PixelFormat::Greyscale8:
+            return {0, 0, 0};
+    }
+    throw std::invalid_argument("unknown pixel format");
+}
+
+bool HasAlpha(PixelFormat format) {
+    return format == PixelFormat::BGRA32 || format == PixelFormat::RGBA32;
+}
+
+void CheckLayout(size_t width, size_t stride, PixelFormat format, const void* data) {
+    if (data == nullptr && width > 0) {
+        throw std::invalid_argument("image buffer has no data");
+    }
+    if (stride < width * GetBytesPerPixel(format)) {
+        throw std::invalid_argument("image buffer stride is less than its row size");
+    }
+}
+}  // namespace
+
+size_t GetBytesPerPixel(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::BGR24:
+        case PixelFormat::RGB24:
+            return 3;
+        case PixelFormat::BGRA32:
+        case PixelFormat::RGBA32:
+            return 4;
+        case PixelFormat::Greyscale8:
+            return 1;
+    }
+    throw std::invalid_argument("unknown pixel format");
+}
+
+Image::Image() : bitmap_(std::make_unique<Bitmap>()) {
+}
+
+Image::Image(const ImageView& view) : Image() {
+    CheckLayout(view.width, view.stride, view.format, view.data);
+    if (view.width == 0 || view.height == 0) {
+        return;
+    }
+    size_t bytes_per_pixel = GetBytesPerPixel(view.format);
+    if (view.format == PixelFormat::Greyscale8) {
+        Matrix<ColourParameters::ColourType> plane(view.width, view.height);
+        for (size_t y = 0; y < view.height; ++y) {
+            const uint8_t* row = view.data + y * view.stride;
+            for (size_t x = 0; x < view.width; ++x) {
+                plane.GetElement(x, y) = ColourParameters::FromByte(row[x]);
+            }
+        }
+        bitmap_->SetGreyscale(std::move(plane));
+        return;
+    }
+    ChannelOffsets offsets = GetChannelOffsets(view.format);
+    Matrix<Bitmap::PrimitivePixel> bytes(view.width, view.height);
+    for (size_t y = 0; y < view.height; ++y) {
+        const uint8_t* row = view.data + y * view.stride;
+        for (size_t x = 0; x < view.width; ++x) {
+            const uint8_t* pixel = row + x * bytes_per_pixel;
+            bytes.GetElement(x, y) = {pixel[offsets.red], pixel[offsets.green], pixel[offsets.blue]};
+        }
+    }
+    bitmap_->SetBytes(std::move(bytes));
+}
+
+Image::Image(const Image& other) : bitmap_(std::make_unique<Bitmap>(*other.bitmap_)) {
+}
+
+Image::Image(Image&& other) noexcept : bitmap_(std::move(other.bitmap_)) {
+}
+
+Image& Image::operator=(Image other) noexcept {
+    std::swap(bitmap_, other.bitmap_);
+    return *this;
+}
+
+Image::~Image() = default;
+
+size_t Image::GetWidth() const {
+    return bitmap_->GetSize().second;
+}
+
+size_t Image::GetHeight() const {
+    return bitmap_->GetSize().first;
+}
+
+void Image::CopyTo(const ImageBuffer& destination) const {
+    if (destination.width != GetWidth() || destination.height != GetHeight()) {
+        throw std::length_error("destination buffer sizes differ from the image sizes");
+    }
+    CheckLayout(destination.width, destination.stride, destination.format, destination.data);
+    if (GetWidth() == 0 || GetHeight() == 0) {
+        return;
+    }
+    size_t bytes_per_pixel = GetBytesPerPixel(destination.format);
+    if (destination.format == PixelFormat::Greyscale8) {
+        // Converting the storage changes how the pixels are kept, not what they are.
+        const Matrix<ColourParameters::ColourType>& plane = *bitmap_->GetGreyscale();
+        for (size_t y = 0; y < GetHeight(); ++y) {
+            uint8_t* row = destination.data + y * destination.stride;
+            for (size_t x = 0; x < GetWidth(); ++x) {
+                row[x] = ColourParameters::ToByte(plane.GetElement(x, y));
+            }
+        }
+        return;
+    }
+    ChannelOffsets offsets = GetChannelOffsets(destination.format);
+    const Matrix<Bitmap::PrimitivePixel>& bytes = *bitmap_->GetBytes();
+    for (size_t y = 0; y < GetHeight(); ++y) {
+        uint8_t* row = destination.data + y * destination.stride;
+        for (size_t x = 0; x < GetWidth(); ++x) {
+            uint8_t* pixel = row + x * bytes_per_pixel;
+            const Bitmap::PrimitivePixel& colour = bytes.GetElement(x, y);
+            pixel[offsets.red] = colour.red;
+            pixel[offsets.green] = colour.green;
+            pixel[offsets.blue] = colour.blue;
+            if (HasAlpha(destination.format)) {
+                pixel[3] = UINT8_MAX;
+            }
+        }
+    }
+}
+
+struct Processor::Pipeline {
+    FilterPipelineMaker maker;
+    FilterPipeline filters;
+    // Wrappers waiting for the filter they apply to, by name and parameters.
+    std::vector<std::vector<std::string>> wrappers;
+
+    // Wraps manipulator into the waiting wrappers, the innermost last, and appends it.
+    void Append(Manipulator* manipulator) {
+        for (auto wrapper = wrappers.rbegin(); wrapper != wrappers.rend(); ++wrapper) {
+            FilterDescriptor descriptor;
+            descriptor.SetFilterName(wrapper->front());
+            for (size_t i = 1; i < wrapper->size(); ++i) {
+                descriptor.AddParameter((*wrapper)[i]);
+            }
+            try {
+                manipulator = maker.GetWrapperMaker(descriptor.GetFilterName())(descriptor, manipulator);
+            } catch (...) {
+                delete manipulator;
+                wrappers.clear();
+                throw;
+            }
+        }
+        wrappers.clear();
+        filters.GetPipeline().push_back(manipulator);
+    }
+};
+
+Processor::Processor() : pipeline_(std::make_unique<Pipeline>()) {
+    FilterMakers::RegisterFilterCreators(pipeline_->maker);
+}
+
+Processor::~Processor() = default;
+
+Processor& Processor::AddFilter(std::string_view name, const std::vector<std::string>& params) {
+    if (pipeline_->maker.GetWrapperMaker(name) != nullptr) {
+        std::vector<std::string> wrapper = {std::string(name)};
+        wrapper.insert(wrapper.end(), params.begin(), params.end());
+        pipeline_->wrappers.push_back(std::move(wrapper));
+        return *this;
+    }
+    FilterDescriptor descriptor;
+    descriptor.SetFilterName(name);
+    for (const std::string& param : params) {
+        descriptor.AddParameter(param);
+    }
+    Manipulator* manipulator = pipeline_->maker.MakeFilter(descriptor);
+    if (manipulator == nullptr) {
+        throw std::invalid_argument("unknown filter " + std::string(name));
+    }
+    pipeline_->Append(manipulator);
+    return *this;
+}
+
+Processor& Processor::AddFilter(std::unique_ptr<Manipulator> manipulator) {
+    if (manipulator == nullptr) {
+        throw std::invalid_argument("null filter passed to Processor::AddFilter");
+    }
+    pipeline_->Append(manipulator.release());
+    return *this;
+}
+
+size_t Processor::GetSize() const {
+    return pipeline_->filters.GetSize();
+}
+
+Image Processor::Run(const ImageView& input) const {
+    if (!pipeline_->wrappers.empty()) {
+        throw std::invalid_argument("no filter follows " + pipeline_->wrappers.back().front());
+    }
+    Image image(input);
+    // Stage by stage rather than FilterPipeline::Apply, which would filter a copy.
+    for (size_t stage = 0; stage < GetSize(); ++stage) {
+        pipeline_->filters.ApplyStage(stage, *image.bitmap_);
+    }
+    return image;
+}
+
+void Processor::Run(const ImageView& input, const ImageBuffer& output) const {
+    Run(input).CopyTo(output);
+}
+
+}  // namespace ImageProcessor
@@ -0,0 +1,98 @@
+#ifndef IMAGE_PROCESSOR_IMAGE_PROCESSOR_API_H
+#define IMAGE_PROCESSOR_IMAGE_PROCESSOR_API_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Bitmap;
+class Manipulator;
+
+// In-memory entry point for embedding the filters into other programs:
+// pipelines are built from owned strings instead of argv, images are read from and written to caller-owned buffers,
+// and nothing touches the filesystem but the files filters are given (a -conv kernel, a -roi-mask).
+namespace ImageProcessor {
+
+enum class PixelFormat {
+    BGR24,
+    RGB24,
+    BGRA32,
+    RGBA32,
+    Greyscale8
+};
+
+size_t GetBytesPerPixel(PixelFormat format);
+
+// Caller-owned pixels: height rows of width pixels, the rows start stride bytes apart.
+struct ImageView {
+    const uint8_t* data;
+    size_t width;
+    size_t height;
+    size_t stride;
+    PixelFormat format;
+};
+
+struct ImageBuffer {
+    uint8_t* data;
+    size_t width;
+    size_t height;
+    size_t stride;
+    PixelFormat format;
+};
+
+// The pixels stay in whatever storage the filters leave them in (8-bit, a grey plane, doubles or a two-colour
+// mask) and are converted only when a filter or CopyTo needs another one.
+class Image {
+public:
+    Image();
+    explicit Image(const ImageView& view);
+    Image(const Image& other);
+    Image(Image&& other) noexcept;
+    Image& operator=(Image other) noexcept;
+    ~Image();
+
+    size_t GetWidth() const;
+    size_t GetHeight() const;
+    // Writes the image into destination (converting to its format, alpha is written opaque),
+    // throws std::length_error if destination has other sizes.
+    void CopyTo(const ImageBuffer& destination) const;
+
+protected:
+    friend class Processor;
+
+    std::unique_ptr<Bitmap> bitmap_;
+};
+
+class Processor {
+public:
+    // Knows every filter the command line tool knows.
+    Processor();
+    Processor(const Processor& other) = delete;
+    Processor& operator=(const Processor& other) = delete;
+    ~Processor();
+
+    // Appends a filter by its command line name (e.g. AddFilter("-blur", {"5"})). Wrappers such as -roi and
+    // -roi-mask apply to the filter appended after them, as on the command line.
+    // Throws std::invalid_argument if the name is unknown or the parameters do not fit.
+    Processor& AddFilter(std::string_view name, const std::vector<std::string>& params = {});
+    // Appends a user-made filter, wrapped by the wrappers appended before it.
+    Processor& AddFilter(std::unique_ptr<Manipulator> manipulator);
+    size_t GetSize() const;
+
+    // Throws std::invalid_argument if the last wrapper has no filter to wrap.
+    Image Run(const ImageView& input) const;
+    // Same as Run(input).CopyTo(output).
+    void Run(const ImageView& input, const ImageBuffer& output) const;
+
+protected:
+    struct Pipeline;
+
+    std::unique_ptr<Pipeline> pipeline_;
+};
+
+}  // namespace ImageProcessor
+
+#endif  // IMAGE_PROCESSOR_IMAGE_PROCESSOR_API_H
@@ -0,0 +1,119 @@
+#ifndef IMAGE_PROCESSOR_INTEGRAL_H
+#define IMAGE_PROCESSOR_INTEGRAL_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace Integral {
+// Pixels [left, right) x [top, bottom).
+struct Rectangle {
+    size_t left;
+    size_t top;
+    size_t right;
+    size_t bottom;
+
+    size_t GetArea() const {
+        return (right - left) * (bottom - top);
+    }
+};
+
+// Whether sums of up to max_sum fit into Sum. Unsigned sums wrap around modulo 2^bits, so the sum of a
+// rectangle is exact whenever the rectangle's own sum fits, however large the whole table grows.
+template <typename Sum>
+bool Fits(uint64_t max_sum) {
+    return std::is_floating_point_v<Sum> || max_sum <= std::numeric_limits<Sum>::max();
+}
+
+// Summed-area table of rows of interleaved channels (the source's width counts the channels): the element
+// (x, y) of a channel is the sum of transform(element) over the pixels [0, x) x [0, y), so the sum over any
+// rectangle costs four lookups. Integer elements should be summed in unsigned integers (see Fits), floating
+// point ones in double. Both passes of the construction are spread over the threads: the rows are summed
+// independently and then the columns are, every thread taking a range of them down the table.
+template <typename Sum>
+class SummedAreaTable {
+public:
+    template <typename ElementType, typename Transform = std::identity>
+    SummedAreaTable(MatrixView<const ElementType> source, size_t channels, Transform transform = {})
+        : channels_(channels), table_(source.width + channels, source.height + 1) {
+        Parallel::ForBlocks(source.height, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                std::span<const ElementType> source_row = source.Row(y);
+                std::span<Sum> row = table_.Row(y + 1);
+                for (size_t x = 0; x < source_row.size(); ++x) {
+                    row[x + channels] = row[x] + static_cast<Sum>(transform(source_row[x]));
+                }
+            }
+        });
+        Parallel::ForBlocks(table_.GetWidth(), [&](size_t begin, size_t end) {
+            for (size_t y = 1; y < table_.GetHeight(); ++y) {
+                std::span<const Sum> above = static_cast<const Matrix<Sum>&>(table_).Row(y - 1);
+                std::span<Sum> row = table_.Row(y);
+                for (size_t x = begin; x < end; ++x) {
+                    row[x] += above[x];
+                }
+            }
+        });
+    }
+
+    // Pixels of the picture, not counting the channels.
+    size_t GetWidth() const {
+        return table_.GetWidth() / channels_ - 1;
+    }
+    size_t GetHeight() const {
+        return table_.GetHeight() - 1;
+    }
+
+    // The (2 * radius + 1)^2 window around the pixel (x, y) cut at the borders.
+    Rectangle GetWindow(size_t x, size_t y, size_t radius) const {
+        return {x > radius ? x - radius : 0, y > radius ? y - radius : 0, std::min(GetWidth(), x + radius + 1),
+                std::min(GetHeight(), y + radius + 1)};
+    }
+
+    Sum GetSum(const Rectangle& rectangle, size_t channel) const {
+        std::span<const Sum> top = table_.Row(rectangle.top);
+        std::span<const Sum> bottom = table_.Row(rectangle.bottom);
+        size_t left = rectangle.left * channels_ + channel;
+        size_t right = rectangle.right * channels_ + channel;
+        return bottom[right] - bottom[left] - top[right] + top[left];
+    }
+
+private:
+    size_t channels_;
+    Matrix<Sum> table_;
+};
+
+// Means over the (2 * radius + 1)^2 windows cut at the borders, integers are rounded to the nearest.
+// Every pixel costs the same whatever the radius.
+template <typename Sum, typename ElementType>
+void BoxMean(MatrixView<const ElementType> source, MatrixView<ElementType> destination, size_t channels,
+             size_t radius) {
+    if (source.width == 0 || source.height == 0) {
+        return;
+    }
+    SummedAreaTable<Sum> table(source, channels);
+    destination.ForEachRow([&](size_t y, std::span<ElementType> row) {
+        for (size_t x = 0; x < table.GetWidth(); ++x) {
+            Rectangle window = table.GetWindow(x, y, radius);
+            Sum area = static_cast<Sum>(window.GetArea());
+            for (size_t c = 0; c < channels; ++c) {
+                Sum sum = table.GetSum(window, c);
+                if constexpr (std::is_integral_v<ElementType>) {
+                    row[x * channels + c] = static_cast<ElementType>((sum + area / 2) / area);
+                } else {
+                    row[x * channels + c] = static_cast<ElementType>(sum / area);
+                }
+            }
+        }
+    });
+}
+}  // namespace Integral
+
+#endif  // IMAGE_PROCESSOR_INTEGRAL_H
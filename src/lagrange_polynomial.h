@@ -2,8 +2,14 @@
 #define IMAGE_PROCESSOR_LAGRANGE_POLYNOMIAL_H
 
 #include "pixel.h"
+#include "poly.h"
+#include "simd.h"
 
+#include <cmath>
 #include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 // Интерполяция многочленом Лагранжа, считается наивно по определению inplace
@@ -41,4 +47,90 @@ protected:
     std::vector<Coefficients> y_;
     size_t size_;
 };
+// Lagrange interpolation in the barycentric form:
+// p(x) = sum(w_i * y_i / (x - x_i)) / sum(w_i / (x - x_i)), w_i = 1 / prod(x_i - x_j).
+// Complexity: O(n^2) for the weights, O(n) per point. Without nodes it is the identity.
+template <typename Coefficients>
+class BarycentricLagrangePolynomial {
+public:
+    BarycentricLagrangePolynomial() = default;
+
+    BarycentricLagrangePolynomial(const std::vector<Coefficients>& x, const std::vector<Coefficients>& y)
+        : x_(x), y_(y), weights_(x.size(), Coefficients{1}) {
+        if (x.size() != y.size()) {
+            throw std::invalid_argument("numbers of interpolation nodes and values differ");
+        }
+        for (size_t i = 0; i < x_.size(); ++i) {
+            for (size_t j = 0; j < x_.size(); ++j) {
+                if (i == j) {
+                    continue;
+                }
+                if (x_[i] == x_[j]) {
+                    throw std::invalid_argument("identical interpolation nodes");
+                }
+                weights_[i] /= (x_[i] - x_[j]);
+            }
+        }
+    }
+
+    Coefficients operator()(Coefficients var) const {
+        Coefficients answer = var;
+        Evaluate(std::span<const Coefficients>(&var, 1), std::span<Coefficients>(&answer, 1));
+        return answer;
+    }
+
+    // output[i] = p(input[i]), the spans may coincide.
+    void Evaluate(std::span<const Coefficients> input, std::span<Coefficients> output) const {
+        if (input.size() != output.size()) {
+            throw std::length_error("input and output spans differ in size");
+        }
+        if (x_.empty()) {
+            std::copy(input.begin(), input.end(), output.begin());
+            return;
+        }
+        Coefficients numerators[PolyParameters::EVALUATION_BLOCK];
+        Coefficients denominators[PolyParameters::EVALUATION_BLOCK];
+        for (size_t begin = 0; begin < input.size(); begin += PolyParameters::EVALUATION_BLOCK) {
+            size_t size = std::min(PolyParameters::EVALUATION_BLOCK, input.size() - begin);
+            const Coefficients* var = input.data() + begin;
+            std::fill(numerators, numerators + size, Coefficients{});
+            std::fill(denominators, denominators + size, Coefficients{});
+            for (size_t j = 0; j < x_.size(); ++j) {
+                const Coefficients node = x_[j];
+                const Coefficients weight = weights_[j];
+                const Coefficients value = y_[j];
+                if constexpr (std::is_same_v<Coefficients, double>) {
+                    Simd::BarycentricStep(numerators, denominators, var, node, weight, value, size);
+                } else {
+                    for (size_t i = 0; i < size; ++i) {
+                        Coefficients term = weight / (var[i] - node);
+                        numerators[i] += term * value;
+                        denominators[i] += term;
+                    }
+                }
+            }
+            for (size_t i = 0; i < size; ++i) {
+                Coefficients answer = numerators[i] / denominators[i];
+                // Points hitting a node exactly (or close enough to overflow) divide infinities: take the node's value.
+                output[begin + i] = std::isfinite(answer) ? answer : y_[GetClosestNode(var[i])];
+            }
+        }
+    }
+
+protected:
+    std::vector<Coefficients> x_;
+    std::vector<Coefficients> y_;
+    std::vector<Coefficients> weights_;
+
+    size_t GetClosestNode(Coefficients var) const {
+        size_t closest = 0;
+        for (size_t j = 1; j < x_.size(); ++j) {
+            if (std::abs(var - x_[j]) < std::abs(var - x_[closest])) {
+                closest = j;
+            }
+        }
+        return closest;
+    }
+};
+
 #endif  // IMAGE_PROCESSOR_LAGRANGE_POLYNOMIAL_H
@@ -1,7 +1,12 @@
 #ifndef IMAGE_PROCESSOR_MATRIX_H
 #define IMAGE_PROCESSOR_MATRIX_H
 
+#include "parallel.h"
+
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
@@ -14,50 +19,94 @@ class SizesNotSuitableException : public std::exception {
 using StandardElementType = int64_t;
 }  // namespace MatrixParameters
 
+// Non-owning window into a matrix: height rows of width elements starting stride elements apart,
+// data points to the window's first element. Element access is not checked: it is for inner loops
+// that already know their bounds.
+template <typename ElementType>
+struct MatrixView {
+    ElementType* data;
+    size_t width;
+    size_t height;
+    size_t stride;
+
+    std::span<ElementType> Row(size_t y) const {
+        return {data + y * stride, width};
+    }
+    ElementType& operator()(size_t x, size_t y) const {
+        return data[y * stride + x];
+    }
+    // The region of width x height elements with the upper left corner at (x, y), throws std::out_of_range
+    // if it does not fit.
+    MatrixView SubView(size_t x, size_t y, size_t sub_width, size_t sub_height) const {
+        if (x + sub_width > width || y + sub_height > height) {
+            throw std::out_of_range("the region does not fit into the view");
+        }
+        return {data + y * stride + x, sub_width, sub_height, stride};
+    }
+
+    // Calls function(y, Row(y)) for every row, rows are spread over the threads.
+    template <typename Function>
+    void ForEachRow(Function function) const {
+        Parallel::ForBlocks(height, [this, &function](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                function(y, Row(y));
+            }
+        });
+    }
+
+    // Replaces every element with function(element), in parallel.
+    template <typename Function>
+    void Transform(Function function) const {
+        ForEachRow([&function](size_t, std::span<ElementType> row) {
+            for (ElementType& element : row) {
+                element = function(element);
+            }
+        });
+    }
+};
+
 template <typename ElementType>
 class Matrix {
 public:
     using MatrixCore = std::vector<ElementType>;
     using ValuesTable = std::vector<std::vector<ElementType> >;
 
-    Matrix() : matrix_(nullptr), height_(0), width_(0){};
+    Matrix() : matrix_(), height_(0), width_(0), offset_(0), stride_(0){};
 
-    Matrix(const Matrix& other) : matrix_(nullptr), height_(0), width_(0) {
-        Copy(other);
+    // Copies only the visible elements: a cropped matrix turns compact again.
+    Matrix(const Matrix& other) : Matrix(other.width_, other.height_) {
+        for (size_t y = 0; y < height_; ++y) {
+            std::span<const ElementType> row = other.Row(y);
+            std::copy(row.begin(), row.end(), Row(y).begin());
+        }
     }
 
-    Matrix(Matrix&& other) : matrix_(nullptr), height_(0), width_(0) {
-        std::swap(matrix_, other.matrix_);
-        std::swap(width_, other.width_);
-        std::swap(height_, other.height_);
+    Matrix(Matrix&& other) : Matrix() {
+        Swap(other);
     }
 
-    explicit Matrix(const ValuesTable& other) : matrix_(nullptr), height_(0), width_(0) {
+    explicit Matrix(const ValuesTable& other) : Matrix() {
         size_t column_size = other.size();
-        height_ = column_size;
-        if (column_size > 0) {
-            size_t row_size = other[0].size();
-            width_ = row_size;
-            matrix_ = new MatrixCore(row_size * column_size);
-            auto starting_point = matrix_->begin();
-            for (size_t i = 0; i < column_size; ++i) {
-                std::copy(other[i].begin(), other[i].end(), starting_point);
-                std::advance(starting_point, row_size);
+        if (column_size > 0 && !other[0].empty()) {
+            height_ = column_size;
+            width_ = other[0].size();
+            stride_ = width_;
+            matrix_.reserve(width_ * height_);
+            for (const std::vector<ElementType>& row : other) {
+                std::copy(row.begin(), row.end(), std::back_inserter(matrix_));
             }
-        } else {
-            height_ = 0;
-            width_ = 0;
-            matrix_ = nullptr;
         }
     }
 
-    explicit Matrix(size_t width, size_t height) : matrix_(nullptr), height_(height), width_(width) {
+    explicit Matrix(size_t width, size_t height)
+        : matrix_(), height_(height), width_(width), offset_(0), stride_(width) {
         if (height == 0 || width == 0) {
             height_ = 0;
             width_ = 0;
+            stride_ = 0;
             return;
         }
-        matrix_ = new MatrixCore(height * width);
+        matrix_.resize(height * width);
     }
 
     std::pair<size_t, size_t> GetSize() const {
@@ -77,45 +126,90 @@ public:
         if (y >= height_) {
             throw std::out_of_range("Y is out of range");
         }
-        return (*matrix_)[GetWidth() * y + x];
+        return matrix_[offset_ + stride_ * y + x];
     }
     ElementType GetElement(size_t x, size_t y) const {
-        return (*matrix_)[GetWidth() * y + x];
+        return matrix_[offset_ + stride_ * y + x];
     }
 
+    // Contiguous unchecked rows.
+    std::span<ElementType> Row(size_t y) {
+        return {matrix_.data() + offset_ + y * stride_, width_};
+    }
+    std::span<const ElementType> Row(size_t y) const {
+        return {matrix_.data() + offset_ + y * stride_, width_};
+    }
+
+    MatrixView<ElementType> GetView() {
+        return {matrix_.data() + offset_, width_, height_, stride_};
+    }
+    MatrixView<const ElementType> GetView() const {
+        return {matrix_.data() + offset_, width_, height_, stride_};
+    }
+    MatrixView<ElementType> GetView(size_t x, size_t y, size_t width, size_t height) {
+        return GetView().SubView(x, y, width, height);
+    }
+
+    // Narrows the matrix to the region of width x height elements with the upper left corner at (x, y) in O(1):
+    // the storage is kept, only the window moves. Throws std::out_of_range if the region does not fit.
+    void Crop(size_t x, size_t y, size_t width, size_t height) {
+        if (x + width > width_ || y + height > height_) {
+            throw std::out_of_range("the region does not fit into the matrix");
+        }
+        if (width == 0 || height == 0) {
+            *this = Matrix();
+            return;
+        }
+        offset_ += y * stride_ + x;
+        width_ = width;
+        height_ = height;
+    }
+
+    template <typename Function>
+    void ForEachRow(Function function) {
+        GetView().ForEachRow(function);
+    }
+    template <typename Function>
+    void ForEachRow(Function function) const {
+        GetView().ForEachRow(function);
+    }
+    template <typename Function>
+    void Transform(Function function) {
+        GetView().Transform(function);
+    }
+
+    // Borders are extended by their closest elements. Every result row is accumulated kernel row by kernel row
+    // over a padded copy of the source row, so the innermost loop is a contiguous multiply-add.
     template <typename T>
     Matrix<ElementType>& Convolution(const Matrix<T>& other) {
         size_t other_height = other.GetHeight();
         size_t other_width = other.GetWidth();
+        if (other_height == 0 || other_width == 0 || height_ == 0) {
+            return *this;
+        }
         size_t mid_height = (other_height) / 2;
         size_t mid_width = (other_width) / 2;
-        Matrix temp_answer = *this;
-        for (size_t i = 0; i < GetHeight(); ++i) {
-            for (size_t j = 0; j < GetWidth(); ++j) {
-                ElementType temp_answer_xy{};
-                for (size_t y_ij = 0; y_ij < other_height; ++y_ij) {
-                    for (size_t x_ij = 0; x_ij < other_width; ++x_ij) {
-                        size_t index_x_ij{};
-                        size_t index_y_ij{};
-                        if (mid_width > x_ij + j) {
-                            index_x_ij = 0;
-                        } else {
-                            index_x_ij = std::min(x_ij + j - mid_width, GetWidth() - 1);
-                        }
-                        if (mid_height > y_ij + i) {
-                            index_y_ij = 0;
-                        } else {
-                            index_y_ij = std::min(y_ij + i - mid_height, GetHeight() - 1);
-                        }
-                        const ElementType& closest_to_ij = GetElement(index_x_ij, index_y_ij);
-                        const T& other_element_ij = other.GetElement(x_ij, y_ij);
-                        temp_answer_xy += (closest_to_ij * other_element_ij);
+        Matrix temp_answer(width_, height_);
+        const Matrix& source = *this;
+        temp_answer.ForEachRow([&](size_t i, std::span<ElementType> answer_row) {
+            std::vector<ElementType> padded(width_ + other_width - 1);
+            std::fill(answer_row.begin(), answer_row.end(), ElementType{});
+            for (size_t y_ij = 0; y_ij < other_height; ++y_ij) {
+                size_t index_y_ij = mid_height > y_ij + i ? 0 : std::min(y_ij + i - mid_height, height_ - 1);
+                std::span<const ElementType> source_row = source.Row(index_y_ij);
+                for (size_t k = 0; k < padded.size(); ++k) {
+                    padded[k] = source_row[mid_width > k ? 0 : std::min(k - mid_width, width_ - 1)];
+                }
+                for (size_t x_ij = 0; x_ij < other_width; ++x_ij) {
+                    const T other_element_ij = other.GetElement(x_ij, y_ij);
+                    const ElementType* shifted = padded.data() + x_ij;
+                    for (size_t j = 0; j < width_; ++j) {
+                        answer_row[j] += shifted[j] * other_element_ij;
                     }
                 }
-                temp_answer.GetElement(j, i) = temp_answer_xy;
             }
-        }
-        Copy(temp_answer);
+        });
+        *this = std::move(temp_answer);
         return *this;
     }
 
@@ -123,10 +217,8 @@ public:
         if (this == &other) {
             return *this;
         }
-        matrix_ = new MatrixCore(other.height_ * other.width_);
-        height_ = other.GetHeight();
-        width_ = other.GetWidth();
-        std::copy(other.matrix_->begin(), other.matrix_->end(), matrix_->begin());
+        Matrix temp(other);
+        Swap(temp);
         return *this;
     }
 
@@ -134,18 +226,24 @@ public:
         if (this == &other) {
             return *this;
         }
-        std::swap(other.matrix_, matrix_);
-        std::swap(other.height_, height_);
-        std::swap(other.width_, width_);
+        Swap(other);
         return *this;
     }
 
     bool operator==(const Matrix& other) const {
-        return (*other.matrix_ == *matrix_ && other.height_ == height_ && other.width_ == width_);
+        if (other.height_ != height_ || other.width_ != width_) {
+            return false;
+        }
+        for (size_t y = 0; y < height_; ++y) {
+            if (!std::equal(Row(y).begin(), Row(y).end(), other.Row(y).begin())) {
+                return false;
+            }
+        }
+        return true;
     }
 
     bool operator!=(const Matrix& other) const {
-        return (*other.matrix_ != *matrix_ || other.height_ != height_ || other.width_ != width_);
+        return !(*this == other);
     }
 
     ElementType operator*(const Matrix& other) const {
@@ -153,46 +251,45 @@ public:
         if (GetSize() != other.GetSize()) {
             throw MatrixParameters::SizesNotSuitableException();
         }
-        for (size_t i = 0; i < GetWidth() * GetHeight(); ++i) {
-            answer += (*matrix_)[i] * (*other.matrix_)[i];
+        for (size_t y = 0; y < height_; ++y) {
+            for (size_t x = 0; x < width_; ++x) {
+                answer += Row(y)[x] * other.Row(y)[x];
+            }
         }
         return answer;
     }
 
+    // Keeps the upper left part, new elements are value-initialised. Shrinking is a Crop.
     void Resize(size_t new_width, size_t new_height) {
-        const size_t width = new_width + 0;
-        const size_t height = new_height + 0;
-        Matrix<ElementType> temp(width, height);
-        size_t min_width = std::min(width_, new_width);
-        size_t min_height = std::min(height_, new_height);
+        if (new_width <= width_ && new_height <= height_) {
+            Crop(0, 0, new_width, new_height);
+            return;
+        }
+        Matrix<ElementType> temp(new_width, new_height);
+        size_t min_width = std::min(width_, temp.width_);
+        size_t min_height = std::min(height_, temp.height_);
         for (size_t y = 0; y < min_height; ++y) {
-            for (size_t x = 0; x < min_width; ++x) {
-                ElementType& temp_xy = temp.GetElement(x, y);
-                temp_xy = this->GetElement(x, y);
-            }
+            std::span<const ElementType> row = Row(y);
+            std::copy(row.begin(), row.begin() + static_cast<std::ptrdiff_t>(min_width), temp.Row(y).begin());
         }
-        Copy(temp);
+        *this = std::move(temp);
     }
 
-    ~Matrix() {
-        if (matrix_ != nullptr) {
-            delete matrix_;
-        }
-    }
+    ~Matrix() = default;
 
 private:
-    MatrixCore* matrix_;
+    MatrixCore matrix_;
     size_t height_;
     size_t width_;
+    size_t offset_;  // of the element (0, 0) in matrix_
+    size_t stride_;
 
-    void Copy(const Matrix& other) {
-        MatrixCore* temp = new MatrixCore(other.height_ * other.width_);
-        delete matrix_;
-        matrix_ = nullptr;
-        height_ = other.height_;
-        width_ = other.width_;
-        std::copy(other.matrix_->begin(), other.matrix_->end(), temp->begin());
-        std::swap(matrix_, temp);
+    void Swap(Matrix& other) {
+        std::swap(matrix_, other.matrix_);
+        std::swap(height_, other.height_);
+        std::swap(width_, other.width_);
+        std::swap(offset_, other.offset_);
+        std::swap(stride_, other.stride_);
     }
 };
 
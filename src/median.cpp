@@ -0,0 +1,194 @@
+#include "median.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace {
+void CompareExchange(uint8_t& a, uint8_t& b) {
+    uint8_t low = std::min(a, b);
+    b = std::max(a, b);
+    a = low;
+}
+
+uint8_t Median3(uint8_t a, uint8_t b, uint8_t c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// The row y with the rows beyond the borders replaced by the closest ones.
+std::span<const uint8_t> ClampedRow(const MatrixView<const uint8_t>& view, int64_t y) {
+    return view.Row(static_cast<size_t>(std::clamp<int64_t>(y, 0, static_cast<int64_t>(view.height) - 1)));
+}
+
+// Histograms of one channel: the fine and the coarse bins of every column and of the window.
+class ChannelHistograms {
+public:
+    explicit ChannelHistograms(size_t width)
+        : width_(width), columns_(width * MedianParameters::BINS), coarse_columns_(width * MedianParameters::COARSE_BINS) {
+    }
+
+    void AddToColumn(size_t x, uint8_t value) {
+        ++columns_[x * MedianParameters::BINS + value];
+        ++coarse_columns_[x * MedianParameters::COARSE_BINS + value / MedianParameters::FINE_BINS];
+    }
+    void RemoveFromColumn(size_t x, uint8_t value) {
+        --columns_[x * MedianParameters::BINS + value];
+        --coarse_columns_[x * MedianParameters::COARSE_BINS + value / MedianParameters::FINE_BINS];
+    }
+
+    // The window spanning the columns -radius ... radius, the missing ones replaced by the column 0.
+    void ResetWindow(size_t radius) {
+        std::fill(window_.begin(), window_.end(), 0);
+        std::fill(coarse_window_.begin(), coarse_window_.end(), 0);
+        for (int64_t x = -static_cast<int64_t>(radius); x <= static_cast<int64_t>(radius); ++x) {
+            MoveWindow(GetColumn(x), width_);
+        }
+    }
+
+    // Adds the column added, subtracts the column removed unless it is width_.
+    void MoveWindow(size_t added, size_t removed) {
+        if (added == removed) {
+            return;
+        }
+        const uint16_t* add = columns_.data() + added * MedianParameters::BINS;
+        const uint16_t* coarse_add = coarse_columns_.data() + added * MedianParameters::COARSE_BINS;
+        if (removed == width_) {
+            for (size_t i = 0; i < MedianParameters::BINS; ++i) {
+                window_[i] += add[i];
+            }
+            for (size_t i = 0; i < MedianParameters::COARSE_BINS; ++i) {
+                coarse_window_[i] += coarse_add[i];
+            }
+            return;
+        }
+        const uint16_t* subtract = columns_.data() + removed * MedianParameters::BINS;
+        const uint16_t* coarse_subtract = coarse_columns_.data() + removed * MedianParameters::COARSE_BINS;
+        for (size_t i = 0; i < MedianParameters::BINS; ++i) {
+            window_[i] += add[i] - subtract[i];
+        }
+        for (size_t i = 0; i < MedianParameters::COARSE_BINS; ++i) {
+            coarse_window_[i] += coarse_add[i] - coarse_subtract[i];
+        }
+    }
+
+    // The value with exactly rank values below it in the window.
+    uint8_t GetValue(size_t rank) const {
+        size_t below = 0;
+        size_t coarse = 0;
+        while (below + coarse_window_[coarse] <= rank) {
+            below += coarse_window_[coarse++];
+        }
+        size_t value = coarse * MedianParameters::FINE_BINS;
+        while (below + window_[value] <= rank) {
+            below += window_[value++];
+        }
+        return static_cast<uint8_t>(value);
+    }
+
+    size_t GetColumn(int64_t x) const {
+        return static_cast<size_t>(std::clamp<int64_t>(x, 0, static_cast<int64_t>(width_) - 1));
+    }
+
+private:
+    size_t width_;
+    std::vector<uint16_t> columns_;
+    std::vector<uint16_t> coarse_columns_;
+    std::array<uint16_t, MedianParameters::BINS> window_;
+    std::array<uint16_t, MedianParameters::COARSE_BINS> coarse_window_;
+};
+}  // namespace
+
+namespace Median {
+void Apply(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels, size_t radius) {
+    if (radius == 1) {
+        ApplyNetwork(source, destination, channels);
+    } else {
+        ApplyHistograms(source, destination, channels, radius);
+    }
+}
+
+void ApplyNetwork(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels) {
+    size_t length = source.width;
+    if (length == 0) {
+        return;
+    }
+    destination.ForEachRow([&](size_t y, std::span<uint8_t> row) {
+        // The three rows with the pixels beyond the left and the right borders replaced by the closest ones.
+        std::array<std::vector<uint8_t>, 3> padded;
+        for (size_t i = 0; i < 3; ++i) {
+            std::span<const uint8_t> source_row = ClampedRow(source, static_cast<int64_t>(y + i) - 1);
+            padded[i].resize(length + 2 * channels);
+            std::copy(source_row.begin(), source_row.end(), padded[i].begin() + static_cast<std::ptrdiff_t>(channels));
+            for (size_t c = 0; c < channels; ++c) {
+                padded[i][c] = source_row[c];
+                padded[i][length + channels + c] = source_row[length - channels + c];
+            }
+        }
+        // Every column of three is sorted once for the three windows sharing it. The median of the window is
+        // then the median of the largest of the minima, the median of the medians and the smallest of the maxima.
+        std::vector<uint8_t> low(padded[0]);
+        std::vector<uint8_t> middle(padded[1]);
+        std::vector<uint8_t> high(padded[2]);
+        for (size_t j = 0; j < low.size(); ++j) {
+            CompareExchange(low[j], middle[j]);
+            CompareExchange(middle[j], high[j]);
+            CompareExchange(low[j], middle[j]);
+        }
+        for (size_t j = 0; j < length; ++j) {
+            uint8_t lows = std::max({low[j], low[j + channels], low[j + 2 * channels]});
+            uint8_t highs = std::min({high[j], high[j + channels], high[j + 2 * channels]});
+            row[j] = Median3(lows, Median3(middle[j], middle[j + channels], middle[j + 2 * channels]), highs);
+        }
+    });
+}
+
+void ApplyHistograms(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels,
+                     size_t radius) {
+    if (radius > MedianParameters::MAX_RADIUS) {
+        throw std::invalid_argument("the median radius is too large");
+    }
+    size_t width = source.width / channels;
+    if (width == 0) {
+        return;
+    }
+    int64_t signed_radius = static_cast<int64_t>(radius);
+    size_t rank = (2 * radius + 1) * (2 * radius + 1) / 2;
+    // Every strip fills its column histograms once, strips are made at least as high as the window.
+    Parallel::ForBlocks(
+        source.height,
+        [&](size_t begin, size_t end) {
+            for (size_t c = 0; c < channels; ++c) {
+                ChannelHistograms histograms(width);
+                int64_t first = static_cast<int64_t>(begin);
+                for (int64_t y = first - signed_radius; y <= first + signed_radius; ++y) {
+                    std::span<const uint8_t> row = ClampedRow(source, y);
+                    for (size_t x = 0; x < width; ++x) {
+                        histograms.AddToColumn(x, row[x * channels + c]);
+                    }
+                }
+                for (size_t y = begin; y < end; ++y) {
+                    if (y > begin) {
+                        int64_t signed_y = static_cast<int64_t>(y);
+                        std::span<const uint8_t> removed = ClampedRow(source, signed_y - signed_radius - 1);
+                        std::span<const uint8_t> added = ClampedRow(source, signed_y + signed_radius);
+                        for (size_t x = 0; x < width; ++x) {
+                            histograms.RemoveFromColumn(x, removed[x * channels + c]);
+                            histograms.AddToColumn(x, added[x * channels + c]);
+                        }
+                    }
+                    histograms.ResetWindow(radius);
+                    std::span<uint8_t> row = destination.Row(y);
+                    for (size_t x = 0; x < width; ++x) {
+                        if (x > 0) {
+                            int64_t signed_x = static_cast<int64_t>(x);
+                            histograms.MoveWindow(histograms.GetColumn(signed_x + signed_radius),
+                                                  histograms.GetColumn(signed_x - signed_radius - 1));
+                        }
+                        row[x * channels + c] = histograms.GetValue(rank);
+                    }
+                }
+            }
+        },
+        std::max(ParallelParameters::MIN_BLOCK_SIZE, 2 * radius + 1));
+}
+}  // namespace Median
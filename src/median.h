@@ -0,0 +1,38 @@
+#ifndef IMAGE_PROCESSOR_MEDIAN_H
+#define IMAGE_PROCESSOR_MEDIAN_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace MedianParameters {
+// Windows of up to (2 * 127 + 1)^2 pixels keep the histogram counts in 16 bits.
+const size_t MAX_RADIUS = 127;
+const size_t BINS = 256;
+// The coarse histogram counts the values by their high 4 bits.
+const size_t COARSE_BINS = 16;
+const size_t FINE_BINS = BINS / COARSE_BINS;
+}  // namespace MedianParameters
+
+// Medians over the (2 * radius + 1)^2 windows of 8-bit data, borders are extended by their closest elements.
+// source and destination hold channels interleaved channels per pixel (their width counts the channels),
+// every channel gets its own median. Both spread the rows over the threads in strips.
+namespace Median {
+// Picks the sorting network for radius 1 and the histograms otherwise.
+void Apply(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels, size_t radius);
+
+// Radius 1: a compare-exchange network sharing the sorted columns between the neighbouring windows.
+void ApplyNetwork(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels);
+
+// Perreault and Hebert's constant time median: every column keeps the histogram of its 2 * radius + 1 pixels
+// and moves down a row with one removal and one addition, the window's histogram moves right by adding
+// one column histogram and subtracting another. The work per pixel does not depend on the radius; the median
+// is found in the 16 coarse bins first and then in the 16 fine ones of the chosen coarse bin.
+void ApplyHistograms(MatrixView<const uint8_t> source, MatrixView<uint8_t> destination, size_t channels,
+                     size_t radius);
+}  // namespace Median
+
+#endif  // IMAGE_PROCESSOR_MEDIAN_H
@@ -0,0 +1,402 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace {
+using BitmapParameters::StorageFormat;
+
+size_t ToMebibytes(size_t bytes) {
+    return (bytes >> 20) + ((bytes & ((static_cast<size_t>(1) << 20) - 1)) != 0);
+}
+
+size_t GetPictureHeight(const Bitmap::DIBHeader& header) {
+    return static_cast<size_t>(std::abs(static_cast<int64_t>(header.height)));
+}
+
+// Whether a takes more bytes per pixel than b.
+bool IsWider(StorageFormat a, StorageFormat b) {
+    return MemoryBudget::GetStorageSize(a, BitMask::WORD_BITS, 1) >
+           MemoryBudget::GetStorageSize(b, BitMask::WORD_BITS, 1);
+}
+
+// Sum of the halos of the chain, UNBOUNDED_HALO if any of them is.
+size_t GetHaloSum(const std::vector<Manipulator*>& filters) {
+    size_t sum = 0;
+    for (const Manipulator* filter : filters) {
+        size_t halo = filter->GetHalo();
+        if (halo == ManipulatorParameters::UNBOUNDED_HALO || sum > ManipulatorParameters::UNBOUNDED_HALO - halo) {
+            return ManipulatorParameters::UNBOUNDED_HALO;
+        }
+        sum += halo;
+    }
+    return sum;
+}
+
+// The storage Bitmap::load keeps the pixels of header in.
+StorageFormat GetLoadFormat(const Bitmap::DIBHeader& header) {
+    if (header.bits_per_pixel == BitmapParameters::GREYSCALE_BITS_PER_PIXEL) {
+        return StorageFormat::Greyscale;
+    }
+    if (header.bits_per_pixel == BitmapParameters::MASK_BITS_PER_PIXEL) {
+        return StorageFormat::Mask;
+    }
+    return StorageFormat::Bytes;
+}
+
+// Peak of the filters applied to a width x height picture in format, precision receives the widest storage.
+size_t EstimateChainPeak(StorageFormat format, size_t width, size_t height, const std::vector<Manipulator*>& filters,
+                         StorageFormat& precision) {
+    precision = format;
+    size_t peak = MemoryBudget::GetStorageSize(format, width, height);
+    for (const Manipulator* filter : filters) {
+        StorageFormat run = Manipulator::ChooseFormat(filter->GetAcceptedFormats(), format,
+                                                      format == StorageFormat::Greyscale);
+        // A conversion holds the old storage next to the new one.
+        size_t converted = run != format ? MemoryBudget::GetStorageSize(format, width, height) : 0;
+        size_t before = MemoryBudget::GetStorageSize(run, width, height);
+        std::tie(width, height) = filter->GetOutputSize(width, height);
+        size_t after = MemoryBudget::GetStorageSize(run, width, height);
+        peak = std::max(peak, converted + before + MemoryBudgetParameters::WORKING_COPIES * std::max(before, after));
+        format = run;
+        if (IsWider(format, precision)) {
+            precision = format;
+        }
+    }
+    return peak;
+}
+
+// Peak of a strip of rows output rows of a picture in format, read with halo rows above and below it.
+size_t EstimateStripPeak(StorageFormat format, size_t width, size_t height, const std::vector<Manipulator*>& filters,
+                         size_t halo, size_t rows) {
+    StorageFormat precision;
+    return EstimateChainPeak(format, width, std::min(height, rows + 2 * std::min(halo, height)), filters, precision);
+}
+
+// The most rows per strip within budget, 0 if not even one row fits.
+size_t FitStripRows(StorageFormat format, size_t width, size_t height, const std::vector<Manipulator*>& filters,
+                    size_t budget) {
+    size_t halo = GetHaloSum(filters);
+    size_t low = 0;
+    size_t high = height;
+    while (low < high) {
+        size_t middle = low + (high - low + 1) / 2;
+        if (EstimateStripPeak(format, width, height, filters, halo, middle) <= budget) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+// The storages the filters of a Spill plan read their strips in: the input's, then what the previous filter left,
+// rounded to 8-bit if wider than spill_precision.
+std::vector<StorageFormat> GetSpillFormats(StorageFormat format, const std::vector<Manipulator*>& filters,
+                                           StorageFormat spill_precision) {
+    std::vector<StorageFormat> formats;
+    for (const Manipulator* filter : filters) {
+        formats.push_back(format);
+        format = Manipulator::ChooseFormat(filter->GetAcceptedFormats(), format, format == StorageFormat::Greyscale);
+        if (IsWider(format, spill_precision)) {
+            format = StorageFormat::Bytes;
+        }
+    }
+    return formats;
+}
+
+using ReadRows = std::function<bool(size_t first, size_t count, Bitmap& strip)>;
+using WriteRows = std::function<bool(size_t top, Bitmap& strip, size_t skip, size_t count)>;
+
+// Streams height rows through the filters strip_rows output rows at a time. read fills a strip with the rows
+// [first, first + count) of the source, write takes the rows [skip, skip + count) of the filtered strip as the rows
+// [top, top + count) of the result.
+bool RunStrips(size_t height, const std::vector<Manipulator*>& filters, size_t strip_rows, const ReadRows& read,
+               const WriteRows& write) {
+    size_t halo = GetHaloSum(filters);
+    for (size_t top = 0; top < height; top += strip_rows) {
+        size_t bottom = std::min(height, top + strip_rows);
+        size_t first = top - std::min(top, halo);
+        size_t last = bottom + std::min(height - bottom, halo);
+        Bitmap strip;
+        if (!read(first, last - first, strip)) {
+            return false;
+        }
+        for (const Manipulator* filter : filters) {
+            filter->ApplyToBitmap(strip);
+        }
+        if (!write(top, strip, top - first, bottom - top)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A picture between two filters of a Spill plan, kept in a file row by row in the storage the strips come in
+// (rounded to 8-bit if wider than the plan's spill precision), so the next filter reads back what it would have
+// been given in memory. A mask keeps its two colours in memory. The file is removed with the object.
+class SpillFile {
+public:
+    SpillFile(std::string path, StorageFormat spill_precision)
+        : path_(std::move(path)), spill_precision_(spill_precision) {
+    }
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+    ~SpillFile() {
+        file_.close();
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+    }
+
+    // Strips are written from the top down, the one of row 0 starts the picture afresh.
+    bool Write(size_t top, Bitmap& strip, size_t skip, size_t count) {
+        if (IsWider(strip.GetStorageFormat(), spill_precision_)) {
+            strip.Convert(StorageFormat::Bytes);
+        }
+        if (top == 0) {
+            file_.close();
+            file_.open(path_, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            format_ = strip.GetStorageFormat();
+            width_ = GetWidth(strip);
+            palette_ = strip.GetMaskPalette();
+        }
+        if (strip.GetStorageFormat() != format_ || GetWidth(strip) != width_) {
+            return false;
+        }
+        file_.seekp(static_cast<std::streamoff>(top * GetRowSize()));
+        std::vector<double> channels(width_ * VALUES_PER_PIXEL);
+        for (size_t y = skip; y < skip + count; ++y) {
+            if (format_ == StorageFormat::Bytes) {
+                WriteBlock(strip.GetBytes()->Row(y).data(), GetRowSize());
+            } else if (format_ == StorageFormat::Greyscale) {
+                WriteBlock(strip.GetGreyscale()->Row(y).data(), GetRowSize());
+            } else if (format_ == StorageFormat::Mask) {
+                WriteBlock(strip.GetMask()->GetRow(y), GetRowSize());
+            } else {
+                std::span<const Pixel> row = strip.GetData()->Row(y);
+                for (size_t x = 0; x < width_; ++x) {
+                    ColourValue value = row[x].GetColourValue();
+                    channels[VALUES_PER_PIXEL * x] = value.red;
+                    channels[VALUES_PER_PIXEL * x + 1] = value.green;
+                    channels[VALUES_PER_PIXEL * x + 2] = value.blue;
+                }
+                WriteBlock(channels.data(), GetRowSize());
+            }
+        }
+        return static_cast<bool>(file_);
+    }
+
+    bool Read(size_t first, size_t count, Bitmap& strip) {
+        file_.flush();
+        file_.seekg(static_cast<std::streamoff>(first * GetRowSize()));
+        if (format_ == StorageFormat::Bytes) {
+            Matrix<Bitmap::PrimitivePixel> rows(width_, count);
+            for (size_t y = 0; y < count; ++y) {
+                ReadBlock(rows.Row(y).data(), GetRowSize());
+            }
+            strip.SetBytes(std::move(rows));
+        } else if (format_ == StorageFormat::Greyscale) {
+            Matrix<ColourParameters::ColourType> rows(width_, count);
+            for (size_t y = 0; y < count; ++y) {
+                ReadBlock(rows.Row(y).data(), GetRowSize());
+            }
+            strip.SetGreyscale(std::move(rows));
+        } else if (format_ == StorageFormat::Mask) {
+            BitMask rows(width_, count);
+            for (size_t y = 0; y < count; ++y) {
+                ReadBlock(rows.GetRow(y), GetRowSize());
+            }
+            strip.SetMask(std::move(rows), palette_[0], palette_[1]);
+        } else {
+            Matrix<Pixel> rows(width_, count);
+            std::vector<double> channels(width_ * VALUES_PER_PIXEL);
+            for (size_t y = 0; y < count; ++y) {
+                ReadBlock(channels.data(), GetRowSize());
+                std::span<Pixel> row = rows.Row(y);
+                for (size_t x = 0; x < width_; ++x) {
+                    row[x] = Pixel(ColourValue{channels[VALUES_PER_PIXEL * x], channels[VALUES_PER_PIXEL * x + 1],
+                                               channels[VALUES_PER_PIXEL * x + 2]});
+                }
+            }
+            strip.SetData(std::move(rows));
+        }
+        return static_cast<bool>(file_);
+    }
+
+protected:
+    static const size_t VALUES_PER_PIXEL = 3;
+
+    static size_t GetWidth(Bitmap& strip) {
+        if (strip.GetStorageFormat() == StorageFormat::Mask) {
+            return strip.GetMask()->GetWidth();
+        }
+        if (strip.GetStorageFormat() == StorageFormat::Greyscale) {
+            return strip.GetGreyscale()->GetWidth();
+        }
+        if (strip.GetStorageFormat() == StorageFormat::Bytes) {
+            return strip.GetBytes()->GetWidth();
+        }
+        return strip.GetData()->GetWidth();
+    }
+    size_t GetRowSize() const {
+        if (format_ == StorageFormat::Colours) {
+            return width_ * VALUES_PER_PIXEL * sizeof(double);
+        }
+        return MemoryBudget::GetStorageSize(format_, width_, 1);
+    }
+    void WriteBlock(const void* block, size_t size) {
+        file_.write(static_cast<const char*>(block), static_cast<std::streamsize>(size));
+    }
+    void ReadBlock(void* block, size_t size) {
+        file_.read(static_cast<char*>(block), static_cast<std::streamsize>(size));
+    }
+
+    std::string path_;
+    StorageFormat spill_precision_;
+    std::fstream file_;
+    StorageFormat format_ = StorageFormat::Bytes;
+    size_t width_ = 0;
+    std::array<Pixel, BitmapParameters::MASK_PALETTE_SIZE> palette_;
+};
+}  // namespace
+
+namespace MemoryBudget {
+size_t GetStorageSize(StorageFormat format, size_t width, size_t height) {
+    switch (format) {
+        case StorageFormat::Bytes:
+            return width * height * sizeof(Bitmap::PrimitivePixel);
+        case StorageFormat::Colours:
+            return width * height * sizeof(Pixel);
+        case StorageFormat::Greyscale:
+            return width * height * sizeof(ColourParameters::ColourType);
+        case StorageFormat::Mask:
+            return (width + BitMask::WORD_BITS - 1) / BitMask::WORD_BITS * sizeof(BitMask::Word) * height;
+    }
+    return 0;
+}
+
+size_t EstimatePeak(const Bitmap::DIBHeader& header, const std::vector<Manipulator*>& filters, size_t min_width,
+                    size_t min_height, StorageFormat& precision) {
+    size_t width = header.width;
+    size_t height = GetPictureHeight(header);
+    // Bitmap::load keeps 24-bit files as bytes (box-reduced by whole factors if asked to), 8-bit ones as a
+    // plane at most and 1-bit ones as masks.
+    StorageFormat format = GetLoadFormat(header);
+    if (format == StorageFormat::Bytes) {
+        size_t factor_x = min_width == 0 ? 1 : std::max<size_t>(1, width / min_width);
+        size_t factor_y = min_height == 0 ? 1 : std::max<size_t>(1, height / min_height);
+        width = (width + factor_x - 1) / factor_x;
+        height = (height + factor_y - 1) / factor_y;
+    }
+    return EstimateChainPeak(format, width, height, filters, precision);
+}
+
+Plan MakePlan(const Bitmap::DIBHeader& header, const std::vector<Manipulator*>& filters, size_t budget,
+              bool can_stream, size_t min_width, size_t min_height) {
+    using MemoryBudgetParameters::Strategy;
+    Plan plan{Strategy::InMemory, StorageFormat::Bytes, StorageFormat::Bytes, 0, 0};
+    plan.peak = EstimatePeak(header, filters, min_width, min_height, plan.precision);
+    plan.spill_precision = plan.precision;
+    if (plan.peak <= budget) {
+        return plan;
+    }
+    size_t width = header.width;
+    size_t height = GetPictureHeight(header);
+    bool is_streamable = can_stream && header.bits_per_pixel == BitmapParameters::COLOUR_BITS_PER_PIXEL;
+    for (const Manipulator* filter : filters) {
+        is_streamable = is_streamable && filter->GetHalo() != ManipulatorParameters::UNBOUNDED_HALO &&
+                        filter->GetOutputSize(width, height) == std::make_pair(width, height);
+    }
+    if (is_streamable) {
+        size_t least = std::min(height, MemoryBudgetParameters::MIN_STRIP_ROWS);
+        size_t rows = FitStripRows(StorageFormat::Bytes, width, height, filters, budget);
+        if (rows >= least) {
+            plan.strategy = Strategy::Strips;
+            plan.strip_rows = rows;
+            plan.peak = EstimateStripPeak(StorageFormat::Bytes, width, height, filters, GetHaloSum(filters), rows);
+            return plan;
+        }
+        // Filter by filter the strips only need the halo of one of them. The pictures between the filters are
+        // spilled at the precision they are filtered at, or rounded to 8-bit if only the smaller strips fit.
+        for (StorageFormat spill_precision : {plan.precision, StorageFormat::Bytes}) {
+            std::vector<StorageFormat> formats = GetSpillFormats(StorageFormat::Bytes, filters, spill_precision);
+            rows = height;
+            for (size_t i = 0; i < filters.size(); ++i) {
+                rows = std::min(rows, FitStripRows(formats[i], width, height, {filters[i]}, budget));
+            }
+            if (filters.empty() || rows < least) {
+                continue;
+            }
+            plan.strategy = Strategy::Spill;
+            plan.spill_precision = spill_precision;
+            plan.strip_rows = rows;
+            plan.peak = 0;
+            for (size_t i = 0; i < filters.size(); ++i) {
+                plan.peak = std::max(plan.peak, EstimateStripPeak(formats[i], width, height, {filters[i]},
+                                                                  filters[i]->GetHalo(), rows));
+            }
+            return plan;
+        }
+    }
+    throw std::runtime_error("the picture needs about " + std::to_string(ToMebibytes(plan.peak)) +
+                             " MiB in memory, more than the " + std::to_string(ToMebibytes(budget)) +
+                             " MiB allowed, " +
+                             (is_streamable ? "and even the strips of the filters do not fit"
+                                            : "and the filters or the files cannot be streamed in strips"));
+}
+
+bool Stream(const Plan& plan, const std::string& input, const std::string& output,
+            const std::vector<Manipulator*>& filters) {
+    if (plan.strategy == MemoryBudgetParameters::Strategy::InMemory) {
+        throw std::logic_error("plans in memory are not streamed");
+    }
+    BitmapRowReader reader;
+    BitmapRowWriter writer;
+    if (!reader.Open(input.c_str()) || !writer.Open(output.c_str(), reader.GetHeader())) {
+        return false;
+    }
+    ReadRows read_input = [&reader](size_t first, size_t count, Bitmap& strip) {
+        Matrix<Bitmap::PrimitivePixel> rows(reader.GetWidth(), count);
+        if (!reader.Read(first, rows)) {
+            return false;
+        }
+        strip.SetBytes(std::move(rows));
+        return true;
+    };
+    WriteRows write_output = [&writer](size_t top, Bitmap& strip, size_t skip, size_t count) {
+        Matrix<Bitmap::PrimitivePixel>& rows = *strip.GetBytes();
+        rows.Crop(0, skip, rows.GetWidth(), count);
+        return writer.Write(top, rows);
+    };
+    if (plan.strategy == MemoryBudgetParameters::Strategy::Strips) {
+        return RunStrips(reader.GetHeight(), filters, plan.strip_rows, read_input, write_output);
+    }
+    // The pictures between the filters alternate between two files.
+    SpillFile spilled[] = {{output + ".spill0", plan.spill_precision}, {output + ".spill1", plan.spill_precision}};
+    for (size_t i = 0; i < filters.size(); ++i) {
+        ReadRows read = read_input;
+        if (i > 0) {
+            SpillFile& source = spilled[(i - 1) % 2];
+            read = [&source](size_t first, size_t count, Bitmap& strip) { return source.Read(first, count, strip); };
+        }
+        WriteRows write = write_output;
+        if (i + 1 < filters.size()) {
+            SpillFile& target = spilled[i % 2];
+            write = [&target](size_t top, Bitmap& strip, size_t skip, size_t count) {
+                return target.Write(top, strip, skip, count);
+            };
+        }
+        if (!RunStrips(reader.GetHeight(), {filters[i]}, plan.strip_rows, read, write)) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace MemoryBudget
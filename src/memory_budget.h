@@ -0,0 +1,63 @@
+#ifndef IMAGE_PROCESSOR_MEMORY_BUDGET_H
+#define IMAGE_PROCESSOR_MEMORY_BUDGET_H
+
+#include "bitmap.h"
+#include "image_manipulators.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace MemoryBudgetParameters {
+// The whole picture in memory; strips streamed from the input file through the whole chain to the output file;
+// strips streamed through one filter at a time, the pictures between the filters spilled to files.
+enum class Strategy { InMemory, Strips, Spill };
+// Pictures of its storage a filter may hold at once besides its input: its result and a working copy (e.g. the
+// ColourValues a convolution runs on).
+const size_t WORKING_COPIES = 2;
+// Strips of fewer rows (unless the picture itself is shorter) are not worth streaming: the rows of the halos
+// would be read and filtered again and again.
+const size_t MIN_STRIP_ROWS = 16;
+}  // namespace MemoryBudgetParameters
+
+// Chooses how to run a filter chain within a memory budget from the headers of the input alone, before any pixel
+// is read. The estimates follow the storages Manipulator::ApplyToBitmap would run every filter on.
+namespace MemoryBudget {
+struct Plan {
+    MemoryBudgetParameters::Strategy strategy;
+    // The widest storage the filters keep the pictures in: Bytes and Mask are 8-bit, Greyscale and Colours double.
+    BitmapParameters::StorageFormat precision;
+    // The widest storage the pictures between the filters of a Spill plan are kept in: precision, so the result is
+    // that of the whole picture, or Bytes if only strips starting from 8-bit pictures fit, the pictures between
+    // the filters then being rounded as a 24-bit file would round them.
+    BitmapParameters::StorageFormat spill_precision;
+    // Estimated peak in bytes.
+    size_t peak;
+    // Rows written per strip by Strips and Spill.
+    size_t strip_rows;
+};
+
+size_t GetStorageSize(BitmapParameters::StorageFormat format, size_t width, size_t height);
+
+// Peak memory of the filters applied to the picture of header in memory, the picture being box-reduced while
+// loaded as Bitmap::load(file, min_width, min_height) does. precision receives the widest storage on the way.
+size_t EstimatePeak(const Bitmap::DIBHeader& header, const std::vector<Manipulator*>& filters, size_t min_width,
+                    size_t min_height, BitmapParameters::StorageFormat& precision);
+
+// The first strategy fitting into budget bytes: in memory, strips, spilling at the precision of the filters, or
+// spilling rounded to 8-bit. Streaming needs a 24-bit input,
+// filters of bounded halos keeping the size and can_stream (a single 24-bit output). Throws std::runtime_error
+// naming the estimate if nothing fits.
+Plan MakePlan(const Bitmap::DIBHeader& header, const std::vector<Manipulator*>& filters, size_t budget,
+              bool can_stream, size_t min_width = 0, size_t min_height = 0);
+
+// Runs a Strips or Spill plan (std::logic_error for the others) from the input file to the output file, false if
+// a file cannot be read or written.
+// Every strip is read with the rows within the sum of the halos above and below it, so it comes out as it would
+// from the whole picture. Spilled pictures are kept next to the output in the storage the filters leave them in
+// (see Plan::spill_precision) and removed afterwards.
+bool Stream(const Plan& plan, const std::string& input, const std::string& output,
+            const std::vector<Manipulator*>& filters);
+}  // namespace MemoryBudget
+
+#endif  // IMAGE_PROCESSOR_MEMORY_BUDGET_H
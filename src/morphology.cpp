@@ -0,0 +1,105 @@
+#include "morphology.h"
+
+#include <cstdint>
+
+namespace {
+using Word = BitMask::Word;
+
+// result's bit b is row's bit b + shift, the bits from beyond the row are those of fill.
+void Shift(const std::vector<Word>& row, int64_t shift, Word fill, std::vector<Word>& result) {
+    const int64_t word_bits = static_cast<int64_t>(BitMask::WORD_BITS);
+    int64_t words = shift >= 0 ? shift / word_bits : -((-shift + word_bits - 1) / word_bits);
+    int64_t bits = shift - words * word_bits;
+    int64_t size = static_cast<int64_t>(row.size());
+    auto get = [&](int64_t i) { return i < 0 || i >= size ? fill : row[static_cast<size_t>(i)]; };
+    result.resize(row.size());
+    for (int64_t i = 0; i < size; ++i) {
+        Word low = get(i + words);
+        result[static_cast<size_t>(i)] = bits == 0 ? low : (low >> bits) | (get(i + words + 1) << (word_bits - bits));
+    }
+}
+
+// Both passes over the mask, identity being the fill beyond the borders.
+template <typename Select>
+BitMask MaskExtremum(const BitMask& source, Morphology::Window horizontal, Morphology::Window vertical, Word identity,
+                     Select select) {
+    size_t width = source.GetWidth();
+    size_t words = source.GetWordsPerRow();
+    if (width == 0) {
+        return source;
+    }
+    // The unused bits of every row's last word: they are identity while filtering and zero afterwards.
+    Word tail = width % BitMask::WORD_BITS == 0 ? 0 : ~static_cast<Word>(0) << (width % BitMask::WORD_BITS);
+    BitMask rows(width, source.GetHeight());
+    Parallel::ForBlocks(source.GetHeight(), [&](size_t begin, size_t end) {
+        // The row between pads wider than the window, then the windows of 1, 2, 4 ... pixels starting at every
+        // pixel, the last one overlapping the largest power of two to the window's size.
+        size_t pad = horizontal.size / BitMask::WORD_BITS + 1;
+        std::vector<Word> spans(words + 2 * pad);
+        std::vector<Word> shifted;
+        for (size_t y = begin; y < end; ++y) {
+            std::fill(spans.begin(), spans.end(), identity);
+            std::copy(source.GetRow(y), source.GetRow(y) + words, spans.begin() + static_cast<std::ptrdiff_t>(pad));
+            spans[pad + words - 1] = (spans[pad + words - 1] & ~tail) | (identity & tail);
+            size_t span = 1;
+            for (; 2 * span <= horizontal.size; span *= 2) {
+                Shift(spans, static_cast<int64_t>(span), identity, shifted);
+                for (size_t i = 0; i < spans.size(); ++i) {
+                    spans[i] = select(spans[i], shifted[i]);
+                }
+            }
+            if (span < horizontal.size) {
+                Shift(spans, static_cast<int64_t>(horizontal.size - span), identity, shifted);
+                for (size_t i = 0; i < spans.size(); ++i) {
+                    spans[i] = select(spans[i], shifted[i]);
+                }
+            }
+            Shift(spans, -static_cast<int64_t>(horizontal.before), identity, shifted);
+            Word* row = rows.GetRow(y);
+            std::copy(shifted.begin() + static_cast<std::ptrdiff_t>(pad),
+                      shifted.begin() + static_cast<std::ptrdiff_t>(pad + words), row);
+            row[words - 1] &= ~tail;
+        }
+    });
+    BitMask result(width, source.GetHeight());
+    const BitMask& passed = rows;
+    Parallel::ForBlocks(
+        words,
+        [&](size_t begin, size_t end) {
+            std::vector<Word> prefix;
+            std::vector<Word> suffix;
+            for (size_t x = begin; x < end; x += MorphologyParameters::COLUMN_CHUNK) {
+                Morphology::Pass(passed.GetRow(0) + x, words, result.GetRow(0) + x, words, source.GetHeight(),
+                                 std::min(MorphologyParameters::COLUMN_CHUNK, end - x), vertical, identity, select,
+                                 prefix, suffix);
+            }
+        },
+        1);
+    return result;
+}
+}  // namespace
+
+namespace Morphology {
+BitMask Erode(const BitMask& source, Window horizontal, Window vertical) {
+    return MaskExtremum(source, horizontal, vertical, ~static_cast<Word>(0), [](Word a, Word b) { return a & b; });
+}
+
+BitMask Dilate(const BitMask& source, Window horizontal, Window vertical) {
+    return MaskExtremum(source, horizontal, vertical, static_cast<Word>(0), [](Word a, Word b) { return a | b; });
+}
+
+BitMask Apply(MorphologyParameters::Operation operation, const BitMask& source, Window horizontal, Window vertical) {
+    using MorphologyParameters::Operation;
+    switch (operation) {
+        case Operation::Erode:
+            return Erode(source, horizontal, vertical);
+        case Operation::Dilate:
+            return Dilate(source, horizontal, vertical);
+        case Operation::Open:
+            return Dilate(Erode(source, horizontal, vertical), horizontal.Reflected(), vertical.Reflected());
+        case Operation::Close:
+            return Erode(Dilate(source, horizontal, vertical), horizontal.Reflected(), vertical.Reflected());
+    }
+    return source;
+}
+}  // namespace Morphology
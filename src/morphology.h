@@ -0,0 +1,158 @@
+#ifndef IMAGE_PROCESSOR_MORPHOLOGY_H
+#define IMAGE_PROCESSOR_MORPHOLOGY_H
+
+#include "bit_mask.h"
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace MorphologyParameters {
+enum class Operation { Erode, Dilate, Open, Close };
+// Columns (in elements) a thread runs down the picture at once: the buffers of the column pass stay in cache.
+const size_t COLUMN_CHUNK = 256;
+// Longest side of a rectangle: the passes pad every line by the side, longer ones cover any picture anyway.
+const size_t MAX_SIZE = static_cast<size_t>(1) << 16;
+}  // namespace MorphologyParameters
+
+// Erosion and dilation by rectangles, separated into a pass along the rows and one along the columns. Both
+// passes use van Herk and Gil-Werman's algorithm: the line is cut into blocks of the window's size, the running
+// extrema from the left and from the right of every block are kept, and every window, covering the end of one
+// block and the start of the next, takes the extremum of two of them. That is about three comparisons per
+// element whatever the size. Pixels beyond the borders are ignored.
+namespace Morphology {
+// size positions, before of them preceding the filtered one.
+struct Window {
+    size_t before;
+    size_t size;
+
+    // Window of the given size centred on the position, the extra position of even sizes goes before it.
+    static Window Centred(size_t size) {
+        return {size / 2, size};
+    }
+    // The mirrored window, for undoing an erosion by a dilation (opening) and back (closing).
+    Window Reflected() const {
+        return {size - 1 - before, size};
+    }
+};
+
+// One pass along length positions of lanes contiguous elements each, the positions lie source_stride and
+// destination_stride elements apart. identity is the value select never prefers (the pad beyond the ends).
+template <typename ElementType, typename Select>
+void Pass(const ElementType* source, size_t source_stride, ElementType* destination, size_t destination_stride,
+          size_t length, size_t lanes, Window window, ElementType identity, Select select,
+          std::vector<ElementType>& prefix, std::vector<ElementType>& suffix) {
+    size_t size = window.size;
+    size_t extended = length + size - 1;
+    prefix.assign(extended * lanes, identity);
+    for (size_t i = 0; i < length; ++i) {
+        std::copy(source + i * source_stride, source + i * source_stride + lanes,
+                  prefix.begin() + static_cast<std::ptrdiff_t>((i + window.before) * lanes));
+    }
+    suffix = prefix;
+    for (size_t i = 1; i < extended; ++i) {
+        if (i % size == 0) {
+            continue;
+        }
+        ElementType* current = prefix.data() + i * lanes;
+        const ElementType* previous = current - lanes;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            current[lane] = select(previous[lane], current[lane]);
+        }
+    }
+    for (size_t i = extended - 1; i-- > 0;) {
+        if ((i + 1) % size == 0) {
+            continue;
+        }
+        ElementType* current = suffix.data() + i * lanes;
+        const ElementType* next = current + lanes;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            current[lane] = select(next[lane], current[lane]);
+        }
+    }
+    for (size_t i = 0; i < length; ++i) {
+        const ElementType* left = suffix.data() + i * lanes;
+        const ElementType* right = prefix.data() + (i + size - 1) * lanes;
+        ElementType* row = destination + i * destination_stride;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            row[lane] = select(left[lane], right[lane]);
+        }
+    }
+}
+
+// Rows of interleaved channels (the width counts the channels), every channel separately. The rows are spread
+// over the threads for the first pass and the columns for the second.
+template <typename ElementType, typename Select>
+void Extremum(MatrixView<const ElementType> source, MatrixView<ElementType> destination, size_t channels,
+              Window horizontal, Window vertical, ElementType identity, Select select) {
+    if (source.width == 0 || source.height == 0) {
+        return;
+    }
+    Matrix<ElementType> rows(source.width, source.height);
+    Parallel::ForBlocks(source.height, [&](size_t begin, size_t end) {
+        std::vector<ElementType> prefix;
+        std::vector<ElementType> suffix;
+        for (size_t y = begin; y < end; ++y) {
+            Pass(source.Row(y).data(), channels, rows.Row(y).data(), channels, source.width / channels, channels,
+                 horizontal, identity, select, prefix, suffix);
+        }
+    });
+    MatrixView<const ElementType> passed = static_cast<const Matrix<ElementType>&>(rows).GetView();
+    Parallel::ForBlocks(source.width, [&](size_t begin, size_t end) {
+        std::vector<ElementType> prefix;
+        std::vector<ElementType> suffix;
+        for (size_t x = begin; x < end; x += MorphologyParameters::COLUMN_CHUNK) {
+            Pass(passed.data + x, passed.stride, destination.data + x, destination.stride, source.height,
+                 std::min(MorphologyParameters::COLUMN_CHUNK, end - x), vertical, identity, select, prefix, suffix);
+        }
+    });
+}
+
+template <typename ElementType>
+void Erode(MatrixView<const ElementType> source, MatrixView<ElementType> destination, size_t channels,
+           Window horizontal, Window vertical) {
+    Extremum(source, destination, channels, horizontal, vertical, std::numeric_limits<ElementType>::max(),
+             [](ElementType a, ElementType b) { return std::min(a, b); });
+}
+
+template <typename ElementType>
+void Dilate(MatrixView<const ElementType> source, MatrixView<ElementType> destination, size_t channels,
+            Window horizontal, Window vertical) {
+    Extremum(source, destination, channels, horizontal, vertical, std::numeric_limits<ElementType>::lowest(),
+             [](ElementType a, ElementType b) { return std::max(a, b); });
+}
+
+// Opening is the erosion followed by the dilation by the reflected rectangle, closing the other way round.
+template <typename ElementType>
+void Apply(MorphologyParameters::Operation operation, MatrixView<const ElementType> source,
+           MatrixView<ElementType> destination, size_t channels, Window horizontal, Window vertical) {
+    using MorphologyParameters::Operation;
+    if (operation == Operation::Erode) {
+        Erode(source, destination, channels, horizontal, vertical);
+    } else if (operation == Operation::Dilate) {
+        Dilate(source, destination, channels, horizontal, vertical);
+    } else {
+        Matrix<ElementType> first(source.width, source.height);
+        MatrixView<const ElementType> passed = static_cast<const Matrix<ElementType>&>(first).GetView();
+        if (operation == Operation::Open) {
+            Erode(source, first.GetView(), channels, horizontal, vertical);
+            Dilate(passed, destination, channels, horizontal.Reflected(), vertical.Reflected());
+        } else {
+            Dilate(source, first.GetView(), channels, horizontal, vertical);
+            Erode(passed, destination, channels, horizontal.Reflected(), vertical.Reflected());
+        }
+    }
+}
+
+// Erosion and dilation of the set bits of a packed mask. The column pass is the same algorithm on whole words,
+// 64 pixels at once; along the rows the windows are built by doubling shifts of the row, log2(size) word
+// operations per 64 pixels.
+BitMask Erode(const BitMask& source, Window horizontal, Window vertical);
+BitMask Dilate(const BitMask& source, Window horizontal, Window vertical);
+BitMask Apply(MorphologyParameters::Operation operation, const BitMask& source, Window horizontal, Window vertical);
+}  // namespace Morphology
+
+#endif  // IMAGE_PROCESSOR_MORPHOLOGY_H
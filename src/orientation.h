@@ -0,0 +1,94 @@
+#ifndef IMAGE_PROCESSOR_ORIENTATION_H
+#define IMAGE_PROCESSOR_ORIENTATION_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace OrientationParameters {
+// Rotations are clockwise, the transposition mirrors the picture in its main diagonal.
+enum class Operation { FlipHorizontal, FlipVertical, Rotate90, Rotate180, Rotate270, Transpose };
+// Tiles of at most this many elements per side are copied directly, larger ones are split.
+const size_t TILE_SIZE = 16;
+}  // namespace OrientationParameters
+
+namespace Orientation {
+// Whether the operation swaps the width and the height.
+inline bool IsTransposing(OrientationParameters::Operation operation) {
+    using OrientationParameters::Operation;
+    return operation == Operation::Rotate90 || operation == Operation::Rotate270 ||
+           operation == Operation::Transpose;
+}
+
+// Copies source placing its element (x, y) at origin[x * x_step + y * y_step]. The region is halved along its
+// longer side until the tiles are small: a cache-oblivious order in which the rows read and the columns written
+// stay in cache at every level of it, whatever the cache sizes are.
+template <typename ElementType>
+void Scatter(MatrixView<const ElementType> source, ElementType* origin, std::ptrdiff_t x_step, std::ptrdiff_t y_step) {
+    if (source.width <= OrientationParameters::TILE_SIZE && source.height <= OrientationParameters::TILE_SIZE) {
+        for (size_t y = 0; y < source.height; ++y) {
+            const ElementType* row = source.Row(y).data();
+            ElementType* target = origin + static_cast<std::ptrdiff_t>(y) * y_step;
+            for (size_t x = 0; x < source.width; ++x) {
+                target[static_cast<std::ptrdiff_t>(x) * x_step] = row[x];
+            }
+        }
+    } else if (source.width >= source.height) {
+        size_t half = source.width / 2;
+        Scatter(source.SubView(0, 0, half, source.height), origin, x_step, y_step);
+        Scatter(source.SubView(half, 0, source.width - half, source.height),
+                origin + static_cast<std::ptrdiff_t>(half) * x_step, x_step, y_step);
+    } else {
+        size_t half = source.height / 2;
+        Scatter(source.SubView(0, 0, source.width, half), origin, x_step, y_step);
+        Scatter(source.SubView(0, half, source.width, source.height - half),
+                origin + static_cast<std::ptrdiff_t>(half) * y_step, x_step, y_step);
+    }
+}
+
+// The reoriented copy of source. Flips and the half turn move whole rows, read forwards and written
+// forwards or backwards; the transposing orientations go through Scatter in bands of rows, one per thread.
+template <typename ElementType>
+Matrix<ElementType> Apply(OrientationParameters::Operation operation, MatrixView<const ElementType> source) {
+    using OrientationParameters::Operation;
+    size_t width = source.width;
+    size_t height = source.height;
+    if (!IsTransposing(operation)) {
+        Matrix<ElementType> result(width, height);
+        result.ForEachRow([&](size_t y, std::span<ElementType> row) {
+            bool upside_down = operation == Operation::FlipVertical || operation == Operation::Rotate180;
+            std::span<const ElementType> source_row = source.Row(upside_down ? height - y - 1 : y);
+            if (operation == Operation::FlipVertical) {
+                std::copy(source_row.begin(), source_row.end(), row.begin());
+            } else {
+                std::reverse_copy(source_row.begin(), source_row.end(), row.begin());
+            }
+        });
+        return result;
+    }
+    Matrix<ElementType> result(height, width);
+    if (result.GetWidth() == 0) {
+        return result;
+    }
+    std::ptrdiff_t stride = static_cast<std::ptrdiff_t>(result.GetView().stride);
+    ElementType* origin = result.GetView().data;
+    std::ptrdiff_t x_step = stride;
+    std::ptrdiff_t y_step = 1;
+    if (operation == Operation::Rotate90) {
+        origin += height - 1;
+        y_step = -1;
+    } else if (operation == Operation::Rotate270) {
+        origin += static_cast<std::ptrdiff_t>(width - 1) * stride;
+        x_step = -stride;
+    }
+    Parallel::ForBlocks(height, [&](size_t begin, size_t end) {
+        Scatter(source.SubView(0, begin, width, end - begin), origin + static_cast<std::ptrdiff_t>(begin) * y_step,
+                x_step, y_step);
+    });
+    return result;
+}
+}  // namespace Orientation
+
+#endif  // IMAGE_PROCESSOR_ORIENTATION_H
@@ -0,0 +1,43 @@
+#ifndef IMAGE_PROCESSOR_PARALLEL_H
+#define IMAGE_PROCESSOR_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace ParallelParameters {
+// Ranges shorter than this per thread are not worth a thread.
+const size_t MIN_BLOCK_SIZE = 16;
+}  // namespace ParallelParameters
+
+namespace Parallel {
+inline size_t GetThreadCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Splits [0, size) into contiguous blocks and calls function(begin, end) for each of them concurrently,
+// the calling thread takes the last block. Exceptions are rethrown after every block is done.
+// Items heavier than a row (e.g. whole tiles) may lower min_block_size.
+template <typename Function>
+void ForBlocks(size_t size, Function function, size_t min_block_size = ParallelParameters::MIN_BLOCK_SIZE) {
+    size_t blocks = std::min(GetThreadCount(), size / min_block_size);
+    if (blocks <= 1) {
+        if (size > 0) {
+            function(static_cast<size_t>(0), size);
+        }
+        return;
+    }
+    std::vector<std::future<void>> futures;
+    for (size_t block = 0; block + 1 < blocks; ++block) {
+        futures.push_back(std::async(std::launch::async, function, size * block / blocks, size * (block + 1) / blocks));
+    }
+    function(size * (blocks - 1) / blocks, size);
+    for (std::future<void>& future : futures) {
+        future.get();
+    }
+}
+}  // namespace Parallel
+
+#endif  // IMAGE_PROCESSOR_PARALLEL_H
@@ -17,6 +17,10 @@ Pixel::Pixel(ColourParameters::ColourType value) {
     blue_ = norm_value;
 }
 
+Pixel::Pixel(const ColourValue& value)
+    : scheme_(ColourParameters::ColourSchemes::RGB), red_(value.red), green_(value.green), blue_(value.blue) {
+}
+
 std::string Pixel::info() const {
     std::string info_temp;
     info_temp += "Red: " + std::to_string(red_) + "\n";
@@ -109,8 +113,8 @@ void Pixel::Copy(const Pixel &other) {
 }
 
 bool Pixel::operator==(const Pixel &other) const {
-    return abs(red_ - other.red_) < ColourParameters::EPS && abs(green_ - other.green_) < ColourParameters::EPS &&
-           abs(blue_ - other.blue_) < ColourParameters::EPS;  // obnoxious doubles
+    return std::abs(red_ - other.red_) < ColourParameters::EPS && std::abs(green_ - other.green_) < ColourParameters::EPS &&
+           std::abs(blue_ - other.blue_) < ColourParameters::EPS;  // obnoxious doubles
 }
 
 bool Pixel::operator!=(const Pixel &other) const {
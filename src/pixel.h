@@ -2,6 +2,9 @@
 #define IMAGE_PROCESSOR_PIXEL_H
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <string>
 
 namespace ColourParameters {
@@ -11,13 +14,57 @@ namespace ColourParameters {
         RGB,
         Void
     };
-    const double EPS = std::numeric_limits<double>::epsilon();
+    const double EPS = 1e-9;  // far below 8-bit quantisation, far above rounding noise of a convolution
+
+    // 8-bit channel <-> [0, 1] colour, exact round trip for every byte.
+    inline ColourType FromByte(uint8_t value) {
+        return value / 255.0;
+    }
+    inline uint8_t ToByte(ColourType value) {
+        return static_cast<uint8_t>(std::round(std::clamp(value, 0.0, 1.0) * 255));
+    }
 }
 
 namespace PixelParameters {
     using Scalar = double;
 }
 
+// Plain three-channel value for hot loops: trivially copyable, no scheme tag, inline arithmetic without branches
+// and no clamping unless Saturated() is asked for. Pixel converts to and from it.
+struct ColourValue {
+    ColourParameters::ColourType red;
+    ColourParameters::ColourType green;
+    ColourParameters::ColourType blue;
+
+    constexpr ColourValue operator+(const ColourValue& other) const {
+        return {red + other.red, green + other.green, blue + other.blue};
+    }
+    constexpr ColourValue operator-(const ColourValue& other) const {
+        return {red - other.red, green - other.green, blue - other.blue};
+    }
+    constexpr ColourValue operator*(PixelParameters::Scalar l) const {
+        return {red * l, green * l, blue * l};
+    }
+    constexpr ColourValue& operator+=(const ColourValue& other) {
+        red += other.red;
+        green += other.green;
+        blue += other.blue;
+        return *this;
+    }
+    constexpr ColourValue& operator*=(PixelParameters::Scalar l) {
+        red *= l;
+        green *= l;
+        blue *= l;
+        return *this;
+    }
+    // Channels clamped to [0, 1].
+    ColourValue Saturated() const {
+        return {std::clamp(red, 0.0, 1.0), std::clamp(green, 0.0, 1.0), std::clamp(blue, 0.0, 1.0)};
+    }
+
+    bool operator==(const ColourValue& other) const = default;
+};
+
 class Pixel {
 public:
 
@@ -28,6 +75,7 @@ public:
           ColourParameters::ColourType blue,
           ColourParameters::ColourSchemes scheme = ColourParameters::ColourSchemes::Greyscale);
     Pixel(const Pixel &other);
+    explicit Pixel(const ColourValue& value);
 
     std::string info() const;
     Pixel InGrayScalePixel() const;
@@ -63,6 +111,9 @@ public:
     bool operator!=(const Pixel& other) const;
 
     ColourParameters::ColourType GetValue() const;
+    ColourValue GetColourValue() const {
+        return {red_, green_, blue_};
+    }
 
     ColourParameters::ColourType GetRed() const;
     ColourParameters::ColourType GetGreen() const;
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "simd.h"
+
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+namespace PolyParameters {
+// Span evaluations run over blocks of this many points: the inner loops then have no dependencies between points
+// and run on vectors (Simd for doubles, the compiler's vectorisation for other types).
+const size_t EVALUATION_BLOCK = 64;
+}  // namespace PolyParameters
+
 template <typename NumType>
 class Poly {
 public:
@@ -40,7 +52,9 @@ public:
             lhv_coef[it->first] = it->second;
         }
     }
-    Poly(Poly&& rhv) = default;
+    Poly(Poly&& rhv) {
+        std::swap(poly_coefficients_, rhv.poly_coefficients_);
+    }
 
     ~Poly() {
         delete poly_coefficients_;
@@ -122,7 +136,10 @@ public:
         }
     }
 
-    Poly& operator=(Poly&& rhv) = default;
+    Poly& operator=(Poly&& rhv) {
+        std::swap(poly_coefficients_, rhv.poly_coefficients_);
+        return *this;
+    }
 
     Poly operator-() const {
         Poly answer;
@@ -165,6 +182,19 @@ public:
         return poly_coefficients_;
     }
 
+    const std::map<size_t, NumType>* GetCoefficientsTable() const {
+        return poly_coefficients_;
+    }
+
+    // Coefficient of x^i at i, up to the degree.
+    std::vector<NumType> GetDenseCoefficients() const {
+        std::vector<NumType> answer(poly_coefficients_->empty() ? 0 : poly_coefficients_->rbegin()->first + 1);
+        for (const auto& [degree, coefficient] : *poly_coefficients_) {
+            answer[degree] = coefficient;
+        }
+        return answer;
+    }
+
 protected:
     std::map<size_t, NumType>* poly_coefficients_ = nullptr;
 
@@ -223,6 +253,58 @@ protected:
     }
 };
 
+// Dense copy of a Poly for evaluation: no map walks, Horner's scheme over a plain array.
+template <typename NumType>
+class HornerPolynomial {
+public:
+    HornerPolynomial() = default;
+
+    explicit HornerPolynomial(const Poly<NumType>& poly) : coefficients_(poly.GetDenseCoefficients()) {
+    }
+
+    explicit HornerPolynomial(std::vector<NumType> coefficients) : coefficients_(std::move(coefficients)) {
+    }
+
+    NumType operator()(NumType x) const {
+        NumType answer{};
+        for (auto it = coefficients_.rbegin(); it != coefficients_.rend(); ++it) {
+            answer = answer * x + *it;
+        }
+        return answer;
+    }
+
+    // output[i] = P(input[i]), the spans may coincide.
+    void Evaluate(std::span<const NumType> input, std::span<NumType> output) const {
+        if (input.size() != output.size()) {
+            throw std::length_error("input and output spans differ in size");
+        }
+        NumType answers[PolyParameters::EVALUATION_BLOCK];
+        for (size_t begin = 0; begin < input.size(); begin += PolyParameters::EVALUATION_BLOCK) {
+            size_t size = std::min(PolyParameters::EVALUATION_BLOCK, input.size() - begin);
+            const NumType* x = input.data() + begin;
+            std::fill(answers, answers + size, NumType{});
+            for (auto it = coefficients_.rbegin(); it != coefficients_.rend(); ++it) {
+                const NumType coefficient = *it;
+                if constexpr (std::is_same_v<NumType, double>) {
+                    Simd::HornerStep(answers, x, coefficient, size);
+                } else {
+                    for (size_t i = 0; i < size; ++i) {
+                        answers[i] = answers[i] * x[i] + coefficient;
+                    }
+                }
+            }
+            std::copy(answers, answers + size, output.begin() + static_cast<std::ptrdiff_t>(begin));
+        }
+    }
+
+    const std::vector<NumType>& GetCoefficients() const {
+        return coefficients_;
+    }
+
+protected:
+    std::vector<NumType> coefficients_;
+};
+
 // Интерполяция многочленом Лагранжа: делается предподсчёт многочлена Лагранжа, считает значение функции.
 // Сложность: O(n^3) на конструкцию, O(n*g(n)) на подсчёт функции в точке (g(n) - на умножение, в нынешней реализации -
 // - O(1)).
@@ -232,21 +314,21 @@ public:
     PixelLagrangePolynomial() : Poly<Coefficients>(){};
 
     explicit PixelLagrangePolynomial(const std::vector<Coefficients>& x, const std::vector<Coefficients>& y)
-        : Poly<Coefficients>({0, 1}) {
+        : Poly<Coefficients>(std::vector<Coefficients>{0, 1}) {
         size_t size = x.size();
         if (size > 0) {
-            Poly<Coefficients> temp({1});
+            Poly<Coefficients> temp(std::vector<Coefficients>{1});
             for (size_t i = 0; i < size; i++) {
-                Poly<Coefficients> l_i({1});
+                Poly<Coefficients> l_i(std::vector<Coefficients>{1});
                 for (size_t j = 0; j < size; j++) {
                     if (i != j) {
                         Coefficients denominator = x[i] - x[j];
-                        l_i = l_i * Poly<Coefficients>({-x[j] / denominator, 1 / denominator});
+                        l_i = l_i * Poly<Coefficients>(std::vector<Coefficients>{-x[j] / denominator, 1 / denominator});
                     }
                 }
                 temp += (l_i * y[i]);
             }
-            temp -= Poly<Coefficients>({1});
+            temp -= Poly<Coefficients>(std::vector<Coefficients>{1});
             *this->GetCoefficientsTable() = std::move(*temp.GetCoefficientsTable());
         }
     }
@@ -0,0 +1,87 @@
+#include "resample.h"
+
+namespace {
+double Sinc(double x) {
+    return x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+}
+
+// The kernel's support radius in source elements before stretching.
+double GetSupport(ResampleParameters::Kernel kernel) {
+    switch (kernel) {
+        case ResampleParameters::Kernel::Box:
+            return 0.5;
+        case ResampleParameters::Kernel::Bilinear:
+            return 1;
+        case ResampleParameters::Kernel::Bicubic:
+            return 2;
+        case ResampleParameters::Kernel::Lanczos:
+            return ResampleParameters::LANCZOS_LOBES;
+    }
+    return 1;
+}
+
+double GetWeight(ResampleParameters::Kernel kernel, double x) {
+    switch (kernel) {
+        case ResampleParameters::Kernel::Box:
+            // Half-open, so a source element lying halfway between two target ones goes to exactly one of them.
+            return x >= -0.5 && x < 0.5 ? 1 : 0;
+        case ResampleParameters::Kernel::Bilinear:
+            return std::max(0.0, 1 - std::abs(x));
+        case ResampleParameters::Kernel::Bicubic: {
+            const double a = ResampleParameters::BICUBIC_A;
+            x = std::abs(x);
+            if (x < 1) {
+                return ((a + 2) * x - (a + 3)) * x * x + 1;
+            }
+            return x < 2 ? ((a * x - 5 * a) * x + 8 * a) * x - 4 * a : 0;
+        }
+        case ResampleParameters::Kernel::Lanczos:
+            return std::abs(x) < ResampleParameters::LANCZOS_LOBES
+                       ? Sinc(x) * Sinc(x / ResampleParameters::LANCZOS_LOBES)
+                       : 0;
+    }
+    return 0;
+}
+}  // namespace
+
+namespace Resample {
+WeightTable::WeightTable(size_t source_size, size_t target_size, ResampleParameters::Kernel kernel)
+    : taps_(0), starts_(target_size) {
+    double scale = static_cast<double>(source_size) / static_cast<double>(target_size);
+    double stretch = std::max(1.0, scale);
+    double support = GetSupport(kernel) * stretch;
+    // The weights of every target element by the clamped source index, then cut to a common number of taps.
+    std::vector<std::vector<std::pair<size_t, double>>> all_weights(target_size);
+    for (size_t i = 0; i < target_size; ++i) {
+        double centre = (static_cast<double>(i) + 0.5) * scale;
+        int64_t first = static_cast<int64_t>(floor(centre - support));
+        int64_t last = static_cast<int64_t>(ceil(centre + support));
+        double sum = 0;
+        std::vector<std::pair<size_t, double>>& weights = all_weights[i];
+        for (int64_t j = first; j <= last; ++j) {
+            double weight = GetWeight(kernel, (static_cast<double>(j) + 0.5 - centre) / stretch);
+            if (weight == 0) {
+                continue;
+            }
+            size_t index = static_cast<size_t>(std::clamp<int64_t>(j, 0, static_cast<int64_t>(source_size) - 1));
+            if (!weights.empty() && weights.back().first == index) {
+                weights.back().second += weight;
+            } else {
+                weights.push_back({index, weight});
+            }
+            sum += weight;
+        }
+        for (std::pair<size_t, double>& weight : weights) {
+            weight.second /= sum;
+        }
+        taps_ = std::max(taps_, weights.back().first - weights.front().first + 1);
+    }
+    weights_.assign(target_size * taps_, 0);
+    for (size_t i = 0; i < target_size; ++i) {
+        starts_[i] = std::min(all_weights[i].front().first, source_size - taps_);
+        for (const auto& [index, weight] : all_weights[i]) {
+            weights_[i * taps_ + index - starts_[i]] = weight;
+        }
+    }
+}
+}  // namespace Resample
@@ -0,0 +1,169 @@
+#ifndef IMAGE_PROCESSOR_RESAMPLE_H
+#define IMAGE_PROCESSOR_RESAMPLE_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace ResampleParameters {
+enum class Kernel { Box, Bilinear, Bicubic, Lanczos };
+// Keys' cubic with a = -0.5 and the Lanczos window of three lobes.
+const double BICUBIC_A = -0.5;
+const double LANCZOS_LOBES = 3;
+// Large reductions are first box-averaged by whole factors, leaving at least this much for the kernel.
+const size_t REDUCING_GAP = 3;
+// Longest side of a resized picture, so that its area and the estimates of its memory cannot overflow.
+const size_t MAX_SIZE = static_cast<size_t>(1) << 16;
+}  // namespace ResampleParameters
+
+namespace Resample {
+// Box-averaging factor before reducing source elements to target ones, 1 if the kernel should do it alone.
+inline size_t GetBoxFactor(size_t source, size_t target) {
+    return std::max<size_t>(1, target == 0 ? 1 : source / (ResampleParameters::REDUCING_GAP * target));
+}
+
+// Sums of blocks of factor pixels in rows of interleaved channels. Take averages the rows added since the last
+// Take, 8-bit channels are rounded to the nearest.
+template <typename Channel>
+class BoxAccumulator {
+public:
+    using Sum = std::conditional_t<std::is_integral_v<Channel>, uint32_t, double>;
+
+    BoxAccumulator(size_t width, size_t channels, size_t factor)
+        : width_(width), channels_(channels), factor_(factor), sums_((width + factor - 1) / factor * channels) {
+    }
+
+    void Add(std::span<const Channel> row) {
+        for (size_t x = 0; x < width_; ++x) {
+            for (size_t c = 0; c < channels_; ++c) {
+                sums_[x / factor_ * channels_ + c] += row[x * channels_ + c];
+            }
+        }
+    }
+
+    void Take(std::span<Channel> reduced, size_t rows) {
+        for (size_t x = 0; x < sums_.size() / channels_; ++x) {
+            Sum count = static_cast<Sum>(rows * (std::min(width_, (x + 1) * factor_) - x * factor_));
+            for (size_t c = 0; c < channels_; ++c) {
+                Sum& sum = sums_[x * channels_ + c];
+                if constexpr (std::is_integral_v<Channel>) {
+                    reduced[x * channels_ + c] = static_cast<Channel>((sum + count / 2) / count);
+                } else {
+                    reduced[x * channels_ + c] = sum / count;
+                }
+                sum = 0;
+            }
+        }
+    }
+
+private:
+    size_t width_;
+    size_t channels_;
+    size_t factor_;
+    std::vector<Sum> sums_;
+};
+
+// Averages of factor_x x factor_y blocks, the last ones in a row or a column may be smaller.
+template <typename Channel>
+Matrix<Channel> BoxReduce(MatrixView<const Channel> source, size_t channels, size_t factor_x, size_t factor_y) {
+    size_t width = source.width / channels;
+    Matrix<Channel> reduced((width + factor_x - 1) / factor_x * channels, (source.height + factor_y - 1) / factor_y);
+    Parallel::ForBlocks(reduced.GetHeight(), [&](size_t begin, size_t end) {
+        BoxAccumulator<Channel> accumulator(width, channels, factor_x);
+        for (size_t y = begin; y < end; ++y) {
+            size_t last = std::min(source.height, (y + 1) * factor_y);
+            for (size_t source_y = y * factor_y; source_y < last; ++source_y) {
+                accumulator.Add(source.Row(source_y));
+            }
+            accumulator.Take(reduced.Row(y), last - y * factor_y);
+        }
+    });
+    return reduced;
+}
+
+// Weights of the kernel for every target element (its phase): target element i takes the source elements
+// GetStart(i) ... GetStart(i) + GetTaps() - 1 with the weights GetWeights(i). Reductions stretch the kernel
+// over the source elements so it averages them, elements beyond the borders are the closest ones.
+class WeightTable {
+public:
+    WeightTable(size_t source_size, size_t target_size, ResampleParameters::Kernel kernel);
+
+    size_t GetTaps() const {
+        return taps_;
+    }
+    size_t GetStart(size_t i) const {
+        return starts_[i];
+    }
+    std::span<const double> GetWeights(size_t i) const {
+        return {weights_.data() + i * taps_, taps_};
+    }
+
+private:
+    size_t taps_;
+    std::vector<size_t> starts_;
+    std::vector<double> weights_;
+};
+
+// Resizes rows of interleaved channels to the destination, along the rows first and then along the columns,
+// both passes spread over the threads. The column pass is a multiply-add of whole rows.
+template <typename Channel>
+void Resize(MatrixView<const Channel> source, MatrixView<Channel> destination, size_t channels,
+            ResampleParameters::Kernel kernel) {
+    // Bytes are summed in float: eight of them fit into a vector register where four doubles would.
+    using Accumulator = std::conditional_t<std::is_integral_v<Channel>, float, double>;
+    size_t source_width = source.width / channels;
+    size_t target_width = destination.width / channels;
+    if (source_width == 0 || target_width == 0) {
+        return;
+    }
+    WeightTable columns(source_width, target_width, kernel);
+    WeightTable rows(source.height, destination.height, kernel);
+    std::vector<Accumulator> column_weights;
+    for (size_t x = 0; x < target_width; ++x) {
+        std::span<const double> weights = columns.GetWeights(x);
+        column_weights.insert(column_weights.end(), weights.begin(), weights.end());
+    }
+    Matrix<Accumulator> horizontal(destination.width, source.height);
+    horizontal.ForEachRow([&](size_t y, std::span<Accumulator> row) {
+        std::span<const Channel> source_row = source.Row(y);
+        for (size_t x = 0; x < target_width; ++x) {
+            const Channel* taps = source_row.data() + columns.GetStart(x) * channels;
+            const Accumulator* weights = column_weights.data() + x * columns.GetTaps();
+            for (size_t c = 0; c < channels; ++c) {
+                Accumulator sum = 0;
+                for (size_t t = 0; t < columns.GetTaps(); ++t) {
+                    sum += weights[t] * static_cast<Accumulator>(taps[t * channels + c]);
+                }
+                row[x * channels + c] = sum;
+            }
+        }
+    });
+    destination.ForEachRow([&](size_t y, std::span<Channel> row) {
+        std::vector<Accumulator> sums(row.size());
+        std::span<const double> weights = rows.GetWeights(y);
+        for (size_t t = 0; t < rows.GetTaps(); ++t) {
+            Accumulator weight = static_cast<Accumulator>(weights[t]);
+            std::span<const Accumulator> horizontal_row = static_cast<const Matrix<Accumulator>&>(horizontal).Row(rows.GetStart(y) + t);
+            for (size_t x = 0; x < sums.size(); ++x) {
+                sums[x] += weight * horizontal_row[x];
+            }
+        }
+        for (size_t x = 0; x < sums.size(); ++x) {
+            if constexpr (std::is_integral_v<Channel>) {
+                row[x] = static_cast<Channel>(std::clamp<Accumulator>(std::round(sums[x]), 0, 255));
+            } else {
+                row[x] = std::clamp<Accumulator>(sums[x], 0, 1);
+            }
+        }
+    });
+}
+}  // namespace Resample
+
+#endif  // IMAGE_PROCESSOR_RESAMPLE_H
@@ -0,0 +1,350 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+const size_t VALUES_PER_PIXEL = 3;
+
+std::string ToHex(uint64_t value) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+std::pair<size_t, size_t> GetStoredSize(Bitmap& bitmap) {
+    switch (bitmap.GetStorageFormat()) {
+        case BitmapParameters::StorageFormat::Bytes:
+            return {bitmap.GetBytes()->GetWidth(), bitmap.GetBytes()->GetHeight()};
+        case BitmapParameters::StorageFormat::Colours:
+            return {bitmap.GetData()->GetWidth(), bitmap.GetData()->GetHeight()};
+        case BitmapParameters::StorageFormat::Greyscale:
+            return {bitmap.GetGreyscale()->GetWidth(), bitmap.GetGreyscale()->GetHeight()};
+        case BitmapParameters::StorageFormat::Mask:
+            return {bitmap.GetMask()->GetWidth(), bitmap.GetMask()->GetHeight()};
+    }
+    return {0, 0};
+}
+
+// Calls function(bytes, size) with the colours of a mask, then with every row of the pixels as entries store them.
+template <typename Function>
+void ForEachStoredBlock(Bitmap& bitmap, Function function) {
+    switch (bitmap.GetStorageFormat()) {
+        case BitmapParameters::StorageFormat::Bytes: {
+            const Matrix<Bitmap::PrimitivePixel>& bytes = *bitmap.GetBytes();
+            for (size_t y = 0; y < bytes.GetHeight(); ++y) {
+                function(bytes.Row(y).data(), bytes.GetWidth() * sizeof(Bitmap::PrimitivePixel));
+            }
+            break;
+        }
+        case BitmapParameters::StorageFormat::Colours: {
+            const Matrix<Pixel>& data = *bitmap.GetData();
+            std::vector<double> row(data.GetWidth() * VALUES_PER_PIXEL);
+            for (size_t y = 0; y < data.GetHeight(); ++y) {
+                for (size_t x = 0; x < data.GetWidth(); ++x) {
+                    const Pixel pixel = data.GetElement(x, y);
+                    row[VALUES_PER_PIXEL * x] = pixel.GetRed();
+                    row[VALUES_PER_PIXEL * x + 1] = pixel.GetGreen();
+                    row[VALUES_PER_PIXEL * x + 2] = pixel.GetBlue();
+                }
+                function(row.data(), row.size() * sizeof(double));
+            }
+            break;
+        }
+        case BitmapParameters::StorageFormat::Greyscale: {
+            const Matrix<ColourParameters::ColourType>& plane = *bitmap.GetGreyscale();
+            for (size_t y = 0; y < plane.GetHeight(); ++y) {
+                function(plane.Row(y).data(), plane.GetWidth() * sizeof(ColourParameters::ColourType));
+            }
+            break;
+        }
+        case BitmapParameters::StorageFormat::Mask: {
+            const BitMask& mask = *bitmap.GetMask();
+            double colours[BitmapParameters::MASK_PALETTE_SIZE * VALUES_PER_PIXEL];
+            for (size_t i = 0; i < BitmapParameters::MASK_PALETTE_SIZE; ++i) {
+                const Pixel& colour = bitmap.GetMaskPalette()[i];
+                colours[VALUES_PER_PIXEL * i] = colour.GetRed();
+                colours[VALUES_PER_PIXEL * i + 1] = colour.GetGreen();
+                colours[VALUES_PER_PIXEL * i + 2] = colour.GetBlue();
+            }
+            function(colours, sizeof(colours));
+            for (size_t y = 0; y < mask.GetHeight(); ++y) {
+                function(mask.GetRow(y), mask.GetWordsPerRow() * sizeof(BitMask::Word));
+            }
+            break;
+        }
+    }
+}
+}  // namespace
+
+ResultCache::ResultCache(std::string directory, size_t budget, std::string_view precision)
+    : directory_(std::move(directory)), budget_(budget), precision_(precision) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+}
+
+uint64_t ResultCache::HashBytes(const void* bytes, size_t size, uint64_t seed) {
+    const unsigned char* data = static_cast<const unsigned char*>(bytes);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t ResultCache::HashFileParameter(const FilterDescriptor& description) {
+    const auto& filters = CacheParameters::FILE_BACKED_FILTERS;
+    if (description.GetParams().size() != 1 ||
+        std::find(std::begin(filters), std::end(filters), description.GetFilterName()) == std::end(filters)) {
+        return 0;
+    }
+    std::ifstream file{std::string(description.GetParams()[0]), std::ios_base::binary};
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return HashBytes(contents.data(), contents.size(), FNV_OFFSET_BASIS);
+}
+
+uint64_t ResultCache::HashBitmap(Bitmap& bitmap) {
+    // Word-wise FNV-1a over the stored bytes: a byte-wise pass is needlessly slow here.
+    uint64_t hash = FNV_OFFSET_BASIS;
+    auto [width, height] = GetStoredSize(bitmap);
+    uint64_t sizes[3] = {static_cast<uint64_t>(bitmap.GetStorageFormat()), width, height};
+    hash = HashBytes(sizes, sizeof(sizes), hash);
+    ForEachStoredBlock(bitmap, [&hash](const void* block, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(block);
+        size_t words = size / sizeof(uint64_t);
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t word = 0;
+            std::memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+            hash ^= word;
+            hash *= FNV_PRIME;
+        }
+        hash = HashBytes(bytes + words * sizeof(uint64_t), size % sizeof(uint64_t), hash);
+    });
+    return hash;
+}
+
+std::string ResultCache::MakeKey(uint64_t input_hash, const std::vector<FilterDescriptor>& descriptions,
+                                 size_t prefix_length) const {
+    std::string key = precision_ + '\n' + ToHex(input_hash) + '\n';
+    for (size_t i = 0; i < std::min(prefix_length, descriptions.size()); ++i) {
+        key += descriptions[i].GetCanonicalForm();
+        uint64_t file_hash = HashFileParameter(descriptions[i]);
+        if (file_hash != 0) {
+            key += " #" + ToHex(file_hash);
+        }
+        key += '\n';
+    }
+    return key;
+}
+
+std::string ResultCache::GetPath(std::string_view key) const {
+    std::filesystem::path path(directory_);
+    path /= ToHex(HashBytes(key.data(), key.size(), FNV_OFFSET_BASIS)) + std::string(CacheParameters::FILE_EXTENSION);
+    return path.string();
+}
+
+size_t ResultCache::GetDataOffset(size_t key_size) {
+    size_t offset = sizeof(FileHeader) + key_size;
+    return (offset + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+size_t ResultCache::GetRowSize(BitmapParameters::StorageFormat format, size_t width) {
+    switch (format) {
+        case BitmapParameters::StorageFormat::Bytes:
+            return width * sizeof(Bitmap::PrimitivePixel);
+        case BitmapParameters::StorageFormat::Colours:
+            return width * VALUES_PER_PIXEL * sizeof(double);
+        case BitmapParameters::StorageFormat::Greyscale:
+            return width * sizeof(ColourParameters::ColourType);
+        case BitmapParameters::StorageFormat::Mask:
+            return (width + BitMask::WORD_BITS - 1) / BitMask::WORD_BITS * sizeof(BitMask::Word);
+    }
+    return 0;
+}
+
+size_t ResultCache::GetPrefixSize(BitmapParameters::StorageFormat format) {
+    return format == BitmapParameters::StorageFormat::Mask
+               ? BitmapParameters::MASK_PALETTE_SIZE * VALUES_PER_PIXEL * sizeof(double)
+               : 0;
+}
+
+bool ResultCache::Load(std::string_view key, Bitmap& bitmap) const {
+    std::string path = GetPath(key);
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat file_stat {};
+    if (fstat(file, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(FileHeader)) {
+        close(file);
+        return false;
+    }
+    size_t file_size = file_stat.st_size;
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+    const char* bytes = static_cast<const char*>(mapping);
+    FileHeader header{};
+    std::memcpy(&header, bytes, sizeof(header));
+    auto format = static_cast<BitmapParameters::StorageFormat>(header.format);
+    // Every pixel takes at least a bit, so checking the width first keeps the row size from overflowing.
+    bool is_valid = header.magic == CacheParameters::MAGIC && header.version == CacheParameters::VERSION &&
+                    header.key_size == key.size() && GetDataOffset(key.size()) <= file_size &&
+                    std::memcmp(bytes + sizeof(FileHeader), key.data(), key.size()) == 0 && header.width > 0 &&
+                    header.height > 0 && header.width <= file_size * CHAR_BIT &&
+                    GetRowSize(format, header.width) > 0;
+    size_t offset = GetDataOffset(key.size());
+    size_t row_size = is_valid ? GetRowSize(format, header.width) : 0;
+    is_valid = is_valid && GetPrefixSize(format) <= file_size - offset &&
+               header.height == (file_size - offset - GetPrefixSize(format)) / row_size &&
+               header.height * row_size == file_size - offset - GetPrefixSize(format);
+    if (is_valid) {
+        const char* rows = bytes + offset + GetPrefixSize(format);
+        if (format == BitmapParameters::StorageFormat::Bytes) {
+            Matrix<Bitmap::PrimitivePixel> result(header.width, header.height);
+            for (size_t y = 0; y < header.height; ++y) {
+                std::memcpy(result.Row(y).data(), rows + y * row_size, row_size);
+            }
+            bitmap.SetBytes(std::move(result));
+        } else if (format == BitmapParameters::StorageFormat::Colours) {
+            Matrix<Pixel> result(header.width, header.height);
+            const double* values = reinterpret_cast<const double*>(rows);
+            for (size_t y = 0; y < header.height; ++y) {
+                for (size_t x = 0; x < header.width; ++x) {
+                    result.GetElement(x, y) =
+                        Pixel(values[0], values[1], values[2], ColourParameters::ColourSchemes::RGB);
+                    values += VALUES_PER_PIXEL;
+                }
+            }
+            bitmap.SetData(std::move(result));
+        } else if (format == BitmapParameters::StorageFormat::Greyscale) {
+            Matrix<ColourParameters::ColourType> result(header.width, header.height);
+            for (size_t y = 0; y < header.height; ++y) {
+                std::memcpy(result.Row(y).data(), rows + y * row_size, row_size);
+            }
+            bitmap.SetGreyscale(std::move(result));
+        } else {
+            const double* colours = reinterpret_cast<const double*>(bytes + offset);
+            BitMask result(header.width, header.height);
+            for (size_t y = 0; y < header.height; ++y) {
+                std::memcpy(result.GetRow(y), rows + y * row_size, row_size);
+            }
+            bitmap.SetMask(std::move(result),
+                           Pixel(colours[0], colours[1], colours[2], ColourParameters::ColourSchemes::RGB),
+                           Pixel(colours[3], colours[4], colours[5], ColourParameters::ColourSchemes::RGB));
+        }
+    }
+    munmap(mapping, file_size);
+
+    if (is_valid) {
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    }
+    return is_valid;
+}
+
+bool ResultCache::Store(std::string_view key, Bitmap& bitmap) const {
+    auto [width, height] = GetStoredSize(bitmap);
+    if (width == 0 || height == 0) {
+        return false;
+    }
+    std::string path = GetPath(key);
+    std::string temp_path = path + ".tmp" + std::to_string(getpid());
+    std::ofstream file(temp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    FileHeader header{CacheParameters::MAGIC, CacheParameters::VERSION, width, height, key.size(),
+                      bitmap.GetStorageFormat()};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(key.data(), static_cast<std::streamsize>(key.size()));
+    const char padding[sizeof(double)] = {};
+    file.write(padding, static_cast<std::streamsize>(GetDataOffset(key.size()) - sizeof(header) - key.size()));
+    ForEachStoredBlock(bitmap, [&file](const void* block, size_t size) {
+        file.write(static_cast<const char*>(block), static_cast<std::streamsize>(size));
+    });
+    file.close();
+
+    std::error_code error;
+    if (!file) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    // Writing to a temporary name first keeps concurrent readers from mapping a half-written entry.
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
+
+size_t ResultCache::Restore(uint64_t input_hash, const std::vector<FilterDescriptor>& descriptions,
+                            Bitmap& bitmap) const {
+    for (size_t prefix_length = descriptions.size(); prefix_length > 0; --prefix_length) {
+        if (Load(MakeKey(input_hash, descriptions, prefix_length), bitmap)) {
+            return prefix_length;
+        }
+    }
+    return 0;
+}
+
+void ResultCache::Evict() const {
+    struct Entry {
+        std::filesystem::path path;
+        uintmax_t size;
+        std::filesystem::file_time_type last_used;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total_size = 0;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(directory_, error)) {
+        if (!file.is_regular_file(error) || file.path().extension() != CacheParameters::FILE_EXTENSION) {
+            continue;
+        }
+        Entry entry{file.path(), file.file_size(error), file.last_write_time(error)};
+        if (error) {
+            continue;
+        }
+        total_size += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total_size <= budget_) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& lhs, const Entry& rhs) { return lhs.last_used < rhs.last_used; });
+    for (const Entry& entry : entries) {
+        if (total_size <= budget_) {
+            break;
+        }
+        if (std::filesystem::remove(entry.path, error)) {
+            total_size -= entry.size;
+        }
+    }
+}
+
+const std::string& ResultCache::GetDirectory() const {
+    return directory_;
+}
+
+size_t ResultCache::GetBudget() const {
+    return budget_;
+}
@@ -0,0 +1,77 @@
+#ifndef IMAGE_PROCESSOR_RESULT_CACHE_H
+#define IMAGE_PROCESSOR_RESULT_CACHE_H
+
+#include "bitmap.h"
+#include "command_line_parser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace CacheParameters {
+const size_t DEFAULT_BUDGET = static_cast<size_t>(1) << 30;  // 1 GiB
+const uint32_t MAGIC = 0x43505049;                          // "IPPC"
+const uint32_t VERSION = 2;
+const std::string_view FILE_EXTENSION = ".ipc";
+// Entries hold whatever storage the filters left the picture in, see Bitmap::GetStorageFormat.
+const std::string_view PRECISION_NATIVE = "native";
+// Filters reading a file named by their only parameter: keys hold a hash of the file's contents besides its name,
+// so editing the file does not restore stale results.
+const std::string_view FILE_BACKED_FILTERS[] = {"-conv", "-roi-mask"};
+}  // namespace CacheParameters
+
+// On-disk content-addressed cache of intermediate pipeline results.
+// An entry is addressed by (hash of the input pixels, precision mode, canonical prefix of the filter chain),
+// so a run can restart from the longest prefix some earlier run has already computed.
+// Entries are the raw rows of the picture's storage (8-bit RGB, RGB doubles, a grey plane or a bit mask and its two
+// colours) behind a small header and are mmap'd on read.
+// Least recently used entries are evicted once the directory grows past the size budget.
+class ResultCache {
+public:
+    explicit ResultCache(std::string directory, size_t budget = CacheParameters::DEFAULT_BUDGET,
+                         std::string_view precision = CacheParameters::PRECISION_NATIVE);
+
+    // Hash of the storage format, the size and the pixels as they are stored.
+    static uint64_t HashBitmap(Bitmap& bitmap);
+
+    std::string MakeKey(uint64_t input_hash, const std::vector<FilterDescriptor>& descriptions,
+                        size_t prefix_length) const;
+    std::string GetPath(std::string_view key) const;
+
+    // Replaces the pixels of bitmap by the entry's, keeping its headers.
+    bool Load(std::string_view key, Bitmap& bitmap) const;
+    bool Store(std::string_view key, Bitmap& bitmap) const;
+    // Loads the longest cached prefix of descriptions into bitmap, returns its length (0 if nothing was found).
+    size_t Restore(uint64_t input_hash, const std::vector<FilterDescriptor>& descriptions, Bitmap& bitmap) const;
+    void Evict() const;
+
+    const std::string& GetDirectory() const;
+    size_t GetBudget() const;
+
+protected:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t width;
+        uint64_t height;
+        uint64_t key_size;
+        uint64_t format;
+    } __attribute__((packed));
+
+    static uint64_t HashBytes(const void* bytes, size_t size, uint64_t seed);
+    // Hash of the contents of the file a file-backed filter reads, 0 for other filters.
+    static uint64_t HashFileParameter(const FilterDescriptor& description);
+    static size_t GetDataOffset(size_t key_size);
+    // Bytes a row of width pixels takes in format and the bytes stored before the rows (a mask's colours),
+    // 0 for formats that are never stored.
+    static size_t GetRowSize(BitmapParameters::StorageFormat format, size_t width);
+    static size_t GetPrefixSize(BitmapParameters::StorageFormat format);
+
+    std::string directory_;
+    size_t budget_;
+    std::string precision_;
+};
+
+#endif  // IMAGE_PROCESSOR_RESULT_CACHE_H
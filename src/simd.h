@@ -0,0 +1,134 @@
+#ifndef IMAGE_PROCESSOR_SIMD_H
+#define IMAGE_PROCESSOR_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Inner loops of the integer convolution and of the span evaluations of polynomials, written with x86 vector
+// intrinsics: 256-bit AVX2 (integers) and AVX (doubles) when the target has them (-mavx2), 128-bit SSE2
+// (SSE4.1 for int32_t) otherwise. Every loop ends with a scalar tail, and other targets run the scalar loop only.
+// The vector loops do the scalar loops' operations in the same order, so the integer results are the same bit
+// for bit and the double ones differ at most by the rounding of multiply-adds the compiler may fuse.
+namespace Simd {
+
+// sum[j] += (a[j] + b[j]) * weight, or sum[j] += a[j] * weight if b is nullptr, wrapping around like the
+// scalar casts back to int16_t.
+inline void MultiplyAdd(int16_t* sum, const int16_t* a, const int16_t* b, int16_t weight, size_t size) {
+    size_t j = 0;
+#if defined(__AVX2__)
+    __m256i weights = _mm256_set1_epi16(weight);
+    for (; j + 16 <= size; j += 16) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + j));
+        if (b != nullptr) {
+            x = _mm256_add_epi16(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j)));
+        }
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + j), _mm256_add_epi16(s, _mm256_mullo_epi16(x, weights)));
+    }
+#elif defined(__SSE2__)
+    __m128i weights = _mm_set1_epi16(weight);
+    for (; j + 8 <= size; j += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + j));
+        if (b != nullptr) {
+            x = _mm_add_epi16(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j)));
+        }
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + j), _mm_add_epi16(s, _mm_mullo_epi16(x, weights)));
+    }
+#endif
+    for (; j < size; ++j) {
+        int16_t x = b != nullptr ? static_cast<int16_t>(a[j] + b[j]) : a[j];
+        sum[j] = static_cast<int16_t>(sum[j] + x * weight);
+    }
+}
+
+inline void MultiplyAdd(int32_t* sum, const int32_t* a, const int32_t* b, int32_t weight, size_t size) {
+    size_t j = 0;
+#if defined(__AVX2__)
+    __m256i weights = _mm256_set1_epi32(weight);
+    for (; j + 8 <= size; j += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + j));
+        if (b != nullptr) {
+            x = _mm256_add_epi32(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j)));
+        }
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + j));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + j), _mm256_add_epi32(s, _mm256_mullo_epi32(x, weights)));
+    }
+#elif defined(__SSE4_1__)
+    __m128i weights = _mm_set1_epi32(weight);
+    for (; j + 4 <= size; j += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + j));
+        if (b != nullptr) {
+            x = _mm_add_epi32(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j)));
+        }
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + j));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + j), _mm_add_epi32(s, _mm_mullo_epi32(x, weights)));
+    }
+#endif
+    for (; j < size; ++j) {
+        int32_t x = b != nullptr ? a[j] + b[j] : a[j];
+        sum[j] += x * weight;
+    }
+}
+
+// One step of Horner's scheme on a block of points: answers[i] = answers[i] * x[i] + coefficient.
+inline void HornerStep(double* answers, const double* x, double coefficient, size_t size) {
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256d coefficients = _mm256_set1_pd(coefficient);
+    for (; i + 4 <= size; i += 4) {
+        __m256d product = _mm256_mul_pd(_mm256_loadu_pd(answers + i), _mm256_loadu_pd(x + i));
+        _mm256_storeu_pd(answers + i, _mm256_add_pd(product, coefficients));
+    }
+#elif defined(__SSE2__)
+    __m128d coefficients = _mm_set1_pd(coefficient);
+    for (; i + 2 <= size; i += 2) {
+        __m128d product = _mm_mul_pd(_mm_loadu_pd(answers + i), _mm_loadu_pd(x + i));
+        _mm_storeu_pd(answers + i, _mm_add_pd(product, coefficients));
+    }
+#endif
+    for (; i < size; ++i) {
+        answers[i] = answers[i] * x[i] + coefficient;
+    }
+}
+
+// Adds the terms of one node to the barycentric sums of a block of points:
+// term = weight / (x[i] - node), numerators[i] += term * value, denominators[i] += term.
+inline void BarycentricStep(double* numerators, double* denominators, const double* x, double node, double weight,
+                            double value, size_t size) {
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256d nodes = _mm256_set1_pd(node);
+    __m256d weights = _mm256_set1_pd(weight);
+    __m256d values = _mm256_set1_pd(value);
+    for (; i + 4 <= size; i += 4) {
+        __m256d term = _mm256_div_pd(weights, _mm256_sub_pd(_mm256_loadu_pd(x + i), nodes));
+        __m256d product = _mm256_mul_pd(term, values);
+        _mm256_storeu_pd(numerators + i, _mm256_add_pd(_mm256_loadu_pd(numerators + i), product));
+        _mm256_storeu_pd(denominators + i, _mm256_add_pd(_mm256_loadu_pd(denominators + i), term));
+    }
+#elif defined(__SSE2__)
+    __m128d nodes = _mm_set1_pd(node);
+    __m128d weights = _mm_set1_pd(weight);
+    __m128d values = _mm_set1_pd(value);
+    for (; i + 2 <= size; i += 2) {
+        __m128d term = _mm_div_pd(weights, _mm_sub_pd(_mm_loadu_pd(x + i), nodes));
+        __m128d product = _mm_mul_pd(term, values);
+        _mm_storeu_pd(numerators + i, _mm_add_pd(_mm_loadu_pd(numerators + i), product));
+        _mm_storeu_pd(denominators + i, _mm_add_pd(_mm_loadu_pd(denominators + i), term));
+    }
+#endif
+    for (; i < size; ++i) {
+        double term = weight / (x[i] - node);
+        numerators[i] += term * value;
+        denominators[i] += term;
+    }
+}
+
+}  // namespace Simd
+
+#endif  // IMAGE_PROCESSOR_SIMD_H
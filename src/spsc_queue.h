@@ -0,0 +1,87 @@
+#ifndef IMAGE_PROCESSOR_SPSC_QUEUE_H
+#define IMAGE_PROCESSOR_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace SpscQueueParameters {
+// Keeps the two indices on separate cache lines, so the producer and the consumer do not invalidate each other's.
+const size_t CACHE_LINE = 64;
+}  // namespace SpscQueueParameters
+
+// Bounded queue between one producing and one consuming thread: a ring of capacity + 1 slots (one always stays
+// free to tell a full ring from an empty one) and two atomic indices, the producer alone moving the tail and the
+// consumer alone the head. Neither side ever takes a lock; a side finding the ring full or empty sleeps on the
+// other side's index (std::atomic::wait) until it moves instead of spinning.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots_(capacity + 1) {
+    }
+
+    SpscQueue(const SpscQueue& other) = delete;
+    SpscQueue& operator=(const SpscQueue& other) = delete;
+
+    size_t GetCapacity() const {
+        return slots_.size() - 1;
+    }
+
+    // The value is moved from only if it was pushed.
+    bool TryPush(T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t next = Next(tail);
+        if (next == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        tail_.notify_one();
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots_[head]);
+        head_.store(Next(head), std::memory_order_release);
+        head_.notify_one();
+        return true;
+    }
+
+    // Waits while the queue is full.
+    void Push(T value) {
+        while (!TryPush(value)) {
+            size_t head = head_.load(std::memory_order_acquire);
+            if (Next(tail_.load(std::memory_order_relaxed)) == head) {
+                head_.wait(head, std::memory_order_acquire);
+            }
+        }
+    }
+
+    // Waits while the queue is empty.
+    T Pop() {
+        T value;
+        while (!TryPop(value)) {
+            size_t tail = tail_.load(std::memory_order_acquire);
+            if (head_.load(std::memory_order_relaxed) == tail) {
+                tail_.wait(tail, std::memory_order_acquire);
+            }
+        }
+        return value;
+    }
+
+private:
+    size_t Next(size_t index) const {
+        return index + 1 == slots_.size() ? 0 : index + 1;
+    }
+
+    std::vector<T> slots_;
+    alignas(SpscQueueParameters::CACHE_LINE) std::atomic<size_t> head_ = 0;
+    alignas(SpscQueueParameters::CACHE_LINE) std::atomic<size_t> tail_ = 0;
+};
+
+#endif  // IMAGE_PROCESSOR_SPSC_QUEUE_H
@@ -0,0 +1,106 @@
+#include "statistics.h"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace Statistics {
+Channel::Channel(double low, double high, size_t bins)
+    : low_(low), scale_(static_cast<double>(bins) / (high - low)), shift_((low + high) / 2), histogram_(bins) {
+    if (bins == 0 || !(high > low)) {
+        throw std::invalid_argument("statistics need a nonempty range of bins");
+    }
+}
+
+void Channel::Merge(const Channel& other) {
+    if (other.histogram_.size() != histogram_.size() || other.low_ != low_ || other.scale_ != scale_) {
+        throw std::invalid_argument("statistics of different bins cannot be merged");
+    }
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+    square_sum_ += other.square_sum_;
+    for (size_t i = 0; i < histogram_.size(); ++i) {
+        histogram_[i] += other.histogram_[i];
+    }
+}
+
+double Channel::GetBinCentre(size_t bin) const {
+    return low_ + (static_cast<double>(bin) + 0.5) / scale_;
+}
+
+const std::vector<uint64_t>& Channel::GetHistogram() const {
+    return histogram_;
+}
+
+uint64_t Channel::GetCount() const {
+    return count_;
+}
+
+double Channel::GetMin() const {
+    return count_ == 0 ? 0 : min_;
+}
+
+double Channel::GetMax() const {
+    return count_ == 0 ? 0 : max_;
+}
+
+double Channel::GetMean() const {
+    return count_ == 0 ? 0 : shift_ + sum_ / static_cast<double>(count_);
+}
+
+double Channel::GetVariance() const {
+    if (count_ == 0) {
+        return 0;
+    }
+    double mean_deviation = sum_ / static_cast<double>(count_);
+    return std::max(0.0, square_sum_ / static_cast<double>(count_) - mean_deviation * mean_deviation);
+}
+
+double Channel::GetPercentile(double fraction) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(count_))));
+    uint64_t counted = 0;
+    size_t bin = 0;
+    for (; bin + 1 < histogram_.size(); ++bin) {
+        counted += histogram_[bin];
+        if (counted >= rank) {
+            break;
+        }
+    }
+    return std::clamp(GetBinCentre(bin), min_, max_);
+}
+
+std::string ToJson(size_t width, size_t height, const std::vector<std::string>& names,
+                   const std::vector<Channel>& channels) {
+    std::ostringstream json;
+    json.precision(9);
+    json << "{\n  \"width\": " << width << ",\n  \"height\": " << height << ",\n  \"channels\": {";
+    for (size_t c = 0; c < channels.size(); ++c) {
+        const Channel& channel = channels[c];
+        json << (c == 0 ? "\n" : ",\n") << "    \"" << names[c] << "\": {\n"
+             << "      \"count\": " << channel.GetCount() << ",\n"
+             << "      \"min\": " << channel.GetMin() << ",\n"
+             << "      \"max\": " << channel.GetMax() << ",\n"
+             << "      \"mean\": " << channel.GetMean() << ",\n"
+             << "      \"variance\": " << channel.GetVariance() << ",\n"
+             << "      \"percentiles\": {";
+        bool is_first = true;
+        for (double fraction : StatisticsParameters::REPORTED_PERCENTILES) {
+            json << (is_first ? "" : ", ") << "\"" << fraction * 100 << "\": " << channel.GetPercentile(fraction);
+            is_first = false;
+        }
+        json << "},\n      \"histogram\": [";
+        for (size_t i = 0; i < channel.GetHistogram().size(); ++i) {
+            json << (i == 0 ? "" : ", ") << channel.GetHistogram()[i];
+        }
+        json << "]\n    }";
+    }
+    json << "\n  }\n}\n";
+    return json.str();
+}
+}  // namespace Statistics
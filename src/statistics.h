@@ -0,0 +1,117 @@
+#ifndef IMAGE_PROCESSOR_STATISTICS_H
+#define IMAGE_PROCESSOR_STATISTICS_H
+
+#include "matrix.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace StatisticsParameters {
+// Bins of the histograms of pictures, one per 8-bit value.
+const size_t BINS = 256;
+// Bins of the histograms of filter responses, whose percentiles choose thresholds finer than the 8-bit values.
+const size_t RESPONSE_BINS = 4096;
+// Percentiles written to the reports, as fractions.
+const double REPORTED_PERCENTILES[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+}  // namespace StatisticsParameters
+
+namespace Statistics {
+// Histogram of the values over [low, high) cut into equal bins (the values beyond fall into the end bins), with
+// the exact count, extrema, mean and variance. The statistics of disjoint parts merge into those of their union,
+// so every thread may count its own part.
+class Channel {
+public:
+    // By default the bins are centred at the 8-bit values i / 255 of [0, 1].
+    explicit Channel(double low = -0.5 / 255, double high = 1 + 0.5 / 255, size_t bins = StatisticsParameters::BINS);
+
+    void Add(double value) {
+        ++count_;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        // Sums of the deviations from the middle of the range: the variance does not cancel out as it would
+        // with the plain sum of squares far from zero.
+        double deviation = value - shift_;
+        sum_ += deviation;
+        square_sum_ += deviation * deviation;
+        ++histogram_[GetBin(value)];
+    }
+    // The statistics must have the same range and bins.
+    void Merge(const Channel& other);
+
+    size_t GetBin(double value) const {
+        double position = (value - low_) * scale_;
+        if (!(position > 0)) {
+            return 0;
+        }
+        return std::min(static_cast<size_t>(position), histogram_.size() - 1);
+    }
+    double GetBinCentre(size_t bin) const;
+    const std::vector<uint64_t>& GetHistogram() const;
+
+    // The extrema, mean and variance of no values are 0.
+    uint64_t GetCount() const;
+    double GetMin() const;
+    double GetMax() const;
+    double GetMean() const;
+    double GetVariance() const;
+    // The centre of the first bin by which the fraction of the values is reached, clamped to the extrema.
+    double GetPercentile(double fraction) const;
+
+private:
+    double low_;
+    double scale_;
+    double shift_;
+    std::vector<uint64_t> histogram_;
+    uint64_t count_ = 0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+    double sum_ = 0;
+    double square_sum_ = 0;
+};
+
+// Statistics of every channel of rows of interleaved channels (the width counts the channels), to_value maps
+// the elements to the values counted. One pass over the picture: every thread counts a band of rows into its
+// own statistics and the bands are merged in order at the end.
+template <typename ElementType, typename ToValue>
+std::vector<Channel> Compute(MatrixView<const ElementType> source, size_t channels, ToValue to_value,
+                             const Channel& empty = Channel()) {
+    std::vector<std::pair<size_t, std::vector<Channel>>> bands;
+    std::mutex mutex;
+    Parallel::ForBlocks(source.height, [&](size_t begin, size_t end) {
+        std::vector<Channel> band(channels, empty);
+        for (size_t y = begin; y < end; ++y) {
+            std::span<const ElementType> row = source.Row(y);
+            for (size_t x = 0; x < row.size(); x += channels) {
+                for (size_t c = 0; c < channels; ++c) {
+                    band[c].Add(to_value(row[x + c]));
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        bands.emplace_back(begin, std::move(band));
+    });
+    std::sort(bands.begin(), bands.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::vector<Channel> result(channels, empty);
+    for (const auto& [begin, band] : bands) {
+        for (size_t c = 0; c < channels; ++c) {
+            result[c].Merge(band[c]);
+        }
+    }
+    return result;
+}
+
+// JSON object of the picture's size and, by channel name, the statistics, the reported percentiles (keyed by
+// percent) and the histogram of every channel.
+std::string ToJson(size_t width, size_t height, const std::vector<std::string>& names,
+                   const std::vector<Channel>& channels);
+}  // namespace Statistics
+
+#endif  // IMAGE_PROCESSOR_STATISTICS_H
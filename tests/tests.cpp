@@ -3,14 +3,33 @@
 #include <sstream>
 #include <stdexcept>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <random>
+#include <type_traits>
 
 #include "../src/matrix.h"
 #include "../src/pixel.h"
 #include "../src/command_line_parser.h"
+#include "../src/convolution.h"
+#include "../src/fft.h"
+#include "../src/integral.h"
+#include "../src/median.h"
+#include "../src/morphology.h"
+#include "../src/orientation.h"
+#include "../src/resample.h"
+#include "../src/spsc_queue.h"
+#include "../src/statistics.h"
 #include "../src/filter_pipeline_maker.h"
 #include "../src/application.h"
+#include "../src/batch.h"
+#include "../src/memory_budget.h"
 #include "../src/image_manipulators.h"
 #include "../src/poly.h"
+#include "../src/result_cache.h"
+#include "../src/simd.h"
+#include "../src/image_processor_api.h"
 
 using namespace std::literals;
 
@@ -28,6 +47,15 @@ void TestWrapper(TestFunction func, std::string info) {
     }
 }
 
+// A fresh directory of its own under the temporary one, the test removes it when it is done.
+std::filesystem::path MakeTestDirectory(const std::string& name) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() /
+                                      ("image_processor_" + name + "_" + std::to_string(std::random_device()()));
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    return directory;
+}
+
 void PixelTest() {
     Pixel pixel1;
     Pixel pixel2(1, 1, 1);
@@ -78,6 +106,1297 @@ void MatrixTest() {
              {Pixel(0.315), Pixel(0.348), Pixel(0.375)}}))));
 }
 
+void MatrixRowsTest() {
+    Matrix<double> matrix(7, 5);
+    for (size_t y = 0; y < matrix.GetHeight(); ++y) {
+        for (size_t x = 0; x < matrix.GetWidth(); ++x) {
+            matrix.GetElement(x, y) = std::sin(static_cast<double>(x * 13 + y * 7));
+        }
+    }
+    assert(matrix.Row(3).size() == 7 && &matrix.Row(3)[2] == &matrix.GetElement(2, 3));
+    MatrixView<double> view = matrix.GetView();
+    assert(view.stride == 7 && &view(4, 2) == &matrix.GetElement(4, 2) && view.Row(1).data() == matrix.Row(1).data());
+
+    Matrix<double> kernel(std::vector<std::vector<double>>({{0.5, -1, 0.25, 2, 1}, {1, 0, 3, -0.5, 0.125}}));
+    Matrix<double> expected(matrix.GetWidth(), matrix.GetHeight());
+    for (size_t i = 0; i < matrix.GetHeight(); ++i) {
+        for (size_t j = 0; j < matrix.GetWidth(); ++j) {
+            double sum = 0;
+            for (size_t y = 0; y < kernel.GetHeight(); ++y) {
+                for (size_t x = 0; x < kernel.GetWidth(); ++x) {
+                    size_t source_y = std::min(std::max<int64_t>(static_cast<int64_t>(i + y) - 1, 0),
+                                               static_cast<int64_t>(matrix.GetHeight()) - 1);
+                    size_t source_x = std::min(std::max<int64_t>(static_cast<int64_t>(j + x) - 2, 0),
+                                               static_cast<int64_t>(matrix.GetWidth()) - 1);
+                    sum += matrix.GetElement(source_x, source_y) * kernel.GetElement(x, y);
+                }
+            }
+            expected.GetElement(j, i) = sum;
+        }
+    }
+    Matrix<double> convolved = matrix;
+    convolved.Convolution(kernel);
+    assert(("Row-wise convolution sums in the kernel order", convolved == expected));
+
+    std::vector<size_t> visited(matrix.GetHeight(), 0);
+    matrix.ForEachRow([&visited](size_t y, std::span<double> row) { visited[y] += row.size(); });
+    assert(std::all_of(visited.begin(), visited.end(), [](size_t size) { return size == 7; }));
+    Matrix<double> doubled = matrix;
+    doubled.Transform([](double value) { return 2 * value; });
+    assert(doubled.GetElement(6, 4) == 2 * matrix.GetElement(6, 4));
+}
+
+void RegionOfInterestTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Pixel> picture = *bitmap.GetData();
+    const Pixel* corner = &picture.GetElement(100, 200);
+    picture.Crop(100, 200, 64, 48);
+    assert(("Crop keeps the storage", &picture.GetElement(0, 0) == corner));
+    assert(picture.GetElement(63, 47) == bitmap.GetData()->GetElement(163, 247));
+    Matrix<Pixel> cropped = picture;
+    CropFilter(30, 1000).Apply(cropped);
+    assert(cropped.GetWidth() == 30 && cropped.GetHeight() == 48);
+    assert(cropped.GetElement(29, 47) == picture.GetElement(29, 47));
+
+    std::vector<Manipulator*> filters = {new SharpeningFilter(), new FastGaussianBlurFilter(1.5), new NegativeFilter(),
+                                         new ToGreyscaleFilter(), new ToGreyscaleBasicFilter(),
+                                         new EdgeDetectionFilter(0.05), new CurvesFilter({0, 0.5, 1}, {0, 0.7, 1}),
+                                         new GaussianBlurFilter(1)};
+    for (const Manipulator* filter : filters) {
+        Matrix<Pixel> result = picture;
+        filter->ApplyView(result.GetView(10, 5, 30, 20));
+        Matrix<Pixel> expected = picture;
+        expected.Crop(10, 5, 30, 20);
+        expected = Matrix<Pixel>(expected);
+        filter->Apply(expected);
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                bool is_inside = x >= 10 && x < 40 && y >= 5 && y < 25;
+                const Pixel& reference = is_inside ? expected.GetElement(x - 10, y - 5) : picture.GetElement(x, y);
+                assert(("Regions are filtered in place, the rest is untouched",
+                        result.GetElement(x, y).GetColourValue() == reference.GetColourValue()));
+            }
+        }
+        delete filter;
+    }
+    bool is_thrown = false;
+    try {
+        CropFilter(10, 10).ApplyView(picture.GetView());
+    } catch (const std::logic_error& e) {
+        is_thrown = true;
+    }
+    assert(("Regions cannot be cropped", is_thrown));
+}
+
+void RegionFilterTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    const Matrix<Pixel>& picture = *bitmap.GetData();
+    auto check = [&picture](const Matrix<Pixel>& result, const Matrix<Pixel>& expected, auto is_inside) {
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                const Pixel& reference = is_inside(x, y) ? expected.GetElement(x, y) : picture.GetElement(x, y);
+                assert(("Regions match the whole picture filtered, the rest is untouched",
+                        result.GetElement(x, y).GetColourValue() == reference.GetColourValue()));
+            }
+        }
+    };
+
+    Matrix<Pixel> blurred = picture;
+    FastGaussianBlurFilter(2).Apply(blurred);
+    Matrix<Pixel> result = picture;
+    RegionFilter(new FastGaussianBlurFilter(2), {{100, 120, 60, 40}, {600, 620, 100, 100}}).Apply(result);
+    check(result, blurred, [](size_t x, size_t y) {
+        return (x >= 100 && x < 160 && y >= 120 && y < 160) || (x >= 600 && y >= 620);
+    });
+
+    // The bilateral grid is laid over the whole picture, so is the grid of a region.
+    Matrix<Pixel> smoothed = picture;
+    BilateralFilter(8, 0.1).Apply(smoothed);
+    result = picture;
+    RegionFilter(new BilateralFilter(8, 0.1), {{70, 90, 50, 40}}).Apply(result);
+    check(result, smoothed, [](size_t x, size_t y) { return x >= 70 && x < 120 && y >= 90 && y < 130; });
+
+    Matrix<Pixel> negative = picture;
+    NegativeFilter().Apply(negative);
+    result = picture;
+    RegionFilter(new NegativeFilter(), {{10, 10, 20, 20}, {20, 20, 20, 20}}).Apply(result);
+    check(result, negative, [](size_t x, size_t y) {
+        return (x >= 10 && x < 30 && y >= 10 && y < 30) || (x >= 20 && x < 40 && y >= 20 && y < 40);
+    });
+
+    BitMask mask(picture.GetWidth(), picture.GetHeight());
+    auto is_in_disk = [](size_t x, size_t y) { return (x - 300) * (x - 300) + (y - 200) * (y - 200) < 2500; };
+    for (size_t y = 150; y < 250; ++y) {
+        for (size_t x = 250; x < 350; ++x) {
+            mask.SetElement(x, y, is_in_disk(x, y));
+        }
+    }
+    Matrix<Pixel> sharpened = picture;
+    SharpeningFilter().Apply(sharpened);
+    result = picture;
+    RegionFilter(new SharpeningFilter(), mask).Apply(result);
+    check(result, sharpened, [&mask](size_t x, size_t y) { return mask.GetElement(x, y); });
+
+    // Filters the negative and counts the pixels it was run on and how many times it copied them.
+    class CountingFilter : public NegativeFilter {
+    public:
+        CountingFilter(size_t& pixels, size_t& copies) : pixels_(pixels), copies_(copies) {
+        }
+        void Apply(Matrix<Pixel>& data) const override {
+            ++copies_;
+            NegativeFilter::Apply(data);
+        }
+        void ApplyView(const MatrixView<Pixel>& view) const override {
+            pixels_ += view.width * view.height;
+            NegativeFilter::ApplyView(view);
+        }
+
+    protected:
+        size_t& pixels_;
+        size_t& copies_;
+    };
+    // Plates in opposite corners are filtered on their own, not in the box holding both of them.
+    BitMask corners(picture.GetWidth(), picture.GetHeight());
+    auto is_in_corner = [&picture](size_t x, size_t y) {
+        return (x < 30 && y < 20) || (x + 30 >= picture.GetWidth() && y + 20 >= picture.GetHeight());
+    };
+    for (size_t y = 0; y < picture.GetHeight(); ++y) {
+        for (size_t x = 0; x < picture.GetWidth(); ++x) {
+            corners.SetElement(x, y, is_in_corner(x, y));
+        }
+    }
+    size_t pixels = 0;
+    size_t copies = 0;
+    result = picture;
+    RegionFilter(new CountingFilter(pixels, copies), corners).Apply(result);
+    check(result, negative, is_in_corner);
+    assert(("Only the plates are filtered, in place", pixels == 2 * 30 * 20 && copies == 0));
+    result = picture;
+    RegionFilter(new SharpeningFilter(), corners).Apply(result);
+    check(result, sharpened, is_in_corner);
+    // A thin diagonal would make a box of the whole picture, its tiles are filtered one by one instead.
+    BitMask diagonal(picture.GetWidth(), picture.GetHeight());
+    for (size_t y = 0; y < picture.GetHeight(); ++y) {
+        diagonal.SetElement(y % picture.GetWidth(), y, true);
+    }
+    pixels = 0;
+    result = picture;
+    RegionFilter(new CountingFilter(pixels, copies), diagonal).Apply(result);
+    check(result, negative, [&diagonal](size_t x, size_t y) { return diagonal.GetElement(x, y); });
+    assert(pixels < picture.GetWidth() * picture.GetHeight() / 4);
+    result = picture;
+    RegionFilter(new SharpeningFilter(), diagonal).Apply(result);
+    check(result, sharpened, [&diagonal](size_t x, size_t y) { return diagonal.GetElement(x, y); });
+
+    bool is_thrown = false;
+    try {
+        Matrix<Pixel> small(10, 10);
+        RegionFilter(new NegativeFilter(), mask).Apply(small);
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(("Masks of another size are rejected", is_thrown));
+
+    std::vector<std::string> arguments = {"-roi", "1", "2", "3", "4", "-blur", "2", "-neg"};
+    std::vector<FilterDescriptor> descriptions(3);
+    descriptions[0].SetFilterName(arguments[0]);
+    descriptions[0].SetParams({arguments[1], arguments[2], arguments[3], arguments[4]});
+    descriptions[1].SetFilterName(arguments[5]);
+    descriptions[1].SetParams({arguments[6]});
+    descriptions[2].SetFilterName(arguments[7]);
+    FilterPipelineMaker maker;
+    FilterMakers::RegisterFilterCreators(maker);
+    FilterPipeline pipeline = maker.BuildPipeline(descriptions);
+    assert(("The region and its filter are one stage", pipeline.GetSize() == 2));
+    assert((maker.GetStageEnds(descriptions) == std::vector<size_t>{2, 3}));
+    descriptions.resize(1);
+    is_thrown = false;
+    try {
+        maker.BuildPipeline(descriptions);
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(("A region needs a filter", is_thrown));
+
+    // Negative and non-numeric coordinates are refused instead of wrapping around.
+    auto is_refused = [&maker](const std::vector<std::string_view>& params) {
+        std::vector<FilterDescriptor> region(2);
+        region[0].SetFilterName("-roi");
+        region[0].SetParams(params);
+        region[1].SetFilterName("-neg");
+        try {
+            maker.BuildPipeline(region);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(("Negative coordinates are refused", is_refused({"-1", "0", "10", "10"})));
+    assert(("Non-numeric coordinates are refused", is_refused({"0", "0", "10", "10px"})));
+    assert(("Valid coordinates are accepted", !is_refused({"0", "0", "10", "10"})));
+}
+
+void FftConvolutionTest() {
+    assert(Fft::GetGoodSize(1) == 1 && Fft::GetGoodSize(7) == 8 && Fft::GetGoodSize(31) == 32);
+    assert(Fft::GetGoodSize(61) == 64 && Fft::GetGoodSize(97) == 100 && Fft::GetGoodSize(121) == 125);
+    for (size_t size = 1; size <= 40; ++size) {
+        Fft::Plan plan(size);
+        std::vector<Fft::Complex> data(size);
+        std::vector<Fft::Complex> scratch(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = {std::sin(static_cast<double>(i * i)), std::cos(static_cast<double>(3 * i))};
+        }
+        std::vector<Fft::Complex> spectrum = data;
+        plan.Transform(spectrum.data(), false, scratch.data());
+        for (size_t k = 0; k < size; ++k) {
+            Fft::Complex expected;
+            for (size_t i = 0; i < size; ++i) {
+                expected += data[i] * std::polar(1.0, -2 * M_PI * static_cast<double>(i * k % size) / size);
+            }
+            assert(("Transform matches the definition", std::abs(spectrum[k] - expected) < 1e-9));
+        }
+        plan.Transform(spectrum.data(), true, scratch.data());
+        for (size_t i = 0; i < size; ++i) {
+            assert(("Inverse transform restores the data", std::abs(spectrum[i] / static_cast<double>(size) - data[i]) < 1e-12));
+        }
+    }
+
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<ColourValue> picture(150, 110);
+    Matrix<double> plane(150, 110);
+    for (size_t y = 0; y < picture.GetHeight(); ++y) {
+        for (size_t x = 0; x < picture.GetWidth(); ++x) {
+            picture.GetElement(x, y) = bitmap.GetData()->GetElement(x + 200, y + 300).GetColourValue();
+            plane.GetElement(x, y) = picture.GetElement(x, y).green;
+        }
+    }
+    for (auto [kernel_width, kernel_height] : std::vector<std::pair<size_t, size_t>>{
+             {1, 1}, {3, 3}, {4, 6}, {17, 17}, {31, 1}, {1, 20}, {25, 13}}) {
+        Matrix<double> kernel(kernel_width, kernel_height);
+        for (size_t y = 0; y < kernel_height; ++y) {
+            for (size_t x = 0; x < kernel_width; ++x) {
+                kernel.GetElement(x, y) = std::sin(static_cast<double>(7 * x + 3 * y)) / (kernel_width * kernel_height);
+            }
+        }
+        ConvolutionEngine engine(kernel);
+        Matrix<ColourValue> direct = picture;
+        engine.ApplyDirect(direct);
+        Matrix<ColourValue> transformed = picture;
+        engine.ApplyFft(transformed);
+        Matrix<double> direct_plane = plane;
+        engine.ApplyDirect(direct_plane);
+        Matrix<double> transformed_plane = plane;
+        engine.ApplyFft(transformed_plane);
+        assert(transformed.GetSize() == picture.GetSize() && transformed_plane.GetSize() == plane.GetSize());
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                ColourValue difference = transformed.GetElement(x, y) - direct.GetElement(x, y);
+                assert(("FFT and direct convolutions agree",
+                        std::max({std::abs(difference.red), std::abs(difference.green), std::abs(difference.blue)}) < 1e-9));
+                assert(std::abs(transformed_plane.GetElement(x, y) - direct_plane.GetElement(x, y)) < 1e-9);
+            }
+        }
+    }
+    assert(("Small kernels go direct", !ConvolutionEngine(Matrix<double>(3, 3)).IsFftCheaper(512, 512, 3)));
+    assert(("Large kernels go through FFT", ConvolutionEngine(Matrix<double>(31, 31)).IsFftCheaper(512, 512, 3)));
+}
+
+void ConvolutionFilterTest() {
+    KernelAnalysis sharpening = AnalyseKernel(Matrix<double>(ManipulatorParameters::SharpeningFilterBase));
+    assert(sharpening.is_symmetric && sharpening.is_integer && !sharpening.is_separable);
+    assert(sharpening.zero_taps == 4 && sharpening.width == 3 && sharpening.height == 3);
+    Matrix<double> binomial({{1, 4, 6, 4, 1}, {2, 8, 12, 8, 2}, {1, 4, 6, 4, 1}});
+    KernelAnalysis separable = AnalyseKernel(binomial);
+    assert(separable.is_separable && separable.is_symmetric && separable.is_integer && separable.zero_taps == 0);
+    for (size_t y = 0; y < 3; ++y) {
+        for (size_t x = 0; x < 5; ++x) {
+            assert(("Rank-1 kernels are split into a column and a row",
+                    std::abs(separable.column[y] * separable.row[x] - binomial.GetElement(x, y)) < 1e-9));
+        }
+    }
+    Matrix<double> emboss({{-2, -1, 0}, {-1, 1, 1}, {0, 1, 2.5}});
+    KernelAnalysis asymmetric = AnalyseKernel(emboss);
+    assert(!asymmetric.is_symmetric && !asymmetric.is_integer && !asymmetric.is_separable);
+
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Pixel> picture = *bitmap.GetData();
+    picture.Crop(200, 300, 150, 110);
+    picture = Matrix<Pixel>(picture);
+    Matrix<double> large(25, 25);
+    for (size_t y = 0; y < 25; ++y) {
+        for (size_t x = 0; x < 25; ++x) {
+            large.GetElement(x, y) = std::cos(static_cast<double>(x * y + x)) / 200;
+        }
+    }
+    Matrix<double> normalised_binomial = binomial;
+    normalised_binomial.Transform([](double weight) { return weight / 64; });
+    for (const Matrix<double>& kernel : {Matrix<double>(ManipulatorParameters::SharpeningFilterBase), normalised_binomial,
+                                         emboss, large}) {
+        Matrix<ColourValue> expected(picture.GetWidth(), picture.GetHeight());
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                expected.GetElement(x, y) = picture.GetElement(x, y).GetColourValue();
+            }
+        }
+        expected.Convolution(kernel);
+        Matrix<Pixel> result = picture;
+        ConvolutionFilter(kernel).Apply(result);
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                ColourValue difference = result.GetElement(x, y).GetColourValue() - Pixel(expected.GetElement(x, y)).GetColourValue();
+                assert(("Every engine gives the direct convolution",
+                        std::max({std::abs(difference.red), std::abs(difference.green), std::abs(difference.blue)}) < 1e-9));
+            }
+        }
+    }
+    assert(ConvolutionFilter(binomial).GetMethod(512, 512, 3) == ConvolutionFilter::Method::Separable);
+    assert(ConvolutionFilter(emboss).GetMethod(512, 512, 3) == ConvolutionFilter::Method::Taps);
+    assert(ConvolutionFilter(large).GetMethod(512, 512, 3) == ConvolutionFilter::Method::Fft);
+    assert(ConvolutionFilter(large).GetMethod(8, 8, 1) == ConvolutionFilter::Method::Taps);
+
+    std::vector<std::string> arguments = {"", "in.bmp", "out.bmp", "-conv", "3", "3", "0", "-1", "0",
+                                          "-1", "5", "-1", "0", "-1", "0", "-neg"};
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    CommandLineParser parser;
+    assert(parser.Parse(static_cast<int>(argv.size()), argv.data()));
+    assert(("Negative numbers are parameters", parser.GetDescriptions().size() == 2));
+    Manipulator* from_arguments = FilterMakers::MakeConvolutionFilter(parser.GetDescriptions()[0]);
+    std::filesystem::path kernel_file = std::filesystem::temp_directory_path() / "image_processor_kernel.txt";
+    {
+        std::ofstream file(kernel_file);
+        file << "0 -1 0\n-1 5 -1\n0 -1 0\n";
+    }
+    FilterDescriptor from_file_descriptor;
+    std::string kernel_path = kernel_file.string();
+    from_file_descriptor.SetFilterName("-conv");
+    from_file_descriptor.SetParams({kernel_path});
+    Manipulator* from_file = FilterMakers::MakeConvolutionFilter(from_file_descriptor);
+    std::filesystem::remove(kernel_file);
+    Matrix<Pixel> sharpened = picture;
+    SharpeningFilter().Apply(sharpened);
+    for (const Manipulator* filter : {from_arguments, from_file}) {
+        Matrix<Pixel> result = picture;
+        filter->Apply(result);
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                ColourValue difference = result.GetElement(x, y).GetColourValue() - sharpened.GetElement(x, y).GetColourValue();
+                assert(("-conv with the sharpening kernel sharpens",
+                        std::max({std::abs(difference.red), std::abs(difference.green), std::abs(difference.blue)}) < 1e-9));
+            }
+        }
+        delete filter;
+    }
+
+    // Sizes, weights and kernel lines that do not parse completely are refused.
+    auto is_refused = [](const std::vector<std::string_view>& params) {
+        FilterDescriptor descriptor;
+        descriptor.SetFilterName("-conv");
+        descriptor.SetParams(params);
+        try {
+            delete FilterMakers::MakeConvolutionFilter(descriptor);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(("Negative sizes are refused", is_refused({"-1", "1", "1"})));
+    assert(("Sizes overflowing their product are refused", is_refused({"9223372036854775807", "9223372036854775807", "1"})));
+    assert(("Non-numeric weights are refused", is_refused({"1", "2", "1", "abc"})));
+    assert(("Valid kernels are accepted", !is_refused({"1", "2", "1", "-0.5"})));
+    {
+        std::ofstream file(kernel_file);
+        file << "0 1 0\n1,2 1\n";
+    }
+    assert(("Lines that stop parsing midway are refused", is_refused({kernel_path})));
+    std::filesystem::remove(kernel_file);
+}
+
+void IntegerConvolutionTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    assert(bitmap.GetStorageFormat() == BitmapParameters::StorageFormat::Bytes);
+    Bitmap colours = bitmap;
+    colours.Convert(BitmapParameters::StorageFormat::Colours);
+    Matrix<double> emboss({{-2, -1, 0}, {-1, 1, 1}, {0, 1, 2}});
+    Matrix<double> heavy(5, 5);
+    heavy.Transform([](double) { return 7; });
+    heavy.GetElement(2, 2) = -160;
+    std::vector<Manipulator*> filters = {new SharpeningFilter(), new ConvolutionFilter(emboss),
+                                         new ConvolutionFilter(heavy)};
+    for (const Manipulator* filter : filters) {
+        Bitmap bytes_result = bitmap;
+        filter->ApplyToBitmap(bytes_result);
+        assert(("Integer kernels keep 8-bit data", bytes_result.GetStorageFormat() == BitmapParameters::StorageFormat::Bytes));
+        Bitmap colours_result = colours;
+        filter->ApplyToBitmap(colours_result);
+        assert(colours_result.GetStorageFormat() == BitmapParameters::StorageFormat::Colours);
+        assert(("Fixed-point and double paths give the same bytes", *bytes_result.GetBytes() == *colours_result.GetBytes()));
+        delete filter;
+    }
+
+    Matrix<uint16_t> plane(97, 61);
+    Matrix<double> expected(97, 61);
+    for (size_t y = 0; y < plane.GetHeight(); ++y) {
+        for (size_t x = 0; x < plane.GetWidth(); ++x) {
+            plane.GetElement(x, y) = static_cast<uint16_t>((x * 7919 + y * 104729) % 65536);
+            expected.GetElement(x, y) = plane.GetElement(x, y) / 65535.0;
+        }
+    }
+    IntegerConvolution convolution(emboss);
+    assert(convolution.IsApplicable<uint8_t>() && convolution.IsApplicable<uint16_t>());
+    Matrix<uint16_t> result(97, 61);
+    convolution.Apply(static_cast<const Matrix<uint16_t>&>(plane).GetView(), result.GetView(), 1);
+    expected.Convolution(emboss);
+    for (size_t y = 0; y < plane.GetHeight(); ++y) {
+        for (size_t x = 0; x < plane.GetWidth(); ++x) {
+            double value = std::round(std::clamp(expected.GetElement(x, y), 0.0, 1.0) * 65535);
+            assert(("16-bit channels are convolved exactly", result.GetElement(x, y) == value));
+        }
+    }
+    Matrix<double> huge(9, 9);
+    huge.Transform([](double) { return 30000; });
+    assert(("Sums beyond 32 bits are refused", !IntegerConvolution(huge).IsApplicable<uint16_t>()));
+    bool is_thrown = false;
+    try {
+        IntegerConvolution(Matrix<double>({{0, 0.5, 0}}));
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(("Fractional weights are refused", is_thrown));
+}
+
+void GaussianBlurTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Pixel> picture = *bitmap.GetData();
+    picture.Crop(300, 250, 60, 45);
+    picture = Matrix<Pixel>(picture);
+    // Both passes over the whole picture with the weights computed on the spot.
+    auto reference_pass = [](const Matrix<ColourValue>& data, double sigma, bool is_vertical) {
+        Matrix<ColourValue> result(data.GetWidth(), data.GetHeight());
+        for (size_t y = 0; y < data.GetHeight(); ++y) {
+            for (size_t x = 0; x < data.GetWidth(); ++x) {
+                ColourValue sum{};
+                size_t length = is_vertical ? data.GetHeight() : data.GetWidth();
+                size_t position = is_vertical ? y : x;
+                for (size_t i = 0; i < length; ++i) {
+                    double distance = static_cast<double>(i) - static_cast<double>(position);
+                    double weight = exp(-distance * distance / (2 * sigma * sigma)) / (sqrt(2 * M_PI) * sigma);
+                    sum += (is_vertical ? data.GetElement(x, i) : data.GetElement(i, y)) * weight;
+                }
+                result.GetElement(x, y) = sum.Saturated();
+            }
+        }
+        return result;
+    };
+    for (double sigma : {0.7, 3.0, 25.0}) {
+        Matrix<ColourValue> expected(picture.GetWidth(), picture.GetHeight());
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                expected.GetElement(x, y) = picture.GetElement(x, y).GetColourValue();
+            }
+        }
+        expected = reference_pass(reference_pass(expected, sigma, true), sigma, false);
+        for (double epsilon : {1e-3, ManipulatorParameters::GAUSSIAN_EPSILON}) {
+            GaussianBlurFilter filter(sigma, epsilon);
+            assert(("Weights are cut", sigma > 20 || filter.GetRadius() < 10 * sigma));
+            Matrix<Pixel> result = picture;
+            filter.Apply(result);
+            for (size_t y = 0; y < picture.GetHeight(); ++y) {
+                for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                    ColourValue difference = result.GetElement(x, y).GetColourValue() - expected.GetElement(x, y);
+                    assert(("The error stays below epsilon",
+                            std::max({std::abs(difference.red), std::abs(difference.green), std::abs(difference.blue)}) <= epsilon));
+                }
+            }
+        }
+    }
+
+    FilterDescriptor precise;
+    precise.SetFilterName("-blur");
+    precise.SetParams({"2", "precise", "1e-4"});
+    Manipulator* filter = FilterMakers::MakeFastGaussianBlurFilter(precise);
+    assert(("The precise mode is selectable", dynamic_cast<GaussianBlurFilter*>(filter) != nullptr));
+    assert(static_cast<GaussianBlurFilter*>(filter)->GetRadius() == GaussianBlurFilter(2, 1e-4).GetRadius());
+    delete filter;
+}
+
+void PyramidGaussianBlurTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Pixel> picture = *bitmap.GetData();
+    picture.Crop(200, 150, 200, 150);
+    picture = Matrix<Pixel>(picture);
+    for (double sigma : {6.0, 60.0}) {
+        PyramidGaussianBlurFilter filter(sigma);
+        assert(("Large sigma goes down the pyramid", (filter.GetLevel() > 0) == (sigma > 20)));
+        assert(("The difference is invisible in 8 bits", filter.GetErrorBound() < 0.5 / 255));
+        Matrix<Pixel> result = picture;
+        filter.Apply(result);
+        Matrix<Pixel> expected = picture;
+        GaussianBlurFilter(sigma).Apply(expected);
+        for (size_t y = 0; y < picture.GetHeight(); ++y) {
+            for (size_t x = 0; x < picture.GetWidth(); ++x) {
+                ColourValue difference = result.GetElement(x, y).GetColourValue() - expected.GetElement(x, y).GetColourValue();
+                assert(("The error stays within the bound",
+                        std::max({std::abs(difference.red), std::abs(difference.green), std::abs(difference.blue)}) <=
+                            filter.GetErrorBound() + ManipulatorParameters::GAUSSIAN_EPSILON));
+            }
+        }
+    }
+
+    FilterDescriptor pyramid;
+    pyramid.SetFilterName("-blur");
+    pyramid.SetParams({"100", "pyramid"});
+    Manipulator* filter = FilterMakers::MakeFastGaussianBlurFilter(pyramid);
+    assert(("The pyramid mode is selectable", dynamic_cast<PyramidGaussianBlurFilter*>(filter) != nullptr));
+    delete filter;
+}
+
+void MedianTest() {
+    // Noise of two channels, the reference sorts every window with the borders extended.
+    const size_t channels = 2;
+    Matrix<uint8_t> noise(channels * 37, 23);
+    uint32_t state = 1;
+    for (size_t y = 0; y < noise.GetHeight(); ++y) {
+        for (size_t x = 0; x < noise.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            noise.GetElement(x, y) = static_cast<uint8_t>(state >> 16);
+        }
+    }
+    const Matrix<uint8_t>& source = noise;
+    for (size_t radius : {0, 1, 2, 7, 30}) {
+        Matrix<uint8_t> result(noise.GetWidth(), noise.GetHeight());
+        Median::Apply(source.GetView(), result.GetView(), channels, radius);
+        for (size_t y = 0; y < noise.GetHeight(); ++y) {
+            for (size_t x = 0; x < noise.GetWidth(); ++x) {
+                std::vector<uint8_t> window;
+                int64_t pixel = static_cast<int64_t>(x / channels);
+                for (int64_t i = -static_cast<int64_t>(radius); i <= static_cast<int64_t>(radius); ++i) {
+                    for (int64_t j = -static_cast<int64_t>(radius); j <= static_cast<int64_t>(radius); ++j) {
+                        int64_t window_x = std::clamp<int64_t>(pixel + j, 0, static_cast<int64_t>(noise.GetWidth() / channels) - 1);
+                        int64_t window_y = std::clamp<int64_t>(static_cast<int64_t>(y) + i, 0, static_cast<int64_t>(noise.GetHeight()) - 1);
+                        window.push_back(source.GetElement(window_x * channels + x % channels, window_y));
+                    }
+                }
+                std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+                assert(("Medians match the sorted windows", result.GetElement(x, y) == window[window.size() / 2]));
+            }
+        }
+        if (radius == 1) {
+            Matrix<uint8_t> histograms(noise.GetWidth(), noise.GetHeight());
+            Median::ApplyHistograms(source.GetView(), histograms.GetView(), channels, radius);
+            assert(("The sorting network gives the histograms' result", histograms == result));
+        }
+    }
+
+    // Salt and pepper on a flat picture is gone in every storage.
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Bitmap::PrimitivePixel>& bytes = *bitmap.GetBytes();
+    bytes.Crop(0, 0, 40, 30);
+    bytes.Transform([](const Bitmap::PrimitivePixel&) { return Bitmap::PrimitivePixel(100, 150, 200); });
+    for (size_t i = 0; i < 20; ++i) {
+        bytes.GetElement(i * 7 % 40, i * 11 % 30) = Bitmap::PrimitivePixel(i % 2 ? 255 : 0, 0, 255);
+    }
+    Matrix<Bitmap::PrimitivePixel> noisy = bytes;
+    MedianFilter filter(2);
+    filter.ApplyBytes(bytes);
+    Matrix<Pixel> colours(noisy.GetWidth(), noisy.GetHeight());
+    for (size_t y = 0; y < noisy.GetHeight(); ++y) {
+        for (size_t x = 0; x < noisy.GetWidth(); ++x) {
+            const Bitmap::PrimitivePixel& pixel = noisy.GetElement(x, y);
+            colours.GetElement(x, y) = Pixel(ColourValue{ColourParameters::FromByte(pixel.red), ColourParameters::FromByte(pixel.green),
+                                                         ColourParameters::FromByte(pixel.blue)});
+            assert(("Impulses are removed", bytes.GetElement(x, y) == Bitmap::PrimitivePixel(100, 150, 200)));
+        }
+    }
+    filter.Apply(colours);
+    for (size_t y = 0; y < colours.GetHeight(); ++y) {
+        for (size_t x = 0; x < colours.GetWidth(); ++x) {
+            assert(("Colours give the bytes' result", ColourParameters::ToByte(colours.GetElement(x, y).GetGreen()) == 150));
+        }
+    }
+    bool is_thrown = false;
+    try {
+        MedianFilter(MedianParameters::MAX_RADIUS + 1);
+    } catch (const std::invalid_argument&) {
+        is_thrown = true;
+    }
+    assert(("Radii overflowing the counts are refused", is_thrown));
+    FilterDescriptor descriptor;
+    descriptor.SetFilterName("-median");
+    descriptor.SetParams({"abc"});
+    is_thrown = false;
+    try {
+        delete FilterMakers::MakeMedianFilter(descriptor);
+    } catch (const std::invalid_argument&) {
+        is_thrown = true;
+    }
+    assert(("Non-numeric radii are refused", is_thrown));
+}
+
+void ResizeTest() {
+    using ResampleParameters::Kernel;
+    for (Kernel kernel : {Kernel::Box, Kernel::Bilinear, Kernel::Bicubic, Kernel::Lanczos}) {
+        for (auto [source, target] : std::vector<std::pair<size_t, size_t>>{{7, 7}, {10, 3}, {3, 10}, {640, 97}}) {
+            Resample::WeightTable table(source, target, kernel);
+            for (size_t i = 0; i < target; ++i) {
+                double sum = 0;
+                for (double weight : table.GetWeights(i)) {
+                    sum += weight;
+                }
+                assert(("Weights are normalised", std::abs(sum - 1) < 1e-9));
+                assert(("Taps stay inside the source", table.GetStart(i) + table.GetTaps() <= source));
+                if (source == target) {
+                    assert(("The same size keeps every element", table.GetWeights(i)[i - table.GetStart(i)] == 1));
+                }
+            }
+        }
+    }
+    Resample::WeightTable halves(4, 2, Kernel::Box);
+    assert(("A box halving averages pairs", halves.GetTaps() == 2 && halves.GetStart(1) == 2 &&
+                                                halves.GetWeights(1)[0] == 0.5 && halves.GetWeights(1)[1] == 0.5));
+
+    // A reduction fused into loading gives what the filter does with the whole picture.
+    ResizeFilter filter(100, 80, Kernel::Lanczos);
+    auto [min_width, min_height] = filter.GetMinLoadSize();
+    Bitmap reduced;
+    assert(reduced.load("../examples/notyan.bmp", min_width, min_height));
+    assert(("The loader reduces", reduced.GetBytes()->GetWidth() == 320 && reduced.GetBytes()->GetHeight() == 320));
+    Bitmap full;
+    assert(full.load("../examples/notyan.bmp"));
+    Matrix<Pixel> colours = *full.GetData();
+    filter.ApplyBytes(*reduced.GetBytes());
+    filter.ApplyBytes(*full.GetBytes());
+    assert(("Loading reduced changes nothing", *reduced.GetBytes() == *full.GetBytes()));
+    assert(full.GetBytes()->GetWidth() == 100 && full.GetBytes()->GetHeight() == 80);
+    filter.Apply(colours);
+    for (size_t y = 0; y < colours.GetHeight(); ++y) {
+        for (size_t x = 0; x < colours.GetWidth(); ++x) {
+            assert(("Colours give the bytes' result",
+                    std::abs(colours.GetElement(x, y).GetRed() - ColourParameters::FromByte(full.GetBytes()->GetElement(x, y).red)) < 2.0 / 255));
+        }
+    }
+
+    Matrix<ColourParameters::ColourType> flat(37, 29);
+    flat.Transform([](ColourParameters::ColourType) { return 0.25; });
+    for (Kernel kernel : {Kernel::Box, Kernel::Bilinear, Kernel::Bicubic, Kernel::Lanczos}) {
+        Matrix<ColourParameters::ColourType> resized = flat;
+        ResizeFilter(80, 11, kernel).ApplyGreyscale(resized);
+        assert(resized.GetWidth() == 80 && resized.GetHeight() == 11);
+        for (size_t y = 0; y < resized.GetHeight(); ++y) {
+            for (size_t x = 0; x < resized.GetWidth(); ++x) {
+                assert(("Flat pictures stay flat", std::abs(resized.GetElement(x, y) - 0.25) < 1e-9));
+            }
+        }
+    }
+
+    auto is_refused = [](const std::vector<std::string_view>& params) {
+        FilterDescriptor descriptor;
+        descriptor.SetFilterName("-resize");
+        descriptor.SetParams(params);
+        try {
+            delete FilterMakers::MakeResizeFilter(descriptor);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(("Unknown kernels are refused", is_refused({"10", "10", "nearest"})));
+    assert(("Negative sizes are refused", is_refused({"-5", "10"})));
+    assert(("Sizes with units are refused", is_refused({"100x", "10"})));
+    assert(("Oversized sizes are refused", is_refused({"10", "100000000"})));
+    assert(("Valid sizes are accepted", !is_refused({"100", "10", "box"})));
+}
+
+void BilateralTest() {
+    // A noisy step with a slope, the reference sums the Gaussian weights within 3 sigma_s of every pixel.
+    Matrix<double> step(96, 80);
+    uint32_t state = 1;
+    for (size_t y = 0; y < step.GetHeight(); ++y) {
+        for (size_t x = 0; x < step.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            step.GetElement(x, y) = (x + y < 90 ? 0.2 : 0.7) + 0.002 * static_cast<double>(x) +
+                                    0.15 * static_cast<double>((state >> 16) % 256) / 255;
+        }
+    }
+    const Matrix<double>& source = step;
+    for (double sigma_spatial : {2.0, 8.0}) {
+        for (double sigma_range : {0.05, 0.3}) {
+            Matrix<double> result(step.GetWidth(), step.GetHeight());
+            Bilateral::Apply(source.GetView(), source.GetView(), result.GetView(), sigma_spatial, sigma_range);
+            int64_t reach = static_cast<int64_t>(ceil(3 * sigma_spatial));
+            double error = 0;
+            double change = 0;
+            for (size_t y = 0; y < step.GetHeight(); ++y) {
+                for (size_t x = 0; x < step.GetWidth(); ++x) {
+                    double centre = source.GetElement(x, y);
+                    double sum = 0;
+                    double weights = 0;
+                    for (int64_t i = -reach; i <= reach; ++i) {
+                        for (int64_t j = -reach; j <= reach; ++j) {
+                            int64_t window_x = static_cast<int64_t>(x) + j;
+                            int64_t window_y = static_cast<int64_t>(y) + i;
+                            if (window_x < 0 || window_y < 0 || window_x >= static_cast<int64_t>(step.GetWidth()) ||
+                                window_y >= static_cast<int64_t>(step.GetHeight())) {
+                                continue;
+                            }
+                            double value = source.GetElement(window_x, window_y);
+                            double weight = exp(-static_cast<double>(i * i + j * j) / (2 * sigma_spatial * sigma_spatial) -
+                                                (value - centre) * (value - centre) / (2 * sigma_range * sigma_range));
+                            sum += weight * value;
+                            weights += weight;
+                        }
+                    }
+                    double expected = sum / weights;
+                    assert(("Every pixel is close to the reference", std::abs(result.GetElement(x, y) - expected) < 0.04));
+                    error += std::abs(result.GetElement(x, y) - expected);
+                    change += std::abs(centre - expected);
+                }
+            }
+            assert(("The mean error is small next to the filter's change", error < 0.15 * change));
+
+            // Strips of a single grid row give the same picture as the whole grid.
+            Bilateral::ApplyGrid(source.GetView(), source.GetView(), result.GetView(), sigma_spatial, sigma_range);
+            Matrix<double> strips(step.GetWidth(), step.GetHeight());
+            Bilateral::ApplyGrid(source.GetView(), source.GetView(), strips.GetView(), sigma_spatial, sigma_range, 1);
+            for (size_t y = 0; y < step.GetHeight(); ++y) {
+                for (size_t x = 0; x < step.GetWidth(); ++x) {
+                    assert(("Strips match the whole grid",
+                            std::abs(strips.GetElement(x, y) - result.GetElement(x, y)) < 1e-9));
+                }
+            }
+        }
+    }
+
+    // Tiny sigmas would make huge grids swept a row at a time: they are filtered directly, and a spatial sigma
+    // far below a pixel leaves the picture as it is.
+    const size_t cell_size = sizeof(Bilateral::Cell<double>);
+    assert(("Tiny sigmas are filtered directly", Bilateral::IsDirectCheaper(512, 512, 0.01, 0.001, cell_size,
+                                                                            BilateralParameters::GRID_BUDGET)));
+    assert(("Wide sigmas use the grid", !Bilateral::IsDirectCheaper(512, 512, 8, 0.1, cell_size,
+                                                                    BilateralParameters::GRID_BUDGET)));
+    Matrix<double> direct(step.GetWidth(), step.GetHeight());
+    Bilateral::Apply(source.GetView(), source.GetView(), direct.GetView(), 0.01, 0.001);
+    for (size_t y = 0; y < step.GetHeight(); ++y) {
+        for (size_t x = 0; x < step.GetWidth(); ++x) {
+            assert(("A tiny spatial sigma keeps the picture",
+                    std::abs(direct.GetElement(x, y) - source.GetElement(x, y)) < 1e-9));
+        }
+    }
+
+    // A flat picture stays flat in every storage, and the step keeps its edge.
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    Matrix<Bitmap::PrimitivePixel>& bytes = *bitmap.GetBytes();
+    bytes.Crop(0, 0, 40, 30);
+    bytes.Transform([](const Bitmap::PrimitivePixel&) { return Bitmap::PrimitivePixel(100, 150, 200); });
+    Matrix<Bitmap::PrimitivePixel> flat = bytes;
+    BilateralFilter filter(5, 0.1);
+    bitmap.Convert(BitmapParameters::StorageFormat::Colours);
+    filter.ApplyToBitmap(bitmap);
+    assert(("A flat picture stays flat", *bitmap.GetBytes() == flat));
+    Matrix<double> grey(40, 30);
+    grey.Transform([](double) { return 0.4; });
+    filter.ApplyGreyscale(grey);
+    for (size_t y = 0; y < grey.GetHeight(); ++y) {
+        for (size_t x = 0; x < grey.GetWidth(); ++x) {
+            assert(("A flat plane stays flat", std::abs(grey.GetElement(x, y) - 0.4) < 1e-9));
+        }
+    }
+    Matrix<double> edge = step;
+    BilateralFilter(8, 0.05).ApplyGreyscale(edge);
+    assert(("The edge is kept", edge.GetElement(40, 40) < 0.5 && edge.GetElement(50, 50) > 0.6));
+}
+
+void IntegralTest() {
+    // Rectangle sums and the sums of squares of two channels of noise against plain loops.
+    const size_t channels = 2;
+    Matrix<uint8_t> noise(channels * 37, 23);
+    uint32_t state = 7;
+    for (size_t y = 0; y < noise.GetHeight(); ++y) {
+        for (size_t x = 0; x < noise.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            noise.GetElement(x, y) = static_cast<uint8_t>(state >> 16);
+        }
+    }
+    const Matrix<uint8_t>& source = noise;
+    Integral::SummedAreaTable<uint32_t> sums(source.GetView(), channels);
+    Integral::SummedAreaTable<uint64_t> squares(source.GetView(), channels,
+                                                [](uint8_t value) { return static_cast<uint64_t>(value) * value; });
+    // 16-bit sums wrap around many times over the table, the sums of small rectangles are still exact.
+    Integral::SummedAreaTable<uint16_t> wrapped(source.GetView(), channels);
+    assert(sums.GetWidth() == 37 && sums.GetHeight() == 23);
+    for (size_t i = 0; i < 200; ++i) {
+        state = state * 1103515245 + 12345;
+        size_t left = (state >> 8) % 37;
+        size_t top = (state >> 16) % 23;
+        Integral::Rectangle rectangle{left, top, left + 1 + (state >> 4) % (37 - left), top + 1 + (state >> 12) % (23 - top)};
+        for (size_t c = 0; c < channels; ++c) {
+            uint64_t sum = 0;
+            uint64_t square_sum = 0;
+            for (size_t y = rectangle.top; y < rectangle.bottom; ++y) {
+                for (size_t x = rectangle.left; x < rectangle.right; ++x) {
+                    uint64_t value = source.GetElement(x * channels + c, y);
+                    sum += value;
+                    square_sum += value * value;
+                }
+            }
+            assert(("Rectangle sums match", sums.GetSum(rectangle, c) == sum));
+            assert(("Sums of squares match", squares.GetSum(rectangle, c) == square_sum));
+            if (sum <= UINT16_MAX) {
+                assert(("Wrapped sums stay exact while the rectangle fits", wrapped.GetSum(rectangle, c) == sum));
+            }
+        }
+    }
+
+    // Box means against the windows cut at the borders, for every radius.
+    for (size_t radius : {0, 1, 4, 40}) {
+        Matrix<uint8_t> result(noise.GetWidth(), noise.GetHeight());
+        Integral::BoxMean<uint32_t>(source.GetView(), result.GetView(), channels, radius);
+        for (size_t y = 0; y < noise.GetHeight(); ++y) {
+            for (size_t x = 0; x < noise.GetWidth(); ++x) {
+                Integral::Rectangle window = sums.GetWindow(x / channels, y, radius);
+                uint32_t sum = 0;
+                for (size_t window_y = window.top; window_y < window.bottom; ++window_y) {
+                    for (size_t window_x = window.left; window_x < window.right; ++window_x) {
+                        sum += source.GetElement(window_x * channels + x % channels, window_y);
+                    }
+                }
+                uint32_t area = static_cast<uint32_t>(window.GetArea());
+                assert(("Means are rounded to the nearest", result.GetElement(x, y) == (sum + area / 2) / area));
+            }
+        }
+    }
+
+    // The filter gives the same bytes, within rounding, for bytes and for colours.
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    bitmap.GetBytes()->Crop(100, 100, 120, 90);
+    Bitmap colours = bitmap;
+    colours.Convert(BitmapParameters::StorageFormat::Colours);
+    BoxBlurFilter filter(6);
+    filter.ApplyToBitmap(bitmap);
+    filter.ApplyToBitmap(colours);
+    const Matrix<Bitmap::PrimitivePixel>& bytes_result = *bitmap.GetBytes();
+    const Matrix<Bitmap::PrimitivePixel>& colours_result = *colours.GetBytes();
+    for (size_t y = 0; y < bytes_result.GetHeight(); ++y) {
+        for (size_t x = 0; x < bytes_result.GetWidth(); ++x) {
+            assert(("Bytes and colours agree", std::abs(bytes_result.GetElement(x, y).green -
+                                                        colours_result.GetElement(x, y).green) <= 1));
+        }
+    }
+
+    // A faint step is lost under the global threshold and found by the adaptive one, only on its bright side.
+    Matrix<Pixel> step(40, 30);
+    step.Transform([](const Pixel&) { return Pixel(0.4); });
+    for (size_t y = 0; y < step.GetHeight(); ++y) {
+        for (size_t x = 20; x < step.GetWidth(); ++x) {
+            step.GetElement(x, y) = Pixel(0.5);
+        }
+    }
+    Matrix<Pixel> global = step;
+    EdgeDetectionFilter(0.33).Apply(global);
+    AdaptiveEdgeDetectionFilter(3, 0.05).Apply(step);
+    for (size_t y = 0; y < step.GetHeight(); ++y) {
+        for (size_t x = 0; x < step.GetWidth(); ++x) {
+            assert(("The global threshold misses the step", global.GetElement(x, y).GetRed() == 0));
+            assert(("The adaptive threshold finds it", step.GetElement(x, y).GetRed() == (x == 20 ? 1 : 0)));
+        }
+    }
+
+    // Negative, non-numeric and oversized radii are refused instead of wrapping around.
+    auto is_refused = [](const std::string& name, const std::vector<std::string_view>& params) {
+        FilterDescriptor descriptor;
+        descriptor.SetFilterName(name);
+        descriptor.SetParams(params);
+        try {
+            delete (name == "-boxblur" ? FilterMakers::MakeBoxBlurFilter(descriptor)
+                                       : FilterMakers::MakeEdgeDetectionFilter(descriptor));
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(("Negative box radii are refused", is_refused("-boxblur", {"-3"})));
+    assert(("Non-numeric box radii are refused", is_refused("-boxblur", {"three"})));
+    assert(("Oversized box radii are refused", is_refused("-boxblur", {"100000"})));
+    assert(("Negative window radii are refused", is_refused("-edge", {"adaptive", "-1"})));
+    assert(("Valid radii are accepted", !is_refused("-boxblur", {"3"}) && !is_refused("-edge", {"adaptive", "2"})));
+}
+
+void MorphologyTest() {
+    // Minima and maxima of two channels of noise against the windows cut at the borders.
+    const size_t channels = 2;
+    Matrix<uint8_t> noise(channels * 45, 23);
+    uint32_t state = 3;
+    for (size_t y = 0; y < noise.GetHeight(); ++y) {
+        for (size_t x = 0; x < noise.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            noise.GetElement(x, y) = static_cast<uint8_t>(state >> 16);
+        }
+    }
+    const Matrix<uint8_t>& source = noise;
+    auto extremum = [](const Matrix<uint8_t>& data, size_t channels, Morphology::Window horizontal,
+                       Morphology::Window vertical, bool maximum) {
+        Matrix<uint8_t> result(data.GetWidth(), data.GetHeight());
+        int64_t width = static_cast<int64_t>(data.GetWidth() / channels);
+        int64_t height = static_cast<int64_t>(data.GetHeight());
+        for (int64_t y = 0; y < height; ++y) {
+            for (int64_t x = 0; x < width; ++x) {
+                for (size_t c = 0; c < channels; ++c) {
+                    uint8_t value = maximum ? 0 : 255;
+                    for (int64_t i = 0; i < static_cast<int64_t>(vertical.size); ++i) {
+                        for (int64_t j = 0; j < static_cast<int64_t>(horizontal.size); ++j) {
+                            int64_t window_x = x + j - static_cast<int64_t>(horizontal.before);
+                            int64_t window_y = y + i - static_cast<int64_t>(vertical.before);
+                            if (window_x >= 0 && window_y >= 0 && window_x < width && window_y < height) {
+                                uint8_t element = data.GetElement(window_x * channels + c, window_y);
+                                value = maximum ? std::max(value, element) : std::min(value, element);
+                            }
+                        }
+                    }
+                    result.GetElement(x * channels + c, y) = value;
+                }
+            }
+        }
+        return result;
+    };
+    const std::pair<size_t, size_t> sizes[] = {{1, 1}, {3, 3}, {4, 2}, {7, 5}, {40, 1}, {1, 30}};
+    for (const auto& [width, height] : sizes) {
+        Morphology::Window horizontal = Morphology::Window::Centred(width);
+        Morphology::Window vertical = Morphology::Window::Centred(height);
+        Matrix<uint8_t> eroded = extremum(source, channels, horizontal, vertical, false);
+        Matrix<uint8_t> dilated = extremum(source, channels, horizontal, vertical, true);
+        Matrix<uint8_t> opened = extremum(eroded, channels, horizontal.Reflected(), vertical.Reflected(), true);
+        Matrix<uint8_t> closed = extremum(dilated, channels, horizontal.Reflected(), vertical.Reflected(), false);
+        const std::pair<MorphologyParameters::Operation, const Matrix<uint8_t>*> expected[] = {
+            {MorphologyParameters::Operation::Erode, &eroded},
+            {MorphologyParameters::Operation::Dilate, &dilated},
+            {MorphologyParameters::Operation::Open, &opened},
+            {MorphologyParameters::Operation::Close, &closed}};
+        for (const auto& [operation, reference] : expected) {
+            Matrix<uint8_t> result(noise.GetWidth(), noise.GetHeight());
+            Morphology::Apply(operation, source.GetView(), result.GetView(), channels, horizontal, vertical);
+            assert(("Van Herk/Gil-Werman matches the plain windows", result == *reference));
+        }
+    }
+
+    // Packed masks give the bytes' result, also for rows spanning several words and windows wider than a word.
+    BitMask mask(150, 20);
+    Matrix<uint8_t> bits(150, 20);
+    for (size_t y = 0; y < mask.GetHeight(); ++y) {
+        for (size_t x = 0; x < mask.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            bool bit = (state >> 16) % 5 < 2;
+            mask.SetElement(x, y, bit);
+            bits.GetElement(x, y) = bit;
+        }
+    }
+    const std::pair<size_t, size_t> mask_sizes[] = {{1, 1}, {2, 2}, {3, 5}, {8, 6}, {64, 1}, {70, 3}, {1, 9}};
+    for (const auto& [width, height] : mask_sizes) {
+        Morphology::Window horizontal = Morphology::Window::Centred(width);
+        Morphology::Window vertical = Morphology::Window::Centred(height);
+        for (auto operation : {MorphologyParameters::Operation::Erode, MorphologyParameters::Operation::Dilate,
+                               MorphologyParameters::Operation::Open, MorphologyParameters::Operation::Close}) {
+            BitMask result = Morphology::Apply(operation, mask, horizontal, vertical);
+            Matrix<uint8_t> expected(bits.GetWidth(), bits.GetHeight());
+            Morphology::Apply(operation, static_cast<const Matrix<uint8_t>&>(bits).GetView(), expected.GetView(), 1,
+                              horizontal, vertical);
+            for (size_t y = 0; y < mask.GetHeight(); ++y) {
+                for (size_t x = 0; x < mask.GetWidth(); ++x) {
+                    assert(("Masks match bytes", result.GetElement(x, y) == static_cast<bool>(expected.GetElement(x, y))));
+                }
+                assert(("Unused bits stay zero", result.GetRow(y)[2] >> (150 - 128) == 0));
+            }
+        }
+    }
+
+    // Edge masks stay masks; with the darker colour set the filter dilates the brighter one all the same.
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    EdgeDetectionFilter(0.1).ApplyToBitmap(bitmap);
+    Bitmap inverted;
+    BitMask complement = *bitmap.GetMask();
+    for (size_t y = 0; y < complement.GetHeight(); ++y) {
+        for (size_t x = 0; x < complement.GetWidth(); ++x) {
+            complement.SetElement(x, y, !complement.GetElement(x, y));
+        }
+    }
+    inverted.SetMask(std::move(complement), Pixel(1.0), Pixel(0.0));
+    MorphologyFilter filter(MorphologyParameters::Operation::Close, 3, 3);
+    filter.ApplyToBitmap(bitmap);
+    filter.ApplyToBitmap(inverted);
+    assert(bitmap.GetStorageFormat() == BitmapParameters::StorageFormat::Mask);
+    assert(("The colours decide what is dilated", *bitmap.GetBytes() == *inverted.GetBytes()));
+
+    // Negative, non-numeric and oversized sides are refused instead of wrapping around.
+    auto is_refused = [](const std::vector<std::string_view>& params) {
+        FilterDescriptor descriptor;
+        descriptor.SetFilterName("-erode");
+        descriptor.SetParams(params);
+        try {
+            delete FilterMakers::MakeMorphologyFilter(descriptor);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(("Negative sides are refused", is_refused({"-2"}) && is_refused({"3", "-1"})));
+    assert(("Non-numeric sides are refused", is_refused({"wide"}) && is_refused({"3", "3x"})));
+    assert(("Oversized sides are refused", is_refused({"100000"})));
+    assert(("Valid sides are accepted", !is_refused({"3"}) && !is_refused({"5", "3"})));
+}
+
+void OrientationTest() {
+    // Every orientation against its formula, on pictures large enough to be split into tiles and bands.
+    using OrientationParameters::Operation;
+    for (auto [width, height] : {std::pair<size_t, size_t>{7, 5}, {203, 131}}) {
+        Matrix<uint32_t> picture(width, height);
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                picture.GetElement(x, y) = static_cast<uint32_t>(y * 1000 + x);
+            }
+        }
+        const Matrix<uint32_t>& source = picture;
+        for (auto operation : {Operation::FlipHorizontal, Operation::FlipVertical, Operation::Rotate90,
+                                 Operation::Rotate180, Operation::Rotate270, Operation::Transpose}) {
+            Matrix<uint32_t> result = Orientation::Apply(operation, source.GetView());
+            bool transposed = Orientation::IsTransposing(operation);
+            assert(result.GetWidth() == (transposed ? height : width));
+            assert(result.GetHeight() == (transposed ? width : height));
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    const std::pair<size_t, size_t> places[] = {{width - x - 1, y},          {x, height - y - 1},
+                                                                {height - y - 1, x},         {width - x - 1, height - y - 1},
+                                                                {y, width - x - 1},          {y, x}};
+                    auto [target_x, target_y] = places[static_cast<size_t>(operation)];
+                    assert(("Pixels land where the operation puts them",
+                            result.GetElement(target_x, target_y) == source.GetElement(x, y)));
+                }
+            }
+        }
+    }
+
+    // Top-down files: the rows of a saved picture are reversed and its height negated. Loading gives the same
+    // picture, in every layout and for fused reductions, and saving keeps the file top-down.
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    auto make_top_down = [](const std::filesystem::path& bottom_up, const std::filesystem::path& top_down) {
+        std::ifstream input(bottom_up, std::ios_base::binary);
+        std::vector<char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        int32_t width = 0;
+        int32_t height = 0;
+        uint16_t bits_per_pixel = 0;
+        uint32_t offset = 0;
+        std::memcpy(&offset, file.data() + 10, sizeof(offset));
+        std::memcpy(&width, file.data() + 18, sizeof(width));
+        std::memcpy(&height, file.data() + 22, sizeof(height));
+        std::memcpy(&bits_per_pixel, file.data() + 28, sizeof(bits_per_pixel));
+        size_t row_size = (static_cast<size_t>(width) * bits_per_pixel + 31) / 32 * 4;
+        std::vector<char> flipped(file.begin(), file.begin() + offset);
+        for (int32_t y = height - 1; y >= 0; --y) {
+            auto row = file.begin() + offset + static_cast<std::ptrdiff_t>(y * row_size);
+            flipped.insert(flipped.end(), row, row + static_cast<std::ptrdiff_t>(row_size));
+        }
+        height = -height;
+        std::memcpy(flipped.data() + 22, &height, sizeof(height));
+        std::ofstream output(top_down, std::ios_base::binary);
+        output.write(flipped.data(), static_cast<std::streamsize>(flipped.size()));
+        return flipped;
+    };
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    bitmap.GetBytes()->Crop(10, 20, 101, 37);
+    Bitmap mask_bitmap = bitmap;
+    EdgeDetectionFilter(0.1).ApplyToBitmap(mask_bitmap);
+    mask_bitmap.SetOutputBitsPerPixel(BitmapParameters::MASK_BITS_PER_PIXEL);
+    for (Bitmap* picture : {&bitmap, &mask_bitmap}) {
+        std::filesystem::path bottom_up = directory / "image_processor_bottom_up.bmp";
+        std::filesystem::path top_down = directory / "image_processor_top_down.bmp";
+        std::filesystem::path saved = directory / "image_processor_saved.bmp";
+        assert(picture->save(bottom_up.string().c_str()));
+        std::vector<char> top_down_file = make_top_down(bottom_up, top_down);
+        Bitmap expected;
+        Bitmap loaded;
+        assert(expected.load(bottom_up.string().c_str()));
+        assert(loaded.load(top_down.string().c_str()));
+        assert(("Top-down files load the same picture", *loaded.GetBytes() == *expected.GetBytes()));
+        if (picture == &bitmap) {
+            Bitmap expected_reduced;
+            Bitmap loaded_reduced;
+            assert(expected_reduced.load(bottom_up.string().c_str(), 30, 10));
+            assert(loaded_reduced.load(top_down.string().c_str(), 30, 10));
+            assert(("Fused reductions agree", *loaded_reduced.GetBytes() == *expected_reduced.GetBytes()));
+        }
+        loaded.SetOutputBitsPerPixel(picture == &bitmap ? BitmapParameters::COLOUR_BITS_PER_PIXEL
+                                                        : BitmapParameters::MASK_BITS_PER_PIXEL);
+        assert(loaded.save(saved.string().c_str()));
+        std::ifstream input(saved, std::ios_base::binary);
+        std::vector<char> saved_file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        assert(("Top-down pictures are saved top-down", saved_file == top_down_file));
+        for (const std::filesystem::path& path : {bottom_up, top_down, saved}) {
+            std::filesystem::remove(path);
+        }
+    }
+
+    // The filters on every storage, and the same-size ones on regions.
+    OrientationFilter rotate(Operation::Rotate90);
+    Bitmap colours = bitmap;
+    colours.Convert(BitmapParameters::StorageFormat::Colours);
+    rotate.ApplyToBitmap(bitmap);
+    rotate.ApplyToBitmap(colours);
+    assert(bitmap.GetBytes()->GetWidth() == 37 && bitmap.GetBytes()->GetHeight() == 101);
+    assert(("Bytes and colours agree", *bitmap.GetBytes() == *colours.GetBytes()));
+    Matrix<Pixel> region = *colours.GetData();
+    Matrix<Pixel> flipped = region;
+    OrientationFilter(Operation::FlipVertical).ApplyView(flipped.GetView(0, 0, 37, 50));
+    assert(("Regions are flipped inside", flipped.GetElement(3, 0).GetRed() == region.GetElement(3, 49).GetRed() &&
+                                              flipped.GetElement(3, 60).GetRed() == region.GetElement(3, 60).GetRed()));
+}
+
+void StatisticsTest() {
+    // Three channels of noise against plain loops: the histograms count the 8-bit values, the percentiles are
+    // those of the sorted values rounded to them.
+    const size_t channels = 3;
+    Matrix<double> noise(channels * 53, 41);
+    uint32_t state = 11;
+    for (size_t y = 0; y < noise.GetHeight(); ++y) {
+        for (size_t x = 0; x < noise.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            // The last channel keeps to [0.25, 0.5], away from the ends of the histogram.
+            double value = static_cast<double>(state >> 8) / (1 << 24);
+            noise.GetElement(x, y) = x % channels == 2 ? 0.25 + value / 4 : value;
+        }
+    }
+    const Matrix<double>& source = noise;
+    std::vector<Statistics::Channel> statistics = Statistics::Compute(source.GetView(), channels, std::identity{});
+    assert(statistics.size() == channels);
+    for (size_t c = 0; c < channels; ++c) {
+        std::vector<double> values;
+        std::vector<uint64_t> histogram(StatisticsParameters::BINS);
+        for (size_t y = 0; y < noise.GetHeight(); ++y) {
+            for (size_t x = c; x < noise.GetWidth(); x += channels) {
+                values.push_back(source.GetElement(x, y));
+                ++histogram[ColourParameters::ToByte(source.GetElement(x, y))];
+            }
+        }
+        double mean = 0;
+        for (double value : values) {
+            mean += value / static_cast<double>(values.size());
+        }
+        double variance = 0;
+        for (double value : values) {
+            variance += (value - mean) * (value - mean) / static_cast<double>(values.size());
+        }
+        std::sort(values.begin(), values.end());
+        const Statistics::Channel& channel = statistics[c];
+        assert(("Every value is counted", channel.GetCount() == values.size()));
+        assert(("Extrema match", channel.GetMin() == values.front() && channel.GetMax() == values.back()));
+        assert(("Means match", std::abs(channel.GetMean() - mean) < 1e-12));
+        assert(("Variances match", std::abs(channel.GetVariance() - variance) < 1e-12));
+        assert(("Histograms match", channel.GetHistogram() == histogram));
+        for (double fraction : {0.0, 0.01, 0.3, 0.5, 0.99, 1.0}) {
+            size_t rank = std::max<size_t>(1, static_cast<size_t>(std::ceil(fraction * values.size())));
+            double expected = std::clamp(ColourParameters::FromByte(ColourParameters::ToByte(values[rank - 1])),
+                                         values.front(), values.back());
+            assert(("Percentiles match", std::abs(channel.GetPercentile(fraction) - expected) < 1e-12));
+        }
+    }
+    // The statistics of two bands merged are those of the whole.
+    Statistics::Channel top;
+    Statistics::Channel bottom;
+    for (size_t y = 0; y < noise.GetHeight(); ++y) {
+        for (size_t x = 0; x < noise.GetWidth(); x += channels) {
+            (y < 10 ? top : bottom).Add(source.GetElement(x, y));
+        }
+    }
+    top.Merge(bottom);
+    assert(("Merged histograms match", top.GetHistogram() == statistics[0].GetHistogram()));
+    assert(("Merged variances match", std::abs(top.GetVariance() - statistics[0].GetVariance()) < 1e-12));
+
+    // The same picture gives the same report from 8-bit pixels and from colours, and is passed on unchanged.
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    bitmap.GetBytes()->Crop(100, 100, 120, 90);
+    Bitmap colours = bitmap;
+    colours.Convert(BitmapParameters::StorageFormat::Colours);
+    Matrix<Bitmap::PrimitivePixel> original = *bitmap.GetBytes();
+    StatisticsFilter((directory / "image_processor_bytes.json").string()).ApplyToBitmap(bitmap);
+    StatisticsFilter((directory / "image_processor_colours.json").string()).ApplyToBitmap(colours);
+    assert(("The bytes stay", bitmap.GetStorageFormat() == BitmapParameters::StorageFormat::Bytes));
+    assert(("The picture is unchanged", *bitmap.GetBytes() == original));
+    auto read = [](const std::filesystem::path& path) {
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    };
+    std::string report = read(directory / "image_processor_bytes.json");
+    assert(("Reports match", report == read(directory / "image_processor_colours.json")));
+    assert(("The report has the size and channels",
+            report.find("\"width\": 120") != std::string::npos && report.find("\"blue\"") != std::string::npos &&
+                report.find("\"50\": ") != std::string::npos));
+    std::filesystem::remove(directory / "image_processor_bytes.json");
+    std::filesystem::remove(directory / "image_processor_colours.json");
+
+    // Auto levels stretch a dull gradient to the full range, the same from bytes and from colours.
+    Matrix<Pixel> gradient(64, 8);
+    for (size_t y = 0; y < gradient.GetHeight(); ++y) {
+        for (size_t x = 0; x < gradient.GetWidth(); ++x) {
+            gradient.GetElement(x, y) = Pixel(0.2 + 0.4 * x / 63, 0.3, 0.5 - 0.2 * x / 63);
+        }
+    }
+    Bitmap dull;
+    assert(dull.load("../examples/notyan.bmp"));
+    dull.Convert(BitmapParameters::StorageFormat::Colours);
+    *dull.GetData() = gradient;
+    Bitmap dull_bytes = dull;
+    dull_bytes.Convert(BitmapParameters::StorageFormat::Bytes);
+    AutoLevelsFilter levels(0, 1);
+    levels.ApplyToBitmap(dull);
+    levels.ApplyToBitmap(dull_bytes);
+    const Matrix<Pixel>& stretched = *dull.GetData();
+    assert(("The darkest red becomes black", std::abs(stretched.GetElement(0, 0).GetRed()) < 1e-9));
+    assert(("The brightest red becomes white", std::abs(stretched.GetElement(63, 0).GetRed() - 1) < 1e-9));
+    assert(("The blue is stretched the other way", std::abs(stretched.GetElement(0, 0).GetBlue() - 1) < 1e-9));
+    assert(("A flat channel is left", std::abs(stretched.GetElement(10, 3).GetGreen() - 0.3) < 1e-9));
+    for (size_t x = 0; x < gradient.GetWidth(); ++x) {
+        assert(("Bytes and colours agree",
+                std::abs(ColourParameters::ToByte(stretched.GetElement(x, 0).GetRed()) -
+                         dull_bytes.GetBytes()->GetElement(x, 0).red) <= 2));
+    }
+
+    // The automatic edge threshold keeps about the asked fraction of a noisy picture and nothing of a flat one.
+    Matrix<Pixel> speckles(80, 60);
+    for (size_t y = 0; y < speckles.GetHeight(); ++y) {
+        for (size_t x = 0; x < speckles.GetWidth(); ++x) {
+            state = state * 1103515245 + 12345;
+            speckles.GetElement(x, y) = Pixel(static_cast<double>(state >> 8) / (1 << 24));
+        }
+    }
+    Matrix<Pixel> flat(80, 60);
+    flat.Transform([](const Pixel&) { return Pixel(0.7); });
+    AutoEdgeDetectionFilter(0.1).Apply(speckles);
+    AutoEdgeDetectionFilter(0.1).Apply(flat);
+    size_t edges = 0;
+    for (size_t y = 0; y < speckles.GetHeight(); ++y) {
+        for (size_t x = 0; x < speckles.GetWidth(); ++x) {
+            edges += speckles.GetElement(x, y).GetRed() == 1;
+            assert(("A flat picture has no edges", flat.GetElement(x, y).GetRed() == 0));
+        }
+    }
+    assert(("The fraction of edges is kept", std::abs(static_cast<double>(edges) / (80 * 60) - 0.1) < 0.01));
+}
+
 void CommandLineParserTest() {
     CommandLineParser parser1;
     std::vector<std::string> params({"", "input.bmp", "output.bmp", "-filter1", "param", "param2", "-filter2"});
@@ -154,7 +1473,7 @@ void BitmapTest() {
 
     Bitmap bitmap;
 
-    std::string str1 = "../examples/output.bmp";
+    std::string str1 = "../examples/gradient.bmp";
     assert(bitmap.load(str1.c_str()));
 
     std::string str2 = "../examples/notyan.jpg";
@@ -219,6 +1538,704 @@ void LagrangePolyTest() {
     assert(Poly<double>({std::pair<double, double>(2, 1)}) == lagrange);
 }
 
+void ColourValueTest() {
+    static_assert(std::is_trivially_copyable_v<ColourValue>);
+    static_assert(sizeof(ColourValue) == 3 * sizeof(ColourParameters::ColourType));
+    ColourValue value{0.25, 0.5, 1.5};
+    assert((value * 2 + ColourValue{0.5, 0, 0} == ColourValue{1, 1, 3}));
+    assert(("Saturation is explicit", value.Saturated() == ColourValue({0.25, 0.5, 1})));
+    assert(Pixel(value).GetColourValue() == value);
+
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    CropFilter(40, 30).ApplyToBitmap(bitmap);
+    Matrix<Pixel> reference = *bitmap.GetData();
+    Matrix<Pixel> result = reference;
+    reference.Convolution(Matrix<ManipulatorParameters::ManipulatorBaseType>(ManipulatorParameters::SharpeningFilterBase));
+    SharpeningFilter().Apply(result);
+    for (size_t y = 0; y < result.GetHeight(); ++y) {
+        for (size_t x = 0; x < result.GetWidth(); ++x) {
+            assert(("Value type convolution is exact",
+                    result.GetElement(x, y).GetColourValue() == reference.GetElement(x, y).GetColourValue()));
+        }
+    }
+}
+
+void SimdTest() {
+    // Every length covers the vector loops and their scalar tails.
+    std::mt19937 generator(17);
+    std::uniform_int_distribution<int> channel(0, 255);
+    std::uniform_real_distribution<double> real(-1, 1);
+    for (size_t size = 0; size <= 40; ++size) {
+        std::vector<int16_t> a16(size);
+        std::vector<int16_t> b16(size);
+        std::vector<int32_t> a32(size);
+        std::vector<int32_t> b32(size);
+        std::vector<double> x(size);
+        for (size_t j = 0; j < size; ++j) {
+            a16[j] = static_cast<int16_t>(channel(generator));
+            b16[j] = static_cast<int16_t>(channel(generator));
+            a32[j] = channel(generator) * 1000;
+            b32[j] = channel(generator) * 1000;
+            x[j] = real(generator);
+        }
+        for (bool is_paired : {false, true}) {
+            std::vector<int16_t> sum16(size, 5);
+            std::vector<int32_t> sum32(size, -5);
+            Simd::MultiplyAdd(sum16.data(), a16.data(), is_paired ? b16.data() : nullptr, -3, size);
+            Simd::MultiplyAdd(sum32.data(), a32.data(), is_paired ? b32.data() : nullptr, 7, size);
+            for (size_t j = 0; j < size; ++j) {
+                int expected16 = 5 - 3 * (a16[j] + (is_paired ? b16[j] : 0));
+                int64_t expected32 = -5 + 7 * (static_cast<int64_t>(a32[j]) + (is_paired ? b32[j] : 0));
+                assert(("Integer multiply-adds are exact", sum16[j] == expected16 && sum32[j] == expected32));
+            }
+        }
+        std::vector<double> answers(size, 0.5);
+        std::vector<double> numerators(size, 0.25);
+        std::vector<double> denominators(size, 1);
+        Simd::HornerStep(answers.data(), x.data(), 0.125, size);
+        Simd::BarycentricStep(numerators.data(), denominators.data(), x.data(), 2, 0.75, -1.5, size);
+        for (size_t j = 0; j < size; ++j) {
+            double term = 0.75 / (x[j] - 2);
+            assert(("Horner steps match the scalar ones", std::abs(answers[j] - (0.5 * x[j] + 0.125)) < 1e-15));
+            assert(("Barycentric steps match the scalar ones", std::abs(numerators[j] - (0.25 + term * -1.5)) < 1e-15 &&
+                                                                   std::abs(denominators[j] - (1 + term)) < 1e-15));
+        }
+    }
+}
+
+void PolyEvaluationTest() {
+    std::vector<double> xs;
+    std::vector<double> ys;
+    for (size_t i = 0; i <= 8; ++i) {
+        xs.push_back(i / 8.0);
+        ys.push_back(std::sin(3.0 * i / 8.0));
+    }
+    PixelLagrangePolynomial<double> expanded(xs, ys);
+    HornerPolynomial<double> horner(expanded);
+    BarycentricLagrangePolynomial<double> barycentric(xs, ys);
+    InplacePixelLagrangePolynomial<double> naive(xs, ys);
+
+    std::vector<double> points;
+    for (size_t i = 0; i <= 200; ++i) {
+        points.push_back(-0.1 + 1.2 * i / 200.0);
+    }
+    std::vector<double> horner_values(points.size());
+    std::vector<double> barycentric_values = points;
+    horner.Evaluate(points, horner_values);
+    barycentric.Evaluate(barycentric_values, barycentric_values);
+    for (size_t i = 0; i < points.size(); ++i) {
+        assert(("Horner's scheme is the map walk", horner_values[i] == expanded(points[i])));
+        assert(horner(points[i]) == horner_values[i]);
+        assert(("Barycentric form interpolates the same polynomial",
+                std::abs(barycentric_values[i] - expanded(points[i])) < 1e-9));
+        if (points[i] >= 0 && points[i] <= 1) {
+            assert(std::abs(barycentric_values[i] - naive(Pixel(points[i])).GetRed()) < 1e-9);
+        }
+    }
+    for (size_t i = 0; i < xs.size(); ++i) {
+        assert(("Nodes are hit exactly", barycentric(xs[i]) == ys[i]));
+    }
+    assert(("No nodes is the identity", BarycentricLagrangePolynomial<double>({}, {})(0.3) == 0.3));
+    bool is_thrown = false;
+    try {
+        BarycentricLagrangePolynomial<double>({0, 0}, {0, 1});
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(is_thrown);
+}
+
+void ResultCacheTest() {
+    std::filesystem::path directory = MakeTestDirectory("cache");
+    ResultCache cache(directory.string());
+
+    std::vector<std::string> params({"", "input.bmp", "output.bmp", "-blur", "5", "--cache-dir", "dir", "-sharp"});
+    char* argv[10];
+    std::transform(params.begin(), params.end(), std::begin(argv), [](std::string& a) { return &*a.begin(); });
+    CommandLineParser parser;
+    assert(parser.Parse(8, argv));
+    assert(parser.GetDescriptions().size() == 2);
+    assert(parser.GetOption("--cache-dir") == "dir");
+    std::vector<FilterDescriptor> descriptions = parser.GetDescriptions();
+
+    FilterDescriptor same_blur;
+    same_blur.SetFilterName("-blur");
+    same_blur.SetParams({"5"});
+    assert(same_blur.GetCanonicalForm() == descriptions[0].GetCanonicalForm());
+    FilterDescriptor median;
+    median.SetFilterName("-median");
+    median.SetParams({"10"});
+    FilterDescriptor other_median;
+    other_median.SetFilterName("-median");
+    other_median.SetParams({"1e1"});
+    assert(median.GetCanonicalForm() != other_median.GetCanonicalForm());
+
+    Bitmap image;
+    image.SetData(Matrix<Pixel>({{Pixel(0.1, 0.2, 0.3), Pixel(0.4, 0.5, 0.6)}, {Pixel(0.7), Pixel(0.8)}}));
+    uint64_t input_hash = ResultCache::HashBitmap(image);
+    Bitmap restored;
+    assert(cache.Restore(input_hash, descriptions, restored) == 0);
+    assert(cache.Store(cache.MakeKey(input_hash, descriptions, 1), image));
+    assert(cache.Restore(input_hash, descriptions, restored) == 1);
+    assert(restored.GetStorageFormat() == BitmapParameters::StorageFormat::Colours);
+    assert(*restored.GetData() == *image.GetData());
+    assert(cache.Restore(input_hash + 1, descriptions, restored) == 0);
+
+    // Every storage is kept as it is, 8-bit pictures take a byte per channel.
+    Bitmap bytes;
+    assert(bytes.load("../examples/notyan.bmp"));
+    Bitmap grey = bytes;
+    grey.Convert(BitmapParameters::StorageFormat::Greyscale);
+    Bitmap colours = bytes;
+    colours.Convert(BitmapParameters::StorageFormat::Colours);
+    BitMask bits(70, 3);
+    bits.SetElement(0, 0, true);
+    bits.SetElement(69, 2, true);
+    Bitmap two_colours;
+    two_colours.SetMask(std::move(bits), Pixel(0.1, 0.2, 0.3), Pixel(0.9));
+    for (Bitmap* stored : {&bytes, &grey, &colours, &two_colours}) {
+        std::string stored_key = cache.MakeKey(ResultCache::HashBitmap(*stored), descriptions, 1);
+        assert(cache.Store(stored_key, *stored));
+        Bitmap loaded;
+        assert(cache.Load(stored_key, loaded));
+        assert(("Entries keep the storage", loaded.GetStorageFormat() == stored->GetStorageFormat()));
+        if (stored == &bytes) {
+            size_t pixels = bytes.GetBytes()->GetWidth() * bytes.GetBytes()->GetHeight();
+            assert(("8-bit entries take a byte per channel",
+                    std::filesystem::file_size(cache.GetPath(stored_key)) < 3 * pixels + 1024));
+        }
+        if (stored == &two_colours) {
+            assert(*loaded.GetMask() == *two_colours.GetMask());
+            assert(loaded.GetMaskPalette() == two_colours.GetMaskPalette());
+        }
+        assert(("Entries keep the pixels", *loaded.GetBytes() == *stored->GetBytes()));
+    }
+
+    ResultCache small_cache(directory.string(), 0);
+    small_cache.Evict();
+    assert(cache.Restore(input_hash, descriptions, restored) == 0);
+
+    // Kernels read from files are keyed by what the file holds, not by its name.
+    std::string kernel_path = (directory / "kernel.txt").string();
+    std::ofstream(kernel_path) << "0 0 0\n0 1 0\n0 0 0\n";
+    FilterDescriptor convolution;
+    convolution.SetFilterName("-conv");
+    convolution.SetParams({kernel_path});
+    std::vector<FilterDescriptor> from_file = {convolution};
+    std::string key = cache.MakeKey(input_hash, from_file, 1);
+    assert(cache.Store(key, image));
+    assert(("The same file restores", cache.Restore(input_hash, from_file, restored) == 1));
+    std::ofstream(kernel_path) << "0 0 0\n0 -1 0\n0 0 0\n";
+    assert(("An edited file changes the key", cache.MakeKey(input_hash, from_file, 1) != key));
+    assert(("An edited file restores nothing", cache.Restore(input_hash, from_file, restored) == 0));
+
+    // So are the masks of regions.
+    std::string mask_path = (directory / "mask.bmp").string();
+    Bitmap mask;
+    mask.SetBytes(Matrix<Bitmap::PrimitivePixel>(2, 2));
+    assert(mask.save(mask_path.c_str()));
+    FilterDescriptor region;
+    region.SetFilterName("-roi-mask");
+    region.SetParams({mask_path});
+    FilterDescriptor negative;
+    negative.SetFilterName("-neg");
+    std::vector<FilterDescriptor> masked = {region, negative};
+    key = cache.MakeKey(input_hash, masked, 2);
+    mask.GetBytes()->GetElement(0, 0) = {255, 255, 255};
+    assert(mask.save(mask_path.c_str()));
+    assert(("An edited mask changes the key", cache.MakeKey(input_hash, masked, 2) != key));
+
+    // A second run restores nothing past the first -stats, so every report is written again.
+    std::string first_report = (directory / "first.txt").string();
+    std::string second_report = (directory / "second.txt").string();
+    std::vector<std::string> run_params({"", "../examples/gradient.bmp", (directory / "stats.bmp").string(), "-stats",
+                                         first_report, "-neg", "-stats", second_report, "--cache-dir",
+                                         (directory / "runs").string()});
+    std::transform(run_params.begin(), run_params.end(), std::begin(argv), [](std::string& a) { return &*a.begin(); });
+    Application application;
+    application.Configure();
+    for (size_t run = 0; run < 2; ++run) {
+        std::filesystem::remove(first_report);
+        std::filesystem::remove(second_report);
+        application.Run(10, argv);
+        assert(("Every report is written", std::filesystem::exists(first_report)));
+        assert(("Every report is written", std::filesystem::exists(second_report)));
+    }
+    // Cached stages run in the storage the filters accept, as an uncached run does.
+    run_params[2] = (directory / "plain.bmp").string();
+    argv[2] = run_params[2].data();
+    application.Run(8, argv);
+    Bitmap cached;
+    Bitmap plain;
+    assert(cached.load((directory / "stats.bmp").string().c_str()));
+    assert(plain.load(argv[2]));
+    assert(("Cached and uncached runs agree", *cached.GetBytes() == *plain.GetBytes()));
+    run_params.insert(run_params.end(), {"--cache-size", "-1"});
+    run_params[2] = (directory / "refused.bmp").string();
+    std::vector<char*> refused_argv;
+    std::transform(run_params.begin(), run_params.end(), std::back_inserter(refused_argv),
+                   [](std::string& a) { return &*a.begin(); });
+    application.Run(static_cast<int>(refused_argv.size()), refused_argv.data());
+    assert(("Negative cache sizes are refused", !std::filesystem::exists(run_params[2])));
+    std::filesystem::remove_all(directory);
+}
+
+void FilterGraphTest() {
+    std::filesystem::path directory = MakeTestDirectory("graph");
+    std::vector<std::string> params({"", "../examples/gradient.bmp", (directory / "graph_neg.bmp").string(), "-crop",
+                                     "8", "8", "-neg", "--output", (directory / "graph_double_neg.bmp").string(),
+                                     "-crop", "8", "8", "-neg", "-neg", "--output",
+                                     (directory / "graph_source.bmp").string()});
+    char* argv[16];
+    std::transform(params.begin(), params.end(), std::begin(argv), [](std::string& a) { return &*a.begin(); });
+    CommandLineParser parser;
+    assert(parser.Parse(16, argv));
+    assert(parser.GetBranches().size() == 3);
+    assert(parser.GetDescriptions().size() == 2);
+
+    FilterPipelineMaker fpm;
+    fpm.AddFilterCreator("-crop", &FilterMakers::MakeCropFilter);
+    fpm.AddFilterCreator("-neg", &FilterMakers::MakeNegativeFilter);
+    FilterGraph graph = fpm.BuildGraph(parser.GetBranches());
+    assert(graph.GetNodes().size() == 4);  // source, shared crop, shared negative, second negative
+
+    Bitmap input;
+    assert(input.load(argv[1]));
+    assert(graph.Apply(input).empty());
+    Bitmap negative;
+    Bitmap double_negative;
+    Bitmap source;
+    assert(negative.load(argv[2]));
+    assert(double_negative.load(argv[8]));
+    assert(source.load(argv[15]));
+    assert(negative.GetData()->GetWidth() == 8 && double_negative.GetData()->GetHeight() == 8);
+    assert(source.GetData()->GetSize() == input.GetData()->GetSize());
+    assert(negative.GetData()->GetElement(0, 0) != double_negative.GetData()->GetElement(0, 0));
+
+    // strtol reads "1e1" as 1, so the two crops differ and must not share a node.
+    std::vector<std::string> spellings({"", "../examples/gradient.bmp", (directory / "graph_ten.bmp").string(),
+                                        "-crop", "10", "8", "--output", (directory / "graph_one.bmp").string(),
+                                        "-crop", "1e1", "8"});
+    std::transform(spellings.begin(), spellings.end(), std::begin(argv), [](std::string& a) { return &*a.begin(); });
+    CommandLineParser spellings_parser;
+    assert(spellings_parser.Parse(11, argv));
+    FilterGraph spellings_graph = fpm.BuildGraph(spellings_parser.GetBranches());
+    assert(spellings_graph.GetNodes().size() == 3);
+    assert(spellings_graph.Apply(input).empty());
+    Bitmap ten;
+    Bitmap one;
+    assert(ten.load(argv[2]));
+    assert(one.load(argv[7]));
+    assert(ten.GetData()->GetWidth() == 10 && one.GetData()->GetWidth() == 1);
+    std::filesystem::remove_all(directory);
+}
+
+void BatchTest() {
+    // The queue hands over every value in order between two threads, and refuses values beyond its capacity.
+    SpscQueue<size_t> queue(3);
+    size_t value = 1;
+    for (size_t i = 0; i < 3; ++i) {
+        assert(("Values fit up to the capacity", queue.TryPush(value)));
+    }
+    assert(("A full queue refuses values", !queue.TryPush(value)));
+    while (queue.TryPop(value)) {
+    }
+    const size_t count = 100000;
+    std::future<void> producer = std::async(std::launch::async, [&queue] {
+        for (size_t i = 0; i < count; ++i) {
+            queue.Push(i);
+        }
+    });
+    for (size_t i = 0; i < count; ++i) {
+        assert(("Values come in order", queue.Pop() == i));
+    }
+    producer.get();
+    assert(("The queue is drained", !queue.TryPop(value)));
+
+    // A directory of pictures gives the same files as processing them one by one, a broken file fails alone.
+    std::filesystem::path directory = MakeTestDirectory("batch");
+    std::filesystem::path input = directory / "in";
+    std::filesystem::path output = directory / "out";
+    std::filesystem::create_directories(input);
+    std::filesystem::create_directories(output);
+    for (const char* name : {"b.bmp", "a.bmp", "c.bmp"}) {
+        std::filesystem::copy_file("../examples/gradient.bmp", input / name);
+    }
+    std::ofstream(input / "broken.bmp") << "not a picture";
+    std::ofstream(input / "notes.txt") << "not listed";
+    std::vector<Batch::Job> jobs = Batch::ListDirectory(input, output);
+    assert(("Pictures are listed by name", jobs.size() == 4 && jobs[0].output == (output / "a.bmp").string() &&
+                                               jobs[3].input == (input / "c.bmp").string()));
+    assert(("Small budgets leave one picture per queue", Batch::GetQueueDepth(jobs, 1, 8) == 1));
+    assert(("Large budgets keep the asked depth", Batch::GetQueueDepth(jobs, SIZE_MAX, 8) == 8));
+    Bitmap gradient;
+    assert(gradient.load("../examples/gradient.bmp"));
+    size_t picture = gradient.GetData()->GetWidth() * gradient.GetData()->GetHeight() * sizeof(Pixel);
+    assert(("The budget covers the queues and the stages",
+            Batch::GetQueueDepth(jobs, picture * (BatchParameters::PICTURES_IN_STAGES + 4), 8) == 2));
+
+    NegativeFilter negative;
+    std::vector<std::string> failed = Batch::Run(
+        jobs, 1, [](const std::string& path, Bitmap& bitmap) { return bitmap.load(path.c_str()); },
+        [&negative](Bitmap& bitmap) { negative.ApplyToBitmap(bitmap); },
+        [](const std::string& path, Bitmap& bitmap) { return bitmap.save(path.c_str()); });
+    assert(("Only the broken file fails", failed == std::vector<std::string>{(output / "broken.bmp").string()}));
+    negative.ApplyToBitmap(gradient);
+    const Matrix<Bitmap::PrimitivePixel>& expected = *gradient.GetBytes();
+    for (const char* name : {"a.bmp", "b.bmp", "c.bmp"}) {
+        Bitmap result;
+        assert(result.load((output / name).string().c_str()));
+        assert(("Results match one by one processing", *result.GetBytes() == expected));
+    }
+
+    // Failures of the filters and of saving are reported too.
+    failed = Batch::Run(
+        jobs, 2, [](const std::string& path, Bitmap& bitmap) { return bitmap.load(path.c_str()); },
+        [](Bitmap&) { throw std::logic_error("the filter fails"); },
+        [](const std::string&, Bitmap&) { return true; });
+    assert(("Every job fails", failed.size() == 4));
+    std::filesystem::remove_all(directory);
+}
+
+void MemoryBudgetTest() {
+    Bitmap::BMPHeader bmp_header;
+    Bitmap::DIBHeader dib_header;
+    assert(Bitmap::ReadHeaders("../examples/notyan.bmp", bmp_header, dib_header));
+    FastGaussianBlurFilter blur(2);
+    SharpeningFilter sharpening;
+    NegativeFilter negative;
+    std::vector<Manipulator*> filters = {&blur, &sharpening, &negative};
+    BitmapParameters::StorageFormat precision;
+    size_t peak = MemoryBudget::EstimatePeak(dib_header, filters, 0, 0, precision);
+    assert(("The estimate covers the picture", peak > MemoryBudget::GetStorageSize(precision, dib_header.width,
+                                                                                     std::abs(dib_header.height))));
+
+    // Large budgets keep the picture in memory, smaller ones stream it in strips, then filter by filter.
+    MemoryBudget::Plan plan = MemoryBudget::MakePlan(dib_header, filters, peak, true);
+    assert(("The picture fits in memory", plan.strategy == MemoryBudgetParameters::Strategy::InMemory));
+    plan = MemoryBudget::MakePlan(dib_header, filters, peak / 2, true);
+    assert(("Strips stay within the budget",
+            plan.strategy == MemoryBudgetParameters::Strategy::Strips && plan.peak <= peak / 2));
+    // Filter by filter the strips of two medians need the halo of one of them.
+    MedianFilter first_median(6);
+    MedianFilter second_median(6);
+    std::vector<Manipulator*> medians = {&first_median, &second_median, &negative};
+    size_t medians_peak = MemoryBudget::EstimatePeak(dib_header, medians, 0, 0, precision);
+    MemoryBudget::Plan spill = MemoryBudget::MakePlan(dib_header, medians, medians_peak / 20, true);
+    assert(("Spilling stays within the budget",
+            spill.strategy == MemoryBudgetParameters::Strategy::Spill && spill.peak <= medians_peak / 20));
+    bool is_thrown = false;
+    try {
+        MemoryBudget::MakePlan(dib_header, filters, peak / 2, false);
+    } catch (const std::runtime_error&) {
+        is_thrown = true;
+    }
+    assert(("Nothing fits without streaming", is_thrown));
+    CropFilter crop(10, 10);
+    std::vector<Manipulator*> cropped = {&crop, &negative};
+    is_thrown = false;
+    try {
+        MemoryBudget::MakePlan(dib_header, cropped, 1, true);
+    } catch (const std::runtime_error&) {
+        is_thrown = true;
+    }
+    assert(("Filters changing the size are not streamed", is_thrown));
+    BilateralFilter bilateral(8, 0.1);
+    std::vector<Manipulator*> smoothed = {&bilateral};
+    size_t smoothed_peak = MemoryBudget::EstimatePeak(dib_header, smoothed, 0, 0, precision);
+    assert(("The bilateral filter fits in memory", MemoryBudget::MakePlan(dib_header, smoothed, smoothed_peak, true)
+                                                           .strategy == MemoryBudgetParameters::Strategy::InMemory));
+    is_thrown = false;
+    try {
+        MemoryBudget::MakePlan(dib_header, smoothed, smoothed_peak / 2, true);
+    } catch (const std::runtime_error&) {
+        is_thrown = true;
+    }
+    assert(("The grids of strips would differ from the whole picture's, the bilateral filter is not streamed",
+            is_thrown));
+
+    // Streamed results are those of the whole picture.
+    std::filesystem::path output = std::filesystem::temp_directory_path() / "image_processor_memory_budget.bmp";
+    for (const auto& [streamed, chain] : {std::make_pair(plan, filters), std::make_pair(spill, medians)}) {
+        Bitmap expected;
+        assert(expected.load("../examples/notyan.bmp"));
+        for (Manipulator* filter : chain) {
+            filter->ApplyToBitmap(expected);
+        }
+        std::filesystem::remove(output);
+        assert(MemoryBudget::Stream(streamed, "../examples/notyan.bmp", output.string(), chain));
+        Bitmap result;
+        assert(result.load(output.string().c_str()));
+        assert(("Strips match the whole picture", *result.GetBytes() == *expected.GetBytes()));
+    }
+    assert(("Spilled pictures are removed",
+            !std::filesystem::exists(output.string() + ".spill0") &&
+                !std::filesystem::exists(output.string() + ".spill1")));
+
+    // A blur leaves doubles that are spilled as they are; only if strips of them do not fit are they rounded to
+    // 8-bit, the median then filtering bytes.
+    FastGaussianBlurFilter small_blur(1);
+    std::vector<Manipulator*> blurred = {&small_blur, &first_median};
+    size_t blurred_peak = MemoryBudget::EstimatePeak(dib_header, blurred, 0, 0, precision);
+    std::vector<MemoryBudget::Plan> spills;
+    for (size_t budget = blurred_peak; spills.size() < 2; budget = budget * 19 / 20) {
+        MemoryBudget::Plan blurred_plan = MemoryBudget::MakePlan(dib_header, blurred, budget, true);
+        bool is_rounded = blurred_plan.spill_precision != blurred_plan.precision;
+        if (blurred_plan.strategy == MemoryBudgetParameters::Strategy::Spill && is_rounded == !spills.empty()) {
+            assert(("The budget holds", blurred_plan.peak <= budget));
+            spills.push_back(blurred_plan);
+        }
+    }
+    Bitmap expected;
+    assert(expected.load("../examples/notyan.bmp"));
+    for (Manipulator* filter : blurred) {
+        filter->ApplyToBitmap(expected);
+    }
+    for (const MemoryBudget::Plan& blurred_plan : spills) {
+        assert(MemoryBudget::Stream(blurred_plan, "../examples/notyan.bmp", output.string(), blurred));
+        Bitmap result;
+        assert(result.load(output.string().c_str()));
+        const Matrix<Bitmap::PrimitivePixel>& bytes = *result.GetBytes();
+        int most = 0;
+        for (size_t y = 0; y < bytes.GetHeight(); ++y) {
+            for (size_t x = 0; x < bytes.GetWidth(); ++x) {
+                most = std::max(most, std::abs(bytes.GetElement(x, y).green -
+                                               expected.GetBytes()->GetElement(x, y).green));
+            }
+        }
+        if (blurred_plan.spill_precision == blurred_plan.precision) {
+            assert(("Spilling at the filters' precision matches the whole picture", most == 0));
+        } else {
+            assert(("Rounding between the filters is off by at most one", most <= 1));
+        }
+    }
+
+    // Files shorter than their headers promise are refused before the pixels are allocated.
+    std::ifstream source("../examples/notyan.bmp", std::ios_base::binary);
+    std::string bytes((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    std::ofstream(output, std::ios_base::binary) << bytes.substr(0, bytes.size() / 2);
+    Bitmap truncated;
+    assert(("Truncated files are refused", !truncated.load(output.string().c_str())));
+    std::filesystem::remove(output);
+
+    // Budgets that are not a number of MiB, or overflow in bytes, are refused instead of wrapping around.
+    Application application;
+    application.Configure();
+    for (std::string budget : {"abc", "-8", "17592186044416"}) {
+        std::vector<std::string> params({"", "../examples/notyan.bmp", output.string(), "-neg", "--max-memory", budget});
+        std::vector<char*> argv;
+        std::transform(params.begin(), params.end(), std::back_inserter(argv), [](std::string& a) { return &*a.begin(); });
+        application.Run(static_cast<int>(argv.size()), argv.data());
+        assert(("Invalid budgets are refused", !std::filesystem::exists(output)));
+    }
+}
+
+void ImageProcessorApiTest() {
+    const size_t width = 3;
+    const size_t height = 2;
+    const size_t stride = 16;  // rows are padded
+    std::vector<uint8_t> input(stride * height, 7);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            uint8_t* pixel = input.data() + y * stride + 4 * x;
+            pixel[0] = 10 * x;   // blue
+            pixel[1] = 100;      // green
+            pixel[2] = 200 + y;  // red
+            pixel[3] = 0;
+        }
+    }
+    ImageProcessor::ImageView view{input.data(), width, height, stride, ImageProcessor::PixelFormat::BGRA32};
+
+    ImageProcessor::Processor identity;
+    std::vector<uint8_t> copy(stride * height, 7);
+    identity.Run(view, {copy.data(), width, height, stride, ImageProcessor::PixelFormat::BGRA32});
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t channel = 0; channel < 3; ++channel) {
+                assert(copy[y * stride + 4 * x + channel] == input[y * stride + 4 * x + channel]);
+            }
+            assert(copy[y * stride + 4 * x + 3] == UINT8_MAX);
+        }
+        assert(copy[y * stride + 4 * width] == 7);
+    }
+
+    ImageProcessor::Processor processor;
+    processor.AddFilter("-neg").AddFilter("-crop", {"2", "1"});
+    assert(processor.GetSize() == 2);
+    ImageProcessor::Image result = processor.Run(view);
+    assert(result.GetWidth() == 2 && result.GetHeight() == 1);
+    std::vector<uint8_t> rgb(6);
+    result.CopyTo({rgb.data(), 2, 1, 6, ImageProcessor::PixelFormat::RGB24});
+    assert(rgb[0] == 55 && rgb[1] == 155 && rgb[2] == 255 && rgb[5] == 245);
+
+    // Wrappers apply to the next filter, as on the command line, and user filters are handed over as they are.
+    ImageProcessor::Processor region;
+    region.AddFilter("-roi", {"1", "0", "1", "2"}).AddFilter("-neg").AddFilter(std::make_unique<CropFilter>(2, 2));
+    assert(region.GetSize() == 2);
+    ImageProcessor::Image framed = region.Run(view);
+    assert(framed.GetWidth() == 2 && framed.GetHeight() == 2);
+    std::vector<uint8_t> framed_rgb(12);
+    framed.CopyTo({framed_rgb.data(), 2, 2, 6, ImageProcessor::PixelFormat::RGB24});
+    assert(("Pixels outside the region are kept", framed_rgb[0] == 200 && framed_rgb[2] == 0));
+    assert(("Pixels inside the region are filtered", framed_rgb[3] == 55 && framed_rgb[5] == 245));
+    assert(framed_rgb[9] == 54 && framed_rgb[11] == 245);
+
+    bool is_thrown = false;
+    try {
+        ImageProcessor::Processor dangling;
+        dangling.AddFilter("-neg").AddFilter("-roi", {"0", "0", "1", "1"});
+        dangling.Run(view);
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(("A wrapper without a filter to wrap is reported", is_thrown));
+    is_thrown = false;
+    try {
+        processor.AddFilter("-no-such-filter");
+    } catch (const std::invalid_argument& e) {
+        is_thrown = true;
+    }
+    assert(("Unknown filters are reported", is_thrown));
+    is_thrown = false;
+    try {
+        result.CopyTo({rgb.data(), 1, 1, 6, ImageProcessor::PixelFormat::RGB24});
+    } catch (const std::length_error& e) {
+        is_thrown = true;
+    }
+    assert(("Buffers of other sizes are rejected", is_thrown));
+}
+
+void LazyStorageTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/gradient.bmp"));
+    assert(bitmap.GetStorageFormat() == BitmapParameters::StorageFormat::Bytes);
+
+    FilterPipelineMaker fpm;
+    FilterMakers::RegisterFilterCreators(fpm);
+    FilterDescriptor crop;
+    crop.SetFilterName("-crop");
+    crop.SetParams({"100", "50"});
+    FilterDescriptor negative;
+    negative.SetFilterName("-neg");
+    FilterDescriptor blur;
+    blur.SetFilterName("-blur");
+
+    FilterPipeline byte_pipeline = fpm.BuildPipeline({crop, negative});
+    Bitmap bytes_result = byte_pipeline.Apply(bitmap);
+    assert(("Byte-friendly pipelines are never promoted",
+            bytes_result.GetStorageFormat() == BitmapParameters::StorageFormat::Bytes));
+    Bitmap colours_input = bitmap;
+    colours_input.Convert(BitmapParameters::StorageFormat::Colours);
+    Bitmap colours_result = byte_pipeline.Apply(colours_input);
+    assert(colours_result.GetStorageFormat() == BitmapParameters::StorageFormat::Colours);
+    assert(("8-bit and double paths agree", *bytes_result.GetBytes() == *colours_result.GetBytes()));
+
+    FilterPipeline mixed_pipeline = fpm.BuildPipeline({crop, blur, negative});
+    Bitmap mixed_result = mixed_pipeline.Apply(bitmap);
+    assert(mixed_result.GetStorageFormat() == BitmapParameters::StorageFormat::Colours);
+    assert(mixed_result.GetData()->GetWidth() == 100 && mixed_result.GetData()->GetHeight() == 50);
+
+    Matrix<Bitmap::PrimitivePixel> source = *bitmap.GetBytes();
+    bitmap.Convert(BitmapParameters::StorageFormat::Colours);
+    assert(("Promotion and demotion are lossless", *bitmap.GetBytes() == source));
+}
+
+void GreyscaleStorageTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/gradient.bmp"));
+
+    FilterPipelineMaker fpm;
+    FilterMakers::RegisterFilterCreators(fpm);
+    FilterDescriptor crop;
+    crop.SetFilterName("-crop");
+    crop.SetParams({"64", "48"});
+    FilterDescriptor greyscale;
+    greyscale.SetFilterName("-gs");
+    FilterDescriptor sharp;
+    sharp.SetFilterName("-sharp");
+    FilterDescriptor blur;
+    blur.SetFilterName("-blur");
+    blur.SetParams({"1"});
+    FilterDescriptor curves;
+    curves.SetFilterName("-curves");
+    curves.SetParams({"0", "0", "0.5", "0.6", "1", "1"});
+    FilterDescriptor edge;
+    edge.SetFilterName("-edge");
+    edge.SetParams({"0.05"});
+
+    for (const std::vector<FilterDescriptor>& descriptions :
+         {std::vector<FilterDescriptor>{crop, greyscale, sharp, blur, curves},
+          std::vector<FilterDescriptor>{crop, edge, sharp}}) {
+        FilterPipeline pipeline = fpm.BuildPipeline(descriptions);
+        Bitmap plane_result = pipeline.Apply(bitmap);
+        assert(("Greyscale filters keep a single plane",
+                plane_result.GetStorageFormat() == BitmapParameters::StorageFormat::Greyscale));
+        Bitmap colours_result = bitmap;
+        pipeline.Apply(*colours_result.GetData());
+        assert(("Single plane and three channels agree", *plane_result.GetBytes() == *colours_result.GetBytes()));
+    }
+
+    FilterPipeline pipeline = fpm.BuildPipeline({crop, greyscale});
+    Bitmap result = pipeline.Apply(bitmap);
+    result.SetOutputBitsPerPixel(BitmapParameters::GREYSCALE_BITS_PER_PIXEL);
+    assert(result.save("greyscale_test.bmp"));
+    Bitmap loaded;
+    assert(loaded.load("greyscale_test.bmp"));
+    std::filesystem::remove("greyscale_test.bmp");
+    assert(loaded.GetDIBHeader().bits_per_pixel == BitmapParameters::GREYSCALE_BITS_PER_PIXEL);
+    assert(("Grey palettes are loaded as a single plane",
+            loaded.GetStorageFormat() == BitmapParameters::StorageFormat::Greyscale));
+    assert(("8-bit greyscale files round trip", *loaded.GetBytes() == *result.GetBytes()));
+}
+
+void EdgeMaskTest() {
+    Bitmap bitmap;
+    assert(bitmap.load("../examples/notyan.bmp"));
+    CropFilter(96, 80).ApplyToBitmap(bitmap);
+    double threshold = 0.05;
+
+    Matrix<Pixel> reference = *Bitmap(bitmap).GetData();
+    for (size_t y = 0; y < reference.GetHeight(); ++y) {
+        for (size_t x = 0; x < reference.GetWidth(); ++x) {
+            reference.GetElement(x, y).ToGreyscale();
+        }
+    }
+    reference.Convolution(Matrix<ManipulatorParameters::ManipulatorBaseType>(
+        ManipulatorParameters::EdgeDetectionFilterBase));
+    size_t edges = 0;
+    for (BitmapParameters::StorageFormat format :
+         {BitmapParameters::StorageFormat::Bytes, BitmapParameters::StorageFormat::Colours}) {
+        Bitmap result = bitmap;
+        result.Convert(format);
+        EdgeDetectionFilter(threshold).ApplyToBitmap(result);
+        assert(result.GetStorageFormat() == BitmapParameters::StorageFormat::Mask);
+        const BitMask& mask = *result.GetMask();
+        edges = 0;
+        for (size_t y = 0; y < reference.GetHeight(); ++y) {
+            for (size_t x = 0; x < reference.GetWidth(); ++x) {
+                assert(("Fused edges agree with convolution",
+                        mask.GetElement(x, y) == (reference.GetElement(x, y).GetRed() >= threshold)));
+                edges += mask.GetElement(x, y);
+            }
+        }
+    }
+    assert(edges > 0 && edges < reference.GetWidth() * reference.GetHeight());
+
+    Bitmap result = bitmap;
+    EdgeDetectionFilter(threshold).ApplyToBitmap(result);
+    result.SetOutputBitsPerPixel(BitmapParameters::MASK_BITS_PER_PIXEL);
+    assert(result.save("edge_mask_test.bmp"));
+    assert(("Masks take one bit per pixel", std::filesystem::file_size("edge_mask_test.bmp") ==
+                                                 sizeof(Bitmap::BMPHeader) + sizeof(Bitmap::DIBHeader) + 8 + 12 * 80));
+    Bitmap loaded;
+    assert(loaded.load("edge_mask_test.bmp"));
+    std::filesystem::remove("edge_mask_test.bmp");
+    assert(loaded.GetStorageFormat() == BitmapParameters::StorageFormat::Mask);
+    assert(("1-bit files round trip", *loaded.GetMask() == *result.GetMask()));
+    assert(*loaded.GetBytes() == *result.GetBytes());
+}
+
 void LeakCheckTest() {
 
 }
@@ -230,12 +2247,38 @@ void Testing() {
 
     TestWrapper(PixelTest, "Pixel logic test");
     TestWrapper(MatrixTest, "Matrix logic + convolution test");
+    TestWrapper(MatrixRowsTest, "Matrix rows and parallel algorithms test");
+    TestWrapper(RegionOfInterestTest, "Region of interest test");
+    TestWrapper(RegionFilterTest, "Region filter test");
+    TestWrapper(FftConvolutionTest, "FFT convolution test");
+    TestWrapper(ConvolutionFilterTest, "User convolution filter test");
+    TestWrapper(IntegerConvolutionTest, "Integer convolution test");
+    TestWrapper(GaussianBlurTest, "Precise Gaussian blur test");
+    TestWrapper(PyramidGaussianBlurTest, "Pyramid Gaussian blur test");
+    TestWrapper(MedianTest, "Median filter test");
+    TestWrapper(ResizeTest, "Resize test");
+    TestWrapper(BilateralTest, "Bilateral test");
+    TestWrapper(IntegralTest, "Integral test");
+    TestWrapper(MorphologyTest, "Morphology test");
+    TestWrapper(OrientationTest, "Orientation test");
+    TestWrapper(StatisticsTest, "Statistics test");
     TestWrapper(CommandLineParserTest, "CommandLineParser test");
     TestWrapper(FilterPipelineMakerTest, "FilterPipelineMaker test");
     TestWrapper(ManipulatorTest, "Manipulator test");
     TestWrapper(BitmapTest, "Bitmap test");
     TestWrapper(PolyTest, "Polynomial test");
     TestWrapper(LagrangePolyTest, "Lagrange polynomial test");
+    TestWrapper(PolyEvaluationTest, "Horner and barycentric evaluation test");
+    TestWrapper(SimdTest, "Vector loops test");
+    TestWrapper(ColourValueTest, "Pixel value type test");
+    TestWrapper(ResultCacheTest, "Result cache test");
+    TestWrapper(FilterGraphTest, "Filter graph test");
+    TestWrapper(BatchTest, "Batch pipelining test");
+    TestWrapper(MemoryBudgetTest, "Memory budget test");
+    TestWrapper(ImageProcessorApiTest, "In-memory API test");
+    TestWrapper(LazyStorageTest, "Lazy 8-bit storage test");
+    TestWrapper(GreyscaleStorageTest, "Single-plane greyscale test");
+    TestWrapper(EdgeMaskTest, "Fused edge detection mask test");
 
     std::cout << std::endl << "---------------------" << std::endl;
     std::cout << "Tests passed successfully!" << std::endl;